@@ -16,9 +16,8 @@ class OptimizedTrigger {
         return result;
     }
     
-    // Use DMA for audio input to reduce CPU load
-    void setupDMA() {
-        // Configure DMA for automatic audio buffer filling
-        // This runs in background without CPU intervention
-    }
+    // Audio input is already DMA driven (AudioInputI2S fills its blocks
+    // without the CPU). The cost is analysis inside the audio interrupt:
+    // feed the analyser through an AudioAnalysisTap and run it from an
+    // AnalysisTask (analysis_task.h) at a lower priority instead.
 };
\ No newline at end of file
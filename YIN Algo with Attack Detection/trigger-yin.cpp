@@ -2,45 +2,92 @@
 #include <Audio.h>
 #include <Wire.h>
 #include <SPI.h>
+#include <arm_math.h>
+#include <block_features.h>
+#include <drum_map.h>
+#include <midi_out.h>
+#include <event_log.h>
+
+// Power-of-two ring of samples where every sample is stored twice, at i and
+// i + N. The newest `len` samples are therefore always one contiguous run
+// starting at latest(len): no modulo when reading, no copy to linearise.
+template <int N>
+class MirroredRing {
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+public:
+    void write(const int16_t* src, int count) {
+        while (count > 0) {
+            int run = min(count, N - writeIndex);
+            memcpy(data + writeIndex, src, run * sizeof(int16_t));
+            memcpy(data + writeIndex + N, src, run * sizeof(int16_t));
+            writeIndex = (writeIndex + run) & (N - 1);
+            src += run;
+            count -= run;
+        }
+    }
+    
+    // Oldest of the newest len samples (len <= N), in time order
+    const int16_t* latest(int len) const {
+        return data + writeIndex + N - len;
+    }
+    
+private:
+    alignas(4) int16_t data[2 * N] = {0};
+    int writeIndex = 0;
+};
+
+// Bass guitar ranges (E1 to B2) -> sample index, compiled to a lookup table
+constexpr DrumBand BASS_BANDS[12] = {
+    {  39.0f,  43.0f,  0, 0 },  // E1
+    {  43.5f,  47.5f,  1, 0 },  // F1
+    {  48.0f,  52.0f,  2, 0 },  // G1
+    {  52.5f,  57.5f,  3, 0 },  // A1
+    {  58.0f,  63.0f,  4, 0 },  // B1
+    {  63.5f,  69.5f,  5, 0 },  // C2
+    {  70.0f,  76.0f,  6, 0 },  // D2
+    {  76.5f,  83.5f,  7, 0 },  // E2
+    {  84.0f,  91.0f,  8, 0 },  // F2
+    {  91.5f,  99.5f,  9, 0 },  // G2
+    { 100.0f, 108.0f, 10, 0 },  // A2
+    { 108.5f, 118.5f, 11, 0 },  // B2
+};
+constexpr DrumMap<12> BASS_MAP(BASS_BANDS);
+
+// Bass notes on channel 1 over USB and Serial1 (5-pin DIN)
+MidiOut midi;
+
+// Hits are printed from the end of loop(), never on the trigger path
+EventLog events;
 
 class GuitarTrigger {
 private:
     static const int SAMPLE_RATE = 44100;
     static const int BUFFER_SIZE = 2048;  // ~46ms at 44.1kHz
-    static const int YIN_BUFFER_SIZE = 512;  // For YIN algorithm
+    static const int YIN_FFT_SIZE = BUFFER_SIZE;  // Cross-correlation FFT
+    static const int YIN_BUFFER_SIZE = 1280;      // Longest lag + 2 (~35 Hz)
     
-    float audioBuffer[BUFFER_SIZE];
+    MirroredRing<BUFFER_SIZE> ring;
     float yinBuffer[YIN_BUFFER_SIZE];
-    int bufferIndex = 0;
     
-    // Frequency ranges for triggers (customize these)
-    struct NoteRange {
-        float minFreq;
-        float maxFreq;
-        int sampleIndex;
-        int midiNote;
-    };
+    // YIN lag search, set from the string range by setPitchRange()
+    int tauMin = 0;
+    int tauMax = 0;
+    
+    // FFT scratch for the difference function
+    arm_rfft_fast_instance_f32 fftInstance;
+    float pitchFrame[YIN_FFT_SIZE];
+    float fftSignal[YIN_FFT_SIZE];
+    float fftWindow[YIN_FFT_SIZE];
+    float fftTemp[YIN_FFT_SIZE];
     
-    // Bass guitar ranges (E1 to G3)
-    NoteRange bassRanges[12] = {
-        {39.0, 43.0, 0, 28},   // E1
-        {43.5, 47.5, 1, 29},   // F1
-        {48.0, 52.0, 2, 31},   // G1
-        {52.5, 57.5, 3, 33},   // A1
-        {58.0, 63.0, 4, 35},   // B1
-        {63.5, 69.5, 5, 36},   // C2
-        {70.0, 76.0, 6, 38},   // D2
-        {76.5, 83.5, 7, 40},   // E2
-        {84.0, 91.0, 8, 41},   // F2
-        {91.5, 99.5, 9, 43},   // G2
-        {100.0, 108.0, 10, 45}, // A2
-        {108.5, 118.5, 11, 47}  // B2
-    };
+    // MIDI note of each BASS_BANDS range (customize these)
+    const uint8_t bassMidiNotes[12] = { 28, 29, 31, 33, 35, 36, 38, 40, 41, 43, 45, 47 };
     
     // State tracking
     float lastFrequency = 0;
     float lastAmplitude = 0;
     bool noteActive = false;
+    int lastNote = -1;                     // MIDI note held, -1 for none
     unsigned long lastTriggerTime = 0;
     const unsigned int RETRIGGER_TIME = 50; // ms minimum between triggers
     
@@ -49,34 +96,88 @@ private:
     int energyHistoryIndex = 0;
     float lastEnergy = 0;
     
+    // Fixed-point features of the last two blocks, from detectPluck()
+    BlockFeatures olderBlock, newestBlock;
+    
+    // A pluck waiting for enough of its own note in the ring to pitch it;
+    // on the onset block the frame is nearly all the note before
+    static const int PITCH_MIN_SAMPLES = 1536;  // ~35ms, a low E window
+    bool pluckPending = false;
+    int pendingSamples = 0;                     // since the onset block
+    float pendingVelocity = 0;
+    
 public:
-    // Optimized YIN implementation for Teensy
-    float detectPitch(float* buffer, int bufferSize) {
+    GuitarTrigger() {
+        arm_rfft_fast_init_f32(&fftInstance, YIN_FFT_SIZE);
+        setPitchRange(BASS_BANDS[0].minHz, BASS_BANDS[11].maxHz);
+    }
+    
+    // millis() and pitch of the latest trigger
+    unsigned long lastTriggered() const { return lastTriggerTime; }
+    float lastTriggerFrequency() const { return lastFrequency; }
+    
+    // Limit the YIN lag search to the instrument's range
+    void setPitchRange(float minFreq, float maxFreq) {
+        tauMin = max(2, (int)(SAMPLE_RATE / maxFreq));
+        tauMax = min(YIN_BUFFER_SIZE - 2, (int)(SAMPLE_RATE / minFreq) + 1);
+    }
+    
+    // YIN on the most recent YIN_FFT_SIZE samples of buffer.
+    //
+    // Difference function over a window of W = n - 1 - tauMax samples:
+    //   d(tau) = sum x[i]^2 + sum x[i+tau]^2 - 2 * sum x[i] x[i+tau]
+    // The two energies slide one sample per lag; the cross term for every
+    // lag comes from one FFT cross-correlation (three 2048-point real FFTs)
+    // instead of the old O(N^2) loop. i + tau never leaves the buffer.
+    float detectPitch(const int16_t* buffer, int bufferSize) {
         float threshold = 0.15;  // Confidence threshold
         
-        // Step 1: Difference function
-        for (int tau = 0; tau < YIN_BUFFER_SIZE; tau++) {
-            float sum = 0;
-            for (int i = 0; i < YIN_BUFFER_SIZE; i++) {
-                float delta = buffer[i] - buffer[i + tau];
-                sum += delta * delta;
-            }
-            yinBuffer[tau] = sum;
+        int n = min(bufferSize, YIN_FFT_SIZE);
+        arm_q15_to_float((q15_t*)(buffer + bufferSize - n), pitchFrame, n);
+        const float* x = pitchFrame;
+        int window = n - 1 - tauMax;
+        if (window < tauMin) {
+            return -1;  // Not enough audio for the lowest note
         }
         
+        // Step 1: Difference function
+        // Cross term r(tau) = IFFT(conj(FFT(x[0..W))) * FFT(x))
+        memcpy(fftTemp, x, n * sizeof(float));
+        memset(fftTemp + n, 0, (YIN_FFT_SIZE - n) * sizeof(float));
+        arm_rfft_fast_f32(&fftInstance, fftTemp, fftSignal, 0);
+        
+        memcpy(fftTemp, x, window * sizeof(float));
+        memset(fftTemp + window, 0, (YIN_FFT_SIZE - window) * sizeof(float));
+        arm_rfft_fast_f32(&fftInstance, fftTemp, fftWindow, 0);
+        
+        // Packed spectra: [0] = DC, [1] = Nyquist, then (re, im) pairs
+        fftTemp[0] = fftWindow[0] * fftSignal[0];
+        fftTemp[1] = fftWindow[1] * fftSignal[1];
+        arm_cmplx_conj_f32(fftWindow + 2, fftWindow + 2, YIN_FFT_SIZE / 2 - 1);
+        arm_cmplx_mult_cmplx_f32(fftWindow + 2, fftSignal + 2, fftTemp + 2, YIN_FFT_SIZE / 2 - 1);
+        arm_rfft_fast_f32(&fftInstance, fftTemp, fftWindow, 1);
+        const float* r = fftWindow;
+        
+        float energy0;
+        arm_dot_prod_f32((float32_t*)x, (float32_t*)x, window, &energy0);
+        float energyTau = energy0;
+        
         // Step 2: Cumulative mean normalized difference
         yinBuffer[0] = 1;
         float runningSum = 0;
-        for (int tau = 1; tau < YIN_BUFFER_SIZE; tau++) {
-            runningSum += yinBuffer[tau];
-            yinBuffer[tau] *= tau / runningSum;
+        for (int tau = 1; tau <= tauMax + 1; tau++) {
+            energyTau += x[tau + window - 1] * x[tau + window - 1] - x[tau - 1] * x[tau - 1];
+            float d = energy0 + energyTau - 2 * r[tau];
+            if (d < 0) d = 0;  // Rounding on near-silent input
+            runningSum += d;
+            yinBuffer[tau] = runningSum > 0 ? d * tau / runningSum : 1;
         }
         
-        // Step 3: Absolute threshold
+        // Step 3: Absolute threshold, only over the instrument's lags
         int tau = -1;
-        for (int i = 2; i < YIN_BUFFER_SIZE; i++) {
+        for (int i = tauMin; i <= tauMax; i++) {
             if (yinBuffer[i] < threshold) {
-                while (i + 1 < YIN_BUFFER_SIZE && yinBuffer[i + 1] < yinBuffer[i]) {
+                while (i + 1 <= tauMax && yinBuffer[i + 1] < yinBuffer[i]) {
                     i++;
                 }
                 tau = i;
@@ -85,42 +186,38 @@ public:
         }
         
         // Step 4: Parabolic interpolation
-        if (tau == -1 || tau == YIN_BUFFER_SIZE - 1) {
+        if (tau == -1) {
             return -1;  // No pitch found
         }
         
+        // (tau - 1 and tau + 1 are always inside the computed lags)
         float betterTau = tau;
-        if (tau > 0 && tau < YIN_BUFFER_SIZE - 1) {
-            float x0 = yinBuffer[tau - 1];
-            float x1 = yinBuffer[tau];
-            float x2 = yinBuffer[tau + 1];
-            
-            float a = (x2 - 2 * x1 + x0) / 2;
-            float b = (x2 - x0) / 2;
-            if (a != 0) {
-                betterTau = tau - b / (2 * a);
-            }
+        float x0 = yinBuffer[tau - 1];
+        float x1 = yinBuffer[tau];
+        float x2 = yinBuffer[tau + 1];
+        
+        float a = (x2 - 2 * x1 + x0) / 2;
+        float b = (x2 - x0) / 2;
+        if (a != 0) {
+            betterTau = tau - b / (2 * a);
         }
         
         return SAMPLE_RATE / betterTau;
     }
     
     // Fast onset detection optimized for plucked strings
-    bool detectPluck(float* buffer, int bufferSize, float& velocity) {
+    bool detectPluck(const int16_t* buffer, int bufferSize, float& velocity) {
+        // Energy, HFC and ZCR of the last 256 samples in one Q15 pass
+        const int16_t* older = buffer + bufferSize - 256;
+        const int16_t* newest = buffer + bufferSize - 128;
+        blockFeatures(older, 128, older[-1], olderBlock);
+        blockFeatures(newest, 128, newest[-1], newestBlock);
+        
         // Calculate current frame energy
-        float energy = 0;
-        for (int i = bufferSize - 256; i < bufferSize; i++) {
-            energy += buffer[i] * buffer[i];
-        }
-        energy = sqrt(energy / 256.0);
+        float energy = sqrt((olderBlock.energy + newestBlock.energy) / 256.0) / 32768.0;
         
         // High-frequency content (important for pluck detection)
-        float hfc = 0;
-        for (int i = bufferSize - 128; i < bufferSize - 1; i++) {
-            float diff = abs(buffer[i + 1] - buffer[i]);
-            hfc += diff * diff;
-        }
-        hfc = sqrt(hfc / 128.0);
+        float hfc = newestBlock.hfcRms(128);
         
         // Calculate energy increase ratio
         float avgHistory = 0;
@@ -152,119 +249,148 @@ public:
         return isOnset;
     }
     
-    // Zero-crossing rate for additional validation
-    int calculateZCR(float* buffer, int start, int length) {
+    // Period in samples from the zero crossings of buffer: the span from
+    // the first crossing to the last over their count, two to a period, with
+    // hysteresis at a quarter of the peak so pick noise and overtones
+    // riding on the fundamental don't count. 0 under one whole period.
+    float zeroCrossingPeriod(const int16_t* buffer, int bufferSize) {
+        int peak = 0;
+        for (int i = 0; i < bufferSize; i++) {
+            peak = max(peak, abs((int)buffer[i]));
+        }
+        int level = peak / 4;
         int crossings = 0;
-        for (int i = start; i < start + length - 1; i++) {
-            if ((buffer[i] >= 0 && buffer[i + 1] < 0) || 
-                (buffer[i] < 0 && buffer[i + 1] >= 0)) {
-                crossings++;
+        int first = 0, last = 0;
+        int side = 0;  // -1 below -level, +1 above +level
+        for (int i = 0; i < bufferSize; i++) {
+            int now = buffer[i] > level ? 1 : (buffer[i] < -level ? -1 : side);
+            if (side != 0 && now != side) {
+                if (crossings++ == 0) first = i;
+                last = i;
             }
+            side = now;
         }
-        return crossings;
+        return crossings >= 3 ? 2.0f * (last - first) / (crossings - 1) : 0;
     }
     
     // Main processing function
-    void process(float* inputBuffer, int inputSize) {
-        // Copy to circular buffer
-        for (int i = 0; i < inputSize; i++) {
-            audioBuffer[bufferIndex] = inputBuffer[i];
-            bufferIndex = (bufferIndex + 1) % BUFFER_SIZE;
-        }
+    void process(const int16_t* inputBuffer, int inputSize) {
+        ring.write(inputBuffer, inputSize);
+        const int16_t* frame = ring.latest(BUFFER_SIZE);  // oldest -> newest
         
         // Check for pluck
         float velocity;
-        bool pluckDetected = detectPluck(audioBuffer, BUFFER_SIZE, velocity);
+        bool pluckDetected = detectPluck(frame, BUFFER_SIZE, velocity);
         
         if (pluckDetected && 
             (millis() - lastTriggerTime) > RETRIGGER_TIME) {
+            pluckPending = true;
+            pendingSamples = 0;
+            pendingVelocity = velocity;
+        }
+        
+        if (pluckPending) {
+            pendingSamples += inputSize;
+            int len = min(pendingSamples, BUFFER_SIZE);
+            const int16_t* note = frame + BUFFER_SIZE - len;
             
-            // Detect pitch using YIN
-            float frequency = detectPitch(audioBuffer, BUFFER_SIZE);
+            // Detect pitch using YIN, on the new note only
+            float frequency = len >= PITCH_MIN_SAMPLES ? detectPitch(note, len) : -1;
             
             if (frequency > 0) {
-                // Validate with zero-crossing rate
-                int expectedZCR = (int)(frequency * 2 * 256 / SAMPLE_RATE);
-                int actualZCR = calculateZCR(audioBuffer, BUFFER_SIZE - 256, 256);
+                // Validate with zero crossings: a second estimate of the
+                // period over the same samples. YIN's lag range stops at
+                // B2, so a higher note reads as a subharmonic there while
+                // its crossings keep its real period.
+                float period = SAMPLE_RATE / frequency;
+                float zcrPeriod = zeroCrossingPeriod(note, len);
                 
-                // Check if ZCR is within reasonable range
-                if (abs(actualZCR - expectedZCR) < expectedZCR * 0.3) {
+                // Check the two periods agree within 30%
+                if (fabsf(zcrPeriod - period) < period * 0.3f) {
                     // Find matching range and trigger sample
-                    triggerSample(frequency, velocity);
+                    triggerSample(frequency, pendingVelocity);
                     lastFrequency = frequency;
-                    lastAmplitude = velocity;
+                    lastAmplitude = pendingVelocity;
                     lastTriggerTime = millis();
                     noteActive = true;
+                    pluckPending = false;
                 }
             }
+            // Past a whole frame the pitch isn't coming
+            if (pendingSamples >= BUFFER_SIZE) {
+                pluckPending = false;
+            }
         }
         
         // Note off detection (optional)
         if (noteActive) {
-            float currentEnergy = 0;
-            for (int i = BUFFER_SIZE - 128; i < BUFFER_SIZE; i++) {
-                currentEnergy += audioBuffer[i] * audioBuffer[i];
-            }
-            currentEnergy = sqrt(currentEnergy / 128.0);
+            float currentEnergy = newestBlock.rms(128);
             
             if (currentEnergy < lastAmplitude * 0.1) {
                 noteActive = false;
-                // Trigger note off if needed
+                if (lastNote >= 0) midi.noteOff(lastNote);
+                lastNote = -1;
             }
         }
     }
     
     void triggerSample(float frequency, float velocity) {
         // Find matching range
-        for (int i = 0; i < 12; i++) {
-            if (frequency >= bassRanges[i].minFreq && 
-                frequency <= bassRanges[i].maxFreq) {
-                
-                // Trigger your sample here
-                // sendMIDI(bassRanges[i].midiNote, velocity * 127);
-                // or
-                // playSample(bassRanges[i].sampleIndex, velocity);
-                
-                Serial.print("Triggered: ");
-                Serial.print(frequency);
-                Serial.print(" Hz, Sample: ");
-                Serial.print(i);
-                Serial.print(", Velocity: ");
-                Serial.println(velocity);
-                
-                break;
-            }
-        }
+        int i = BASS_MAP.band(frequency);
+        if (i < 0) return;
+        
+        // Monophonic: a new note ends the one before, the same note
+        // restarts itself. Held until the energy dies away.
+        if (lastNote >= 0 && lastNote != bassMidiNotes[i]) midi.noteOff(lastNote);
+        midi.noteOn(bassMidiNotes[i], velocity, 0);
+        lastNote = bassMidiNotes[i];
+        // or
+        // playSample(BASS_MAP.drum(i), velocity);
+        
+        events.log(LOG_HIT, i, frequency, velocity);
     }
 };
 
+// "Triggered: 41.20 Hz, Sample: 0, Velocity: 0.52" for each hit
+int formatHit(char* buf, size_t size, const LogRecord& r) {
+    if (r.reason != LOG_HIT) return EventLog::formatDefault(buf, size, r);
+    return snprintf(buf, size, "Triggered: %.2f Hz, Sample: %d, Velocity: %.2f\n",
+                    r.frequency, r.drum, r.velocity);
+}
+
 // Teensy Audio Library setup
 AudioInputI2S            audioInput;
-AudioAnalyzeFFT1024      fft;
-AudioConnection          patchCord1(audioInput, 0, fft, 0);
+AudioRecordQueue         queue;
+AudioConnection          patchCord1(audioInput, 0, queue, 0);
 AudioControlSGTL5000     audioShield;
 
 GuitarTrigger trigger;
-float audioBlock[128];
 
 void setup() {
     Serial.begin(115200);
-    AudioMemory(12);
+    AudioMemory(20);
     audioShield.enable();
     audioShield.inputSelect(AUDIO_INPUT_LINEIN);
     audioShield.volume(0.5);
     
     // High-pass filter to remove DC and low rumble
     audioShield.adcHighPassFilterEnable();
+    
+    queue.begin();
+    
+    Serial1.begin(31250);
+    midi.begin(&Serial1);
+    midi.channel(1);
+    
+    events.formatter(formatHit);
 }
 
 void loop() {
     // Process audio blocks
-    if (fft.available()) {
-        // Get audio data
-        for (int i = 0; i < 128; i++) {
-            audioBlock[i] = fft.read(i);
-        }
-        trigger.process(audioBlock, 128);
+    while (queue.available()) {
+        trigger.process(queue.readBuffer(), AUDIO_BLOCK_SAMPLES);
+        queue.freeBuffer();
     }
+    midi.service();
+    events.drain(Serial);
 }
\ No newline at end of file
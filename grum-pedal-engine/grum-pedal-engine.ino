@@ -0,0 +1,271 @@
+// GUITAR DRUM TRIGGER - ONE SKETCH, COMPILE-TIME CONFIGURATION
+// The onset method, pitch source and drum sounds come from the GrumPedal
+// Trigger<> engine (trigger_engine.h). Pick a pedal with PEDAL_SKU; only
+// the analysers and voices of that combination are built, so no SKU pays
+// CPU or audio blocks for paths it never reads.
+//
+//   SKU_SYNTH     block-rate pluck onset + its period, synth drums
+//                 (grum-pedal.cpp, lowest latency)
+//   SKU_SAMPLES   RMS envelope onset + Teensy YIN, SD kit in RAM
+//                 (grum_pedal-BEST_CLAUDE / grum-pedal-sketch_COMBINED)
+//   SKU_SPECTRAL  spectral flux onset + 2048 point FFT pitch, synth drums
+//                 (grum-pedal.cpp with USE_BLOCK_TRIGGER 0)
+//   SKU_TASK_YIN  RMS envelope onset + sliding YIN in a background task
+//                 below the audio interrupt, synth drums; 'a' prints the
+//                 task's latency and drops
+//   SKU_YIN       the same pair with the sliding YIN in the audio
+//                 interrupt, to compare SKU_TASK_YIN against
+//
+// The synth SKUs play pooled voices (SynthPoolVoices): a drum hit again
+// rings on under the new hit instead of restarting. SynthVoices, the five
+// AudioSynthSimpleDrum objects, still drops in for the old sound.
+//
+// Other pairings are one line: any onset policy with any pitch policy and
+// any voice policy (see onset_policies.h, pitch_policies.h,
+// voice_policies.h).
+//
+// SPECULATE 1 adds a zero-crossing guess (guess_policies.h): the drum plays
+// as soon as the guess names one, and is swapped if the pitch policy then
+// names another. 's' prints how often that happened. Only the SKUs whose
+// pitch policy waits gain anything; SKU_SYNTH already plays at the period.
+//
+// Every hit starts at its pick's sample within the output block. With
+// FIXED_LATENCY_MS it also starts exactly that long after the pick, however
+// long the pitch took, on the SKUs whose onset counts blocks (SKU_SYNTH,
+// SKU_SPECTRAL). A hit whose pitch came too late for that is dropped, not
+// played off time; 'l' then adds how many were.
+//
+// The audio block pool is sized from the SKU's objects (audio_budget.h)
+// rather than one figure for all of them; 'm' prints the blocks each stage
+// holds, and a warning appears by itself if the pool nears its end.
+//
+// Hits are logged from Trigger::update() into an EventLog (event_log.h) and
+// printed from the end of loop(), so a stalled USB port never holds up the
+// next update(), its trigger or a held hit's slot.
+
+#include <Audio.h>
+#include <Wire.h>
+#include <SPI.h>
+#include <SD.h>
+#include <trigger_engine.h>
+#include <latency_probe.h>
+#include <block_monitor.h>
+#include <event_log.h>
+
+#define SKU_SYNTH    1
+#define SKU_SAMPLES  2
+#define SKU_SPECTRAL 3
+#define SKU_TASK_YIN 4
+#define SKU_YIN      5
+
+#ifndef PEDAL_SKU
+#define PEDAL_SKU SKU_SYNTH
+#endif
+
+#ifndef SPECULATE
+#define SPECULATE 0
+#endif
+
+#ifndef FIXED_LATENCY_MS
+#define FIXED_LATENCY_MS 0
+#endif
+
+#if SPECULATE
+typedef ZeroCrossingGuess PedalGuess;
+#else
+typedef NoGuess PedalGuess;
+#endif
+
+#if PEDAL_SKU == SKU_SYNTH
+typedef Trigger<PluckOnset, OnsetPitch, SynthPoolVoices, PedalGuess> PedalTrigger;
+#elif PEDAL_SKU == SKU_SAMPLES
+typedef Trigger<EnvelopeOnset, NoteFrequencyPitch, SampleVoices, PedalGuess> PedalTrigger;
+#elif PEDAL_SKU == SKU_SPECTRAL
+typedef Trigger<FluxOnset, SpectrumPitch, SynthPoolVoices, PedalGuess> PedalTrigger;
+#elif PEDAL_SKU == SKU_TASK_YIN
+typedef Trigger<EnvelopeOnset, TaskYinPitch, SynthPoolVoices, PedalGuess> PedalTrigger;
+#elif PEDAL_SKU == SKU_YIN
+typedef Trigger<EnvelopeOnset, SlidingYinPitch, SynthPoolVoices, PedalGuess> PedalTrigger;
+#else
+#error "unknown PEDAL_SKU"
+#endif
+
+// Audio signal flow
+AudioInputI2S             audioInput;      // Guitar input
+AudioFilterBiquad         highpass;        // Remove DC offset
+AudioBlockProbe           inputBlocks("input");
+PedalTrigger              pedal(highpass); // Analysers + drum voices
+AudioBlockProbe           pedalBlocks("pedal");
+AudioMixer4               mainMixer;       // Dry guitar + drums
+AudioOutputI2S            audioOutput;     // Output to amp
+AudioBlockProbe           outputBlocks("output");
+
+AudioConnection patchCord1(audioInput, 0, highpass, 0);
+AudioConnection patchCord2(audioInput, 0, mainMixer, 0);     // Dry guitar
+AudioConnection patchCord3(pedal.output(), 0, mainMixer, 1);  // Drums
+AudioConnection patchCord4(mainMixer, 0, audioOutput, 0);    // Left out
+AudioConnection patchCord5(mainMixer, 0, audioOutput, 1);    // Right out
+
+AudioControlSGTL5000 audioShield;
+
+// Pool for this SKU: the engine's policies plus the graph above
+constexpr AudioBudget AUDIO_BUDGET = PedalTrigger::budget()
+    .add(AUDIO_COST_I2S_IN).add(AUDIO_COST_FILTER)
+    .add(AUDIO_COST_MIXER).add(AUDIO_COST_I2S_OUT);
+AudioBlockMonitor audioBlocks(AUDIO_BUDGET.blocks(), AUDIO_BUDGET);
+
+// Onset -> loop -> noteOn -> output timing; 'l' prints it, 'r' clears
+LatencyProbe latency;
+
+const char *const DRUM_NAMES[] = { "🥁 KICK!", "🪘 SNARE!", "🎩 HAT!", "🔔 RIDE!", "💥 CRASH!" };
+
+#if PEDAL_SKU == SKU_SAMPLES
+#if defined(ARDUINO_TEENSY41)
+  const int SD_CS = BUILTIN_SDCARD;   // Teensy 4.1 onboard SD
+#else
+  const int SD_CS = 10;               // Audio Shield Rev D CS
+#endif
+
+// Band order: drum i plays for band i of the trigger
+enum { KICK, SNARE, HHCL, RIDE, CRASH, NUM_DRUMS };
+struct KitFile { uint8_t drum; const char *file; float minVelocity; };
+const KitFile KIT_FILES[] = {
+  { KICK,  "KICK.WAV",    0.0f  },
+  { SNARE, "SNARE.WAV",   0.0f  },
+  { SNARE, "SNAREHI.WAV", 0.75f },   // optional accent layer
+  { HHCL,  "HHCL.WAV",    0.0f  },
+  { RIDE,  "RIDE.WAV",    0.0f  },
+  { CRASH, "CRASH.WAV",   0.0f  },
+};
+const int NUM_KIT_FILES = sizeof(KIT_FILES) / sizeof(KIT_FILES[0]);
+DrumSample drumSamples[NUM_KIT_FILES];
+
+void loadKit() {
+  Serial.print("Mounting SD... ");
+  if (!SD.begin(SD_CS)) {
+    Serial.println("FAILED");
+    while (1) { /* halt */ }
+  }
+  Serial.println("OK");
+
+  DrumVoiceManager &kit = pedal.voice.kit();
+  for (int i = 0; i < NUM_KIT_FILES; i++) {
+    if (!drumSamples[i].load(KIT_FILES[i].file)) continue;
+    drumSamples[i].printInfo(Serial);
+    kit.addLayer(KIT_FILES[i].drum, drumSamples[i], KIT_FILES[i].minVelocity);
+  }
+  for (int d = 0; d < NUM_DRUMS; d++) kit.setDrum(d, 0.72f);
+}
+#endif
+
+// The hit handler runs inside Trigger::update(), on the trigger path, so it
+// only logs; loop() drains the log to Serial without waiting for the port
+EventLog events;
+
+enum HitLog : uint8_t {
+  LOG_EARLY_HIT = LOG_USER,   // played on the guess
+  LOG_CORRECTED_HIT,          // played over a withdrawn guess
+  LOG_BELOW_KICK,             // pitch under the kick band
+  LOG_WITHDRAWN,              // pitch timed out, guess in drum withdrawn
+  LOG_LATE                    // drum dropped, its FIXED_LATENCY_MS slot gone
+};
+
+// Every settled onset, played or not
+void logHit(const TriggerHit &hit) {
+  if (hit.drum < 0) {
+    if (hit.replaced >= 0) events.log(LOG_WITHDRAWN, hit.replaced);
+    else if (hit.frequency > 0) events.log(LOG_BELOW_KICK, -1, hit.frequency, hit.velocity);
+    else events.log(LOG_NO_PITCH, -1, -1.0f, hit.velocity);
+    return;
+  }
+  if (hit.late) events.log(LOG_LATE, hit.drum, hit.frequency, hit.velocity);
+  if (!hit.played) return;   // retrigger hold, or late
+  uint8_t reason = LOG_HIT;
+  if (hit.early) reason = LOG_EARLY_HIT;
+  else if (hit.replaced >= 0) reason = LOG_CORRECTED_HIT;
+  events.log(reason, hit.drum, hit.frequency, hit.velocity);
+}
+
+int formatHit(char *buf, size_t size, const LogRecord &r) {
+  bool named = r.drum >= 0 && r.drum < 5;
+  switch (r.reason) {
+    case LOG_HIT:
+    case LOG_EARLY_HIT:
+    case LOG_CORRECTED_HIT:
+      if (!named) break;
+      return snprintf(buf, size, "%s %.1f Hz, Vel: %.2f%s\n", DRUM_NAMES[r.drum], r.frequency, r.velocity,
+                      r.reason == LOG_EARLY_HIT ? " (early)" : r.reason == LOG_CORRECTED_HIT ? " (corrected)" : "");
+    case LOG_WITHDRAWN:
+      if (!named) break;
+      return snprintf(buf, size, "Onset without pitch - early %s withdrawn\n", DRUM_NAMES[r.drum]);
+    case LOG_LATE:
+      if (!named) break;
+      return snprintf(buf, size, "Late for its slot - %s %.1f Hz dropped\n", DRUM_NAMES[r.drum], r.frequency);
+    case LOG_BELOW_KICK:
+      return snprintf(buf, size, "Onset below the kick band - skipped\n");
+    case LOG_NO_PITCH:
+      return snprintf(buf, size, "Onset without pitch - skipped\n");
+  }
+  return EventLog::formatDefault(buf, size, r);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+
+  Serial.println("====================================");
+  Serial.println("     GUITAR DRUMS - TRIGGER ENGINE   ");
+  Serial.println("====================================");
+
+  AudioMemory(AUDIO_BUDGET.blocks());
+  audioBlocks.printBudget(Serial);
+  audioShield.enable();
+  audioShield.inputSelect(AUDIO_INPUT_LINEIN);
+  audioShield.lineInLevel(10);
+  audioShield.micGain(40);
+  audioShield.volume(0.7);
+
+  highpass.setHighpass(0, 30, 0.5);
+
+  pedal.begin();
+#if PEDAL_SKU == SKU_SAMPLES
+  loadKit();
+#endif
+  events.formatter(formatHit);
+  pedal.onHit(logHit);
+
+  latency.begin();
+  pedal.latencyProbe(&latency);
+  pedal.fixedLatency(FIXED_LATENCY_MS * AUDIO_SAMPLE_RATE_EXACT / 1000);
+
+  mainMixer.gain(0, 0);     // Dry guitar volume (0%)
+  mainMixer.gain(1, 1.0);   // Drum levels live in the voice policy
+
+  Serial.println("\n♪ Ready! Play your guitar! ♪");
+  Serial.println("====================================\n");
+}
+
+void loop() {
+  pedal.update();
+  audioBlocks.check(Serial);
+
+  // Serial commands
+  if (Serial.available()) {
+    char c = Serial.read();
+    if (c == 'l') {
+      latency.print(Serial);
+      if (FIXED_LATENCY_MS) Serial.printf("Dropped, late for %d ms: %lu\n", FIXED_LATENCY_MS, (unsigned long)pedal.late());
+    }
+    if (c == 'r') {
+      latency.reset();
+      audioBlocks.resetMax();
+    }
+    if (c == 'm') audioBlocks.print(Serial);
+    if (c == 's') pedal.printSpeculation(Serial);
+#if PEDAL_SKU == SKU_TASK_YIN
+    if (c == 'a') pedal.pitch.analysis().printStats(Serial);
+#endif
+  }
+
+  events.drain(Serial);
+}
@@ -4,55 +4,236 @@
 #include <Audio.h>
 #include <Wire.h>
 #include <SPI.h>
+#include <analyze_pluck_trigger.h>
+#include <analyze_band_onsets.h>
+#include <analyze_multi_pluck.h>
+#include <mixer_fused.h>
+#include <spectral_frame.h>
+#include <fft_engine.h>
+#include <latency_probe.h>
+#include <cpu_profiler.h>
+#include <drum_map.h>
+#include <event_log.h>
+#include <midi_out.h>
+#include <calibrate_input.h>
+#include <preset_store.h>
+#include <preset_shell.h>
+#include <block_monitor.h>
+
+// 1: onset runs per audio block in the ISR (AudioAnalyzePluckTrigger)
+// 0: original loop() path; FFTs of a sample ring computed in loop()
+#ifndef USE_BLOCK_TRIGGER
+#define USE_BLOCK_TRIGGER 1
+#endif
+
+// 1 (with USE_BLOCK_TRIGGER): an onset test per string band instead of
+// one pitch (AudioAnalyzeBandOnsets), so a strum can fire several drums
+#ifndef POLY_TRIGGER
+#define POLY_TRIGGER 0
+#endif
+
+// 1 (with USE_BLOCK_TRIGGER, not POLY_TRIGGER): guitar on the left input
+// and bass on the right, each with its own onset test, pitch range and
+// drums (AudioAnalyzeMultiPluck); the dry signal stays the guitar's
+#ifndef MULTI_INPUT
+#define MULTI_INPUT 0
+#endif
+#define BASS_INPUT (USE_BLOCK_TRIGGER && !POLY_TRIGGER && MULTI_INPUT)
+
+// 1: with no valid input calibration in EEPROM, run one at boot ('c'
+// runs one any time)
+#ifndef CALIBRATE_ON_BOOT
+#define CALIBRATE_ON_BOOT 1
+#endif
+
+// 1: print a per-object / per-detector CPU table every 2 s
+#ifndef PROFILE_CPU
+#define PROFILE_CPU 0
+#endif
 
 // Audio signal flow - YOUR EXACT SETUP
 AudioInputI2S             audioInput;      // Guitar input
+AudioBlockProbe           inputBlocks("input");
 AudioSynthSimpleDrum      drumKick;        // Kick drum sound
 AudioSynthSimpleDrum      drumSnare;       // Snare drum sound  
 AudioSynthSimpleDrum      drumHihat;       // Hi-hat sound
 AudioSynthSimpleDrum      drumRide;        // Ride sound
 AudioSynthSimpleDrum      drumCrash;       // Crash sound
-AudioMixer4               drumMixer;       // Mix all drums
-AudioMixer4               mainMixer;       // Mix drums + guitar
+AudioBlockProbe           drumBlocks("drums");
+AudioMixerFused<6>        mainMixer;       // Guitar + all five drums, one pass
 AudioOutputI2S            audioOutput;     // Output to amp
+AudioBlockProbe           outputBlocks("output");
 
 // Analysis objects for detection
-AudioAnalyzeFFT256        fft;             // For frequency and onset detection
+#if USE_BLOCK_TRIGGER && POLY_TRIGGER
+AudioAnalyzeBandOnsets    strings;         // Per-band onsets, polyphonic
+#elif USE_BLOCK_TRIGGER && MULTI_INPUT
+AudioAnalyzeMultiPluck    pluck(2);        // Guitar (0) and bass (1) onsets
+#elif USE_BLOCK_TRIGGER
+AudioAnalyzePluckTrigger  pluck;           // Per-block onset + pitch
+#else
+AudioSampleRing<2048>     sampleRing;      // Last 2048 samples for both FFTs
 AudioAnalyzePeak          peak;            // Peak detection
+#endif
 AudioFilterBiquad         highpass;        // Remove DC offset
+#if BASS_INPUT
+AudioFilterBiquad         bassHighpass;    // Same for the bass input
+#endif
+AudioCalibrateInput       calibrator;      // Noise floor and line-in level
+AudioBlockProbe           analysisBlocks("analysis");
 
 // Audio connections - keeping your exact output routing!
 AudioConnection patchCord1(audioInput, 0, highpass, 0);
-AudioConnection patchCord2(highpass, 0, fft, 0);
+#if USE_BLOCK_TRIGGER && POLY_TRIGGER
+AudioConnection patchCord2(highpass, 0, strings, 0);
+#elif USE_BLOCK_TRIGGER
+AudioConnection patchCord2(highpass, 0, pluck, 0);
+#if MULTI_INPUT
+AudioConnection patchCord13(audioInput, 1, bassHighpass, 0);
+AudioConnection patchCord14(bassHighpass, 0, pluck, 1);
+#endif
+#else
+AudioConnection patchCord2(highpass, 0, sampleRing, 0);
 AudioConnection patchCord3(highpass, 0, peak, 0);
+#endif
+AudioConnection patchCord12(highpass, 0, calibrator, 0);
 AudioConnection patchCord4(audioInput, 0, mainMixer, 0);  // Dry guitar
-AudioConnection patchCord5(drumKick, 0, drumMixer, 0);
-AudioConnection patchCord6(drumSnare, 0, drumMixer, 1);
-AudioConnection patchCord7(drumHihat, 0, drumMixer, 2);
-AudioConnection patchCord8(drumRide, 0, drumMixer, 3);
-AudioConnection patchCord9(drumCrash, 0, mainMixer, 2);   // Crash direct
-AudioConnection patchCord10(drumMixer, 0, mainMixer, 1);   // All drums
-AudioConnection patchCord11(mainMixer, 0, audioOutput, 0); // Left out
-AudioConnection patchCord12(mainMixer, 0, audioOutput, 1); // Right out
+AudioConnection patchCord5(drumKick, 0, mainMixer, 1);
+AudioConnection patchCord6(drumSnare, 0, mainMixer, 2);
+AudioConnection patchCord7(drumHihat, 0, mainMixer, 3);
+AudioConnection patchCord8(drumRide, 0, mainMixer, 4);
+AudioConnection patchCord9(drumCrash, 0, mainMixer, 5);
+AudioConnection patchCord10(mainMixer, 0, audioOutput, 0); // Left out
+AudioConnection patchCord11(mainMixer, 0, audioOutput, 1); // Right out
 
 AudioControlSGTL5000 audioShield;
 
+// Pool for the graph above; the analysers copy what they keep, so only
+// the sources and the mixer cost blocks. 'a' prints each stage's share.
+constexpr AudioBudget AUDIO_BUDGET = AudioBudget()
+    .add(AUDIO_COST_I2S_IN).add(AUDIO_COST_SIMPLE_DRUM, 5)
+    .add(AUDIO_COST_MIXER_FUSED).add(AUDIO_COST_I2S_OUT)
+    .add(AUDIO_COST_FILTER, 1 + BASS_INPUT);
+AudioBlockMonitor audioBlocks(AUDIO_BUDGET.blocks(), AUDIO_BUDGET);
+
+// Onset -> loop -> noteOn -> mixer output timing; 'l' prints it, 'r' clears
+LatencyProbe latency;
+
+// Trigger path messages, printed from the end of loop() when the USB
+// port has room; 'b' switches to binary records for tools/logdecode
+EventLog events;
+
+// Every hit also goes out as a GM drum note on channel 10, over USB (when
+// USB Type includes MIDI) and on Serial1 for a 5-pin jack; 'm' mutes the
+// pedal's own drums for a MIDI-only rig
+MidiOut midi;
+const uint8_t DRUM_NOTE[5] = {36, 38, 42, 51, 49};   // kick, snare, hat, ride, crash
+
+#if BASS_INPUT
+// The bass input's own split: kick from 35 Hz (open E, 41.2 Hz) to A#1
+// (1st fret of the A), snare from B1 (61.7 Hz, 2nd fret of the A) to G#2
+// (1st fret of the G), ride from A2 (110 Hz, 2nd fret of the G) up
+const float BASS_EDGES[] = { 35, 60, 110 };
+const int8_t BASS_DRUMS[] = { 0, 1, 3 };
+#endif
+bool internalDrums = true;
+
+// Line-in level, gate and band floor measured on this guitar; stored in
+// EEPROM so a boot with a valid copy goes straight to playing
+InputCalibration inputCal;
+uint8_t inputLevel = 10;
+
+#if PROFILE_CPU
+CpuProfiler cpu;
+uint8_t SCOPE_ONSET, SCOPE_PITCH, SCOPE_ONSET_FFT, SCOPE_PITCH_FFT, SCOPE_TRIGGER;
+#define CPU_SCOPE(id) CpuScope cpuScope_(cpu, id)
+#else
+#define CPU_SCOPE(id)
+#endif
+
+AudioSynthSimpleDrum *const DRUMS[5] = { &drumKick, &drumSnare, &drumHihat, &drumRide, &drumCrash };
+
+// String to drum mapping, retrigger time, onset thresholds and drum sounds.
+// Levels are each drum's full-velocity gain on mainMixer channels 1-5, the
+// old drumMixer x mainMixer products (kick 0.7 x 0.8, crash 0.6 direct).
+// 'p ...' lines edit the playing preset and store it in EEPROM
+// (preset_shell.h); the boot slot is loaded at power-up.
+const PedalPreset DEFAULT_PRESET = {
+  PRESET_MAGIC, PRESET_VERSION, sizeof(PedalPreset), 0, 0,
+  "default", 5, 0,
+  80,                        // ms between hits of the same drum
+  1.2f, 0.8f, 1.2f,          // THRESHOLD_MULTIPLIER, HFC_THRESHOLD, ENERGY_RATIO_THRESHOLD
+  {
+    {  60, 0, 0 },           // KICK DRUM (60-110 Hz) - Low E string area
+    { 110, 1, 0 },           // SNARE DRUM (110-165 Hz) - A string area
+    { 165, 2, 0 },           // HI-HAT (165-260 Hz) - D & G string area
+    { 260, 3, 0 },           // RIDE CYMBAL (260-400 Hz) - B string area
+    { 400, 4, 0 },           // CRASH CYMBAL (400+ Hz) - High E string upper frets
+  },
+  {
+    // Hz, ms, second mix %, pitch mod %, level %, reserved - YOUR EXACT SETTINGS
+    {  60, 150,   0, 50, 56, 0 },   // KICK - Deep and punchy (60Hz fundamental)
+    { 200, 100, 100, 20, 56, 0 },   // SNARE - Snappy with noise (200Hz + noise)
+    { 800,  40, 100,  0, 40, 0 },   // HI-HAT - Short and crisp (800Hz)
+    { 500, 300,  50, 10, 40, 0 },   // RIDE - Metallic ring (500Hz)
+    { 900, 500, 100,  0, 60, 0 },   // CRASH - Long and bright (900Hz)
+  },
+};
+PedalPreset preset = DEFAULT_PRESET;
+PresetStore presets;
+PresetShell presetShell(presets, DEFAULT_PRESET);
+
+// Frequency to drum bands, compiled to a lookup table (drum_map.h) and
+// rebuilt when a preset changes them
+DrumMap<PedalPreset::MAX_BANDS> drumMap = DEFAULT_PRESET.drumMap();
+
 // Advanced onset detection variables
 const int ENERGY_HISTORY_SIZE = 8;
 float energyHistory[ENERGY_HISTORY_SIZE] = {0};
 int energyHistoryIndex = 0;
 float lastEnergy = 0;
-float fftData[128];  // Store FFT data for reuse
+// FFT onsets only: the frame's HFC held at its peak and decaying, ~190 ms
+// at one frame a block. A new pick lifts HFC over it; the beating of a
+// low string that is still ringing swells the energy but not the HFC.
+float hfcPeak = 0;
+const float HFC_PEAK_DECAY = 0.985f;
+const float HFC_PEAK_RISE = 1.2f;
+// Parseval for the Hann-windowed frame at the FFT256 scale: RMS^2 = 4/3 x power
+const float HANN_POWER = 4.0f / 3.0f;
+#if !USE_BLOCK_TRIGGER
+// Onset: 256 points every block (2.9 ms). Pitch: 2048 points every four
+// blocks, 21.5 Hz bins instead of 172 Hz, so the 110 Hz kick/snare split
+// is resolved. Both read the same ring.
+// A pitch frame spans 46 ms, so the drum waits for the first frames that
+// start after the pick: ~60-70 ms from pick to drum.
+FFTEngine<256, 256, 128>   onsetFFT;
+FFTEngine<2048, 2048, 512> pitchFFT;
+#endif
+float fftData[128];  // Onset magnitudes, at the FFT256 scale the thresholds expect
+SpectralFrame spectrum;       // Onset features of fftData, once per frame
+SpectralFrame pitchSpectrum;  // Fundamental and bands from the pitch FFT
 
 // Add these variables for improved pitch detection
 float pitchHistory[3] = {0};  // Store last 3 pitch detections
 int pitchHistoryIndex = 0;
-float zcrBuffer[128];  // Buffer for zero-crossing rate calculation
-int zcrBufferIndex = 0;
+
+// FFT onsets only: an onset waits for pitch frames of its own note. The
+// pitch frame ending at the onset is ~46 ms of the note before the pick,
+// so the drum is picked from frames that start at or after the onset
+// block, giving up after PITCH_WAIT_FRAMES of them.
+const int PITCH_WAIT_FRAMES = 3;
+struct PendingOnset {
+  bool waiting;
+  uint32_t start;       // samplesWritten() at the start of the onset block
+  float velocity;
+  float band[SpectralFrame::NUM_BANDS];   // onset frame, for the fallback
+  int frames;           // pitch frames seen since the onset
+};
+PendingOnset pendingOnset = {};
 
 // Control variables - your existing ones
 unsigned long lastTriggerTime[5] = {0};
-const int retriggerDelay = 80;  // Minimum ms between same drum
+unsigned long retriggerDelay = 80;  // Minimum ms between same drum
 float lastPeakLevel = 0;
 
 // Onset detection thresholds - MADE MORE SENSITIVE
@@ -72,10 +253,11 @@ void setup() {
   Serial.println("Initializing...");
   
   // Audio setup - keeping your exact configuration
-  AudioMemory(50);
+  AudioMemory(AUDIO_BUDGET.blocks());
+  audioBlocks.printBudget(Serial);
   audioShield.enable();
   audioShield.inputSelect(AUDIO_INPUT_LINEIN);
-  audioShield.lineInLevel(10);     // INCREASED from 0 to 10 for more sensitivity
+  audioShield.lineInLevel(inputLevel);  // INCREASED from 0 to 10 for more sensitivity
   audioShield.micGain(40);         // Boost for guitar
   audioShield.volume(0.7);         // Output volume
   
@@ -86,19 +268,74 @@ void setup() {
   for (int i = 0; i < ENERGY_HISTORY_SIZE; i++) {
     energyHistory[i] = 0.001;
   }
-  
+
+#if USE_BLOCK_TRIGGER && POLY_TRIGGER
+  // Band onsets keep their own defaults; the drum split is the same
+#elif USE_BLOCK_TRIGGER
+  // Same thresholds as the loop() detector, now evaluated every block
+  pluck.thresholds(noiseFloor, THRESHOLD_MULTIPLIER, HFC_THRESHOLD, ENERGY_RATIO_THRESHOLD);
+#if MULTI_INPUT
+  // The guitar's bands carry the preset's drums, not band numbers
+  float guitarEdges[PedalPreset::MAX_BANDS];
+  int8_t guitarDrums[PedalPreset::MAX_BANDS];
+  for (uint8_t i = 0; i < preset.numBands; i++) {
+    guitarEdges[i] = preset.bands[i].minHz;
+    guitarDrums[i] = preset.bands[i].drum;
+  }
+  pluck.bands(0, guitarEdges, guitarDrums, preset.numBands);
+  bassHighpass.setHighpass(0, 30, 0.5);
+  // Down to a 5-string's low B's 2nd harmonic if the fundamental is weak,
+  // and time for two periods of low E
+  pluck.pitchRange(1, 30.0f, 500.0f, 20);
+  pluck.bands(1, BASS_EDGES, BASS_DRUMS, sizeof(BASS_EDGES) / sizeof(BASS_EDGES[0]));
+#endif
+#else
+  // Fine bins: the lowest eight peaks must reach past the 3rd harmonic
+  // of a high E, not be spent on 5 kHz of string noise
+  pitchSpectrum.peakMaxHz = 2000;
+#endif
+  
+  latency.begin();
+  mainMixer.latencyProbe(&latency);
+  events.formatter(formatEvent);
+  Serial1.begin(31250);
+  midi.begin(&Serial1);
+
+#if PROFILE_CPU
+  cpu.begin(2000);
+  cpu.addObject("input", audioInput);
+  cpu.addObject("highpass", highpass);
+#if USE_BLOCK_TRIGGER && POLY_TRIGGER
+  cpu.addObject("strings", strings);
+#elif USE_BLOCK_TRIGGER
+  cpu.addObject("pluck", pluck);
+#if MULTI_INPUT
+  cpu.addObject("bassHighpass", bassHighpass);
+#endif
+#else
+  cpu.addObject("ring", sampleRing);
+  cpu.addObject("peak", peak);
+#endif
+  cpu.addObject("kick", drumKick);
+  cpu.addObject("snare", drumSnare);
+  cpu.addObject("hihat", drumHihat);
+  cpu.addObject("ride", drumRide);
+  cpu.addObject("crash", drumCrash);
+  cpu.addObject("mixer", mainMixer);
+  cpu.addObject("output", audioOutput);
+  SCOPE_ONSET     = cpu.addScope("onset");
+  SCOPE_PITCH     = cpu.addScope("pitch");
+  SCOPE_ONSET_FFT = cpu.addScope("onsetFFT");
+  SCOPE_PITCH_FFT = cpu.addScope("pitchFFT");
+  SCOPE_TRIGGER   = cpu.addScope("trigger");
+#endif
+
   // Configure drum sounds - YOUR EXACT SETTINGS
   setupDrumSounds();
   
   // Setup mixer levels - YOUR EXACT LEVELS
-  drumMixer.gain(0, 0.7);   // Kick volume
-  drumMixer.gain(1, 0.7);   // Snare volume
-  drumMixer.gain(2, 0.5);   // Hihat volume
-  drumMixer.gain(3, 0.5);   // Ride volume
-  
   mainMixer.gain(0, 0);     // Dry guitar volume (0%)
-  mainMixer.gain(1, 0.8);   // Drums volume
-  mainMixer.gain(2, 0.6);   // Crash volume
+  for (int i = 0; i < 5; i++) mainMixer.gain(1 + i, preset.level(i));
   
   // Play startup drum sequence
   delay(500);
@@ -114,27 +351,57 @@ void setup() {
   
   Serial.println("\n♪ Ready! Play your guitar! ♪");
   Serial.println("====================================\n");
-}
 
-// Calculate energy from FFT data
-float calculateEnergy() {
-  float energy = 0;
-  for (int i = 0; i < 128; i++) {
-    energy += fftData[i] * fftData[i];
+  if (inputCal.load()) {
+    applyCalibration();
+  } else if (CALIBRATE_ON_BOOT) {
+    calibrator.begin(audioShield, inputLevel, Serial);
   }
-  energy = sqrt(energy / 128.0);
-  return energy;
+
+  // One EEPROM read; a missing or damaged slot leaves the built-in preset
+  PedalPreset stored = preset;
+  const uint8_t slot = presets.bootSlot();
+  if (slot != PresetStore::NO_SLOT && presets.load(slot, stored)) {
+    applyPreset(stored);
+    Serial.printf("Preset %u: %s\n", slot, preset.name);
+  }
+}
+
+// Take over a measured input: line-in level, then the gates that depend
+// on it. HFC and ratio thresholds are relative and stay as tuned.
+void applyCalibration() {
+  inputLevel = inputCal.lineIn;
+  audioShield.lineInLevel(inputLevel);
+  noiseFloor = inputCal.gate;
+#if USE_BLOCK_TRIGGER && POLY_TRIGGER
+  strings.thresholds(inputCal.bandFloor, 1.6f);   // the object's default ratio
+#elif USE_BLOCK_TRIGGER
+  pluck.thresholds(noiseFloor, THRESHOLD_MULTIPLIER, HFC_THRESHOLD, ENERGY_RATIO_THRESHOLD);
+#endif
+  inputCal.print(Serial);
 }
 
-// Calculate High Frequency Content for pluck detection
-float calculateHFC() {
-  float hfc = 0;
-  for (int i = 64; i < 128; i++) {
-    float weight = (float)i / 128.0;
-    hfc += fftData[i] * fftData[i] * weight;
+// While calibrating nothing plays: onsets are dropped, and any key cancels
+void serviceCalibration() {
+#if USE_BLOCK_TRIGGER
+  PluckEvent ev;
+#if POLY_TRIGGER
+  while (strings.read(ev)) {}
+#else
+  while (pluck.read(ev)) {}
+#endif
+#endif
+  AudioCalibrateInput::State state = calibrator.service();
+  if (state == AudioCalibrateInput::DONE) {
+    inputCal = calibrator.result();
+    inputCal.save();
+    applyCalibration();
+    Serial.println("Calibration saved");
+  }
+  if (Serial.available()) {
+    Serial.read();
+    calibrator.cancel();
   }
-  hfc = sqrt(hfc / 64.0);
-  return hfc;
 }
 
 // Update energy history
@@ -152,12 +419,17 @@ float updateEnergyHistory(float currentEnergy) {
 
 // Advanced onset detection
 bool detectOnset(float level, float &velocity) {
+  CPU_SCOPE(SCOPE_ONSET);
+  // In the block trigger's units, time-domain RMS of the block and of its
+  // first difference, so the same thresholds and presets apply
+  float hfc = sqrtf(spectrum.diffPower * HANN_POWER);
+  bool hfcRising = hfc > hfcPeak * HFC_PEAK_RISE;
+  hfcPeak = max(hfc, hfcPeak * HFC_PEAK_DECAY);
   if (level < noiseFloor) return false;
   
-  float currentEnergy = calculateEnergy();
+  float currentEnergy = sqrtf(spectrum.power * HANN_POWER);
   if (currentEnergy < 0.001) currentEnergy = level;
   
-  float hfc = calculateHFC();
   float avgHistory = updateEnergyHistory(currentEnergy);
   adaptiveThreshold = avgHistory * THRESHOLD_MULTIPLIER + noiseFloor;
   
@@ -171,7 +443,7 @@ bool detectOnset(float level, float &velocity) {
   bool risingEdge = currentEnergy > lastEnergy * 1.2;
   
   bool isOnset = false;
-  if (energyCondition && ratioCondition && risingEdge) {
+  if (energyCondition && ratioCondition && risingEdge && hfcRising) {
     if (hfcCondition || currentEnergy > adaptiveThreshold * 3) {
       isOnset = true;
       velocity = constrain(currentEnergy * 2.0, 0.0, 1.0);
@@ -182,118 +454,135 @@ bool detectOnset(float level, float &velocity) {
   return isOnset;
 }
 
-// Detect pitch from FFT data
-float detectPitch() {
-  float maxLevel = 0;
-  int maxBin = 0;
-  
-  for (int i = 2; i < 128; i++) {
-    if (fftData[i] > maxLevel) {
-      maxLevel = fftData[i];
-      maxBin = i;
-    }
+// Map frequency to a drum index (-1 if below the kick band)
+int drumForFrequency(float freq) {
+  return drumMap.drumFor(freq);
+}
+
+// Set a drum's velocity on its mixer channel as it restarts. noteGain()
+// lands on the same block boundary as noteOn(), so the gain belongs to the
+// new hit; nothing else shares the channel. `offset` moves the hit to the
+// pick's sample within that block (PluckEvent::offset). The audio
+// interrupt is held off across the pair so both land on the same block.
+void startDrum(int drumIndex, float gain, uint8_t offset) {
+  if (!internalDrums) return;
+  latency.noteOn();
+  AudioNoInterrupts();
+  mainMixer.noteGain(1 + drumIndex, preset.level(drumIndex) * gain, offset);
+  switch (drumIndex) {
+    case 0: drumKick.noteOn();  break;
+    case 1: drumSnare.noteOn(); break;
+    case 2: drumHihat.noteOn(); break;
+    case 3: drumRide.noteOn();  break;
+    case 4: drumCrash.noteOn(); break;
   }
-  
-  if (maxLevel < 0.01) return -1;
-  
-  // Simple frequency calculation
-  float frequency = maxBin * 44100.0 / 256.0;
-  return frequency;
+  AudioInterrupts();
 }
 
-// YOUR EXACT DRUM TRIGGERING FUNCTION - with velocity support via mixer
-void triggerDrumForFrequency(float freq, float velocity) {
+// YOUR EXACT DRUM TRIGGERING FUNCTION - with velocity support via mixer.
+// Every trigger path comes through here for the retrigger hold and the
+// velocity curve; `reason` and `freq` are what the event log records
+// (LOG_ENERGY_FALLBACK logs the band energy in place of a frequency).
+void triggerDrum(int drumIndex, float freq, float velocity, uint8_t offset,
+                 uint8_t reason = LOG_HIT) {
+  CPU_SCOPE(SCOPE_TRIGGER);
+  if (drumIndex < 0 || !canRetrigger(drumIndex)) return;
+
   // Adjust drum velocity based on input velocity
   float drumGain = velocity * 0.8 + 0.2;  // Scale velocity (0.2 to 1.0)
-  
-  // KICK DRUM (60-110 Hz) - Low E string area
-  if (freq >= 60 && freq < 110) {
-    if (canRetrigger(0)) {
-      drumMixer.gain(0, 0.7 * drumGain);  // Adjust kick volume by velocity
-      drumKick.noteOn();  // Trigger drum (no parameter)
-      Serial.print("🥁 KICK! ");
-      Serial.print(freq, 1);
-      Serial.print(" Hz, Vel: ");
-      Serial.println(velocity, 2);
-    }
+  startDrum(drumIndex, drumGain, offset);
+  midi.noteOn(DRUM_NOTE[drumIndex], velocity);
+
+  events.log(reason, drumIndex, freq, velocity);
+}
+
+void triggerDrumForFrequency(float freq, float velocity) {
+  triggerDrum(drumForFrequency(freq), freq, velocity, 0);
+}
+
+// The sketch's own wording for the event log
+int formatEvent(char *buf, size_t size, const LogRecord &r) {
+  static const char *const HIT_NAMES[5] = { "🥁 KICK!", "🪘 SNARE!", "🎩 HAT!", "🔔 RIDE!", "💥 CRASH!" };
+  static const char *const FALLBACK_NAMES[3] = { "KICK", "SNARE", "HAT" };
+  switch (r.reason) {
+    case LOG_HIT:
+      if (r.drum < 0 || r.drum >= 5) break;
+      return snprintf(buf, size, "%s %.1f Hz, Vel: %.2f\n", HIT_NAMES[r.drum], r.frequency, r.velocity);
+    case LOG_NO_PITCH:
+      return snprintf(buf, size, "Onset without pitch - skipped\n");
+    case LOG_STABLE_PITCH:
+      return snprintf(buf, size, "Stable pitch: %.2f Hz\n", r.frequency);
+    case LOG_UNSTABLE_PITCH:
+      return snprintf(buf, size, "Unstable pitch: %.2f Hz - using best guess\n", r.frequency);
+    case LOG_ENERGY_FALLBACK:
+      if (r.drum < 0 || r.drum >= 3) break;
+      return snprintf(buf, size, "Energy fallback - E:%.3f → %s\n", r.frequency, FALLBACK_NAMES[r.drum]);
   }
-  // SNARE DRUM (110-165 Hz) - A string area
-  else if (freq >= 110 && freq < 165) {
-    if (canRetrigger(1)) {
-      drumMixer.gain(1, 0.7 * drumGain);  // Adjust snare volume by velocity
-      drumSnare.noteOn();
-      Serial.print("🪘 SNARE! ");
-      Serial.print(freq, 1);
-      Serial.print(" Hz, Vel: ");
-      Serial.println(velocity, 2);
-    }
+  return EventLog::formatDefault(buf, size, r);
+}
+
+// YOUR EXACT DRUM SOUND SETUP, from the preset
+void setupDrum(int drumIndex, const PresetVoice &v) {
+  AudioSynthSimpleDrum &drum = *DRUMS[drumIndex];
+  drum.frequency(v.frequency);
+  drum.length(v.lengthMs);
+  drum.secondMix(v.secondMix / 100.0f);
+  drum.pitchMod(v.pitchMod / 100.0f);
+}
+
+void setupDrumSounds() {
+  for (int i = 0; i < 5; i++) setupDrum(i, preset.voices[i]);
+}
+
+// Switch presets mid-song: only what differs is touched, and all of it
+// between two audio updates, so no block sees half a preset
+void applyPreset(const PedalPreset &next) {
+  const uint16_t changes = presetChanges(preset, next);
+
+  // Tables first, outside the critical section
+  DrumMap<PedalPreset::MAX_BANDS> map = next.drumMap();
+#if USE_BLOCK_TRIGGER && POLY_TRIGGER
+  OnsetBand onsetBands[PedalPreset::MAX_BANDS];
+  for (uint8_t i = 0; i < next.numBands; i++) {
+    const float lo = next.bands[i].minHz;
+    onsetBands[i] = { lo, i + 1 < next.numBands ? next.bandTopHz(i) : max(1000.0f, lo * 2), (int8_t)next.bands[i].drum };
   }
-  // HI-HAT (165-260 Hz) - D & G string area
-  else if (freq >= 165 && freq < 260) {
-    if (canRetrigger(2)) {
-      drumMixer.gain(2, 0.5 * drumGain);  // Adjust hihat volume by velocity
-      drumHihat.noteOn();
-      Serial.print("🎩 HAT! ");
-      Serial.print(freq, 1);
-      Serial.print(" Hz, Vel: ");
-      Serial.println(velocity, 2);
-    }
+#elif USE_BLOCK_TRIGGER
+  float edges[PedalPreset::MAX_BANDS];
+  for (uint8_t i = 0; i < next.numBands; i++) edges[i] = next.bands[i].minHz;
+#if MULTI_INPUT
+  // The guitar's bands name their drums; the bass keeps its own split
+  int8_t drums[PedalPreset::MAX_BANDS];
+  for (uint8_t i = 0; i < next.numBands; i++) drums[i] = next.bands[i].drum;
+#endif
+#endif
+
+  AudioNoInterrupts();
+  if (changes & PRESET_BANDS) {
+    drumMap = map;
+#if USE_BLOCK_TRIGGER && POLY_TRIGGER
+    strings.bands(onsetBands, next.numBands);
+#elif USE_BLOCK_TRIGGER && MULTI_INPUT
+    pluck.bands(0, edges, drums, next.numBands);
+#elif USE_BLOCK_TRIGGER
+    pluck.bands(edges, next.numBands);
+#endif
   }
-  // RIDE CYMBAL (260-400 Hz) - B string area
-  else if (freq >= 260 && freq < 400) {
-    if (canRetrigger(3)) {
-      drumMixer.gain(3, 0.5 * drumGain);  // Adjust ride volume by velocity
-      drumRide.noteOn();
-      Serial.print("🔔 RIDE! ");
-      Serial.print(freq, 1);
-      Serial.print(" Hz, Vel: ");
-      Serial.println(velocity, 2);
-    }
+  if (changes & PRESET_TRIGGER) {
+    retriggerDelay = next.retriggerMs;
+    THRESHOLD_MULTIPLIER = next.multiplier;
+    HFC_THRESHOLD = next.hfcThreshold;
+    ENERGY_RATIO_THRESHOLD = next.ratioThreshold;
+#if USE_BLOCK_TRIGGER && !POLY_TRIGGER
+    pluck.thresholds(noiseFloor, THRESHOLD_MULTIPLIER, HFC_THRESHOLD, ENERGY_RATIO_THRESHOLD);
+#endif
   }
-  // CRASH CYMBAL (400+ Hz) - High E string upper frets
-  else if (freq >= 400) {
-    if (canRetrigger(4)) {
-      mainMixer.gain(2, 0.6 * drumGain);  // Adjust crash volume by velocity (on main mixer)
-      drumCrash.noteOn();
-      Serial.print("💥 CRASH! ");
-      Serial.print(freq, 1);
-      Serial.print(" Hz, Vel: ");
-      Serial.println(velocity, 2);
-    }
+  for (int i = 0; i < 5; i++) {
+    if (changes & (PRESET_VOICE << i)) setupDrum(i, next.voices[i]);
   }
-}
+  AudioInterrupts();
 
-// YOUR EXACT DRUM SOUND SETUP
-void setupDrumSounds() {
-  // KICK - Deep and punchy (60Hz fundamental)
-  drumKick.frequency(60);
-  drumKick.length(150);
-  drumKick.secondMix(0.0);
-  drumKick.pitchMod(0.5);
-  
-  // SNARE - Snappy with noise (200Hz + noise)
-  drumSnare.frequency(200);
-  drumSnare.length(100);
-  drumSnare.secondMix(1.0);
-  drumSnare.pitchMod(0.2);
-  
-  // HI-HAT - Short and crisp (800Hz)
-  drumHihat.frequency(800);
-  drumHihat.length(40);
-  drumHihat.secondMix(1.0);
-  drumHihat.pitchMod(0.0);
-  
-  // RIDE - Metallic ring (500Hz)
-  drumRide.frequency(500);
-  drumRide.length(300);
-  drumRide.secondMix(0.5);
-  drumRide.pitchMod(0.1);
-  
-  // CRASH - Long and bright (900Hz)
-  drumCrash.frequency(900);
-  drumCrash.length(500);
-  drumCrash.secondMix(1.0);
-  drumCrash.pitchMod(0.0);
+  preset = next;
 }
 
 // YOUR EXACT RETRIGGER FUNCTION
@@ -305,95 +594,10 @@ bool canRetrigger(int drumIndex) {
   return false;
 }
 
-// Zero-crossing rate calculation for frequency validation
-float calculateZCR(float* buffer, int length) {
-  int crossings = 0;
-  for (int i = 1; i < length; i++) {
-    // Count zero crossings
-    if ((buffer[i-1] >= 0 && buffer[i] < 0) || 
-        (buffer[i-1] < 0 && buffer[i] >= 0)) {
-      crossings++;
-    }
-  }
-  // Convert to frequency estimate (crossings per sample * sample rate / 2)
-  float zcrFreq = (crossings * 44100.0) / (length * 2.0);
-  return zcrFreq;
-}
-
-// Find harmonic peaks in FFT data
-bool findHarmonicPeaks(int* peaks, float* levels, int maxPeaks) {
-  // Find local maxima in FFT data
-  int peakCount = 0;
-  
-  for (int i = 1; i < 30 && peakCount < maxPeaks; i++) {
-    // Check if this bin is a local maximum
-    if (i < 127 && fftData[i] > fftData[i-1] && 
-        fftData[i] > fftData[i+1] && 
-        fftData[i] > 0.002) {
-      peaks[peakCount] = i;
-      levels[peakCount] = fftData[i];
-      peakCount++;
-    }
-  }
-  
-  return peakCount > 0;
-}
-
-// Detect pitch with harmonic analysis and validation
-float detectPitchWithHarmonics() {
-  int peaks[8];
-  float levels[8];
-  
-  // Find peaks in spectrum
-  if (!findHarmonicPeaks(peaks, levels, 8)) {
-    return -1;  // No significant peaks
-  }
-  
-  // Find fundamental by looking for harmonic relationships
-  float bestFundamental = -1;
-  float bestScore = 0;
-  
-  // Test each peak as potential fundamental
-  for (int f = 0; f < 3; f++) {  // Check first 3 peaks
-    if (peaks[f] == 0) continue;
-    
-    float fundamental = peaks[f] * 172.27;  // Convert bin to Hz
-    float score = levels[f];  // Start with peak strength
-    
-    // Look for harmonics of this fundamental
-    for (int h = 2; h <= 4; h++) {  // Check 2nd, 3rd, 4th harmonics
-      int harmonicBin = peaks[f] * h;
-      if (harmonicBin < 30) {
-        // Check if there's energy at the harmonic
-        float harmonicEnergy = fftData[harmonicBin];
-        if (harmonicBin > 0 && harmonicBin < 128) {
-          // Also check neighboring bins (not perfect tuning)
-          harmonicEnergy = max(harmonicEnergy, fftData[harmonicBin-1]);
-          if (harmonicBin < 127) {
-            harmonicEnergy = max(harmonicEnergy, fftData[harmonicBin+1]);
-          }
-        }
-        
-        // Add to score if harmonic is present
-        if (harmonicEnergy > 0.001) {
-          score += harmonicEnergy * (1.0 / h);  // Weight lower harmonics more
-        }
-      }
-    }
-    
-    // Update best if this is better
-    if (score > bestScore && fundamental >= 60 && fundamental <= 800) {
-      bestScore = score;
-      bestFundamental = fundamental;
-    }
-  }
-  
-  return bestFundamental;
-}
-
 // Multi-frame pitch averaging for stability
 float getStablePitch() {
-  float currentPitch = detectPitchWithHarmonics();
+  CPU_SCOPE(SCOPE_PITCH);
+  float currentPitch = pitchSpectrum.fundamental;
   
   // Store in history
   pitchHistory[pitchHistoryIndex] = currentPitch;
@@ -429,100 +633,193 @@ float getStablePitch() {
   // Debug output
   static int debugCount = 0;
   if (++debugCount % 5 == 0 && avgPitch > 0) {
-    Serial.print("Stable pitch: ");
-    Serial.print(avgPitch);
-    Serial.print(" Hz (");
-    Serial.print(validCount);
-    Serial.println(" frames)");
+    events.log(LOG_STABLE_PITCH, -1, avgPitch);
   }
   
   return avgPitch;
 }
 
 void loop() {
+  if (calibrator.active()) {
+    serviceCalibration();
+    midi.service();
+    events.drain(Serial);
+    return;
+  }
+
+#if USE_BLOCK_TRIGGER
+  // Onset, pitch and velocity were already decided in the audio ISR;
+  // just hand the events to the drums.
+  PluckEvent ev;
+#if POLY_TRIGGER
+  // One event per string band; a strum gives several in the same block
+  while (strings.read(ev)) {
+    latency.onset(ev.cycles);
+    triggerDrum(ev.drum, ev.frequency, ev.velocity, ev.offset);
+  }
+  lastPeakLevel = 0;
+  for (uint8_t b = 0; b < strings.bandCount(); b++) {
+    lastPeakLevel = max(lastPeakLevel, strings.level(b));
+  }
+#else
+  while (pluck.read(ev)) {
+    latency.onset(ev.cycles);
+    if (ev.drum >= 0) {
+#if MULTI_INPUT
+      // Each input's bands already name the drum
+      triggerDrum(ev.drum, ev.frequency, ev.velocity, ev.offset);
+#else
+      // ev.drum is pluck's band; the preset says which drum that plays
+      triggerDrum(preset.bands[ev.drum].drum, ev.frequency, ev.velocity, ev.offset);
+#endif
+    } else {
+      events.log(LOG_NO_PITCH, -1, -1.0f, ev.velocity);
+    }
+  }
+#if MULTI_INPUT
+  lastPeakLevel = max(pluck.level(0), pluck.level(1));
+#else
+  lastPeakLevel = pluck.level();
+#endif
+#endif
+#else
   // NEW: Advanced onset detection with improved pitch detection
-  if (fft.available() && peak.available()) {
-    // Read FFT data once
-    for (int i = 0; i < 128; i++) {
-      fftData[i] = fft.read(i);
+  bool pitchFrame;
+  {
+    CPU_SCOPE(SCOPE_PITCH_FFT);
+    pitchFrame = pitchFFT.compute(sampleRing);
+    if (pitchFrame) {
+      pitchSpectrum.compute(pitchFFT.magnitudes(), pitchFFT.BINS, pitchFFT.binHz());
     }
-    
-    // Read peak level
+  }
+  bool onsetFrame = false;
+  if (peak.available()) {
+    CPU_SCOPE(SCOPE_ONSET_FFT);
+    onsetFrame = onsetFFT.compute(sampleRing);
+    if (onsetFrame) {
+      // AudioAnalyzeFFT256 read a full scale sine as 0.5, FFTEngine as 1.0
+      const float *mag = onsetFFT.magnitudes();
+      for (int i = 0; i < 128; i++) {
+        fftData[i] = mag[i] * 0.5f;
+      }
+      // Every onset detector below reads this one pass over the frame
+      spectrum.compute(fftData, 128, onsetFFT.binHz());
+    }
+  }
+  if (onsetFrame) {
+    // Read peak level (once - the status indicator reuses it)
     float level = peak.read();
+    lastPeakLevel = level;
     
     // Check for onset with velocity
     float velocity = 0;
     bool onsetDetected = detectOnset(level, velocity);
     
     if (onsetDetected) {
-      // Use multi-frame averaged pitch detection with harmonic analysis
-      float freq = getStablePitch();
+      // This detector only exists in loop(), so onset and seen coincide
+      latency.onset(LatencyProbe::now());
+      // A pick still waiting for its pitch is replaced by this one
+      if (pendingOnset.waiting) events.log(LOG_NO_PITCH, -1, -1.0f, pendingOnset.velocity);
+      pendingOnset.waiting = true;
+      pendingOnset.start = onsetFFT.frameTime() - AUDIO_BLOCK_SAMPLES;
+      pendingOnset.velocity = velocity;
+      for (int b = 0; b < SpectralFrame::NUM_BANDS; b++) pendingOnset.band[b] = spectrum.band[b];
+      pendingOnset.frames = 0;
+      // Frames from before the pick must not vote on its pitch
+      for (int i = 0; i < 3; i++) pitchHistory[i] = 0;
+    }
+  }
+  // Only pitch frames that start at or after the onset block count
+  if (pitchFrame && pendingOnset.waiting &&
+      (int32_t)(pitchFFT.frameTime() - pendingOnset.start) >= pitchFFT.windowLength()) {
+    pendingOnset.frames++;
+    const float velocity = pendingOnset.velocity;
+    // Use multi-frame averaged pitch detection with harmonic analysis
+    float freq = getStablePitch();
+    
+    if (freq > 0) {  // Valid, stable frequency detected
+      // Trigger the appropriate drum with velocity
+      pendingOnset.waiting = false;
+      triggerDrumForFrequency(freq, velocity);
+    } else if (pendingOnset.frames >= PITCH_WAIT_FRAMES) {
+      pendingOnset.waiting = false;
+      // Improved fallback using harmonic content analysis
+      // Look for presence of harmonics to determine drum type
+      float fundamental = pitchSpectrum.fundamental;
       
-      if (freq > 0) {  // Valid, stable frequency detected
-        // Trigger the appropriate drum with velocity
-        triggerDrumForFrequency(freq, velocity);
+      if (fundamental > 0) {
+        // Got a fundamental but not stable over time
+        events.log(LOG_UNSTABLE_PITCH, -1, fundamental, velocity);
+        triggerDrumForFrequency(fundamental, velocity);
       } else {
-        // Improved fallback using harmonic content analysis
-        // Look for presence of harmonics to determine drum type
-        float fundamental = detectPitchWithHarmonics();
+        // No clear pitch - use the onset frame's energy distribution
+        float lowEnergy = pendingOnset.band[0];   // 150-600 Hz
+        float midEnergy = pendingOnset.band[1];   // 600-1450 Hz
+        float highEnergy = pendingOnset.band[2];  // 1450-3500 Hz
         
-        if (fundamental > 0) {
-          // Got a fundamental but not stable over time
-          Serial.print("Unstable pitch: ");
-          Serial.print(fundamental);
-          Serial.println(" Hz - using best guess");
-          triggerDrumForFrequency(fundamental, velocity);
-        } else {
-          // No clear pitch - use energy distribution
-          float lowEnergy = 0;   // Bins 1-3 (80-250 Hz)
-          float midEnergy = 0;   // Bins 4-8 (250-500 Hz)
-          float highEnergy = 0;  // Bins 9+ (500+ Hz)
-          
-          for (int i = 1; i <= 3; i++) lowEnergy += fftData[i];
-          for (int i = 4; i <= 8; i++) midEnergy += fftData[i];
-          for (int i = 9; i <= 20; i++) highEnergy += fftData[i];
-          
-          // Only show fallback if we have significant energy
-          if (lowEnergy + midEnergy + highEnergy > 0.01) {
-            Serial.print("Energy fallback - L:");
-            Serial.print(lowEnergy, 3);
-            Serial.print(" M:");
-            Serial.print(midEnergy, 3);
-            Serial.print(" H:");
-            Serial.println(highEnergy, 3);
-            
-            // Trigger based on energy distribution
-            if (lowEnergy > midEnergy * 1.5 && lowEnergy > highEnergy * 1.5) {
-              drumMixer.gain(0, 0.7 * velocity);
-              drumKick.noteOn();
-              Serial.println("→ KICK");
-            } else if (midEnergy > highEnergy * 1.2) {
-              drumMixer.gain(1, 0.7 * velocity);
-              drumSnare.noteOn();
-              Serial.println("→ SNARE");
-            } else {
-              drumMixer.gain(2, 0.5 * velocity);
-              drumHihat.noteOn();
-              Serial.println("→ HAT");
-            }
+        // Only show fallback if we have significant energy
+        if (lowEnergy + midEnergy + highEnergy > 0.01) {
+          // Trigger based on energy distribution
+          int drum;
+          if (lowEnergy > midEnergy * 1.5 && lowEnergy > highEnergy * 1.5) {
+            drum = 0;  // KICK
+          } else if (midEnergy > highEnergy * 1.2) {
+            drum = 1;  // SNARE
+          } else {
+            drum = 2;  // HAT
           }
+          triggerDrum(drum, lowEnergy + midEnergy + highEnergy, velocity, 0, LOG_ENERGY_FALLBACK);
+        } else {
+          events.log(LOG_NO_PITCH, -1, -1.0f, velocity);
         }
       }
     }
   }
   
+#endif
+
+  // Note-offs, and one USB packet for all of this pass's hits
+  midi.service();
+
+#if PROFILE_CPU
+  cpu.report(Serial);
+#endif
+
+  events.drain(Serial);
+  audioBlocks.check(Serial);
+
+  // Serial commands
+  if (Serial.available()) {
+    char c = Serial.read();
+    if (c == 'p' || presetShell.active()) {
+      // A preset command line, a character per pass
+      if (presetShell.feed(c, preset, Serial)) applyPreset(presetShell.result());
+      c = 0;
+    }
+    if (c == 'l') latency.print(Serial);
+    if (c == 'r') {
+      latency.reset();
+      audioBlocks.resetMax();
+    }
+    if (c == 'a') audioBlocks.print(Serial);
+    if (c == 'b') events.mode(events.mode() == EventLog::MODE_BINARY ? EventLog::MODE_TEXT
+                                                                     : EventLog::MODE_BINARY);
+    if (c == 'm') {
+      internalDrums = !internalDrums;
+      Serial.println(internalDrums ? "Drums: pedal + MIDI" : "Drums: MIDI only");
+    }
+    if (c == 'c') calibrator.begin(audioShield, inputLevel, Serial);
+  }
+
   // Status indicator
   static unsigned long lastStatusTime = 0;
   static int dotCount = 0;
   if (millis() - lastStatusTime > 100) {
-    if (peak.available()) {
-      float level = peak.read();
-      if (level > 0.001) {
-        dotCount++;
-        if (dotCount >= 10) {
-          Serial.print("♪");
-          dotCount = 0;
-        }
+    if (lastPeakLevel > 0.001) {
+      dotCount++;
+      if (dotCount >= 10) {
+        Serial.print("♪");
+        dotCount = 0;
       }
     }
     lastStatusTime = millis();
@@ -532,6 +829,10 @@ void loop() {
 // Optional: Adjust sensitivity on the fly
 void adjustSensitivity(float newMultiplier) {
   THRESHOLD_MULTIPLIER = constrain(newMultiplier, 1.0, 3.0);
+  preset.multiplier = THRESHOLD_MULTIPLIER;
+#if USE_BLOCK_TRIGGER && !POLY_TRIGGER
+  pluck.thresholds(noiseFloor, THRESHOLD_MULTIPLIER, HFC_THRESHOLD, ENERGY_RATIO_THRESHOLD);
+#endif
   Serial.print("Sensitivity adjusted to: ");
   Serial.println(THRESHOLD_MULTIPLIER);
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 // GUITAR -> DRUM SAMPLES (based on your working sketch)
-// Replaces synth drums with SD WAV playback but keeps your exact band mapping.
+// Replaces synth drums with WAV samples (read from SD once at boot, played
+// from RAM) but keeps your exact band mapping.
 //
 // Hardware: Teensy 4.x + Audio Shield (Rev D) OR Teensy 4.1 (onboard SD)
 // Input: Audio Shield LINE IN (same as your sketch)
@@ -8,6 +9,14 @@
 #include <Wire.h>
 #include <SPI.h>
 #include <SD.h>
+#include <drum_sample.h>
+#include <drum_voices.h>
+#include <cpu_profiler.h>
+#include <drum_map.h>
+#include <event_log.h>
+
+// 1: print a per-object / per-stage CPU table every 2 s
+#define PROFILE_CPU 0
 
 // ====== SD CONFIG ======
 #if defined(ARDUINO_TEENSY41)
@@ -23,6 +32,26 @@ const char* FILE_HHCL  = "HHCL.WAV";
 const char* FILE_RIDE  = "RIDE.WAV";
 const char* FILE_CRASH = "CRASH.WAV";
 
+// ====== KIT ======
+// Decoded once in setup() so a trigger never touches the SD card.
+// KICK..CRASH match the drum index used by canRetrigger().
+enum { KICK, SNARE, HHCL, RIDE, CRASH, HHOP, NUM_DRUMS };
+
+struct KitFile { uint8_t drum; const char* file; float minVelocity; bool required; };
+KitFile kitFiles[] = {
+  { KICK,  FILE_KICK,     0.0f,  true  },
+  { SNARE, FILE_SNARE,    0.0f,  true  },
+  { SNARE, "SNAREHI.WAV", 0.75f, false },  // optional accent layer
+  { HHCL,  FILE_HHCL,     0.0f,  true  },
+  { RIDE,  FILE_RIDE,     0.0f,  true  },
+  { CRASH, FILE_CRASH,    0.0f,  true  },
+  { HHOP,  "HHOP.WAV",    0.0f,  false },  // optional open hat, choked by HHCL
+};
+const int NUM_KIT_FILES = sizeof(kitFiles) / sizeof(kitFiles[0]);
+DrumSample drumSamples[NUM_KIT_FILES];
+
+const float OPEN_HAT_VELOCITY = 0.85f;    // hard picks on the hat band open it
+
 // ======Frequency Smoothing (NEW) =====
 const int FREQ_HISTORY_SIZE = 3; // Number of samples to average
 float freqHistory[FREQ_HISTORY_SIZE];
@@ -35,18 +64,8 @@ AudioInputI2S             audioInput;      // Guitar input (Audio Shield)
 AudioAnalyzeNoteFrequency notefreq;        // Note detection
 AudioAnalyzePeak          peak;            // Peak detection
 
-// SD WAV players (multiple so hits can overlap)
-AudioPlaySdWav            wav1;
-AudioPlaySdWav            wav2;
-AudioPlaySdWav            wav3;
-AudioPlaySdWav            wav4;
-AudioPlaySdWav            wav5;
-AudioPlaySdWav            wav6;
-
-// Mixers for WAVs -> drum bus
-AudioMixer4               drumMixA;        // up to 4 sources
-AudioMixer4               drumMixB;        // up to 4 sources (we'll use 2 of them)
-AudioMixer4               drumBus;         // sum A+B to one bus
+// RAM sample voices (handed out by DrumVoiceManager), summed in one pass
+AudioPlaySamplePool       drumPool;
 
 // Final mix (kept from your sketch idea): guitar dry + drums + (extra slot if needed)
 AudioMixer4               mainMixer;       
@@ -59,48 +78,33 @@ AudioConnection patchCord1(audioInput, 0, notefreq, 0);
 AudioConnection patchCord2(audioInput, 0, peak, 0);
 AudioConnection patchCord3(audioInput, 0, mainMixer, 0);    // Dry guitar to main
 
-// WAV players into the two submixers
-AudioConnection patchCord4(wav1, 0, drumMixA, 0);
-AudioConnection patchCord5(wav2, 0, drumMixA, 1);
-AudioConnection patchCord6(wav3, 0, drumMixA, 2);
-AudioConnection patchCord7(wav4, 0, drumMixA, 3);
-AudioConnection patchCord8(wav5, 0, drumMixB, 0);
-AudioConnection patchCord9(wav6, 0, drumMixB, 1);
-
-// Submixers into drumBus
-AudioConnection patchCord10(drumMixA, 0, drumBus, 0);
-AudioConnection patchCord11(drumMixB, 0, drumBus, 1);
-
-// Drum bus into main mix
-AudioConnection patchCord12(drumBus, 0, mainMixer, 1);
+// Drum voices into main mix
+AudioConnection patchCord4(drumPool, 0, mainMixer, 1);
 
 // Main to outputs (stereo)
-AudioConnection patchCord13(mainMixer, 0, audioOutput, 0);  // Left
-AudioConnection patchCord14(mainMixer, 0, audioOutput, 1);  // Right
+AudioConnection patchCord5(mainMixer, 0, lineOutput, 0);   // Left
+AudioConnection patchCord6(mainMixer, 0, lineOutput, 1);   // Right
 
 // ====== CONTROL ======
 unsigned long lastTriggerTime[5] = {0};
 const int retriggerDelay = 80;  // Minimum ms between same drum
 
-// simple round-robin across the 6 players
-AudioPlaySdWav* players[6] = { &wav1, &wav2, &wav3, &wav4, &wav5, &wav6 };
-int nextPlayer = 0;
-
-bool playSample(const char* fname) {
-  // try to find a free player first
-  for (int i = 0; i < 6; ++i) {
-    int idx = (nextPlayer + i) % 6;
-    if (!players[idx]->isPlaying()) {
-      players[idx]->play(fname);
-      nextPlayer = (idx + 1) % 6;
-      return true;
-    }
-  }
-  // steal the next slot if all busy
-  players[nextPlayer]->stop();
-  bool ok = players[nextPlayer]->play(fname);
-  nextPlayer = (nextPlayer + 1) % 6;
-  return ok;
+// Polyphonic voices: quietest/oldest stealing, hat choke, velocity layers
+DrumVoiceManager voices;
+
+// Hit messages, printed from the end of loop() when the USB port has room
+EventLog events;
+
+#if PROFILE_CPU
+CpuProfiler cpu;
+uint8_t SCOPE_SMOOTH, SCOPE_TRIGGER;
+#define CPU_SCOPE(id) CpuScope cpuScope_(cpu, id)
+#else
+#define CPU_SCOPE(id)
+#endif
+
+bool playSample(int drum, float velocity) {
+  return voices.noteOn(drum, velocity) >= 0;
 }
 
 bool canRetrigger(int drumIndex) {
@@ -113,6 +117,7 @@ bool canRetrigger(int drumIndex) {
 
 // ===== NEW FUNCTION: Smooth frequency readings =====
 float getSmoothedFrequency(float newFreq) {
+  CPU_SCOPE(SCOPE_SMOOTH);
   // Add new frequency to history
   freqHistory[freqHistoryIndex] = newFreq;
   freqHistoryIndex = (freqHistoryIndex + 1) % FREQ_HISTORY_SIZE;
@@ -145,7 +150,8 @@ void setup() {
   Serial.println("   GUITAR DRUM MACHINE - SD SAMPLES ");
   Serial.println("====================================");
 
-  AudioMemory(80); // more buffers for SD playback
+  AudioMemory(80);
+  events.formatter(formatHit);
 
   // Initialize frequency history
   for (int i = 0; i < FREQ_HISTORY_SIZE; i++) {
@@ -161,12 +167,6 @@ void setup() {
   // Analysis
   notefreq.begin(0.05);
 
-  // Mix gains
-  for (int i = 0; i < 4; ++i) drumMixA.gain(i, 0.8);
-  for (int i = 0; i < 4; ++i) drumMixB.gain(i, 0.8);
-  drumBus.gain(0, 0.9);
-  drumBus.gain(1, 0.9);
-
   mainMixer.gain(0, 0.0f);  // Dry guitar (set to taste; you had 0 before)
   mainMixer.gain(1, 0.9f);  // Drums
   mainMixer.gain(2, 0.0f);
@@ -180,22 +180,48 @@ void setup() {
   }
   Serial.println("OK");
 
-  // Quick existence check (helps catch typos/format issues)
-  const char* files[] = { FILE_KICK, FILE_SNARE, FILE_HHCL, FILE_RIDE, FILE_CRASH };
-  for (auto f : files) {
-    if (!SD.exists(f)) {
-      Serial.print("⚠️ Missing file on SD: ");
-      Serial.println(f);
-    }
+  // Decode every drum sample into RAM once (also catches typos/format issues)
+  uint32_t sampleBytes = 0;
+  for (int i = 0; i < NUM_KIT_FILES; ++i) {
+    bool ok = drumSamples[i].load(kitFiles[i].file);
+    if (!ok && !kitFiles[i].required) continue;  // optional layer not on the card
+    if (!ok || drumSamples[i].error()) Serial.print("⚠️ ");
+    drumSamples[i].printInfo(Serial);
+    sampleBytes += drumSamples[i].bytes();
+    voices.addLayer(kitFiles[i].drum, drumSamples[i], kitFiles[i].minVelocity);
   }
+  Serial.printf("Samples in RAM: %lu bytes total\n", (unsigned long)sampleBytes);
+
+  // 12 voices, velocity applied inside each voice
+  voices.begin(drumPool, 12);
+
+  // 0.72 = the old 0.8 voice level x 0.9 drumBus gain
+  voices.setDrum(KICK,  0.72f);
+  voices.setDrum(SNARE, 0.72f);
+  voices.setDrum(HHCL,  0.72f, 1, 3);   // hats share choke group 1,
+  voices.setDrum(HHOP,  0.72f, 1, 1);   // at most 3 closed / 1 open
+  voices.setDrum(RIDE,  0.72f);
+  voices.setDrum(CRASH, 0.72f);
 
   // Tiny demo to prove audio path
   delay(300);
   Serial.println("Playing short test (KICK->SNARE->HAT)...");
-  playSample(FILE_KICK); delay(180);
-  playSample(FILE_SNARE); delay(180);
-  playSample(FILE_HHCL); delay(250);
+  playSample(KICK, 1.0f); delay(180);
+  playSample(SNARE, 1.0f); delay(180);
+  playSample(HHCL, 1.0f); delay(250);
   Serial.println("Ready! Play your guitar.");
+
+#if PROFILE_CPU
+  cpu.begin(2000);
+  cpu.addObject("input", audioInput);
+  cpu.addObject("notefreq", notefreq);
+  cpu.addObject("peak", peak);
+  cpu.addObject("drumPool", drumPool);
+  cpu.addObject("mixer", mainMixer);
+  cpu.addObject("output", lineOutput);
+  SCOPE_SMOOTH  = cpu.addScope("smooth");
+  SCOPE_TRIGGER = cpu.addScope("trigger");
+#endif
 }
 
 // ====== MAIN ======
@@ -209,7 +235,9 @@ void loop() {
     if (probability > 0.6 && level > 0.02) {
       // NEW: Use smoothed frequency instead of raw
       float smoothedFreq = getSmoothedFrequency(freq);
-      triggerDrumForFrequency(smoothedFreq);
+      // Velocity from the pick level (same curve as the Claude_v2 sketch)
+      float velocity = constrain(sqrtf(level) * 1.5f, 0.1f, 1.0f);
+      triggerDrumForFrequency(smoothedFreq, velocity);
 
       // Optional debug: show both raw and smooth frequency
       if (false) { // Set to true to see the difference }
@@ -221,43 +249,57 @@ void loop() {
       }
     }
   }
+
+#if PROFILE_CPU
+  cpu.report(Serial);
+#endif
+
+  events.drain(Serial);
 }
 
 // ====== YOUR MAPPING, NOW TRIGGERING SAMPLES ======
-void triggerDrumForFrequency(float freq) {
-  // KICK (60-110 Hz)
-  if (freq >= 60 && freq < 110) {
-    if (canRetrigger(0)) {
-      playSample(FILE_KICK);
-      Serial.print("🥁 KICK! "); Serial.print(freq, 1); Serial.println(" Hz");
-    }
-  }
-  // SNARE (110-165 Hz)
-  else if (freq >= 110 && freq < 165) {
-    if (canRetrigger(1)) {
-      playSample(FILE_SNARE);
-      Serial.print("🪘 SNARE! "); Serial.print(freq, 1); Serial.println(" Hz");
-    }
-  }
-  // HI-HAT (165-260 Hz) -> closed hat sample
-  else if (freq >= 165 && freq < 260) {
-    if (canRetrigger(2)) {
-      playSample(FILE_HHCL);
-      Serial.print("🎩 HAT! "); Serial.print(freq, 1); Serial.println(" Hz");
-    }
-  }
-  // RIDE (260-400 Hz)
-  else if (freq >= 260 && freq < 400) {
-    if (canRetrigger(3)) {
-      playSample(FILE_RIDE);
-      Serial.print("🔔 RIDE! "); Serial.print(freq, 1); Serial.println(" Hz");
-    }
-  }
-  // CRASH (400+ Hz)
-  else if (freq >= 400) {
-    if (canRetrigger(4)) {
-      playSample(FILE_CRASH);
-      Serial.print("💥 CRASH! "); Serial.print(freq, 1); Serial.println(" Hz");
+// Frequency bands to retrigger slots, compiled to a lookup table (drum_map.h)
+constexpr DrumBand DRUM_BANDS[] = {
+  {  60,   110, 0, 0 },   // KICK (60-110 Hz)
+  { 110,   165, 1, 0 },   // SNARE (110-165 Hz)
+  { 165,   260, 2, 0 },   // HI-HAT (165-260 Hz) -> closed hat sample
+  { 260,   400, 3, 0 },   // RIDE (260-400 Hz)
+  { 400, 16384, 4, 0 },   // CRASH (400+ Hz)
+};
+constexpr DrumMap<5> DRUM_MAP(DRUM_BANDS);
+
+void triggerDrumForFrequency(float freq, float velocity) {
+  CPU_SCOPE(SCOPE_TRIGGER);
+  int slot = DRUM_MAP.drumFor(freq);
+  if (slot < 0 || !canRetrigger(slot)) return;
+
+  switch (slot) {
+    case 0:
+      playSample(KICK, velocity);
+      break;
+    case 1:
+      playSample(SNARE, velocity);
+      break;
+    case 2: {
+      // Hard picks open the hat if an HHOP sample is loaded; the next
+      // closed hat chokes it
+      bool open = velocity >= OPEN_HAT_VELOCITY && voices.hasDrum(HHOP);
+      playSample(open ? HHOP : HHCL, velocity);
+      break;
     }
+    case 3:
+      playSample(RIDE, velocity);
+      break;
+    case 4:
+      playSample(CRASH, velocity);
+      break;
   }
+  events.log(LOG_HIT, slot, freq, velocity);
+}
+
+// "🥁 KICK! 82.4 Hz" for each hit in the event log
+int formatHit(char *buf, size_t size, const LogRecord &r) {
+  static const char *const NAMES[5] = { "🥁 KICK!", "🪘 SNARE!", "🎩 HAT!", "🔔 RIDE!", "💥 CRASH!" };
+  if (r.reason != LOG_HIT || r.drum < 0 || r.drum >= 5) return EventLog::formatDefault(buf, size, r);
+  return snprintf(buf, size, "%s %.1f Hz\n", NAMES[r.drum], r.frequency);
 }
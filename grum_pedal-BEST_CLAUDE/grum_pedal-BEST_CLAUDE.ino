@@ -1,7 +1,9 @@
 // GUITAR -> DRUM SAMPLES WITH TRUE BYPASS TOGGLE
-// Footswitch toggles between:
+// Footswitch tap toggles between:
 //   - BYPASS: Clean guitar only (for recording guitar to looper)
 //   - ACTIVE: Drums only (for recording drums to looper)
+// Holding it (or pressing the optional kit switch) steps to the next kit;
+// the next kit is always preloaded, so the change is instant.
 //
 // Hardware: Teensy 4.0 + Audio Shield Rev D
 // Input: Audio Shield LINE IN
@@ -12,19 +14,31 @@
 #include <Wire.h>
 #include <SPI.h>
 #include <SD.h>
+#include <drum_sample.h>
+#include <drum_voices.h>
+#include <kit_bank.h>
+#include <bypass_fade.h>
+#include <event_log.h>
 #include <Bounce2.h>  // For debouncing
 
 // ====== BYPASS CONTROL PINS (NEW) ======
 const int FOOTSWITCH_PIN = 2;   // Digital pin 2 for footswitch (momentary, normally open)
 const int LED_PIN = 3;          // Digital pin 3 for LED indicator
+const int KIT_SWITCH_PIN = 4;   // Optional second footswitch: next kit on press
 // Note: Pins 2 and 3 are safe to use on Teensy 4.0 with Audio Shield
 
 // ====== BYPASS STATE (NEW) ======
 bool bypassMode = true;          // Start in bypass mode (guitar only)
 Bounce footswitch = Bounce();   // Debouncer for footswitch
+Bounce kitSwitch = Bounce();
 unsigned long lastToggleTime = 0;
 const int toggleDebounceTime = 50;  // Additional debounce protection
 
+// Tap = bypass toggle on release, hold = next kit as soon as it is held
+const unsigned long LONG_PRESS_MS = 600;
+unsigned long pressStartTime = 0;
+bool pressHandled = true;
+
 // ====== SD CONFIG ======
 #if defined(ARDUINO_TEENSY41)
   const int SD_CS = BUILTIN_SDCARD;   // Teensy 4.1 onboard SD
@@ -32,12 +46,64 @@ const int toggleDebounceTime = 50;  // Additional debounce protection
   const int SD_CS = 10;               // Audio Shield Rev D CS
 #endif
 
-// ====== FILE NAMES ======
-const char* FILE_KICK  = "KICK.WAV";
-const char* FILE_SNARE = "SNARE.WAV";
-const char* FILE_HHCL  = "HHCL.WAV";
-const char* FILE_RIDE  = "RIDE.WAV";
-const char* FILE_CRASH = "CRASH.WAV";
+// ====== KITS ======
+// Each kit is decoded into RAM by the KitBank before it is needed, so a
+// trigger never touches the SD card. KICK..CRASH match the drum index
+// used by canRetrigger(). Extra kits live in folders on the card and are
+// skipped if their files are missing.
+enum { KICK, SNARE, HHCL, RIDE, CRASH, HHOP, NUM_DRUMS };
+
+const KitFile studioFiles[] = {
+  { KICK,  "KICK.WAV",    0.0f,  true  },
+  { SNARE, "SNARE.WAV",   0.0f,  true  },
+  { SNARE, "SNAREHI.WAV", 0.75f, false },  // optional accent layer
+  { HHCL,  "HHCL.WAV",    0.0f,  true  },
+  { RIDE,  "RIDE.WAV",    0.0f,  true  },
+  { CRASH, "CRASH.WAV",   0.0f,  true  },
+  { HHOP,  "HHOP.WAV",    0.0f,  false },  // optional open hat, choked by HHCL
+};
+const KitFile rockFiles[] = {
+  { KICK,  "ROCK/KICK.WAV",    0.0f,  true  },
+  { SNARE, "ROCK/SNARE.WAV",   0.0f,  true  },
+  { SNARE, "ROCK/SNAREHI.WAV", 0.75f, false },
+  { HHCL,  "ROCK/HHCL.WAV",    0.0f,  true  },
+  { RIDE,  "ROCK/RIDE.WAV",    0.0f,  true  },
+  { CRASH, "ROCK/CRASH.WAV",   0.0f,  true  },
+  { HHOP,  "ROCK/HHOP.WAV",    0.0f,  false },
+};
+const KitFile brushFiles[] = {
+  { KICK,  "BRUSH/KICK.WAV",  0.0f, true  },
+  { SNARE, "BRUSH/SNARE.WAV", 0.0f, true  },
+  { HHCL,  "BRUSH/HHCL.WAV",  0.0f, true  },
+  { RIDE,  "BRUSH/RIDE.WAV",  0.0f, true  },
+  { CRASH, "BRUSH/CRASH.WAV", 0.0f, false },
+  { HHOP,  "BRUSH/HHOP.WAV",  0.0f, false },
+};
+
+// Per-drum level, choke group and voice cap; 0.72 = the old 0.8 voice
+// level x 0.9 drumBus gain. Hats share choke group 1, at most 3 closed /
+// 1 open.
+const KitDrum studioDrums[] = {
+  { KICK,  0.72f, 0, 0 }, { SNARE, 0.72f, 0, 0 }, { HHCL, 0.72f, 1, 3 },
+  { HHOP,  0.72f, 1, 1 }, { RIDE,  0.72f, 0, 0 }, { CRASH, 0.72f, 0, 0 },
+};
+const KitDrum rockDrums[] = {
+  { KICK,  0.80f, 0, 0 }, { SNARE, 0.76f, 0, 0 }, { HHCL, 0.64f, 1, 3 },
+  { HHOP,  0.64f, 1, 1 }, { RIDE,  0.68f, 0, 0 }, { CRASH, 0.72f, 0, 2 },
+};
+const KitDrum brushDrums[] = {
+  { KICK,  0.66f, 0, 0 }, { SNARE, 0.80f, 0, 0 }, { HHCL, 0.60f, 1, 3 },
+  { HHOP,  0.60f, 1, 1 }, { RIDE,  0.72f, 0, 0 }, { CRASH, 0.60f, 0, 0 },
+};
+
+const KitDef kits[] = {
+  KIT_DEF("Studio", studioFiles, studioDrums),
+  KIT_DEF("Rock",   rockFiles,   rockDrums),
+  KIT_DEF("Brush",  brushFiles,  brushDrums),
+};
+const uint8_t NUM_KITS = sizeof(kits) / sizeof(kits[0]);
+
+const float OPEN_HAT_VELOCITY = 0.85f;    // hard picks on the hat band open it
 
 // ====== Frequency Smoothing ======
 const int FREQ_HISTORY_SIZE = 3;
@@ -51,21 +117,11 @@ AudioInputI2S             audioInput;      // Guitar input (Audio Shield)
 AudioAnalyzeNoteFrequency notefreq;        // Note detection
 AudioAnalyzePeak          peak;            // Peak detection
 
-// SD WAV players (multiple so hits can overlap)
-AudioPlaySdWav            wav1;
-AudioPlaySdWav            wav2;
-AudioPlaySdWav            wav3;
-AudioPlaySdWav            wav4;
-AudioPlaySdWav            wav5;
-AudioPlaySdWav            wav6;
-
-// Mixers for WAVs -> drum bus
-AudioMixer4               drumMixA;        // up to 4 sources
-AudioMixer4               drumMixB;        // up to 4 sources
-AudioMixer4               drumBus;         // sum A+B to one bus
-
-// Final mix: guitar dry + drums
-AudioMixer4               mainMixer;       
+// RAM sample voices (handed out by DrumVoiceManager), summed in one pass
+AudioPlaySamplePool       drumPool;
+
+// Final mix: guitar dry + drums, crossfaded on bypass
+AudioEffectBypassFade     bypassStage;
 AudioOutputI2S            lineOutput;      // Line out ONLY (no headphone code)
 
 AudioControlSGTL5000      audioShield;
@@ -73,53 +129,36 @@ AudioControlSGTL5000      audioShield;
 // Patch cords
 AudioConnection patchCord1(audioInput, 0, notefreq, 0);
 AudioConnection patchCord2(audioInput, 0, peak, 0);
-AudioConnection patchCord3(audioInput, 0, mainMixer, 0);    // Dry guitar to main
-
-// WAV players into the two submixers
-AudioConnection patchCord4(wav1, 0, drumMixA, 0);
-AudioConnection patchCord5(wav2, 0, drumMixA, 1);
-AudioConnection patchCord6(wav3, 0, drumMixA, 2);
-AudioConnection patchCord7(wav4, 0, drumMixA, 3);
-AudioConnection patchCord8(wav5, 0, drumMixB, 0);
-AudioConnection patchCord9(wav6, 0, drumMixB, 1);
-
-// Submixers into drumBus
-AudioConnection patchCord10(drumMixA, 0, drumBus, 0);
-AudioConnection patchCord11(drumMixB, 0, drumBus, 1);
+AudioConnection patchCord3(audioInput, 0, bypassStage, 0);  // Dry guitar to main
 
-// Drum bus into main mix
-AudioConnection patchCord12(drumBus, 0, mainMixer, 1);
+// Drum voices into main mix
+AudioConnection patchCord4(drumPool, 0, bypassStage, 1);
 
 // Main to LINE OUTPUT only (removed headphone monitoring)
-AudioConnection patchCord13(mainMixer, 0, lineOutput, 0);  // Left
-AudioConnection patchCord14(mainMixer, 0, lineOutput, 1);  // Right
+AudioConnection patchCord5(bypassStage, 0, lineOutput, 0);  // Left
+AudioConnection patchCord6(bypassStage, 0, lineOutput, 1);  // Right
+
+// Bypass crossfade length: 10 ms
+const uint32_t BYPASS_RAMP_SAMPLES = 441;
 
 // ====== CONTROL ======
 unsigned long lastTriggerTime[5] = {0};
 const int retriggerDelay = 80;
 
-// Round-robin across the 6 players
-AudioPlaySdWav* players[6] = { &wav1, &wav2, &wav3, &wav4, &wav5, &wav6 };
-int nextPlayer = 0;
+// Polyphonic voices: quietest/oldest stealing, hat choke, velocity layers
+DrumVoiceManager voices;
+
+// Hit messages, printed from the end of loop() when the USB port has room
+EventLog events;
+
+// Active kit plus the next one preloading in the background
+KitBank kitBank(voices, drumPool);
 
-bool playSample(const char* fname) {
+bool playSample(int drum, float velocity) {
   // Don't play if in bypass mode
   if (bypassMode) return false;
   
-  // Try to find a free player first
-  for (int i = 0; i < 6; ++i) {
-    int idx = (nextPlayer + i) % 6;
-    if (!players[idx]->isPlaying()) {
-      players[idx]->play(fname);
-      nextPlayer = (idx + 1) % 6;
-      return true;
-    }
-  }
-  // Steal the next slot if all busy
-  players[nextPlayer]->stop();
-  bool ok = players[nextPlayer]->play(fname);
-  nextPlayer = (nextPlayer + 1) % 6;
-  return ok;
+  return voices.noteOn(drum, velocity) >= 0;
 }
 
 bool canRetrigger(int drumIndex) {
@@ -153,32 +192,47 @@ float getSmoothedFrequency(float newFreq) {
 
 // ====== NEW FUNCTION: Update audio routing based on bypass state ======
 void updateBypassState() {
-  // Use AudioNoInterrupts to prevent pops/clicks
-  AudioNoInterrupts();
+  // Crossfades over BYPASS_RAMP_SAMPLES, so no pops/clicks
+  bypassStage.bypass(bypassMode);
   
   if (bypassMode) {
-    // BYPASS MODE: Guitar only, no drums
-    mainMixer.gain(0, 1.0f);  // Guitar at full volume
-    mainMixer.gain(1, 0.0f);  // Drums completely muted
+    // BYPASS MODE: Guitar only, no drums; analysis stops once faded
     digitalWrite(LED_PIN, LOW);  // LED off
     Serial.println(">>> BYPASS MODE: Guitar only");
   } else {
     // ACTIVE MODE: Drums only, no guitar
-    mainMixer.gain(0, 0.0f);  // Guitar completely muted
-    mainMixer.gain(1, 0.9f);  // Drums at normal level
     digitalWrite(LED_PIN, HIGH);  // LED on
     Serial.println(">>> ACTIVE MODE: Drums only");
   }
-  
-  AudioInterrupts();
+}
+
+void nextKit() {
+  if (kitBank.next()) {
+    Serial.printf(">>> KIT: %s\n", kitBank.name());
+  } else if (kitBank.pending()) {
+    Serial.printf(">>> KIT: %s still loading, switching when ready\n", kits[kitBank.wantedKit()].name);
+  }
 }
 
 // ====== NEW FUNCTION: Handle footswitch ======
 void checkFootswitch() {
   footswitch.update();
+  kitSwitch.update();
   
   // Check for press (transition from HIGH to LOW for normally open switch)
   if (footswitch.fell()) {
+    pressStartTime = millis();
+    pressHandled = false;
+  }
+
+  // Held long enough: next kit, and no bypass toggle on release
+  if (!pressHandled && footswitch.read() == LOW && millis() - pressStartTime >= LONG_PRESS_MS) {
+    pressHandled = true;
+    nextKit();
+  }
+
+  if (footswitch.rose() && !pressHandled) {
+    pressHandled = true;
     // Additional debounce protection
     if (millis() - lastToggleTime > toggleDebounceTime) {
       lastToggleTime = millis();
@@ -186,6 +240,8 @@ void checkFootswitch() {
       updateBypassState();
     }
   }
+
+  if (kitSwitch.fell()) nextKit();
 }
 
 // ====== SETUP ======
@@ -196,7 +252,7 @@ void setup() {
   Serial.println("=========================================");
   Serial.println(" GUITAR DRUM MACHINE - TRUE BYPASS MODE ");
   Serial.println("=========================================");
-  Serial.println("Footswitch: Press to toggle modes");
+  Serial.println("Footswitch: Tap to toggle modes, hold for next kit");
   Serial.println("BYPASS: Guitar only -> Looper");
   Serial.println("ACTIVE: Drums only -> Looper");
   Serial.println();
@@ -209,8 +265,12 @@ void setup() {
   // Initialize debouncer (NEW)
   footswitch.attach(FOOTSWITCH_PIN);
   footswitch.interval(25);  // 25ms debounce time
+  pinMode(KIT_SWITCH_PIN, INPUT_PULLUP);
+  kitSwitch.attach(KIT_SWITCH_PIN);
+  kitSwitch.interval(25);
 
   AudioMemory(80);
+  events.formatter(formatHit);
 
   // Initialize frequency history
   for (int i = 0; i < FREQ_HISTORY_SIZE; i++) {
@@ -232,17 +292,14 @@ void setup() {
   // Analysis
   notefreq.begin(0.05);
 
-  // Mix gains for drum submixers
-  for (int i = 0; i < 4; ++i) drumMixA.gain(i, 0.8);
-  for (int i = 0; i < 4; ++i) drumMixB.gain(i, 0.8);
-  drumBus.gain(0, 0.9);
-  drumBus.gain(1, 0.9);
-
-  // Initial bypass state (starts in BYPASS mode)
-  mainMixer.gain(0, 1.0f);  // Guitar ON
-  mainMixer.gain(1, 0.0f);  // Drums OFF
-  mainMixer.gain(2, 0.0f);  // Unused
-  mainMixer.gain(3, 0.0f);  // Unused
+  // Initial bypass state (starts in BYPASS mode): guitar 1.0 / drums 0
+  // bypassed, guitar 0 / drums 0.9 active. The analyser inputs are
+  // dropped while fully bypassed.
+  bypassStage.rampSamples(BYPASS_RAMP_SAMPLES);
+  bypassStage.engagedLevels(0.0f, 0.9f);
+  bypassStage.suspend(patchCord1);
+  bypassStage.suspend(patchCord2);
+  bypassStage.bypass(bypassMode);
 
   // SD init
   Serial.print("Mounting SD... ");
@@ -252,14 +309,17 @@ void setup() {
   }
   Serial.println("OK");
 
-  // Check for drum sample files
-  const char* files[] = { FILE_KICK, FILE_SNARE, FILE_HHCL, FILE_RIDE, FILE_CRASH };
-  for (auto f : files) {
-    if (!SD.exists(f)) {
-      Serial.print("⚠️ Missing file on SD: ");
-      Serial.println(f);
-    }
+  // 12 voices, velocity applied inside each voice
+  voices.begin(drumPool, 12);
+
+  // Decode the first kit that loads into RAM (also catches typos/format
+  // issues); the next one then preloads from loop()
+  if (!kitBank.begin(kits, NUM_KITS)) {
+    Serial.println("No kit could be loaded");
+    while (1) { /* halt */ }
   }
+  Serial.printf("Kit: %s\n", kitBank.name());
+  kitBank.printStatus(Serial);
 
   // Test drums (only plays if you toggle to active mode)
   delay(300);
@@ -271,11 +331,25 @@ void setup() {
 
 // ====== MAIN LOOP ======
 void loop() {
-  // Check footswitch for mode changes (NEW)
+  // Check footswitch for mode and kit changes (NEW)
   checkFootswitch();
+
+  // Preload the next kit, a few KB per pass
+  kitBank.service();
+
+  // Fully bypassed: analysers lose their input, and the drums (already
+  // faded out) stop so the pool goes idle
+  if (bypassStage.service()) voices.allNotesOff();
   
   // Only process drum triggers when in ACTIVE mode
-  if (!bypassMode) {
+  if (!bypassMode && bypassStage.resumedBlocks() < AUDIO_GUITARTUNER_BLOCKS) {
+    // Just back from bypass: notefreq's window still holds audio from
+    // before it, so its results (and the peak since then) are stale
+    if (notefreq.available()) notefreq.read();
+    if (peak.available()) peak.read();
+    freqHistoryIndex = 0;
+    freqHistoryFilled = false;
+  } else if (!bypassMode) {
     if (notefreq.available() && peak.available()) {
       float freq = notefreq.read();
       float probability = notefreq.probability();
@@ -284,61 +358,65 @@ void loop() {
       // Gate threshold
       if (probability > 0.6 && level > 0.02) {
         float smoothedFreq = getSmoothedFrequency(freq);
-        triggerDrumForFrequency(smoothedFreq);
+        // Velocity from the pick level (same curve as the Claude_v2 sketch)
+        float velocity = constrain(sqrtf(level) * 1.5f, 0.1f, 1.0f);
+        triggerDrumForFrequency(smoothedFreq, velocity);
       }
     }
   }
+
+  events.drain(Serial);
 }
 
 // ====== DRUM TRIGGERING ======
-void triggerDrumForFrequency(float freq) {
+void triggerDrumForFrequency(float freq, float velocity) {
   // KICK (60-110 Hz)
   if (freq >= 60 && freq < 110) {
     if (canRetrigger(0)) {
-      playSample(FILE_KICK);
-      Serial.print("🥁 KICK! "); 
-      Serial.print(freq, 1); 
-      Serial.println(" Hz");
+      playSample(KICK, velocity);
+      events.log(LOG_HIT, 0, freq, velocity);
     }
   }
   // SNARE (110-165 Hz)
   else if (freq >= 110 && freq < 165) {
     if (canRetrigger(1)) {
-      playSample(FILE_SNARE);
-      Serial.print("🪘 SNARE! "); 
-      Serial.print(freq, 1); 
-      Serial.println(" Hz");
+      playSample(SNARE, velocity);
+      events.log(LOG_HIT, 1, freq, velocity);
     }
   }
   // HI-HAT (165-260 Hz)
   else if (freq >= 165 && freq < 260) {
     if (canRetrigger(2)) {
-      playSample(FILE_HHCL);
-      Serial.print("🎩 HAT! "); 
-      Serial.print(freq, 1); 
-      Serial.println(" Hz");
+      // Hard picks open the hat if an HHOP sample is loaded; the next
+      // closed hat chokes it
+      bool open = velocity >= OPEN_HAT_VELOCITY && voices.hasDrum(HHOP);
+      playSample(open ? HHOP : HHCL, velocity);
+      events.log(LOG_HIT, 2, freq, velocity);
     }
   }
   // RIDE (260-400 Hz)
   else if (freq >= 260 && freq < 400) {
     if (canRetrigger(3)) {
-      playSample(FILE_RIDE);
-      Serial.print("🔔 RIDE! "); 
-      Serial.print(freq, 1); 
-      Serial.println(" Hz");
+      playSample(RIDE, velocity);
+      events.log(LOG_HIT, 3, freq, velocity);
     }
   }
   // CRASH (400+ Hz)
   else if (freq >= 400) {
     if (canRetrigger(4)) {
-      playSample(FILE_CRASH);
-      Serial.print("💥 CRASH! "); 
-      Serial.print(freq, 1); 
-      Serial.println(" Hz");
+      playSample(CRASH, velocity);
+      events.log(LOG_HIT, 4, freq, velocity);
     }
   }
 }
 
+// "🥁 KICK! 82.4 Hz" for each hit in the event log
+int formatHit(char *buf, size_t size, const LogRecord &r) {
+  static const char *const NAMES[5] = { "🥁 KICK!", "🪘 SNARE!", "🎩 HAT!", "🔔 RIDE!", "💥 CRASH!" };
+  if (r.reason != LOG_HIT || r.drum < 0 || r.drum >= 5) return EventLog::formatDefault(buf, size, r);
+  return snprintf(buf, size, "%s %.1f Hz\n", NAMES[r.drum], r.frequency);
+}
+
 // ====== WIRING GUIDE ======
 /*
  * FOOTSWITCH WIRING (9-pin using 3 pins for momentary switch):
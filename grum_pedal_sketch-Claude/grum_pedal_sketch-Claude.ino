@@ -1,7 +1,10 @@
 // Teensy 4.0 + Audio Shield with SD Card Sample Playback
-// Guitar -> Drum trigger with SD card samples
+// Guitar -> Drum trigger with SD card samples (loaded into RAM at boot)
 // Samples should be 16-bit, 44.1kHz WAV files named:
 // KICK.WAV, SNARE.WAV, HAT.WAV, RIDE.WAV, CRASH.WAV
+// or one DRUMS.KIT image from tools/kitpack (drums 0..4 as below), which
+// boots faster: it is copied to the shield's SerialFlash once and read
+// back in a single pass from then on, SD card or not.
 
 #include <Audio.h>
 #include <Wire.h>
@@ -9,25 +12,40 @@
 #include <SD.h>
 #include <SerialFlash.h>
 #include <CrashReport.h>
+#include <drum_sample.h>
+#include <drum_kit.h>
+#include <drum_voices.h>
+#include <analyze_sliding_yin.h>
+#include <latency_probe.h>
+#include <drum_map.h>
+#include <event_log.h>
 
 // Use built-in SD card on Teensy 4.0 Audio Shield
 #define SDCARD_CS_PIN    10
 #define SDCARD_MOSI_PIN  11
 #define SDCARD_SCK_PIN   13
+#define FLASH_CS_PIN     6
+
+// Define to the address of a kit image on memory mapped flash (Teensy
+// 4.1 QSPI pads) to play it in place instead, with the size of the
+// window it may occupy:
+// #define KIT_MAPPED_ADDR  0x70000000
+// #define KIT_MAPPED_SIZE  (16UL << 20)
+#if defined(KIT_MAPPED_ADDR) && !defined(KIT_MAPPED_SIZE)
+#error "KIT_MAPPED_ADDR needs KIT_MAPPED_SIZE, the flash window the image may span"
+#endif
 
 // ---------------- Audio objects ----------------
 AudioInputI2S       in1;
 AudioMixer4         inMix;
 AudioFilterBiquad   biq;        // stage0 notch 60Hz, stage1 HPF 70Hz
-AudioAnalyzeNoteFrequency yin;  // YIN pitch
+AudioAnalyzeSlidingYin yin;     // YIN pitch, new estimate every block
 AudioAnalyzeRMS     rms;        // RMS for onset envelope
 AudioAnalyzePeak    peak;       // Peak for clipping/emergency
 AudioAnalyzeFFT256  fft;        // For spectral flux
 
-// SD card sample players (5 drums)
-AudioPlaySdWav      kickWav, snareWav, hatWav, rideWav, crashWav;
-AudioMixer4         drumMix1;   // Mix first 4 drums
-AudioMixer4         drumMix2;   // Mix crash + drumMix1
+// RAM sample voices (5 drums, velocity applied per voice)
+AudioPlaySamplePool drumPool;
 AudioMixer4         mainMix;    // Final mix with dry signal
 AudioSynthWaveform  beep;       // Boot confirmation beep
 AudioOutputI2S      out1;
@@ -42,18 +60,8 @@ AudioConnection patchRMS(biq, 0, rms, 0);
 AudioConnection patchPEAK(biq, 0, peak, 0);
 AudioConnection patchFFT(biq, 0, fft, 0);
 
-// SD WAV players to drum mixer
-AudioConnection patchKickL(kickWav, 0, drumMix1, 0);
-AudioConnection patchSnareL(snareWav, 0, drumMix1, 1);
-AudioConnection patchHatL(hatWav, 0, drumMix1, 2);
-AudioConnection patchRideL(rideWav, 0, drumMix1, 3);
-
-// Cascade mixers (we need more than 4 inputs)
-AudioConnection patchDrums1(drumMix1, 0, drumMix2, 0);
-AudioConnection patchCrashL(crashWav, 0, drumMix2, 1);
-
 // Final mix
-AudioConnection patchDrums(drumMix2, 0, mainMix, 1);
+AudioConnection patchDrums(drumPool, 0, mainMix, 1);
 AudioConnection patchDry(inMix, 0, mainMix, 0);   // dry signal (muted by default)
 AudioConnection patchBeep(beep, 0, mainMix, 2);   // boot beep
 
@@ -75,7 +83,7 @@ const float    YIN_CONF        = 0.80f;
 
 // Per-drum debounce & mapping lock
 const uint32_t RETRIGGER_MS    = 90;     // per-drum lockout
-const float    HYST_PCT        = 0.06f;  // band hysteresis
+constexpr float HYST_PCT       = 0.06f;  // band hysteresis
 const uint32_t LOCK_MS         = 150;    // string continuity: lock drum choice after onset
 
 // Dual-EMA onset (primary)
@@ -107,6 +115,9 @@ const char* sampleFiles[] = {
   "RIDE.WAV",
   "CRASH.WAV"
 };
+const char* KIT_FILE = "DRUMS.KIT";
+const float drumLevel[5] = { 0.9f, 0.9f, 0.7f, 0.7f, 0.8f };
+const char* drumNames[5] = { "KICK ", "SNARE", "HAT  ", "RIDE ", "CRASH" };
 
 // ---------------- State ----------------
 uint32_t lastTrig[5] = {0,0,0,0,0};
@@ -131,18 +142,32 @@ uint32_t  lockUntilMs  = 0;
 
 // SD card status
 bool      sdCardReady = false;
-bool      samplesFound[5] = {false, false, false, false, false};
-
-// Bands for EADGBE open strings
-struct Band { float fmin, fmax; uint8_t idx; };
-Band bands[] = {
-  {  74.0f,  92.0f, 0 }, // E2 -> Kick
-  { 100.0f, 122.0f, 1 }, // A2 -> Snare
-  { 135.0f, 160.0f, 2 }, // D3 -> Hat
-  { 185.0f, 210.0f, 2 }, // G3 -> Hat
-  { 235.0f, 260.0f, 3 }, // B3 -> Ride
-  { 315.0f, 350.0f, 4 }, // E4 -> Crash
+DrumSample       drumSamples[5];
+DrumKit          kit;
+uint8_t         *kitImage = nullptr;   // RAM copy of the kit, if read
+uint32_t         kitImageBytes = 0;    // bytes read into kitImage
+DrumVoiceManager voices;
+
+// Onset -> noteOn -> first pool block timing; 'l' prints it, 'r' clears
+LatencyProbe latency;
+
+// Trigger messages, printed from the end of loop() when the USB port has
+// room; 'b' switches to binary records for tools/logdecode
+EventLog events;
+
+// Bands for EADGBE open strings, each widened by HYST_PCT and compiled
+// to a lookup table (drum_map.h)
+#define STRING_BAND(fmin, fmax, idx) { (fmin) * (1.0f - HYST_PCT), (fmax) * (1.0f + HYST_PCT), idx, 0 }
+constexpr DrumBand BANDS[] = {
+  STRING_BAND( 74.0f,  92.0f, 0), // E2 -> Kick
+  STRING_BAND(100.0f, 122.0f, 1), // A2 -> Snare
+  STRING_BAND(135.0f, 160.0f, 2), // D3 -> Hat
+  STRING_BAND(185.0f, 210.0f, 2), // G3 -> Hat
+  STRING_BAND(235.0f, 260.0f, 3), // B3 -> Ride
+  STRING_BAND(315.0f, 350.0f, 4), // E4 -> Crash
 };
+#undef STRING_BAND
+constexpr DrumMap<6> BAND_MAP(BANDS);
 
 static inline float clamp01(float x){ return x < 0 ? 0 : (x > 1 ? 1 : x); }
 
@@ -152,85 +177,124 @@ bool canRetrigger(uint8_t i) {
   return false;
 }
 
-int bandFor(float f) {
-  for (uint8_t i=0; i<sizeof(bands)/sizeof(bands[0]); ++i) {
-    float cmin = bands[i].fmin * (1.0f - HYST_PCT);
-    float cmax = bands[i].fmax * (1.0f + HYST_PCT);
-    if (f >= cmin && f <= cmax) return i;
-  }
-  return -1;
-}
-
 void trigger(uint8_t drumIdx, float vel, float freq) {
-  if (!sdCardReady || !samplesFound[drumIdx]) {
-    Serial.printf("Cannot trigger drum %d - sample not available\n", drumIdx);
+  if (!sdCardReady || !voices.hasDrum(drumIdx)) {
+    events.log(LOG_NO_SAMPLE, drumIdx, freq, vel);
     return;
   }
   
-  float v = vel * 0.85f + 0.15f; // keep audible at low vel
-  
-  switch (drumIdx) {
-    case 0: 
-      kickWav.play(sampleFiles[0]);
-      drumMix1.gain(0, 0.9f * v);
-      Serial.printf("KICK  %.1fHz v=%.2f\n", freq, vel);
-      break;
-    case 1:
-      snareWav.play(sampleFiles[1]);
-      drumMix1.gain(1, 0.9f * v);
-      Serial.printf("SNARE %.1fHz v=%.2f\n", freq, vel);
-      break;
-    case 2:
-      hatWav.play(sampleFiles[2]);
-      drumMix1.gain(2, 0.7f * v);
-      Serial.printf("HAT   %.1fHz v=%.2f\n", freq, vel);
-      break;
-    case 3:
-      rideWav.play(sampleFiles[3]);
-      drumMix1.gain(3, 0.7f * v);
-      Serial.printf("RIDE  %.1fHz v=%.2f\n", freq, vel);
-      break;
-    case 4:
-      crashWav.play(sampleFiles[4]);
-      drumMix2.gain(1, 0.8f * v);
-      Serial.printf("CRASH %.1fHz v=%.2f\n", freq, vel);
-      break;
+  // Gain = drumLevel * (0.15 + 0.85 * vel), set on the voice itself
+  latency.noteOn();
+  voices.noteOn(drumIdx, vel);
+  events.log(LOG_HIT, drumIdx, freq, vel);
+}
+
+int formatEvent(char *buf, size_t size, const LogRecord &r) {
+  if (r.drum < 0 || r.drum >= 5) return EventLog::formatDefault(buf, size, r);
+  if (r.reason == LOG_HIT) {
+    return snprintf(buf, size, "%s %.1fHz v=%.2f\n", drumNames[r.drum], r.frequency, r.velocity);
+  }
+  if (r.reason == LOG_NO_SAMPLE) {
+    return snprintf(buf, size, "Cannot trigger drum %d - sample not available\n", r.drum);
   }
+  return EventLog::formatDefault(buf, size, r);
 }
 
 // ---------------- Setup ----------------
-bool initSDCard() {
-  if (!(SD.begin(SDCARD_CS_PIN))) {
-    Serial.println("Unable to access SD card!");
+// Copy KIT_FILE from SD to SerialFlash unless it is already there. A
+// different kit of another size needs the flash erased first.
+void copyKitToFlash() {
+  File src = SD.open(KIT_FILE);
+  if (!src) return;
+  uint32_t size = src.size();
+  SerialFlashFile dst = SerialFlash.open(KIT_FILE);
+  if (dst) {
+    if (dst.size() != size) Serial.println("Kit on SD differs from flash copy; erase flash to update");
+    dst.close();
+    src.close();
+    return;
+  }
+  if (!SerialFlash.create(KIT_FILE, size) || !(dst = SerialFlash.open(KIT_FILE))) {
+    Serial.println("No room for the kit on SerialFlash");
+    src.close();
+    return;
+  }
+  Serial.printf("Copying %s to SerialFlash (%lu bytes)\n", KIT_FILE, (unsigned long)size);
+  uint8_t buf[256];
+  int n;
+  while ((n = src.read(buf, sizeof(buf))) > 0) dst.write(buf, n);
+  dst.close();
+  src.close();
+}
+
+// A kit image from mapped flash, SerialFlash or SD; false to fall back
+// to the loose WAVs
+bool loadKit(bool sdOk) {
+#ifdef KIT_MAPPED_ADDR
+  if (kit.attach((const void *)KIT_MAPPED_ADDR, KIT_MAPPED_SIZE) && kit.verify()) {
+    kit.assign(voices);
+    kit.printInfo(Serial);
+    return true;
+  }
+#endif
+  bool flashOk = SerialFlash.begin(FLASH_CS_PIN);
+  if (flashOk && sdOk) copyKitToFlash();
+
+  if (flashOk) {
+    SerialFlashFile f = SerialFlash.open(KIT_FILE);
+    if (f) {
+      kitImage = DrumKit::readImage(f, kitImageBytes);
+      f.close();
+    }
+  }
+  if (!kitImage && sdOk) {
+    File f = SD.open(KIT_FILE);
+    if (f) {
+      kitImage = DrumKit::readImage(f, kitImageBytes);
+      f.close();
+    }
+  }
+  if (!kitImage) return false;
+
+  if (!kit.attach(kitImage, kitImageBytes) || !kit.verify()) {
+    Serial.printf("%s unusable (%s)\n", KIT_FILE, kit.error() ? kit.error() : "bad CRC");
+    kit.detach();
+    DrumKit::freeImage(kitImage);
+    kitImage = nullptr;
     return false;
   }
-  Serial.println("SD card initialized successfully");
+  kit.assign(voices);
+  kit.printInfo(Serial);
+  return true;
+}
+
+bool initSDCard() {
+  bool sdOk = SD.begin(SDCARD_CS_PIN);
+  Serial.println(sdOk ? "SD card initialized successfully" : "Unable to access SD card!");
+  if (loadKit(sdOk)) return true;
+  if (!sdOk) return false;
   
-  // Check for each sample file
+  // Decode each sample into RAM once
   for (int i = 0; i < 5; i++) {
-    if (SD.exists(sampleFiles[i])) {
-      samplesFound[i] = true;
-      Serial.printf("Found: %s\n", sampleFiles[i]);
+    if (drumSamples[i].load(sampleFiles[i])) {
+      voices.addLayer(i, drumSamples[i]);
+      Serial.print("Found: ");
     } else {
-      Serial.printf("Missing: %s\n", sampleFiles[i]);
+      Serial.print("Missing: ");
     }
+    drumSamples[i].printInfo(Serial);
   }
   
   return true;
 }
 
 void setupMixers() {
-  // Drum mixer 1 (kick, snare, hat, ride)
-  drumMix1.gain(0, 0.9f);  // kick
-  drumMix1.gain(1, 0.9f);  // snare
-  drumMix1.gain(2, 0.7f);  // hat
-  drumMix1.gain(3, 0.7f);  // ride
-  
-  // Drum mixer 2 (drumMix1 + crash)
-  drumMix2.gain(0, 1.0f);  // drumMix1
-  drumMix2.gain(1, 0.8f);  // crash
-  drumMix2.gain(2, 0.0f);
-  drumMix2.gain(3, 0.0f);
+  // One voice per drum, as with the old per-drum SD players; a retrigger
+  // cross-fades the drum's previous hit instead of cutting it.
+  voices.begin(drumPool, 5);
+  drumPool.latencyProbe(&latency);
+  voices.velocityFloor(0.15f);  // keep audible at low vel
+  for (int i = 0; i < 5; i++) voices.setDrum(i, drumLevel[i], 0, 1);
   
   // Main mix
   mainMix.gain(0, 0.00f);  // dry signal (muted by default, increase to 0.1-0.3 for monitoring)
@@ -260,6 +324,8 @@ void setup() {
   sgtl.unmuteHeadphone();
   sgtl.lineOutLevel(29);  // Set line out level for headphones
   userVolume = VOL_DEFAULT;
+  latency.begin();
+  events.formatter(formatEvent);
 
   // Configure input mixer
   inMix.gain(0, 0.5f); // L
@@ -272,6 +338,7 @@ void setup() {
   biq.setHighpass(1, HPF_HZ, 0.707f);
 
   // Initialize analyzers
+  yin.pitchRange(60.0f, 400.0f);  // BANDS[] span plus hysteresis
   yin.begin(0.15f);
   fft.windowFunction(AudioWindowHanning256);
 
@@ -395,7 +462,11 @@ void loop() {
 
   // 5) Combined onset
   bool onset = onsetDual && (onsetFlux || !haveFft);
-  if (onset) lastOnsetMs = now;
+  // RMS has no block timestamp, so the probe's onset is this loop() pass
+  if (onset) {
+    lastOnsetMs = now;
+    latency.onset(LatencyProbe::now());
+  }
 
   // 6) Pitch + drum mapping with continuity lock
   float f = -1.0f, q = 0.0f;
@@ -413,8 +484,7 @@ void loop() {
       if ((int32_t)(now - lockUntilMs) < 0 && lockedDrum >= 0) {
         b = lockedDrum;
       } else {
-        int bandIdx = bandFor(f);
-        if (bandIdx >= 0) b = bands[bandIdx].idx;
+        b = BAND_MAP.drumFor(f);
       }
 
       if (b >= 0) {
@@ -440,4 +510,16 @@ void loop() {
                   pRms, ratio, f, q, sdCardReady?1:0);
     tdbg = millis();
   }
+
+  // 8) Serial commands
+  if (Serial.available()) {
+    char c = Serial.read();
+    if (c == 'l') latency.print(Serial);
+    if (c == 'r') latency.reset();
+    if (c == 'k') kit.printInfo(Serial);
+    if (c == 'b') events.mode(events.mode() == EventLog::MODE_BINARY ? EventLog::MODE_TEXT
+                                                                     : EventLog::MODE_BINARY);
+  }
+
+  events.drain(Serial);
 }
\ No newline at end of file
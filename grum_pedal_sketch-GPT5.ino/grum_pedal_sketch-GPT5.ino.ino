@@ -1,5 +1,7 @@
 // GUITAR -> DRUM SAMPLES (Teensy Audio)
 // Plays SD WAV samples based on detected guitar frequency / band energy.
+// Short drums live in RAM; ride and crash keep only their attack there and
+// stream the rest from SD outside the audio interrupt (SampleStreamer).
 //
 // Hardware: Teensy 4.x + Audio Shield (Rev D). Guitar into Line In or Mic In.
 // SD wiring: use the Audio Shield SD slot. Set SD CS to BUILTIN_SDCARD on T4.1,
@@ -9,6 +11,9 @@
 #include <Wire.h>
 #include <SPI.h>
 #include <SD.h>
+#include <drum_sample.h>
+#include <drum_voices.h>
+#include <sample_streamer.h>
 
 // ---------- CONFIG ----------
 #if defined(ARDUINO_TEENSY41)
@@ -30,15 +35,21 @@ float rideMinHz  = 700.0f, rideMaxHz  = 1200.0f;
 float crashMinHz = 900.0f;                          // bright top
 float hatMinHz   = 4000.0f;                          // closed hats by brightness
 
-// File names on SD (8.3 uppercase recommended)
-const char* FILE_KICK  = "KICK.WAV";
-const char* FILE_SNARE = "SNARE.WAV";
-const char* FILE_TOM1  = "TOM1.WAV";
-const char* FILE_TOM2  = "TOM2.WAV";
-const char* FILE_RIDE  = "RIDE.WAV";
-const char* FILE_CRASH = "CRASH.WAV";
-const char* FILE_HHCL  = "HHCL.WAV";
-const char* FILE_HHOP  = "HHOP.WAV";
+// File names on SD (8.3 uppercase recommended). residentMs 0 loads the
+// whole file into RAM; otherwise only that much of the attack, the tail
+// streams from SD.
+enum { KICK, SNARE, TOM1, TOM2, RIDE, CRASH, HHCL, HHOP, NUM_DRUMS };
+struct KitFile { const char *file; uint32_t residentMs; };
+const KitFile KIT_FILES[NUM_DRUMS] = {
+  { "KICK.WAV",  0   },
+  { "SNARE.WAV", 0   },
+  { "TOM1.WAV",  0   },
+  { "TOM2.WAV",  0   },
+  { "RIDE.WAV",  150 },
+  { "CRASH.WAV", 150 },
+  { "HHCL.WAV",  0   },
+  { "HHOP.WAV",  0   },
+};
 
 // ---------- AUDIO GRAPH ----------
 // Input
@@ -49,13 +60,10 @@ AudioAmplifier       inGain;
 AudioAnalyzePeak     peak;
 AudioAnalyzeFFT1024  fft;
 
-// Players (use a couple in round-robin so overlaps don’t cut off)
-const int NPLAY = 6;
-AudioPlaySdWav       play[NPLAY];
+// Drum voices: every sample summed in one object, no SD reads in the ISR
+AudioPlaySamplePool  drumPool;
 
 // Mixers
-AudioMixer4          mixA;
-AudioMixer4          mixB;
 AudioMixer4          mainMix;       // final sum to outputs
 AudioOutputI2S       out;
 
@@ -64,17 +72,7 @@ AudioConnection pc1(in, 0, inGain, 0);
 AudioConnection pc2(inGain, 0, peak, 0);
 AudioConnection pc3(inGain, 0, fft, 0);
 
-// Players into two subgroup mixers so we can sum >4 sources
-AudioConnection pc4(play[0], 0, mixA, 0);
-AudioConnection pc5(play[1], 0, mixA, 1);
-AudioConnection pc6(play[2], 0, mixA, 2);
-AudioConnection pc7(play[3], 0, mixA, 3);
-
-AudioConnection pc8(play[4], 0, mixB, 0);
-AudioConnection pc9(play[5], 0, mixB, 1);
-
-AudioConnection pc10(mixA, 0, mainMix, 0);
-AudioConnection pc11(mixB, 0, mainMix, 1);
+AudioConnection pc4(drumPool, 0, mainMix, 0);
 
 // Optional: blend a touch of live guitar through
 AudioConnection pc12(inGain, 0, mainMix, 2);
@@ -86,29 +84,19 @@ AudioControlSGTL5000 codec;
 
 // ---------- STATE ----------
 uint32_t lastTrig = 0;
-int nextPlayer = 0;
+DrumSample       drumSamples[NUM_DRUMS];
+DrumVoiceManager voices;
+SampleStreamer   streamer;          // SD tails of ride and crash
 
 // ---------- HELPERS ----------
 bool canRetrigger() {
   return (millis() - lastTrig) > retriggerMs;
 }
 
-void triggerFile(const char* name) {
-  // round-robin so multiple hits can overlap
-  for (int i = 0; i < NPLAY; ++i) {
-    int idx = (nextPlayer + i) % NPLAY;
-    if (!play[idx].isPlaying()) {
-      play[idx].play(name);
-      nextPlayer = (idx + 1) % NPLAY;
-      lastTrig = millis();
-      return;
-    }
-  }
-  // if all busy, steal the next slot
-  play[nextPlayer].stop();
-  play[nextPlayer].play(name);
+void triggerDrum(int drum) {
+  // The voice manager steals the quietest voice when all are busy
+  voices.noteOn(drum, 1.0f);
   lastTrig = millis();
-  nextPlayer = (nextPlayer + 1) % NPLAY;
 }
 
 float binHz(int bin) { return (44100.0f / 2.0f) * (float)bin / 1024.0f; }
@@ -136,10 +124,8 @@ void setup() {
   codec.volume(0.6);                       // headphone/line out level
 
   // mixers
-  for (int i = 0; i < 4; ++i) mixA.gain(i, 0.7);
-  for (int i = 0; i < 4; ++i) mixB.gain(i, 0.7);
   mainMix.gain(0, 0.9);
-  mainMix.gain(1, 0.9);
+  mainMix.gain(1, 0.0);
   mainMix.gain(2, 0.15);  // bleed some live guitar if you want it
   mainMix.gain(3, 0.0);
 
@@ -155,10 +141,23 @@ void setup() {
       // (Leave as a tight loop so you notice quickly.)
     }
   }
+
+  // Kit: same 0.7 level the subgroup mixers gave every player; the
+  // closed hat chokes the open one
+  voices.begin(drumPool, 12);
+  drumPool.streamer(&streamer);
+  for (int d = 0; d < NUM_DRUMS; ++d) {
+    drumSamples[d].load(KIT_FILES[d].file, KIT_FILES[d].residentMs);
+    voices.addLayer(d, drumSamples[d]);
+    voices.setDrum(d, 0.7f, (d == HHCL || d == HHOP) ? 1 : 0);
+  }
 }
 
 // ---------- MAIN ----------
 void loop() {
+  // Keep the ride/crash tails ahead of playback
+  streamer.service();
+
   // basic onset gate
   if (peak.available()) {
     float p = peak.read();
@@ -170,22 +169,22 @@ void loop() {
       // You can tailor these to your current mapping (string/position/etc.).
       if (hz > 0) {
         if (hz <= kickMaxHz) {
-          triggerFile(FILE_KICK);
+          triggerDrum(KICK);
         } else if (hz >= snareMinHz && hz <= snareMaxHz) {
-          triggerFile(FILE_SNARE);
+          triggerDrum(SNARE);
         } else if (hz >= tomMinHz && hz <= tomMaxHz) {
           // Pick tom1 or tom2 by sub-band
-          triggerFile(hz < 150.0f ? FILE_TOM1 : FILE_TOM2);
+          triggerDrum(hz < 150.0f ? TOM1 : TOM2);
         } else if (hz >= rideMinHz && hz <= rideMaxHz) {
-          triggerFile(FILE_RIDE);
+          triggerDrum(RIDE);
         } else if (hz >= crashMinHz && hz < hatMinHz) {
-          triggerFile(FILE_CRASH);
+          triggerDrum(CRASH);
         } else if (hz >= hatMinHz) {
           // very bright: closed vs open by overall level
-          triggerFile(p > 0.12f ? FILE_HHOP : FILE_HHCL);
+          triggerDrum(p > 0.12f ? HHOP : HHCL);
         } else {
           // Fallback if weird frequency: snare
-          triggerFile(FILE_SNARE);
+          triggerDrum(SNARE);
         }
       }
     }
@@ -5,6 +5,7 @@
 #include <Wire.h>
 #include <SPI.h>
 #include <CrashReport.h>
+#include <drum_map.h>
 
 // ========== AUDIO GRAPH ==========
 AudioInputI2S             audioInput;
@@ -63,27 +64,27 @@ const int ONSET_HOLDOFF_MS = 50;     // Minimum time between onsets
 const int RETRIGGER_TIME = 100;      // Increased from 70 to prevent spam
 unsigned long lastTriggerTime[5] = {0, 0, 0, 0, 0};
 
-// Frequency bands with hysteresis
-struct FreqBand {
-    float minFreq;
-    float maxFreq;
-    int drumIndex;
-    const char* name;
-};
+// Frequency bands with hysteresis, compiled to a lookup table (drum_map.h)
+constexpr float BAND_OVERLAP = 0.05f;   // 5% overlap between bands
+#define FREQ_BAND(minF, maxF, drum) { (minF) * (1.0f - BAND_OVERLAP), (maxF) * (1.0f + BAND_OVERLAP), drum, 165 }
 
-// Tuned for standard guitar/bass
-FreqBand frequencyBands[] = {
-    {50.0,   95.0,  0, "KICK"},   // Low E and below
-    {96.0,   140.0, 1, "SNARE"},  // A string area
-    {141.0,  220.0, 2, "HAT"},    // D string area
-    {221.0,  350.0, 3, "RIDE"},   // G and B strings
-    {351.0,  800.0, 4, "CRASH"},  // High notes
+// Tuned for standard guitar/bass; the last band +-165 cents (10%) more
+// while the next note stays on the same string
+constexpr DrumBand FREQUENCY_BANDS[] = {
+    FREQ_BAND( 50.0f,  95.0f, 0),   // KICK: Low E and below
+    FREQ_BAND( 96.0f, 140.0f, 1),   // SNARE: A string area
+    FREQ_BAND(141.0f, 220.0f, 2),   // HAT: D string area
+    FREQ_BAND(221.0f, 350.0f, 3),   // RIDE: G and B strings
+    FREQ_BAND(351.0f, 800.0f, 4),   // CRASH: High notes
 };
+#undef FREQ_BAND
+constexpr DrumMap<5> FREQUENCY_MAP(FREQUENCY_BANDS);
 
 // State variables
 float envelopeEMA = 0.0;
 unsigned long lastOnsetTime = 0;
 float lastFrequency = 0;
+int lastBand = -1;
 float pitchConfidence = 0;
 
 // Advanced onset detection variables
@@ -174,23 +175,9 @@ bool detectOnset(float peakLevel, float& velocity) {
 }
 
 int getFrequencyBand(float freq) {
-    const float HYSTERESIS = 0.05;  // 5% overlap between bands
-    
-    for (int i = 0; i < 5; i++) {
-        float minF = frequencyBands[i].minFreq * (1.0 - HYSTERESIS);
-        float maxF = frequencyBands[i].maxFreq * (1.0 + HYSTERESIS);
-        
-        // Bias toward last frequency's band (string continuity)
-        if (abs(freq - lastFrequency) < 20 && i == getFrequencyBand(lastFrequency)) {
-            minF *= 0.9;  // Expand band for same string
-            maxF *= 1.1;
-        }
-        
-        if (freq >= minF && freq <= maxF) {
-            return i;
-        }
-    }
-    return -1;
+    // Bias toward last frequency's band (string continuity)
+    int previous = abs(freq - lastFrequency) < 20 ? lastBand : -1;
+    return FREQUENCY_MAP.band(freq, previous);
 }
 
 bool canRetrigger(int drumIndex) {
@@ -375,6 +362,7 @@ void loop() {
             if (bandIndex >= 0 && canRetrigger(bandIndex)) {
                 triggerDrum(bandIndex, velocity, frequency);
                 lastFrequency = frequency;
+                lastBand = bandIndex;
             }
         }
         // SIMPLIFIED FALLBACK: Only if clipping AND very confident
@@ -0,0 +1,122 @@
+#include "analysis_task.h"
+
+void AudioAnalysisTap::update(void)
+{
+  audio_block_t *block = receiveReadOnly();
+  if (!block) return;
+
+  TapBlock b;
+  memcpy(b.data, block->data, sizeof(b.data));
+  b.cycles = ARM_DWT_CYCCNT;
+  blocks.push(b);
+  release(block);
+}
+
+AnalysisTask *AnalysisTask::running = nullptr;
+
+AnalysisTask::AnalysisTask() : numJobs(0), busy(false)
+{
+  resetStats();
+}
+
+bool AnalysisTask::add(AudioAnalysisTap &tap, BlockAnalyzer &analyzer)
+{
+  if (numJobs >= MAX_JOBS || running == this) return false;
+  jobs[numJobs].tap = &tap;
+  jobs[numJobs].analyzer = &analyzer;
+  numJobs++;
+  return true;
+}
+
+bool AnalysisTask::begin(uint32_t periodUs, uint8_t priority)
+{
+  if (running && running != this) return false;
+  // Blocks queued before the start are stale by now
+  TapBlock b;
+  for (uint8_t i = 0; i < numJobs; i++) {
+    while (jobs[i].tap->read(b)) {}
+  }
+  resetStats();
+  if (!periodUs) return true;
+  running = this;
+  timer.priority(priority);
+  if (!timer.begin(timerIsr, periodUs)) {
+    running = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void AnalysisTask::end()
+{
+  if (running != this) return;
+  timer.end();
+  running = nullptr;
+}
+
+void AnalysisTask::timerIsr()
+{
+  if (running) running->run();
+}
+
+void AnalysisTask::run()
+{
+  // One consumer per tap: a second caller backs off
+  __disable_irq();
+  const bool wasBusy = busy;
+  busy = true;
+  __enable_irq();
+  if (wasBusy) return;
+
+  const uint32_t start = ARM_DWT_CYCCNT;
+  TapBlock b;
+  bool more = true;
+  while (more) {
+    // Round robin, so one tap falling behind can't hold up the others
+    more = false;
+    for (uint8_t i = 0; i < numJobs; i++) {
+      if (!jobs[i].tap->read(b)) continue;
+      jobs[i].analyzer->analyzeBlock(b.data);
+      blockCount++;
+      const uint32_t latency = ARM_DWT_CYCCNT - b.cycles;
+      if (latency > maxLatency) maxLatency = latency;
+      more = true;
+    }
+  }
+  const uint32_t took = ARM_DWT_CYCCNT - start;
+  if (took > maxRun) maxRun = took;
+
+  busy = false;
+}
+
+uint32_t AnalysisTask::dropped()
+{
+  uint32_t n = 0;
+  for (uint8_t i = 0; i < numJobs; i++) n += jobs[i].tap->dropped();
+  return n;
+}
+
+void AnalysisTask::resetStats()
+{
+  __disable_irq();
+  blockCount = 0;
+  maxLatency = 0;
+  maxRun = 0;
+  __enable_irq();
+}
+
+uint32_t AnalysisTask::toMicros(uint32_t cycles)
+{
+#if defined(F_CPU_ACTUAL)
+  return cycles / (F_CPU_ACTUAL / 1000000);
+#else
+  return cycles / (F_CPU / 1000000);
+#endif
+}
+
+void AnalysisTask::printStats(Print &out)
+{
+  out.printf("Analysis: %lu blocks, %lu dropped, latency max %lu us, run max %lu us\n",
+             (unsigned long)blocks(), (unsigned long)dropped(),
+             (unsigned long)maxLatencyUs(), (unsigned long)maxRunUs());
+}
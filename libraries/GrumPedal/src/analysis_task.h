@@ -0,0 +1,117 @@
+// AnalysisTask - pitch analysis below the audio interrupt
+//
+// An analyser that does its work in update() runs inside the audio ISR
+// next to the voices, so one slow frame (a long YIN lag search, a big
+// FFT) makes the whole graph late and the output underruns. With this
+// split only AudioAnalysisTap stays in the graph: its update() copies the
+// block into an SpscQueue and returns. AnalysisTask drains the taps from
+// an IntervalTimer set below the audio update's priority (208 on Teensy
+// 4) and hands every block to its BlockAnalyzer. The audio ISR preempts
+// the analysis whenever it is due, the analysis preempts loop(), and a
+// block is analysed within one timer period plus the time taken by the
+// blocks queued ahead of it (maxLatencyUs()).
+//
+// When the analysis falls further behind than a tap's queue, blocks are
+// dropped and counted, never waited for. One AnalysisTask per sketch; all
+// PIT channels share an interrupt priority, so any other IntervalTimer in
+// the sketch runs at this one's. begin(0) starts no timer and leaves
+// run() to loop().
+//
+// Usage:
+//   AudioAnalysisTap tap;
+//   AudioConnection c(highpass, 0, tap, 0);
+//   AudioAnalyzeSlidingYin yin;        // not connected to the graph
+//   AnalysisTask analysis;
+//   analysis.add(tap, yin);
+//   analysis.begin();
+//   if (yin.available()) f = yin.read();   // loop(), as before
+
+#ifndef analysis_task_h_
+#define analysis_task_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include "spsc_queue.h"
+
+struct TapBlock {
+  int16_t data[AUDIO_BLOCK_SAMPLES];
+  uint32_t cycles;     // ARM_DWT_CYCCNT when the ISR queued it
+};
+
+// Anything that can take its input a block at a time outside update()
+class BlockAnalyzer
+{
+public:
+  virtual ~BlockAnalyzer() {}
+  virtual void analyzeBlock(const int16_t *data) = 0;
+};
+
+class AudioAnalysisTap : public AudioStream
+{
+public:
+  static const uint16_t DEPTH = 8;     // ~23 ms of audio
+
+  AudioAnalysisTap() : AudioStream(1, inputQueueArray) {}
+
+  bool read(TapBlock &b) { return blocks.pop(b); }
+  uint32_t dropped() { return blocks.dropped(); }
+
+  virtual void update(void);
+
+private:
+  audio_block_t *inputQueueArray[1];
+  SpscQueue<TapBlock, DEPTH> blocks;
+};
+
+class AnalysisTask
+{
+public:
+  static const uint8_t MAX_JOBS = 4;
+
+  AnalysisTask();
+
+  // Feed everything tap queues to analyzer. Call before begin().
+  bool add(AudioAnalysisTap &tap, BlockAnalyzer &analyzer);
+
+  // Start the timer: every periodUs at NVIC priority (higher number is
+  // lower priority; must stay above the audio update's 208). periodUs = 0
+  // runs nothing on its own. False if another AnalysisTask is running.
+  bool begin(uint32_t periodUs = 500, uint8_t priority = 224);
+  void end();
+
+  // Drain all taps. The timer calls this; loop() may when begin(0).
+  void run();
+
+  uint32_t blocks() const { return blockCount; }
+  uint32_t dropped();
+  // Longest time from a block's arrival to the end of its analysis, and
+  // the longest single run(), since resetStats().
+  uint32_t maxLatencyUs() const { return toMicros(maxLatency); }
+  uint32_t maxRunUs() const { return toMicros(maxRun); }
+  void resetStats();
+
+  void printStats(Print &out);
+
+private:
+  AnalysisTask(const AnalysisTask &) = delete;
+  AnalysisTask &operator=(const AnalysisTask &) = delete;
+
+  static void timerIsr();
+  static uint32_t toMicros(uint32_t cycles);
+  static AnalysisTask *running;
+
+  struct Job {
+    AudioAnalysisTap *tap;
+    BlockAnalyzer *analyzer;
+  };
+
+  IntervalTimer timer;
+  Job jobs[MAX_JOBS];
+  uint8_t numJobs;
+  volatile bool busy;
+  volatile uint32_t blockCount;
+  volatile uint32_t maxLatency;  // cycles
+  volatile uint32_t maxRun;
+};
+
+#endif
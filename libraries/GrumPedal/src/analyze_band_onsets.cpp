@@ -0,0 +1,205 @@
+#include "analyze_band_onsets.h"
+
+// Same split as AudioAnalyzePluckTrigger's DEFAULT_EDGES
+static const OnsetBand DEFAULT_BANDS[] = {
+  {  60.0f,  110.0f, 0 },   // KICK
+  { 110.0f,  165.0f, 1 },   // SNARE
+  { 165.0f,  260.0f, 2 },   // HAT
+  { 260.0f,  400.0f, 3 },   // RIDE
+  { 400.0f, 1000.0f, 4 },   // CRASH
+};
+
+static const int BAND_SAMPLES = AUDIO_BLOCK_SAMPLES / AudioAnalyzeBandOnsets::DECIMATION;
+
+AudioAnalyzeBandOnsets::AudioAnalyzeBandOnsets(void)
+  : AudioStream(1, inputQueueArray)
+{
+  floorRms = 0.003f;    // ~-50 dBFS in band
+  ratio = 1.6f;
+  maskRatio = 0.8f;
+  spread = 0.25f;       // 12 dB
+  confirm = 2;          // ~6 ms
+  velGain = 4.0f;
+  holdoffBlocks = 10;   // ~29 ms
+
+  numBands = 0;
+  bands(DEFAULT_BANDS, sizeof(DEFAULT_BANDS) / sizeof(DEFAULT_BANDS[0]));
+  blockCount = 0;
+}
+
+// RBJ band-pass, 0 dB at the centre. Cascading two of them keeps the
+// -3 dB points a little inside the range, which is what separates
+// neighbouring strings.
+void AudioAnalyzeBandOnsets::design(uint8_t band, float lowHz, float highHz)
+{
+  const float fs = AUDIO_SAMPLE_RATE_EXACT / DECIMATION;
+  if (highHz > fs * 0.45f) highHz = fs * 0.45f;
+  if (lowHz < 20.0f) lowHz = 20.0f;
+  if (highHz <= lowHz) highHz = lowHz * 1.2f;
+
+  const float fc = sqrtf(lowHz * highHz);
+  const float q = fc / (highHz - lowHz);
+  const float w0 = 2.0f * (float)M_PI * fc / fs;
+  const float alpha = sinf(w0) / (2.0f * q);
+  const float norm = 1.0f / (1.0f + alpha);
+
+  b0[band] = alpha * norm;
+  a1[band] = -2.0f * cosf(w0) * norm;
+  a2[band] = (1.0f - alpha) * norm;
+  centreHz[band] = fc;
+
+  // Power envelope over about one period of the band centre
+  float tau = 1.0f / fc;
+  tau = constrain(tau, 0.002f, 0.012f);
+  envCoeff[band] = 1.0f - expf(-1.0f / (tau * fs));
+}
+
+void AudioAnalyzeBandOnsets::bands(const OnsetBand *specs, uint8_t count)
+{
+  if (count > MAX_BANDS) count = MAX_BANDS;
+  __disable_irq();
+  for (uint8_t k = 0; k < count; k++) {
+    design(k, specs[k].lowHz, specs[k].highHz);
+    drums[k] = specs[k].drum;
+    for (int s = 0; s < 2; s++) z1[s][k] = z2[s][k] = 0.0f;
+    power[k] = average[k] = 0.0f;
+    bandLevel[k] = 0.0f;
+    holdoffCount[k] = 0;
+    lastLevel[k] = olderLevel[k] = 0.0f;
+    firedAt[k] = 0;
+  }
+
+  // What can leak into each band: the lower bands whose 2nd or 3rd
+  // harmonic overlaps it, the upper skirt of the band below and the lower
+  // skirts of every band above
+  for (uint8_t k = 0; k < count; k++) {
+    maskedBy[k] = (uint8_t)(((1u << count) - 1) & ~((2u << k) - 1));
+    if (k) maskedBy[k] |= 1 << (k - 1);
+    for (uint8_t j = 0; j < k; j++) {
+      for (int h = 2; h <= 3; h++) {
+        if (specs[j].lowHz * h < specs[k].highHz && specs[j].highHz * h > specs[k].lowHz) {
+          maskedBy[k] |= 1 << j;
+        }
+      }
+    }
+  }
+  numBands = count;
+  pendingBands = 0;
+  firedRecently = 0;
+  __enable_irq();
+}
+
+void AudioAnalyzeBandOnsets::thresholds(float floor, float r)
+{
+  __disable_irq();
+  floorRms = floor;
+  ratio = r;
+  __enable_irq();
+}
+
+void AudioAnalyzeBandOnsets::update(void)
+{
+  audio_block_t *block = receiveReadOnly();
+  if (!block) return;
+
+  uint32_t now = micros();
+  uint32_t cycles = ARM_DWT_CYCCNT;
+  blockCount++;
+
+  // Box-car average down to fs/4; the band-passes do the rest of the
+  // anti-aliasing
+  float x[BAND_SAMPLES];
+  const int16_t *d = block->data;
+  for (int i = 0; i < BAND_SAMPLES; i++, d += DECIMATION) {
+    x[i] = (int32_t)(d[0] + d[1] + d[2] + d[3]) * (1.0f / (DECIMATION * 32768.0f));
+  }
+  release(block);
+
+  // Sample-outer, band-inner: every band of one sample is independent
+  const uint8_t n = numBands;
+  for (int i = 0; i < BAND_SAMPLES; i++) {
+    const float in = x[i];
+    for (uint8_t k = 0; k < n; k++) {
+      float v = in;
+      for (int s = 0; s < 2; s++) {
+        const float bx = b0[k] * v;
+        const float y = bx + z1[s][k];
+        z1[s][k] = z2[s][k] - a1[k] * y;
+        z2[s][k] = -bx - a2[k] * y;
+        v = y;
+      }
+      power[k] += envCoeff[k] * (v * v - power[k]);
+    }
+  }
+
+  // A band is fresh while its envelope stands well above its running
+  // average (frozen while an onset is pending) and is not lost under the
+  // loudest band, sudden if it got there within two blocks, rising while
+  // it still grows block on block
+  float rms[MAX_BANDS];
+  float loudest = 0.0f;
+  for (uint8_t k = 0; k < n; k++) {
+    rms[k] = sqrtf(power[k] * 2.0f);   // sine peak = 1
+    bandLevel[k] = rms[k];
+    if (rms[k] > loudest) loudest = rms[k];
+  }
+  const float floorNow = max(floorRms, loudest * spread);
+
+  uint8_t fresh = 0, rising = 0, sudden = 0;
+  for (uint8_t k = 0; k < n; k++) {
+    const float r = rms[k];
+    if (r > floorNow && r > average[k] * ratio) fresh |= 1 << k;
+    if (r > floorRms && r > lastLevel[k] * 1.05f) rising |= 1 << k;
+    if (r > olderLevel[k] * ratio) sudden |= 1 << k;
+    olderLevel[k] = lastLevel[k];
+    lastLevel[k] = r;
+    if (holdoffCount[k]) holdoffCount[k]--;
+    if (!(pendingBands & (1 << k))) average[k] += (r - average[k]) * 0.0625f;
+  }
+
+  uint8_t firedNow = 0;
+  for (uint8_t k = 0; k < n; k++) {
+    const uint8_t bit = 1 << k;
+    if (!(pendingBands & bit)) {
+      if (!(fresh & sudden & bit) || holdoffCount[k]) continue;
+      pendingBands |= bit;
+      waited[k] = 0;
+      pending[k].micros = now;
+      pending[k].block = blockCount;
+      pending[k].cycles = cycles;
+      pending[k].offset = 0;          // the envelopes only place it to the block
+      pending[k].channel = 0;
+    }
+
+    // Decide once the band has stopped ringing up (its level is the
+    // velocity) and so have the bands that could be leaking into it
+    if (++waited[k] <= MAX_WAIT) {
+      if (waited[k] < confirm || (rising & (bit | maskedBy[k]))) continue;
+    }
+    // Either way this level is the band's new average, so it takes
+    // another jump to start again
+    pendingBands &= ~bit;
+    average[k] = rms[k];
+
+    // Still up, and not just spill from a new note in another band
+    bool ok = fresh & bit;
+    const uint8_t from = maskedBy[k] & (fresh | firedRecently | firedNow);
+    for (uint8_t j = 0; ok && j < n; j++) {
+      if ((from & (1 << j)) && rms[k] < rms[j] * maskRatio) ok = false;
+    }
+    if (!ok) continue;
+
+    holdoffCount[k] = holdoffBlocks;
+    pending[k].drum = drums[k];
+    pending[k].velocity = constrain(rms[k] * velGain, 0.0f, 1.0f);
+    pending[k].frequency = centreHz[k];
+    events.push(pending[k]);
+    firedAt[k] = blockCount;
+    firedNow |= bit;
+  }
+
+  firedRecently = 0;
+  for (uint8_t k = 0; k < n; k++) {
+    if (firedAt[k] && blockCount - firedAt[k] <= holdoffBlocks) firedRecently |= 1 << k;
+  }
+}
@@ -0,0 +1,130 @@
+// AudioAnalyzeBandOnsets - polyphonic onsets from a band-pass filterbank
+//
+// AudioAnalyzePluckTrigger and the loop() detectors follow one pitch, so a
+// strummed chord fires one drum at best. This object splits the input
+// into up to MAX_BANDS string ranges, each a 4th order band-pass (two
+// cascaded biquads), and runs a cheap onset test per band: the band's
+// envelope (about one period of its centre frequency) jumping well above
+// its own running average. Every band fires on its own, so one strum can
+// start several drums in the same block; each onset is published as a
+// PluckEvent with the band's drum and centre frequency, stamped with the
+// block it was seen in.
+//
+// The bands only need the fundamentals, which stay under ~1.3 kHz on a
+// guitar, so the filterbank runs at a quarter of the sample rate (the
+// input is averaged four samples at a time first). Filter state and
+// coefficients are stored band-major in flat arrays and the inner loop
+// walks all bands per sample: the decimated input is read once and the
+// bands' multiply-adds have no dependency on each other, so they pipeline
+// on the FPU instead of waiting on one filter's feedback. Six bands cost
+// about as much per block as one full-rate biquad section pair.
+//
+// One note also shows up in other bands: its 2nd and 3rd harmonics above
+// it, the filter skirts either side, the pick's click everywhere, and the
+// narrow low bands ring up last. So an onset waits (confirmBlocks() at
+// least, MAX_WAIT at most) until its band and every band that could be
+// leaking into it have stopped rising; it is then published at the
+// band's level if no such band with a new note is more than
+// 1 / harmonicMask() times louder. That costs the low strings ~20 ms of
+// latency, and an octave over the root of a chord is taken for its
+// harmonic.
+//
+// Usage:
+//   AudioAnalyzeBandOnsets strings;
+//   AudioConnection c(highpass, 0, strings, 0);
+//   ...
+//   PluckEvent ev;
+//   while (strings.read(ev)) triggerDrum(ev.drum, ev.frequency, ev.velocity);
+
+#ifndef analyze_band_onsets_h_
+#define analyze_band_onsets_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include "analyze_pluck_trigger.h"
+#include "spsc_queue.h"
+
+struct OnsetBand {
+  float lowHz;
+  float highHz;
+  int8_t drum;       // reported in PluckEvent::drum
+};
+
+class AudioAnalyzeBandOnsets : public AudioStream
+{
+public:
+  static const uint8_t MAX_BANDS = 8;
+  static const uint8_t DECIMATION = 4;
+  static const uint8_t MAX_WAIT = 8;          // blocks, ~23 ms
+
+  AudioAnalyzeBandOnsets(void);
+
+  // Band ranges, ascending. Defaults to the kick/snare/hat/ride/crash
+  // split of AudioAnalyzePluckTrigger, crash capped at 1 kHz.
+  void bands(const OnsetBand *bands, uint8_t count);
+
+  // Band level (0..1, sine peak) must exceed floor and be ratio x its
+  // running average.
+  void thresholds(float floor, float ratio);
+  // Bands more than this far under the loudest are ignored (0..1).
+  void spreadLimit(float fraction) { spread = fraction; }
+  // Blocks between an onset and its check (default 2).
+  void confirmBlocks(uint8_t blocks) { confirm = blocks; }
+  // Minimum blocks between two onsets of one band.
+  void holdoff(uint16_t blocks) { holdoffBlocks = blocks; }
+  // Level of a band against one leaking into it (default 0.8); 0 lets
+  // every band fire on its own.
+  void harmonicMask(float ratio) { maskRatio = ratio; }
+  // velocity = band RMS x gain, clipped to 1.
+  void velocityGain(float gain) { velGain = gain; }
+
+  bool available(void) { return !events.empty(); }
+  bool read(PluckEvent &ev) { return events.pop(ev); }
+  uint32_t dropped(void) { return events.dropped(); }
+
+  // Band level at the end of the most recent block.
+  float level(uint8_t band) { return band < numBands ? bandLevel[band] : 0.0f; }
+  uint8_t bandCount(void) const { return numBands; }
+
+  virtual void update(void);
+
+private:
+  void design(uint8_t band, float lowHz, float highHz);
+
+  audio_block_t *inputQueueArray[1];
+  SpscQueue<PluckEvent, 16> events;
+
+  // Band-major, [band], both sections share coefficients
+  float b0[MAX_BANDS];           // b1 = 0, b2 = -b0
+  float a1[MAX_BANDS];
+  float a2[MAX_BANDS];
+  float z1[2][MAX_BANDS];        // transposed direct form II state
+  float z2[2][MAX_BANDS];
+  float envCoeff[MAX_BANDS];
+  float power[MAX_BANDS];        // smoothed y^2
+
+  float centreHz[MAX_BANDS];
+  int8_t drums[MAX_BANDS];
+  uint8_t maskedBy[MAX_BANDS];   // bit j: band j's note can show up here
+  uint8_t numBands;
+
+  float floorRms, ratio, spread;
+  float maskRatio;
+  uint8_t confirm;
+  float velGain;
+  uint16_t holdoffBlocks;
+
+  float average[MAX_BANDS];      // running level
+  volatile float bandLevel[MAX_BANDS];
+  uint16_t holdoffCount[MAX_BANDS];
+  float lastLevel[MAX_BANDS];    // one and two blocks back
+  float olderLevel[MAX_BANDS];
+  uint8_t pendingBands;          // onsets waiting to be decided
+  uint8_t waited[MAX_BANDS];     // blocks so far
+  PluckEvent pending[MAX_BANDS];
+  uint32_t firedAt[MAX_BANDS];   // block of the last published onset
+  uint8_t firedRecently;         // bands that fired within holdoff
+  uint32_t blockCount;
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include "analyze_multi_pluck.h"
+#include "block_features.h"
+
+// AudioAnalyzePluckTrigger's defaults: KICK 60-110, SNARE 110-165,
+// HAT 165-260, RIDE 260-400, CRASH 400+
+static const float DEFAULT_EDGES[] = { 60.0f, 110.0f, 165.0f, 260.0f, 400.0f };
+static const int8_t DEFAULT_DRUMS[] = { 0, 1, 2, 3, 4 };
+
+AudioAnalyzeMultiPluck::AudioAnalyzeMultiPluck(uint8_t channels)
+  : AudioStream(channels < MAX_CHANNELS ? channels : MAX_CHANNELS, inputQueueArray)
+{
+  numChannels = channels < MAX_CHANNELS ? channels : MAX_CHANNELS;
+  thresholdMultiplier = 1.2f;
+  hfcThreshold = 0.8f;
+  ratioThreshold = 1.2f;
+  holdoffBlocks = 10;   // ~29 ms
+
+  pending = 0;
+  above = 0;
+  memset(pendingEvent, 0, sizeof(pendingEvent));
+  for (uint8_t k = 0; k < MAX_CHANNELS; k++) {
+    floorLevel[k] = 0.0001f;
+    for (int i = 0; i < HISTORY_SIZE; i++) energyHistory[i][k] = 0.001f;
+    historyIndex[k] = 0;
+    prevEnergy[k] = 0;
+    prevHfc[k] = 0;
+    prevSample[k] = 0;
+    holdoffCount[k] = 0;
+    lastPeak[k] = 0;
+    pendingBlocks[k] = 0;
+    pendingSample[k] = 0;
+    lastUpCrossing[k] = -1;
+    hysteresis[k] = 0;
+    pendingEvent[k].channel = k;
+    numBands[k] = 0;
+    bands(k, DEFAULT_EDGES, DEFAULT_DRUMS, sizeof(DEFAULT_EDGES) / sizeof(DEFAULT_EDGES[0]));
+    pitchRange(k, 55.0f, 1000.0f, 12);
+  }
+  skipCount = 0;
+  blockCount = 0;
+}
+
+void AudioAnalyzeMultiPluck::thresholds(float floor, float multiplier,
+                                        float hfcThr, float ratioThr)
+{
+  __disable_irq();
+  for (uint8_t k = 0; k < MAX_CHANNELS; k++) floorLevel[k] = floor;
+  thresholdMultiplier = multiplier;
+  hfcThreshold = hfcThr;
+  ratioThreshold = ratioThr;
+  __enable_irq();
+}
+
+void AudioAnalyzeMultiPluck::noiseFloor(uint8_t channel, float floor)
+{
+  if (channel >= MAX_CHANNELS) return;
+  floorLevel[channel] = floor;
+}
+
+void AudioAnalyzeMultiPluck::pitchRange(uint8_t channel, float minHz, float maxHz, uint8_t maxBlocks)
+{
+  if (channel >= MAX_CHANNELS) return;
+  if (minHz < 20.0f) minHz = 20.0f;
+  if (maxHz <= minHz) maxHz = minHz * 2.0f;
+  __disable_irq();
+  minPeriod[channel] = (uint32_t)(AUDIO_SAMPLE_RATE_EXACT / maxHz);
+  maxPeriod[channel] = (uint32_t)(AUDIO_SAMPLE_RATE_EXACT / minHz) + 1;
+  maxPitchBlocks[channel] = maxBlocks ? maxBlocks : 1;
+  __enable_irq();
+}
+
+void AudioAnalyzeMultiPluck::bands(uint8_t channel, const float *edgesHz, const int8_t *drums,
+                                   uint8_t count)
+{
+  if (channel >= MAX_CHANNELS) return;
+  if (count > MAX_BANDS) count = MAX_BANDS;
+  __disable_irq();
+  for (uint8_t i = 0; i < count; i++) {
+    bandEdges[channel][i] = edgesHz[i];
+    bandDrums[channel][i] = drums[i];
+  }
+  numBands[channel] = count;
+  __enable_irq();
+}
+
+int AudioAnalyzeMultiPluck::drumFor(uint8_t channel, float freq)
+{
+  if (channel >= numChannels) return -1;
+  const float *edges = bandEdges[channel];
+  const uint8_t n = numBands[channel];
+  if (freq <= 0 || n == 0 || freq < edges[0]) return -1;
+  int b = 0;
+  while (b + 1 < n && freq >= edges[b + 1]) b++;
+  return bandDrums[channel][b];
+}
+
+// AudioAnalyzePluckTrigger::trackPeriod() on one channel's state
+bool AudioAnalyzeMultiPluck::trackPeriod(uint8_t ch, const int16_t *data, uint32_t &period)
+{
+  const uint8_t bit = 1 << ch;
+  const int16_t hyst = hysteresis[ch];
+  const uint32_t lo = minPeriod[ch], hi = maxPeriod[ch];
+  const uint32_t start = pendingSample[ch];
+  int32_t last = lastUpCrossing[ch];
+  bool up = above & bit;
+  bool found = false;
+
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    int16_t x = data[i];
+    int32_t n = (int32_t)(start + i);
+    if (!up && x > hyst) {
+      up = true;
+      if (last >= 0) {
+        uint32_t p = (uint32_t)(n - last);
+        if (p >= lo && p <= hi) {
+          period = p;
+          found = true;
+          break;
+        }
+      }
+      last = n;
+    } else if (up && x < -hyst) {
+      up = false;
+    }
+  }
+
+  lastUpCrossing[ch] = last;
+  above = up ? (above | bit) : (above & ~bit);
+  if (!found) pendingSample[ch] = start + AUDIO_BLOCK_SAMPLES;
+  return found;
+}
+
+void AudioAnalyzeMultiPluck::publish(uint8_t ch, float freq)
+{
+  pendingEvent[ch].frequency = freq;
+  pendingEvent[ch].drum = (int8_t)drumFor(ch, freq);
+  events.push(pendingEvent[ch]);
+  pending &= ~(1 << ch);
+}
+
+void AudioAnalyzeMultiPluck::update(void)
+{
+  const uint8_t n = numChannels;
+  audio_block_t *block[MAX_CHANNELS];
+  uint8_t live = 0;
+  for (uint8_t k = 0; k < n; k++) {
+    block[k] = receiveReadOnly(k);
+    if (block[k]) live |= 1 << k;
+  }
+  if (!live) return;
+
+  uint32_t now = micros();
+  uint32_t cycles = ARM_DWT_CYCCNT;
+  blockCount++;
+
+  // Pass 1: energy, HFC and peak of every input, the only full-rate work
+  float energy[MAX_CHANNELS], hfc[MAX_CHANNELS], peak[MAX_CHANNELS];
+  int32_t peakAbs[MAX_CHANNELS], prevPeakAbs[MAX_CHANNELS];
+  for (uint8_t k = 0; k < n; k++) {
+    if (!(live & (1 << k))) continue;
+    const int16_t *p = block[k]->data;
+    BlockFeatures f;
+    blockFeatures(p, AUDIO_BLOCK_SAMPLES, prevSample[k], f);
+    prevSample[k] = p[AUDIO_BLOCK_SAMPLES - 1];
+    peakAbs[k] = f.peak;
+    energy[k] = f.rms(AUDIO_BLOCK_SAMPLES);
+    hfc[k] = f.hfcRms(AUDIO_BLOCK_SAMPLES);
+    peak[k] = peakAbs[k] * (1.0f / 32768.0f);
+    prevPeakAbs[k] = (int32_t)(lastPeak[k] * 32768.0f);
+    lastPeak[k] = peak[k];
+  }
+
+  // Pass 2: AudioAnalyzePluckTrigger::onsetTest() for every channel
+  // above its gate
+  uint8_t onsets = 0;
+  float velocity[MAX_CHANNELS];
+  for (uint8_t k = 0; k < n; k++) {
+    if (!(live & (1 << k))) continue;
+    const bool hfcJump = hfc[k] > 0.01f && hfc[k] > prevHfc[k] * AudioAnalyzePluckTrigger::HFC_JUMP;
+    prevHfc[k] = hfc[k];
+    if (peak[k] >= floorLevel[k]) {
+      float e = energy[k];
+      if (e < 0.001f) e = peak[k];
+
+      energyHistory[historyIndex[k]][k] = e;
+      historyIndex[k] = (historyIndex[k] + 1) % HISTORY_SIZE;
+      float avgHistory = 0;
+      for (int i = 0; i < HISTORY_SIZE; i++) avgHistory += energyHistory[i][k];
+      avgHistory /= HISTORY_SIZE;
+
+      float adaptiveThreshold = avgHistory * thresholdMultiplier + floorLevel[k];
+      float energyRatio = e / (avgHistory + 0.001f);
+      float hfcRatio = hfc[k] / (avgHistory + 0.001f);
+
+      bool energyCondition = e > adaptiveThreshold;
+      bool ratioCondition = energyRatio > ratioThreshold;
+      bool hfcCondition = hfcRatio > hfcThreshold || hfc[k] > 0.01f;
+      bool risingEdge = e > prevEnergy[k] * 1.2f;
+
+      bool isOnset = hfcJump;
+      if (energyCondition && ratioCondition && risingEdge) {
+        if (hfcCondition || e > adaptiveThreshold * 3) isOnset = true;
+      }
+      if (isOnset) {
+        onsets |= 1 << k;
+        velocity[k] = constrain(e * 2.0f, 0.0f, 1.0f);
+      }
+      prevEnergy[k] = e;
+    }
+    if (holdoffCount[k]) holdoffCount[k]--;
+  }
+
+  // Pass 3: a new pitch search on each fresh onset, or on one stronger
+  // than the pick its channel is still searching for
+  for (uint8_t k = 0; onsets >> k; k++) {
+    if (!(onsets & (1 << k))) continue;
+    const bool searching = pending & (1 << k);
+    if (holdoffCount[k] ||
+        (searching && velocity[k] <= pendingEvent[k].velocity)) {
+      skipCount++;
+      continue;
+    }
+    if (searching) skipCount++;
+    pending |= 1 << k;
+    above &= ~(1 << k);
+    pendingBlocks[k] = 0;
+    pendingSample[k] = 0;
+    lastUpCrossing[k] = -1;
+    hysteresis[k] = (int16_t)(peakAbs[k] * 3 / 10);
+    PluckEvent &ev = pendingEvent[k];
+    ev.velocity = velocity[k];
+    ev.micros = now;
+    ev.block = blockCount;
+    ev.offset = AudioAnalyzePluckTrigger::attackOffset(block[k]->data, peakAbs[k], prevPeakAbs[k]);
+    ev.cycles = cycles;
+    holdoffCount[k] = holdoffBlocks;
+  }
+
+  // Pass 4: the period search, only on the channels waiting for one
+  const uint8_t searching = pending & live;
+  for (uint8_t k = 0; searching >> k; k++) {
+    if (!(searching & (1 << k))) continue;
+    uint32_t period;
+    if (trackPeriod(k, block[k]->data, period)) {
+      publish(k, AUDIO_SAMPLE_RATE_EXACT / (float)period);
+    } else if (++pendingBlocks[k] >= maxPitchBlocks[k]) {
+      publish(k, -1.0f);
+    }
+  }
+
+  for (uint8_t k = 0; k < n; k++) {
+    if (block[k]) release(block[k]);
+  }
+}
@@ -0,0 +1,125 @@
+// AudioAnalyzeMultiPluck - the pluck trigger on several inputs at once
+//
+// The sketches analyse one channel: the left input, or left and right
+// summed. This object runs AudioAnalyzePluckTrigger's onset test and
+// period tracking on up to MAX_CHANNELS inputs, each with its own noise
+// floor, pitch range and band -> drum map, so a guitar and a bass on the
+// two I2S channels share one pedal, or a hex pickup through AudioInputTDM
+// triggers per string. Every PluckEvent says which input it came from
+// (PluckEvent::channel); its drum is already that input's.
+//
+// One object instead of N trigger objects: state is kept structure-of-
+// arrays, channel-minor ([...][channel]) as AudioAnalyzeBandOnsets keeps
+// its bands, and update() works in passes over all channels. The only
+// per-sample work is blockFeatures() (the DSP SIMD pass) on each input,
+// and the period search on the channels that are waiting for a pitch;
+// the onset decisions are a few flat loops over the channel arrays, with
+// no per-object update, queue or lock overhead per channel. A quiet
+// channel costs its feature pass and nothing else.
+//
+// Channel 0 given the same input gives the same events as
+// AudioAnalyzePluckTrigger, and onsets that publish no event (held off,
+// or losing to a stronger pick on their channel) count in skipped() the
+// same way, summed over the channels.
+//
+// Usage:
+//   AudioAnalyzeMultiPluck players(2);
+//   AudioConnection c0(guitarHighpass, 0, players, 0);
+//   AudioConnection c1(bassHighpass, 0, players, 1);
+//   const float BASS_EDGES[] = { 30, 60, 90 };
+//   const int8_t BASS_DRUMS[] = { 0, 1, 3 };    // kick, snare, ride
+//   players.bands(1, BASS_EDGES, BASS_DRUMS, 3);
+//   players.pitchRange(1, 30, 400, 16);
+//   ...
+//   PluckEvent ev;
+//   while (players.read(ev)) if (ev.drum >= 0) triggerDrum(ev.drum, ...);
+//
+//   AudioInputTDM hex;                           // one string per slot
+//   AudioAnalyzeMultiPluck strings(6);
+
+#ifndef analyze_multi_pluck_h_
+#define analyze_multi_pluck_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include "analyze_pluck_trigger.h"
+#include "spsc_queue.h"
+
+class AudioAnalyzeMultiPluck : public AudioStream
+{
+public:
+  static const uint8_t MAX_CHANNELS = 8;
+  static const uint8_t MAX_BANDS = AudioAnalyzePluckTrigger::MAX_BANDS;
+
+  explicit AudioAnalyzeMultiPluck(uint8_t channels);
+
+  // As AudioAnalyzePluckTrigger, for every channel
+  void thresholds(float noiseFloor, float multiplier, float hfcThreshold, float ratioThreshold);
+  void holdoff(uint16_t blocks) { holdoffBlocks = blocks; }
+  // One channel's gate (0..1 peak), for inputs at different levels
+  void noiseFloor(uint8_t channel, float floor);
+  void pitchRange(uint8_t channel, float minHz, float maxHz, uint8_t maxBlocks);
+  // Lower band edges in Hz, ascending, and the drum of each band. Every
+  // channel defaults to AudioAnalyzePluckTrigger's split, band i = drum i.
+  void bands(uint8_t channel, const float *edgesHz, const int8_t *drums, uint8_t count);
+
+  uint8_t channels(void) const { return numChannels; }
+  bool available(void) { return !events.empty(); }
+  bool read(PluckEvent &ev) { return events.pop(ev); }
+  uint32_t dropped(void) { return events.dropped(); }
+  uint32_t skipped(void) const { return skipCount; }
+  uint32_t blocks(void) const { return blockCount; }
+
+  // Peak of the channel's most recent block, 0..1
+  float level(uint8_t channel) { return channel < numChannels ? lastPeak[channel] : 0.0f; }
+
+  int drumFor(uint8_t channel, float freq);
+
+  virtual void update(void);
+
+private:
+  bool trackPeriod(uint8_t ch, const int16_t *data, uint32_t &period);
+  void publish(uint8_t ch, float freq);
+
+  audio_block_t *inputQueueArray[MAX_CHANNELS];
+  SpscQueue<PluckEvent, 16> events;
+  uint8_t numChannels;
+
+  // Shared thresholds
+  float thresholdMultiplier;
+  float hfcThreshold;
+  float ratioThreshold;
+  uint16_t holdoffBlocks;
+
+  // Channel-minor, [channel]
+  static const int HISTORY_SIZE = 8;
+  float floorLevel[MAX_CHANNELS];
+  float energyHistory[HISTORY_SIZE][MAX_CHANNELS];
+  uint8_t historyIndex[MAX_CHANNELS];
+  float prevEnergy[MAX_CHANNELS];
+  float prevHfc[MAX_CHANNELS];
+  int16_t prevSample[MAX_CHANNELS];
+  uint16_t holdoffCount[MAX_CHANNELS];
+  volatile float lastPeak[MAX_CHANNELS];
+
+  // Pitch tracking after an onset
+  uint32_t minPeriod[MAX_CHANNELS];
+  uint32_t maxPeriod[MAX_CHANNELS];
+  uint8_t maxPitchBlocks[MAX_CHANNELS];
+  uint8_t pending;                         // bit per channel
+  uint8_t pendingBlocks[MAX_CHANNELS];
+  uint32_t pendingSample[MAX_CHANNELS];
+  int32_t lastUpCrossing[MAX_CHANNELS];
+  int16_t hysteresis[MAX_CHANNELS];
+  uint8_t above;                           // bit per channel
+  PluckEvent pendingEvent[MAX_CHANNELS];
+
+  float bandEdges[MAX_CHANNELS][MAX_BANDS];
+  int8_t bandDrums[MAX_CHANNELS][MAX_BANDS];
+  uint8_t numBands[MAX_CHANNELS];
+
+  volatile uint32_t skipCount;
+  uint32_t blockCount;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include "analyze_pluck_trigger.h"
+
+// Default band edges, same split as triggerDrumForFrequency():
+// KICK 60-110, SNARE 110-165, HAT 165-260, RIDE 260-400, CRASH 400+
+static const float DEFAULT_EDGES[] = { 60.0f, 110.0f, 165.0f, 260.0f, 400.0f };
+
+AudioAnalyzePluckTrigger::AudioAnalyzePluckTrigger(void)
+  : AudioStream(1, inputQueueArray)
+{
+  noiseFloor = 0.0001f;
+  thresholdMultiplier = 1.2f;
+  hfcThreshold = 0.8f;
+  ratioThreshold = 1.2f;
+  holdoffBlocks = 10;   // ~29 ms
+
+  for (int i = 0; i < HISTORY_SIZE; i++) energyHistory[i] = 0.001f;
+  historyIndex = 0;
+  prevEnergy = 0;
+  prevHfc = 0;
+  prevSample = 0;
+
+  pending = false;
+  pendingBlocks = 0;
+  pendingSample = 0;
+  lastUpCrossing = -1;
+  hysteresis = 0;
+  above = false;
+  memset(&pendingEvent, 0, sizeof(pendingEvent));
+
+  numBands = 0;
+  bands(DEFAULT_EDGES, sizeof(DEFAULT_EDGES) / sizeof(DEFAULT_EDGES[0]));
+  maxPitchBlocks = 0;
+  pitchRange(55.0f, 1000.0f, 12);
+
+  holdoffCount = 0;
+  skipCount = 0;
+  blockCount = 0;
+  lastPeak = 0;
+  lastEnergy = 0;
+}
+
+void AudioAnalyzePluckTrigger::thresholds(float floor, float multiplier,
+                                          float hfcThr, float ratioThr)
+{
+  __disable_irq();
+  noiseFloor = floor;
+  thresholdMultiplier = multiplier;
+  hfcThreshold = hfcThr;
+  ratioThreshold = ratioThr;
+  __enable_irq();
+}
+
+void AudioAnalyzePluckTrigger::pitchRange(float minHz, float maxHz, uint8_t maxBlocks)
+{
+  if (minHz < 20.0f) minHz = 20.0f;
+  if (maxHz <= minHz) maxHz = minHz * 2.0f;
+  __disable_irq();
+  minPeriod = (uint32_t)(AUDIO_SAMPLE_RATE_EXACT / maxHz);
+  maxPeriod = (uint32_t)(AUDIO_SAMPLE_RATE_EXACT / minHz) + 1;
+  maxPitchBlocks = maxBlocks ? maxBlocks : 1;
+  __enable_irq();
+}
+
+void AudioAnalyzePluckTrigger::bands(const float *edgesHz, uint8_t count)
+{
+  if (count > MAX_BANDS) count = MAX_BANDS;
+  __disable_irq();
+  for (uint8_t i = 0; i < count; i++) bandEdges[i] = edgesHz[i];
+  numBands = count;
+  __enable_irq();
+}
+
+int AudioAnalyzePluckTrigger::drumFor(float freq)
+{
+  if (freq <= 0 || numBands == 0 || freq < bandEdges[0]) return -1;
+  int b = 0;
+  while (b + 1 < numBands && freq >= bandEdges[b + 1]) b++;
+  return b;
+}
+
+// Onset test from detectOnset() in grum-pedal.cpp, fed with time-domain
+// block features instead of FFT bins. A pick quieter than the note it
+// cuts off never lifts the energy over its history, so a jump in HFC
+// alone counts too: without it the onset, and a fixedLatency() slot
+// timed from it, came blocks after the attack.
+bool AudioAnalyzePluckTrigger::onsetTest(float energy, float hfc, float peak,
+                                         float &velocity)
+{
+  const bool hfcJump = hfc > 0.01f && hfc > prevHfc * HFC_JUMP;
+  prevHfc = hfc;
+  if (peak < noiseFloor) return false;
+  if (energy < 0.001f) energy = peak;
+
+  energyHistory[historyIndex] = energy;
+  historyIndex = (historyIndex + 1) % HISTORY_SIZE;
+  float avgHistory = 0;
+  for (int i = 0; i < HISTORY_SIZE; i++) avgHistory += energyHistory[i];
+  avgHistory /= HISTORY_SIZE;
+
+  float adaptiveThreshold = avgHistory * thresholdMultiplier + noiseFloor;
+  float energyRatio = energy / (avgHistory + 0.001f);
+  float hfcRatio = hfc / (avgHistory + 0.001f);
+
+  bool energyCondition = energy > adaptiveThreshold;
+  bool ratioCondition = energyRatio > ratioThreshold;
+  bool hfcCondition = hfcRatio > hfcThreshold || hfc > 0.01f;
+  bool risingEdge = energy > prevEnergy * 1.2f;
+
+  bool isOnset = hfcJump;
+  if (energyCondition && ratioCondition && risingEdge) {
+    if (hfcCondition || energy > adaptiveThreshold * 3) isOnset = true;
+  }
+  if (isOnset) velocity = constrain(energy * 2.0f, 0.0f, 1.0f);
+
+  prevEnergy = energy;
+  return isOnset;
+}
+
+// Schmitt-trigger up-crossings on the raw samples. Returns true once a
+// period inside the configured pitch range has been seen.
+bool AudioAnalyzePluckTrigger::trackPeriod(const int16_t *data, uint32_t &period)
+{
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    int16_t x = data[i];
+    int32_t n = (int32_t)(pendingSample + i);
+    if (!above && x > hysteresis) {
+      above = true;
+      if (lastUpCrossing >= 0) {
+        uint32_t p = (uint32_t)(n - lastUpCrossing);
+        if (p >= minPeriod && p <= maxPeriod) {
+          period = p;
+          return true;
+        }
+      }
+      lastUpCrossing = n;
+    } else if (above && x < -hysteresis) {
+      above = false;
+    }
+  }
+  pendingSample += AUDIO_BLOCK_SAMPLES;
+  return false;
+}
+
+void AudioAnalyzePluckTrigger::publish(float freq)
+{
+  pendingEvent.frequency = freq;
+  pendingEvent.drum = (int8_t)drumFor(freq);
+  events.push(pendingEvent);
+  pending = false;
+}
+
+// First sample at a quarter of the block's peak, and above anything a
+// note still ringing from the previous block reached: where the onset
+// block's new energy starts
+uint8_t AudioAnalyzePluckTrigger::attackOffset(const int16_t *p, int32_t peakAbs, int32_t prevPeakAbs)
+{
+  const int32_t level = constrain(prevPeakAbs * 3 / 2, peakAbs / 4, peakAbs);
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    if (p[i] >= level || p[i] <= -level) return (uint8_t)i;
+  }
+  return 0;
+}
+
+void AudioAnalyzePluckTrigger::update(void)
+{
+  audio_block_t *block = receiveReadOnly();
+  if (!block) return;
+
+  uint32_t now = micros();
+  uint32_t cycles = ARM_DWT_CYCCNT;
+  blockCount++;
+
+  // One pass: energy, first-difference energy (HFC proxy) and peak
+  const int16_t *p = block->data;
+  BlockFeatures f;
+  blockFeatures(p, AUDIO_BLOCK_SAMPLES, prevSample, f);
+  prevSample = p[AUDIO_BLOCK_SAMPLES - 1];
+  int32_t peakAbs = f.peak;
+
+  float energy = f.rms(AUDIO_BLOCK_SAMPLES);
+  float hfc = f.hfcRms(AUDIO_BLOCK_SAMPLES);
+  float peak = peakAbs * (1.0f / 32768.0f);
+  const int32_t prevPeakAbs = (int32_t)(lastPeak * 32768.0f);
+  lastPeak = peak;
+  lastEnergy = energy;
+
+  float velocity = 0;
+  bool onset = onsetTest(energy, hfc, peak, velocity);
+  if (holdoffCount) holdoffCount--;
+
+  // A new pick while the last is still searching: the stronger one wins
+  if (onset && (holdoffCount ||
+                (pending && velocity <= pendingEvent.velocity))) {
+    skipCount++;
+    onset = false;
+  }
+  if (onset) {
+    if (pending) skipCount++;
+    pending = true;
+    pendingBlocks = 0;
+    pendingSample = 0;
+    lastUpCrossing = -1;
+    above = false;
+    hysteresis = (int16_t)(peakAbs * 3 / 10);
+    pendingEvent.velocity = velocity;
+    pendingEvent.micros = now;
+    pendingEvent.block = blockCount;
+    pendingEvent.offset = attackOffset(p, peakAbs, prevPeakAbs);
+    pendingEvent.cycles = cycles;
+    holdoffCount = holdoffBlocks;
+  }
+
+  if (pending) {
+    uint32_t period;
+    if (trackPeriod(p, period)) {
+      publish(AUDIO_SAMPLE_RATE_EXACT / (float)period);
+    } else if (++pendingBlocks >= maxPitchBlocks) {
+      publish(-1.0f);
+    }
+  }
+
+  release(block);
+}
@@ -0,0 +1,137 @@
+// AudioAnalyzePluckTrigger - block-rate pluck onset detector
+//
+// Runs the energy / high-frequency-content onset test from grum-pedal.cpp
+// on every 128 sample block inside the audio interrupt, instead of waiting
+// for loop() to notice a new FFT frame. When a pluck is found the object
+// tracks the period of the new note (Schmitt-trigger up-crossings) and
+// publishes a PluckEvent carrying drum index, velocity and timestamp.
+//
+// Latency is one block for the onset plus one period of the string for the
+// pitch, so roughly 3 ms on the high strings and ~15 ms on low E. If no
+// period can be measured within pitchRange()'s block limit the event is
+// still published with drum = -1 and frequency = -1.
+//
+// One pluck is tracked at a time. An onset inside holdoff() of the last
+// one is taken as the same pick; a stronger onset after it, while the
+// last one is still waiting for its period, replaces it and the search
+// starts again on the new pick. Onsets that never become an event that
+// way (held off, weaker, or replaced) are counted in skipped().
+//
+// The event also says where in its block the attack starts (offset): the
+// first sample reaching a quarter of the block's peak. A voice started at
+// that offset of an output block keeps the pick's timing to the sample
+// instead of snapping it to a block edge (AudioMixerFused::noteGain(),
+// AudioPlaySamplePool::play()).
+//
+// Usage:
+//   AudioAnalyzePluckTrigger pluck;
+//   AudioConnection c(highpass, 0, pluck, 0);
+//   ...
+//   PluckEvent ev;
+//   while (pluck.read(ev)) { if (ev.drum >= 0) triggerDrum(ev.drum, ...); }
+
+#ifndef analyze_pluck_trigger_h_
+#define analyze_pluck_trigger_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include "block_features.h"
+#include "spsc_queue.h"
+
+struct PluckEvent {
+  int8_t   drum;       // band index from bands(), -1 if no pitch
+  float    velocity;   // 0..1, from onset energy
+  float    frequency;  // Hz, -1 if no period was measured
+  uint32_t micros;     // micros() of the block that crossed the threshold
+  uint32_t block;      // audio block counter of that block
+  uint8_t  offset;     // sample of that block where the attack starts
+  uint32_t cycles;     // ARM_DWT_CYCCNT at that block, for LatencyProbe
+  uint8_t  channel;    // input it came from (AudioAnalyzeMultiPluck), else 0
+};
+
+class AudioAnalyzePluckTrigger : public AudioStream
+{
+public:
+  static const uint8_t MAX_BANDS = 8;
+  // HFC rise over one block that makes an onset whatever the energy did
+  static constexpr float HFC_JUMP = 4.0f;
+
+  AudioAnalyzePluckTrigger(void);
+
+  // Same knobs as the globals in grum-pedal.cpp (noiseFloor,
+  // THRESHOLD_MULTIPLIER, HFC_THRESHOLD, ENERGY_RATIO_THRESHOLD).
+  void thresholds(float noiseFloor, float multiplier, float hfcThreshold, float ratioThreshold);
+  // Minimum number of blocks between two onsets.
+  void holdoff(uint16_t blocks) { holdoffBlocks = blocks; }
+  // Pitch search range and how many blocks to wait for a period.
+  void pitchRange(float minHz, float maxHz, uint8_t maxBlocks);
+  // Lower band edges in Hz, ascending. Band i is edges[i] <= f < edges[i+1],
+  // the last band is open ended. Defaults to the kick/snare/hat/ride/crash
+  // split used by triggerDrumForFrequency().
+  void bands(const float *edgesHz, uint8_t count);
+
+  bool available(void) { return !events.empty(); }
+  bool read(PluckEvent &ev) { return events.pop(ev); }
+  uint32_t dropped(void) { return events.dropped(); }
+  // Onsets that published no event of their own, see above
+  uint32_t skipped(void) const { return skipCount; }
+  // Blocks analysed so far; PluckEvent::block of the latest is blocks()
+  uint32_t blocks(void) const { return blockCount; }
+
+  // Peak and RMS of the most recent block, 0..1.
+  float level(void) { return lastPeak; }
+  float energy(void) { return lastEnergy; }
+
+  int drumFor(float freq);
+
+  // First sample of an onset block at a quarter of its peak and above
+  // the previous block's peak (abs sample values)
+  static uint8_t attackOffset(const int16_t *data, int32_t peakAbs, int32_t prevPeakAbs);
+
+  virtual void update(void);
+
+private:
+  bool onsetTest(float energy, float hfc, float peak, float &velocity);
+  bool trackPeriod(const int16_t *data, uint32_t &period);
+  void publish(float freq);
+
+  audio_block_t *inputQueueArray[1];
+  SpscQueue<PluckEvent, 8> events;
+
+  // Onset thresholds
+  float noiseFloor;
+  float thresholdMultiplier;
+  float hfcThreshold;
+  float ratioThreshold;
+  uint16_t holdoffBlocks;
+
+  // Energy history (ENERGY_HISTORY_SIZE in grum-pedal.cpp)
+  static const int HISTORY_SIZE = 8;
+  float energyHistory[HISTORY_SIZE];
+  uint8_t historyIndex;
+  float prevEnergy;
+  float prevHfc;
+  int16_t prevSample;
+
+  // Pitch tracking after an onset
+  uint32_t minPeriod, maxPeriod;
+  uint8_t maxPitchBlocks;
+  bool pending;
+  uint8_t pendingBlocks;
+  uint32_t pendingSample;
+  int32_t lastUpCrossing;
+  int16_t hysteresis;
+  bool above;
+  PluckEvent pendingEvent;
+
+  float bandEdges[MAX_BANDS];
+  uint8_t numBands;
+
+  uint16_t holdoffCount;
+  volatile uint32_t skipCount;
+  uint32_t blockCount;
+  volatile float lastPeak;
+  volatile float lastEnergy;
+};
+
+#endif
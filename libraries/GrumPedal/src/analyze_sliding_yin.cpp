@@ -0,0 +1,156 @@
+#include "analyze_sliding_yin.h"
+
+AudioAnalyzeSlidingYin::AudioAnalyzeSlidingYin() : AudioStream(1, inputQueueArray)
+{
+  thresh = 0.15f;
+  enabled = false;
+  newOutput = false;
+  freq = prob = 0;
+  pitchRange(40.0f, 1000.0f);
+}
+
+void AudioAnalyzeSlidingYin::begin(float threshold)
+{
+  __disable_irq();
+  thresh = threshold;
+  reset();
+  enabled = true;
+  __enable_irq();
+}
+
+void AudioAnalyzeSlidingYin::pitchRange(float lo, float hi)
+{
+  if (lo < 20.0f) lo = 20.0f;
+  if (hi < lo * 2) hi = lo * 2;
+
+  // Decimate as far as keeps >= 20 samples per period of the top note
+  uint8_t f = 8, s = 3;
+  while (f > 1 && AUDIO_SAMPLE_RATE_EXACT / f / hi < 20.0f) {
+    f >>= 1;
+    s--;
+  }
+  float fs = AUDIO_SAMPLE_RATE_EXACT / f;
+  // Below this the lowest period is longer than MAX_TAU lags
+  if (lo < fs / (MAX_TAU - 1)) lo = fs / (MAX_TAU - 1);
+
+  __disable_irq();
+  minHz = lo;
+  maxHz = hi;
+  factor = f;
+  shift = s + 1;   // + 1: keeps each squared difference inside int32
+  tauMin = max(2, (int)(fs / hi));
+  tauMax = min((int)MAX_TAU, (int)(fs / lo) + 1);
+  window = tauMax;
+  reset();
+  __enable_irq();
+}
+
+void AudioAnalyzeSlidingYin::reset()
+{
+  memset(hist, 0, sizeof(hist));
+  memset(diff, 0, sizeof(diff));
+  head = 0;
+  boxSum = 0;
+  boxCount = 0;
+  newOutput = false;
+}
+
+bool AudioAnalyzeSlidingYin::available()
+{
+  __disable_irq();
+  bool flag = newOutput;
+  if (flag) newOutput = false;
+  __enable_irq();
+  return flag;
+}
+
+float AudioAnalyzeSlidingYin::read()
+{
+  __disable_irq();
+  float f = freq;
+  __enable_irq();
+  return f;
+}
+
+float AudioAnalyzeSlidingYin::probability()
+{
+  __disable_irq();
+  float p = prob;
+  __enable_irq();
+  return p;
+}
+
+void AudioAnalyzeSlidingYin::push(int16_t s)
+{
+  uint32_t i = head & (RING - 1);
+  hist[i] = hist[i + RING] = s;
+  head++;
+
+  // p[-k] is the sample k steps back; the mirror keeps it contiguous
+  const int16_t *p = hist + i + RING;
+  const int16_t *q = p - window;
+  const int32_t x0 = p[0], xw = q[0];
+  for (uint16_t tau = 1; tau <= tauMax + 1; tau++) {
+    int32_t a = x0 - p[-tau];
+    int32_t b = xw - q[-tau];
+    diff[tau] += a * a - b * b;
+  }
+}
+
+void AudioAnalyzeSlidingYin::analyze()
+{
+  // Normalise, then take the first dip under the threshold and slide to
+  // its local minimum (same rule as GuitarTrigger::detectPitch)
+  int64_t running = 0;
+  cmnd[0] = 1.0f;
+  for (uint16_t tau = 1; tau <= tauMax + 1; tau++) {
+    running += diff[tau];
+    cmnd[tau] = running > 0 ? (float)diff[tau] * tau / (float)running : 1.0f;
+  }
+
+  int tau = -1;
+  for (int i = tauMin; i <= tauMax; i++) {
+    if (cmnd[i] < thresh) {
+      while (i + 1 <= tauMax && cmnd[i + 1] < cmnd[i]) i++;
+      tau = i;
+      break;
+    }
+  }
+  if (tau < 0) return;
+
+  float better = tau;
+  float x0 = cmnd[tau - 1], x1 = cmnd[tau], x2 = cmnd[tau + 1];
+  float a = (x2 - 2 * x1 + x0) / 2;
+  float b = (x2 - x0) / 2;
+  if (a != 0) better = tau - b / (2 * a);
+
+  freq = AUDIO_SAMPLE_RATE_EXACT / factor / better;
+  prob = 1.0f - x1;
+  newOutput = true;
+}
+
+void AudioAnalyzeSlidingYin::analyzeBlock(const int16_t *data)
+{
+  if (!enabled) return;
+
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    boxSum += data[i];
+    if (++boxCount == factor) {
+      push((int16_t)(boxSum >> shift));
+      boxSum = 0;
+      boxCount = 0;
+    }
+  }
+
+  // Nothing to report until the window and the longest lag hold audio
+  if (head < (uint32_t)window + tauMax + 1) return;
+  analyze();
+}
+
+void AudioAnalyzeSlidingYin::update(void)
+{
+  audio_block_t *block = receiveReadOnly();
+  if (!block) return;
+  analyzeBlock(block->data);
+  release(block);
+}
@@ -0,0 +1,102 @@
+// AudioAnalyzeSlidingYin - YIN pitch estimate after every audio block
+//
+// Drop-in for AudioAnalyzeNoteFrequency (begin / available / read /
+// probability). Instead of recomputing the difference function over a
+// whole analysis window every few blocks, each new sample updates the
+// running sums
+//
+//   d(tau) += (x[t] - x[t-tau])^2 - (x[t-W] - x[t-W-tau])^2
+//
+// for every lag, so a fresh estimate and its confidence come out of each
+// 128 sample block. The sums are exact 64 bit integers and never drift.
+//
+// The input is box-filtered and decimated before the update, as far as
+// keeps 20 samples per period of the top note: 8x up to 275 Hz, 4x up to
+// 551 Hz, 2x up to 1102 Hz. Each decimated sample updates every lag up to
+// one period of the lowest note, and each block then normalises them with
+// one divide per lag, so the cost per block is about
+//
+//   (128 / f) x (44100 / (f x minHz)) squared-difference pairs
+//
+// The default 40..1000 Hz runs at 2x: 64 samples x 553 lags, ~35k pairs
+// and 553 divides a block. 55..1000 Hz is ~26k; 60..400 Hz runs at 4x,
+// ~6k; a five-string bass's low B (31..1000 Hz) ~46k. Pick the narrowest
+// range the drum map needs, especially with the object in the audio
+// interrupt. The window W is one lowest period too.
+//
+// Lags stop at MAX_TAU decimated samples, so the lowest note the search
+// can reach depends on the decimation: 20 Hz with the top up to 551 Hz,
+// 22.1 Hz up to 1102 Hz, 44.1 Hz above that. pitchRange() raises a lower
+// minHz to that floor.
+//
+// Patched into the graph it runs in the audio interrupt. Left unpatched
+// and fed through an AudioAnalysisTap and AnalysisTask (analysis_task.h),
+// the same work runs at a lower priority; the loop() side is unchanged.
+
+#ifndef analyze_sliding_yin_h_
+#define analyze_sliding_yin_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include "analysis_task.h"
+
+class AudioAnalyzeSlidingYin : public AudioStream, public BlockAnalyzer
+{
+public:
+  static const uint16_t MAX_TAU = 1000;
+
+  AudioAnalyzeSlidingYin();
+
+  // Start analysing. threshold is the YIN absolute threshold (0.15 as
+  // with AudioAnalyzeNoteFrequency); estimates only publish below it.
+  void begin(float threshold);
+
+  // Lowest and highest fundamental to search for. Default 40..1000 Hz;
+  // the top sets the decimation and the bottom the lags, see above. minHz
+  // below the decimation's floor is raised to it.
+  void pitchRange(float minHz, float maxHz);
+
+  // A new estimate since the last read()
+  bool available();
+  float read();
+
+  // 1 - normalised difference at the chosen lag; rises as the note rings
+  // and the window fills with it.
+  float probability();
+
+  uint8_t decimation() const { return factor; }
+
+  // One block of input; update() calls it, or an AnalysisTask when the
+  // object is fed through an AudioAnalysisTap instead of a patch cord.
+  virtual void analyzeBlock(const int16_t *data);
+
+  virtual void update(void);
+
+private:
+  static const uint16_t RING = 2048;   // >= 2 * MAX_TAU + 2, power of two
+  static_assert(RING >= 2 * MAX_TAU + 2, "ring must hold the window and the longest lag");
+
+  void reset();
+  void push(int16_t s);
+  void analyze();
+
+  audio_block_t *inputQueueArray[1];
+
+  int16_t hist[2 * RING];              // mirrored: hist[i] == hist[i + RING]
+  int64_t diff[MAX_TAU + 2];           // running d(tau)
+  float cmnd[MAX_TAU + 2];             // cumulative mean normalised d(tau)
+  uint32_t head;                       // decimated samples written
+  uint16_t window, tauMin, tauMax;
+  uint8_t factor, shift;
+  int32_t boxSum;
+  uint8_t boxCount;
+
+  float thresh;
+  float minHz, maxHz;
+  bool enabled;
+  volatile bool newOutput;
+  volatile float freq;
+  volatile float prob;
+};
+
+#endif
@@ -0,0 +1,90 @@
+// AudioBudget - the audio block pool a graph needs, worked out at compile time
+//
+// AudioMemory(50), AudioMemory(12) and "100, increased for SD playback"
+// were all guesses, and a pool that runs dry drops blocks without a word:
+// allocate() returns NULL and a voice or the dry guitar goes silent for a
+// block. An object needs pool blocks in two ways:
+//
+//   held   kept from one update() to the next: the I2S output double
+//          buffers both channels, AudioAnalyzeNoteFrequency keeps 24
+//          blocks of history
+//   sent   transmitted each update; a block sits in its destinations'
+//          queues until the last of them has run, a whole cycle when one
+//          comes before its source in the update order
+//
+// AudioBudget adds both up over the objects a sketch declares, so the pool
+// follows the configuration instead of being provisioned for the worst
+// sketch. Pure analysers cost nothing: their input is counted at the
+// object that sent it, and every GrumPedal analyser copies what it keeps.
+// The policies of Trigger<> carry their own budget() (Trigger::budget()).
+//
+// Costs are upper bounds from the Teensy audio library sources; the
+// AudioBlockProbe table (block_monitor.h) shows what the graph really
+// reaches, so a trimmed pool can be checked on the unit.
+//
+// Usage:
+//   constexpr AudioBudget AUDIO_BUDGET = AudioBudget()
+//       .add(AUDIO_COST_I2S_IN).add(AUDIO_COST_I2S_OUT)
+//       .add(AUDIO_COST_SIMPLE_DRUM, 5).add(AUDIO_COST_MIXER);
+//   AudioMemory(AUDIO_BUDGET.blocks());      // need() + 25%
+
+#ifndef audio_budget_h_
+#define audio_budget_h_
+
+#include <stdint.h>
+
+struct AudioCost {
+  uint8_t held;
+  uint8_t sent;
+};
+
+// Teensy audio library objects
+static constexpr AudioCost AUDIO_COST_I2S_IN         = { 2, 2 };   // DMA halves, L + R
+static constexpr AudioCost AUDIO_COST_I2S_OUT        = { 4, 0 };   // two queued per channel
+static constexpr AudioCost AUDIO_COST_FILTER         = { 0, 1 };   // biquad, state variable
+static constexpr AudioCost AUDIO_COST_MIXER          = { 0, 1 };   // AudioMixer4, amplifier
+static constexpr AudioCost AUDIO_COST_SIMPLE_DRUM    = { 0, 1 };
+static constexpr AudioCost AUDIO_COST_PLAY_MEMORY    = { 0, 1 };
+static constexpr AudioCost AUDIO_COST_PLAY_SD_WAV    = { 0, 2 };   // per voice
+static constexpr AudioCost AUDIO_COST_NOTE_FREQUENCY = { 24, 0 };  // AUDIO_GUITARTUNER_BLOCKS
+static constexpr AudioCost AUDIO_COST_FFT256         = { 1, 0 };
+static constexpr AudioCost AUDIO_COST_FFT1024        = { 7, 0 };
+static constexpr AudioCost AUDIO_COST_ANALYZER       = { 0, 0 };   // peak, RMS, tone
+// GrumPedal objects
+static constexpr AudioCost AUDIO_COST_MIXER_FUSED    = { 0, 1 };
+static constexpr AudioCost AUDIO_COST_SAMPLE_POOL    = { 0, 1 };   // any number of voices
+static constexpr AudioCost AUDIO_COST_SYNTH_DRUM_POOL = { 0, 1 };  // any number of voices
+static constexpr AudioCost AUDIO_COST_BYPASS_FADE    = { 0, 1 };
+
+class AudioBudget
+{
+public:
+  constexpr AudioBudget() : heldBlocks(0), sentBlocks(0) {}
+
+  constexpr AudioBudget add(AudioCost cost, uint8_t count = 1) const
+  {
+    return AudioBudget(heldBlocks + cost.held * count, sentBlocks + cost.sent * count);
+  }
+  constexpr AudioBudget add(const AudioBudget &other) const
+  {
+    return AudioBudget(heldBlocks + other.heldBlocks, sentBlocks + other.sentBlocks);
+  }
+
+  constexpr uint16_t held() const { return heldBlocks; }
+  constexpr uint16_t sent() const { return sentBlocks; }
+  // Blocks in use at the worst point of a cycle
+  constexpr uint16_t need() const { return heldBlocks + sentBlocks; }
+  // The pool to give AudioMemory(): need() and `margin` percent, rounded up
+  constexpr uint16_t blocks(uint8_t margin = 25) const
+  {
+    return need() + (need() * margin + 99) / 100;
+  }
+
+private:
+  constexpr AudioBudget(uint16_t held, uint16_t sent) : heldBlocks(held), sentBlocks(sent) {}
+
+  uint16_t heldBlocks;
+  uint16_t sentBlocks;
+};
+
+#endif
@@ -0,0 +1,72 @@
+// AudioSampleRing<N> - the last N input samples, for analysis in loop()
+//
+// An AudioStream sink that only copies each block into a power-of-two
+// ring. Several analysers can then pull windows of different lengths
+// from the same audio at their own pace (see FFTEngine): a short FFT for
+// onsets every block and a long one for pitch every few blocks, without
+// a second copy of the input or any FFT work inside the audio interrupt.
+//
+// Usage:
+//   AudioSampleRing<2048> ring;
+//   AudioConnection c(highpass, 0, ring, 0);
+//   int16_t frame[1024];
+//   ring.snapshot(frame, 1024);     // newest 1024 samples, oldest first
+
+#ifndef audio_sample_ring_h_
+#define audio_sample_ring_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+
+template <int N>
+class AudioSampleRing : public AudioStream
+{
+  static_assert((N & (N - 1)) == 0 && N >= AUDIO_BLOCK_SAMPLES,
+                "ring size must be a power of two of at least one block");
+
+public:
+  AudioSampleRing() : AudioStream(1, inputQueueArray), written(0) {
+    memset(data, 0, sizeof(data));
+  }
+
+  static int size() { return N; }
+
+  // Samples received since start-up (wraps after ~27 hours)
+  uint32_t samplesWritten() const {
+    __disable_irq();
+    uint32_t n = written;
+    __enable_irq();
+    return n;
+  }
+
+  // Copy the newest len (<= N) samples, oldest first. Returns the value of
+  // samplesWritten() the copy corresponds to. Interrupts are held off for
+  // the copy only (two memcpy runs), so a block can't land half way.
+  uint32_t snapshot(int16_t *dst, int len) const {
+    if (len > N) len = N;
+    __disable_irq();
+    uint32_t end = written;
+    uint32_t start = (end - len) & (N - 1);
+    int first = min(len, N - (int)start);
+    memcpy(dst, data + start, first * sizeof(int16_t));
+    memcpy(dst + first, data, (len - first) * sizeof(int16_t));
+    __enable_irq();
+    return end;
+  }
+
+  virtual void update(void) {
+    audio_block_t *block = receiveReadOnly();
+    if (!block) return;
+    // N is a multiple of the block size, so a block never wraps
+    memcpy(data + (written & (N - 1)), block->data, sizeof(block->data));
+    written += AUDIO_BLOCK_SAMPLES;
+    release(block);
+  }
+
+private:
+  audio_block_t *inputQueueArray[1];
+  int16_t data[N];
+  volatile uint32_t written;
+};
+
+#endif
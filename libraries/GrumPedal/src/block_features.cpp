@@ -0,0 +1,64 @@
+#include "block_features.h"
+
+#if defined(__ARM_FEATURE_DSP)
+#include <arm_math.h>
+
+void blockFeatures(const int16_t *x, int n, int16_t prev, BlockFeatures &out)
+{
+  uint64_t energy = 0, hfc = 0;
+  uint32_t crossings = 0;
+  int32_t peak = 0;
+  uint32_t last = (uint32_t)(uint16_t)prev << 16;   // (_, prev)
+
+  for (int i = 0; i < n; i += 2) {
+    uint32_t cur;
+    memcpy(&cur, x + i, 4);                          // (x0, x1), one LDR
+    uint32_t shifted = __PKHBT(last >> 16, cur, 16);  // (prev, x0)
+
+    // Halving subtract can't overflow; the squares come out 4x small
+    uint32_t d = __SHSUB16(cur, shifted);
+    energy = __SMLALD(cur, cur, energy);
+    hfc = __SMLALD(d, d, hfc);
+    crossings += __builtin_popcount((cur ^ shifted) & 0x80008000);
+
+    int32_t a = (int16_t)cur, b = (int32_t)cur >> 16;
+    if (a < 0) a = -a;
+    if (b < 0) b = -b;
+    if (a > peak) peak = a;
+    if (b > peak) peak = b;
+    last = cur;
+  }
+
+  out.energy = energy;
+  out.hfc = hfc << 2;
+  out.zcr = crossings;
+  out.peak = peak > 32767 ? 32767 : peak;
+}
+
+#else
+
+void blockFeatures(const int16_t *x, int n, int16_t prev, BlockFeatures &out)
+{
+  uint64_t energy = 0, hfc = 0;
+  uint32_t crossings = 0;
+  int32_t peak = 0;
+  int32_t last = prev;
+
+  for (int i = 0; i < n; i++) {
+    int32_t s = x[i];
+    int32_t d = (s - last) >> 1;   // matches the SIMD halving subtract
+    energy += s * s;
+    hfc += d * d;
+    crossings += (s ^ last) < 0;
+    int32_t a = s < 0 ? -s : s;
+    if (a > peak) peak = a;
+    last = s;
+  }
+
+  out.energy = energy;
+  out.hfc = hfc << 2;
+  out.zcr = crossings;
+  out.peak = peak > 32767 ? 32767 : peak;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "block_monitor.h"
+
+AudioBlockProbe *AudioBlockProbe::list = nullptr;
+uint16_t AudioBlockProbe::lastUsed = 0;
+
+AudioBlockProbe::AudioBlockProbe(const char *name)
+  : AudioStream(0, NULL), label(name), held(0), heldMax(INT16_MIN), usedMax(0), link(nullptr)
+{
+  // No connections: nothing else would mark it for update_all()
+  active = true;
+  if (!list) {
+    list = this;
+  } else {
+    AudioBlockProbe *p = list;
+    while (p->link) p = p->link;
+    p->link = this;
+  }
+}
+
+void AudioBlockProbe::update(void)
+{
+  const uint16_t used = AudioMemoryUsage();
+  const int16_t d = (int16_t)(used - lastUsed);
+  lastUsed = used;
+  held = d;
+  if (d > heldMax) heldMax = d;
+  if (used > usedMax) usedMax = used;
+}
+
+void AudioBlockProbe::resetMax()
+{
+  __disable_irq();
+  heldMax = held;
+  usedMax = 0;
+  __enable_irq();
+}
+
+AudioBlockMonitor::AudioBlockMonitor(uint16_t poolBlocks, const AudioBudget &model, uint8_t warnPercent)
+  : pool(poolBlocks), budget(model), warnAt((poolBlocks * warnPercent + 99) / 100), warned(0)
+{
+  if (warnAt >= pool && pool > 1) warnAt = pool - 1;
+}
+
+void AudioBlockMonitor::printBudget(Print &out) const
+{
+  out.printf("Audio blocks: pool %u, model %u (%u held, %u in flight)\n", pool, budget.need(),
+             budget.held(), budget.sent());
+  if (pool < budget.need()) {
+    out.printf("WARNING: AudioMemory(%u) is below the model's %u blocks\n", pool, budget.need());
+  }
+}
+
+void AudioBlockMonitor::print(Print &out) const
+{
+  out.printf("Audio blocks: %u in use, peak %u of %u (model %u)\n", AudioMemoryUsage(),
+             AudioMemoryUsageMax(), pool, budget.need());
+  if (!AudioBlockProbe::first()) return;
+  out.println("  after        holds    max  pool max");
+  for (AudioBlockProbe *p = AudioBlockProbe::first(); p; p = p->next()) {
+    out.printf("  %-10s %7d %6d %8u\n", p->name(), p->holds(),
+               p->holdsMax() == INT16_MIN ? 0 : p->holdsMax(), p->poolMax());
+  }
+}
+
+bool AudioBlockMonitor::check(Print &out)
+{
+  const uint16_t peak = AudioMemoryUsageMax();
+  if (peak >= pool && warned < 2) {
+    warned = 2;
+    out.printf("WARNING: audio pool exhausted (%u of %u) - blocks were dropped\n", peak, pool);
+    print(out);
+    return true;
+  }
+  if (peak >= warnAt && warned < 1) {
+    warned = 1;
+    out.printf("WARNING: audio pool at %u of %u blocks\n", peak, pool);
+    print(out);
+    return true;
+  }
+  return false;
+}
+
+void AudioBlockMonitor::resetMax()
+{
+  AudioMemoryUsageMaxReset();
+  for (AudioBlockProbe *p = AudioBlockProbe::first(); p; p = p->next()) p->resetMax();
+  warned = 0;
+}
@@ -0,0 +1,89 @@
+// AudioBlockMonitor - who holds the audio blocks, and a warning before the
+// pool runs out
+//
+// The audio library counts pool blocks only in total (AudioMemoryUsage())
+// and keeps each object's queues private. Instead, an AudioBlockProbe is an
+// empty AudioStream declared straight after the objects it measures. The
+// library updates objects in construction order, so the probe runs right
+// after them every cycle and reads the pool: the change since the previous
+// probe is what that stage still holds (blocks it allocated or kept, less
+// those it consumed), and the count right after it is the pool at that
+// point of the cycle. Probes cost no blocks and a few cycles each.
+//
+//   Audio blocks: 11 in use, peak 14 of 19 (model 15)
+//     after        holds    max  pool max
+//     input            4      4        5
+//     drums            1      5        9
+//     output          -4     -1       11
+//
+// check() in loop() warns once the peak reaches warnPercent of the pool,
+// and again if it ever fills it (allocate() has failed by then and some
+// object lost a block). printBudget() states the pool against the
+// AudioBudget model at boot.
+//
+// Usage:
+//   AudioInputI2S audioInput;
+//   AudioBlockProbe inputBlocks("input");     // measures audioInput
+//   ...
+//   AudioBlockMonitor blocks(AUDIO_BUDGET.blocks(), AUDIO_BUDGET);
+//   AudioMemory(AUDIO_BUDGET.blocks());  blocks.printBudget(Serial);
+//   blocks.check(Serial);                     // every loop()
+//   if (Serial.read() == 'm') blocks.print(Serial);
+
+#ifndef block_monitor_h_
+#define block_monitor_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include "audio_budget.h"
+
+class AudioBlockProbe : public AudioStream
+{
+public:
+  // Measures the objects constructed since the previous probe (the first
+  // probe: since the last one, round the end of the update list)
+  explicit AudioBlockProbe(const char *name);
+
+  const char *name() const { return label; }
+  int16_t holds() const { return held; }
+  int16_t holdsMax() const { return heldMax; }
+  uint16_t poolMax() const { return usedMax; }
+  void resetMax();
+
+  static AudioBlockProbe *first() { return list; }
+  AudioBlockProbe *next() const { return link; }
+
+  virtual void update(void);
+
+private:
+  const char *label;
+  volatile int16_t held;
+  volatile int16_t heldMax;
+  volatile uint16_t usedMax;
+  AudioBlockProbe *link;
+
+  static AudioBlockProbe *list;
+  static uint16_t lastUsed;    // pool in use at the previous probe
+};
+
+class AudioBlockMonitor
+{
+public:
+  AudioBlockMonitor(uint16_t poolBlocks, const AudioBudget &model, uint8_t warnPercent = 90);
+
+  // Pool against the model; warns if AudioMemory() is below it
+  void printBudget(Print &out) const;
+  // Totals and each probe's stage
+  void print(Print &out) const;
+  // loop(): true when it printed a warning
+  bool check(Print &out);
+  void resetMax();
+
+private:
+  uint16_t pool;
+  AudioBudget budget;
+  uint16_t warnAt;
+  uint8_t warned;           // 0, 1 near the limit, 2 exhausted
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "bypass_fade.h"
+#include <dspinst.h>
+
+AudioEffectBypassFade::AudioEffectBypassFade()
+  : AudioStream(2, inputQueueArray), left(0), ramp(512), pending(false), ramping(false),
+    bypassed(true), numCords(0), cordsDown(false), resumed(0)
+{
+  bypassGain[0] = 65536;
+  bypassGain[1] = 0;
+  engagedGain[0] = 0;
+  engagedGain[1] = 65536;
+  for (int ch = 0; ch < 2; ch++) {
+    gain[ch] = target[ch] = bypassGain[ch];
+    step[ch] = 0;
+  }
+}
+
+int32_t AudioEffectBypassFade::toQ16(float g)
+{
+  return (int32_t)(constrain(g, 0.0f, 2.0f) * 65536.0f);
+}
+
+void AudioEffectBypassFade::retarget()
+{
+  const int32_t *g = bypassed ? bypassGain : engagedGain;
+  __disable_irq();
+  target[0] = g[0];
+  target[1] = g[1];
+  pending = true;
+  ramping = true;
+  __enable_irq();
+}
+
+void AudioEffectBypassFade::bypassLevels(float dry, float wet)
+{
+  bypassGain[0] = toQ16(dry);
+  bypassGain[1] = toQ16(wet);
+  retarget();
+}
+
+void AudioEffectBypassFade::engagedLevels(float dry, float wet)
+{
+  engagedGain[0] = toQ16(dry);
+  engagedGain[1] = toQ16(wet);
+  retarget();
+}
+
+void AudioEffectBypassFade::bypass(bool on)
+{
+  // Analysers get their input back before the drums fade in
+  if (!on && cordsDown) {
+    for (uint8_t i = 0; i < numCords; i++) cords[i]->connect();
+    cordsDown = false;
+    resumed = 0;
+  }
+  bypassed = on;
+  retarget();
+}
+
+bool AudioEffectBypassFade::suspend(AudioConnection &cord)
+{
+  if (numCords >= MAX_SUSPENDED) return false;
+  cords[numCords++] = &cord;
+  if (cordsDown) cord.disconnect();
+  return true;
+}
+
+bool AudioEffectBypassFade::service()
+{
+  if (cordsDown || !settled() || !numCords) return false;
+  for (uint8_t i = 0; i < numCords; i++) cords[i]->disconnect();
+  cordsDown = true;
+  return true;
+}
+
+void AudioEffectBypassFade::update(void)
+{
+  if (resumed < 0xFFFF) resumed++;
+  if (pending) {
+    // Start a ramp from the current gains, even mid-ramp
+    const uint32_t n = ramp;
+    for (int ch = 0; ch < 2; ch++) {
+      step[ch] = n ? (target[ch] - gain[ch]) / (int32_t)n : 0;
+      if (!n) gain[ch] = target[ch];
+    }
+    left = n;
+    pending = false;
+  }
+
+  audio_block_t *in[2] = { receiveReadOnly(0), receiveReadOnly(1) };
+
+  if (!left) {
+    ramping = false;
+    // Settled at unity dry and silent effect: pass the dry block through
+    if (gain[0] == 65536 && gain[1] == 0) {
+      if (in[1]) release(in[1]);
+      if (in[0]) {
+        transmit(in[0]);
+        release(in[0]);
+      }
+      return;
+    }
+  }
+
+  int32_t acc[AUDIO_BLOCK_SAMPLES];
+  bool any = false;
+  for (int ch = 0; ch < 2; ch++) {
+    int32_t g = gain[ch];
+    uint32_t l = left;
+    if (in[ch] && (g != 0 || l)) {
+      if (!any) memset(acc, 0, sizeof(acc));
+      any = true;
+      const int16_t *d = in[ch]->data;
+      if (!l) {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) acc[i] += signed_multiply_32x16b(g, d[i]);
+      } else {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+          acc[i] += signed_multiply_32x16b(g, d[i]);
+          if (l && --l == 0) {
+            g = target[ch];
+          } else if (l) {
+            g += step[ch];
+          }
+        }
+      }
+    } else if (l) {
+      // Nothing to scale, but the ramp still moves on
+      g = l > AUDIO_BLOCK_SAMPLES ? g + step[ch] * AUDIO_BLOCK_SAMPLES : target[ch];
+    }
+    gain[ch] = g;
+    if (in[ch]) release(in[ch]);
+  }
+  left = left > AUDIO_BLOCK_SAMPLES ? left - AUDIO_BLOCK_SAMPLES : 0;
+  if (!left) ramping = false;
+  if (!any) return;
+
+  audio_block_t *out = allocate();
+  if (!out) return;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    out->data[i] = signed_saturate_rshift(acc[i], 16, 0);
+  }
+  transmit(out);
+  release(out);
+}
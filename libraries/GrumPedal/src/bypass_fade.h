@@ -0,0 +1,96 @@
+// AudioEffectBypassFade - click-free bypass between dry guitar and drums
+//
+// Input 0 is the dry signal, input 1 the effect (the drum voices). Each
+// side has a gain for bypass and one for engaged, and bypass() moves both
+// from wherever they are to the other pair along a per-sample linear
+// ramp of rampSamples() samples, so a switch mid-ramp reverses smoothly
+// instead of jumping. Once the ramp is done the stage costs next to
+// nothing: unity dry is passed through without a copy, and a silent side
+// is released unread.
+//
+// Patch cords registered with suspend() are disconnected by service()
+// once the stage is fully bypassed, and reconnected by bypass(false)
+// before the ramp back starts; route the analysers' inputs through them.
+// Without input their update()s return at once, and with no trigger
+// running the voices have finished by then, so the drum side of the graph
+// draws no CPU in bypass.
+//
+// An analyser that keeps a window of past blocks picks up where it left
+// off. AudioAnalyzeNoteFrequency holds its 24 (AUDIO_GUITARTUNER_BLOCKS)
+// through the bypass, and its first results after reconnecting are worked
+// out partly on audio from before it. begin() can't clear them (it drops
+// the list without releasing the blocks), so read and discard its results
+// until resumedBlocks() has reached that window.
+//
+// Usage:
+//   AudioEffectBypassFade bypassStage;
+//   AudioConnection dry(audioInput, 0, bypassStage, 0);
+//   AudioConnection wet(drumPool, 0, bypassStage, 1);
+//   bypassStage.engagedLevels(0.0f, 0.9f);   // drums only when engaged
+//   bypassStage.suspend(toNotefreq);
+//   bypassStage.bypass(true);
+//   bypassStage.service();                   // in loop()
+//   if (bypassStage.resumedBlocks() < AUDIO_GUITARTUNER_BLOCKS) ...  // stale
+
+#ifndef bypass_fade_h_
+#define bypass_fade_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+
+class AudioEffectBypassFade : public AudioStream
+{
+public:
+  static const uint8_t MAX_SUSPENDED = 8;
+
+  AudioEffectBypassFade();
+
+  // Gains of the dry and effect inputs in each state (0..2). Defaults:
+  // bypass 1 / 0, engaged 0 / 1. Applied with a ramp.
+  void bypassLevels(float dry, float wet);
+  void engagedLevels(float dry, float wet);
+
+  // Ramp length for every later change; 0 switches at the next block.
+  void rampSamples(uint32_t n) { ramp = n; }
+
+  void bypass(bool on);
+  bool isBypassed() const { return bypassed; }
+
+  // Bypass requested and the ramp to it finished.
+  bool settled() const { return !ramping && bypassed; }
+
+  // Cords to drop while fully bypassed.
+  bool suspend(AudioConnection &cord);
+  bool suspended() const { return cordsDown; }
+  // Blocks since bypass(false) reconnected them, counting up to 65535
+  uint16_t resumedBlocks() const { return resumed; }
+
+  // loop() side: disconnect the suspend() cords once settled(). True on
+  // the call that did, so the caller can stop its voices too.
+  bool service();
+
+  virtual void update(void);
+
+private:
+  static int32_t toQ16(float gain);
+  void retarget();
+
+  audio_block_t *inputQueueArray[2];
+  int32_t bypassGain[2];         // Q16, 65536 = unity
+  int32_t engagedGain[2];
+  int32_t gain[2];               // now (ISR)
+  int32_t target[2];
+  int32_t step[2];               // per sample, during a ramp
+  uint32_t left;                 // samples of ramp to go
+  volatile uint32_t ramp;
+  volatile bool pending;         // new targets for the ISR
+  volatile bool ramping;
+  bool bypassed;
+
+  AudioConnection *cords[MAX_SUSPENDED];
+  uint8_t numCords;
+  bool cordsDown;
+  volatile uint16_t resumed;
+};
+
+#endif
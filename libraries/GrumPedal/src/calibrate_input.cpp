@@ -0,0 +1,276 @@
+#include "calibrate_input.h"
+#include <EEPROM.h>
+#include <stddef.h>
+#include "block_features.h"
+#include "drum_kit.h"
+
+static const uint32_t SETTLE_BLOCKS = 32;   // ~93 ms after the start or a level change
+static const uint8_t PLUCK_BLOCKS = 12;     // ~35 ms: the attack peaks well inside it
+static const uint8_t MAX_LINE_IN = 15;
+
+static uint32_t checksum(const InputCalibration &c)
+{
+  return DrumKit::crc32((const uint8_t *)&c, offsetof(InputCalibration, crc));
+}
+
+bool InputCalibration::valid() const
+{
+  return magic == CALIBRATION_MAGIC && version == CALIBRATION_VERSION &&
+         lineIn <= MAX_LINE_IN && crc == checksum(*this);
+}
+
+bool InputCalibration::load(int address)
+{
+  InputCalibration stored;
+  EEPROM.get(address, stored);
+  if (!stored.valid()) return false;
+  *this = stored;
+  return true;
+}
+
+void InputCalibration::save(int address)
+{
+  magic = CALIBRATION_MAGIC;
+  version = CALIBRATION_VERSION;
+  crc = checksum(*this);
+  EEPROM.put(address, *this);
+}
+
+void InputCalibration::print(Print &out) const
+{
+  out.printf("Input: line-in %u, noise %.4f peak %.5f rms, %u plucks %.3f..%.3f, gate %.4f, band floor %.4f\n",
+             lineIn, noisePeak, noiseRms, plucks, softPeak, pluckPeak, gate, bandFloor);
+}
+
+AudioCalibrateInput::AudioCalibrateInput(void)
+  : AudioStream(1, inputQueueArray)
+{
+  codec = nullptr;
+  out = nullptr;
+  memset(&cal, 0, sizeof(cal));
+  state = IDLE;
+  startLevel = level = 0;
+  wanted = 0;
+  retries = 0;
+  noiseBlocks = timeoutBlocks = 0;
+  lastReported = 0;
+  blockCount = 0;
+  noiseCount = 0;
+  noisePower = noiseMax = 0.0f;
+  pluckThreshold = 1.0f;
+  armed = inPluck = false;
+  pluckBlocks = 0;
+  pluckMax = prevPeak = 0.0f;
+  numPlucks = 0;
+  clipped = 0;
+}
+
+uint32_t AudioCalibrateInput::msToBlocks(uint32_t ms)
+{
+  return (uint32_t)(ms * (AUDIO_SAMPLE_RATE_EXACT / 1000.0f) / AUDIO_BLOCK_SAMPLES) + 1;
+}
+
+float AudioCalibrateInput::stepGain(int steps)
+{
+  return powf(10.0f, steps * STEP_DB / 20.0f);
+}
+
+void AudioCalibrateInput::begin(AudioControlSGTL5000 &c, uint8_t lineIn, Print &o,
+                                uint8_t plucks, uint16_t noiseMs, uint16_t timeoutMs)
+{
+  codec = &c;
+  out = &o;
+  startLevel = level = min(lineIn, MAX_LINE_IN);
+  wanted = plucks < MIN_PLUCKS ? MIN_PLUCKS : plucks > MAX_PLUCKS ? MAX_PLUCKS : plucks;
+  retries = 0;
+  noiseBlocks = msToBlocks(noiseMs);
+  timeoutBlocks = msToBlocks(timeoutMs);
+  memset(&cal, 0, sizeof(cal));
+  codec->lineInLevel(level);
+
+  __disable_irq();
+  blockCount = 0;
+  noiseCount = 0;
+  noisePower = noiseMax = 0.0f;
+  state = NOISE;
+  __enable_irq();
+
+  out->printf("Calibrating input at line-in %u: mute the strings for %u s\n",
+              level, (unsigned)((noiseMs + 999) / 1000));
+}
+
+void AudioCalibrateInput::startPlucks(void)
+{
+  __disable_irq();
+  blockCount = 0;
+  numPlucks = 0;
+  clipped = 0;
+  armed = true;
+  inPluck = false;
+  prevPeak = 1.0f;
+  state = PLUCKS;
+  __enable_irq();
+  lastReported = 0;
+
+  out->printf("Now pluck each string in turn, %u plucks in all, and let each ring for a second\n",
+              wanted);
+}
+
+void AudioCalibrateInput::cancel(void)
+{
+  if (state == IDLE) return;
+  state = IDLE;
+  codec->lineInLevel(startLevel);
+  out->println("Calibration cancelled");
+}
+
+AudioCalibrateInput::State AudioCalibrateInput::service(void)
+{
+  switch (state) {
+    case NOISE: {
+      if (blockCount < SETTLE_BLOCKS + noiseBlocks) return NOISE;
+      __disable_irq();
+      const uint32_t n = noiseCount;
+      const float power = noisePower;
+      const float peak = noiseMax;
+      __enable_irq();
+      cal.noisePeak = peak;
+      cal.noiseRms = sqrtf(power / (n ? n : 1));
+      // A pluck has to stand well clear of the loudest noise
+      pluckThreshold = max(peak * 4.0f, 0.005f);
+      out->printf("Noise: %.4f peak, %.5f rms\n", cal.noisePeak, cal.noiseRms);
+      startPlucks();
+      return PLUCKS;
+    }
+
+    case PLUCKS: {
+      const uint8_t n = numPlucks;
+      while (lastReported < n) {
+        const float p = peaks[lastReported++];
+        out->printf("  pluck %u: %.3f%s\n", lastReported, p, p >= CLIP_PEAK ? " (clipped)" : "");
+      }
+      if (n < wanted && blockCount < SETTLE_BLOCKS + timeoutBlocks) return PLUCKS;
+      return finish();
+    }
+
+    default:
+      return state;
+  }
+}
+
+AudioCalibrateInput::State AudioCalibrateInput::finish(void)
+{
+  state = IDLE;
+  const uint8_t n = numPlucks;
+
+  // Clipped plucks were louder than anything the ADC can say; take 6 dB
+  // off and ask again
+  if (clipped && level > 0 && retries < MAX_RETRIES) {
+    retries++;
+    const uint8_t next = level > 4 ? level - 4 : 0;
+    const float g = stepGain(next - level);
+    cal.noisePeak *= g;
+    cal.noiseRms *= g;
+    pluckThreshold = max(pluckThreshold * g, 0.005f);
+    out->printf("%u of %u plucks clipped: line-in %u -> %u\n", clipped, n, level, next);
+    level = next;
+    codec->lineInLevel(level);
+    startPlucks();
+    return PLUCKS;
+  }
+
+  if (n < MIN_PLUCKS) {
+    codec->lineInLevel(startLevel);
+    out->printf("Calibration failed: %u plucks heard, %u needed\n", n, MIN_PLUCKS);
+    return FAILED;
+  }
+
+  float loudest = 0.0f, softest = 1.0f;
+  for (uint8_t i = 0; i < n; i++) {
+    if (peaks[i] > loudest) loudest = peaks[i];
+    if (peaks[i] < softest) softest = peaks[i];
+  }
+
+  // Round down: the loudest pluck stays at or under the target
+  const int steps = (int)floorf(20.0f * log10f(TARGET_PEAK / loudest) / STEP_DB);
+  const uint8_t next = constrain(level + steps, 0, (int)MAX_LINE_IN);
+  const float g = stepGain(next - level);
+  level = next;
+  codec->lineInLevel(level);
+
+  cal.lineIn = level;
+  cal.plucks = n;
+  cal.noisePeak *= g;
+  cal.noiseRms *= g;
+  cal.pluckPeak = loudest * g;
+  cal.softPeak = softest * g;
+  // 6 dB over the idle input. The in-band floor is against the noise RMS
+  // at the band level's sine-peak scale; the whole noise is an upper bound
+  // for what one band passes.
+  cal.gate = max(cal.noisePeak * 2.0f, 0.0001f);
+  cal.bandFloor = max(cal.noiseRms * 2.83f, 0.0005f);
+  cal.magic = CALIBRATION_MAGIC;
+  cal.version = CALIBRATION_VERSION;
+  cal.crc = checksum(cal);
+
+  cal.print(*out);
+  if (clipped) {
+    out->printf("Warning: still clipping at line-in %u; turn the guitar down\n", level);
+  }
+  if (cal.gate > cal.softPeak * 0.5f) {
+    out->println("Warning: the quietest pluck is close to the noise; check the cable and pickup");
+  }
+  return DONE;
+}
+
+void AudioCalibrateInput::update(void)
+{
+  audio_block_t *block = receiveReadOnly();
+  if (!block) return;
+  const State s = state;
+  if (s != NOISE && s != PLUCKS) {
+    release(block);
+    return;
+  }
+
+  BlockFeatures f;
+  blockFeatures(block->data, AUDIO_BLOCK_SAMPLES, block->data[0], f);
+  release(block);
+  const float peak = f.peak * (1.0f / 32768.0f);
+  const float rms = f.rms(AUDIO_BLOCK_SAMPLES);
+
+  // Let the codec and the high-pass settle after a level change
+  if (++blockCount <= SETTLE_BLOCKS) return;
+
+  if (s == NOISE) {
+    noiseCount++;
+    noisePower += rms * rms;
+    if (peak > noiseMax) noiseMax = peak;
+    return;
+  }
+
+  // One pluck is the highest block peak of its attack. Plucks on a
+  // string still ringing count too: once it has died down to half the
+  // last pluck, a block that jumps 1.5x over the one before is a new one.
+  const float before = prevPeak;
+  prevPeak = peak;
+  if (inPluck) {
+    if (peak > pluckMax) pluckMax = peak;
+    if (++pluckBlocks < PLUCK_BLOCKS) return;
+    peaks[numPlucks] = pluckMax;
+    if (pluckMax >= CLIP_PEAK) clipped++;
+    numPlucks++;
+    inPluck = false;
+    armed = false;
+    return;
+  }
+  if (!armed) {
+    if (peak < peaks[numPlucks - 1] * 0.5f) armed = true;
+    return;
+  }
+  if (peak > pluckThreshold && peak > before * 1.5f && numPlucks < MAX_PLUCKS) {
+    inPluck = true;
+    pluckMax = peak;
+    pluckBlocks = 1;
+  }
+}
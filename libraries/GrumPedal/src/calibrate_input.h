@@ -0,0 +1,133 @@
+// AudioCalibrateInput - noise floor, gate and input gain from the guitar
+//
+// The onset thresholds in the sketches were tuned by ear on one guitar
+// into one SGTL5000 at lineInLevel(10). A hotter pickup clips the ADC (and
+// ends up in the clip emergency mode), a quieter one or a noisy cable sits
+// on the wrong side of noiseFloor. This object measures instead: a few
+// seconds of the idle input with the strings muted, then a few test plucks
+// on every string. From those it picks the line-in level that puts the
+// loudest pluck near TARGET_PEAK (about -6 dBFS, room for a hard strum
+// without clipping), then a gate above the noise at that level for
+// AudioAnalyzePluckTrigger and an in-band floor for AudioAnalyzeBandOnsets.
+// A test pluck that clips says nothing about how loud it really was, so
+// the level drops by 6 dB and the plucks are asked for again.
+//
+// The measuring runs in update() on the block peak and RMS; everything
+// else, including the codec writes and the prompts, happens in service()
+// from loop(), which never blocks. The result is an InputCalibration:
+// a small versioned struct with a CRC that save() puts in EEPROM and
+// load() checks at boot, so the pedal only calibrates when asked or when
+// nothing valid is stored. Keep the triggers quiet while active(): the
+// test plucks are not meant to play drums, and the level changes under
+// them.
+//
+// The SGTL5000 line input goes from 3.12 Vpp full scale at level 0 to
+// 0.24 Vpp at 15, about 1.5 dB a step. micGain() only applies to the mic
+// input and is left alone.
+//
+// Usage:
+//   AudioCalibrateInput calibrator;
+//   AudioConnection c(highpass, 0, calibrator, 0);
+//   InputCalibration cal;
+//   if (!cal.load()) calibrator.begin(audioShield, 10, Serial);
+//   ...
+//   if (calibrator.service() == AudioCalibrateInput::DONE) {   // loop()
+//     cal = calibrator.result();
+//     cal.save();
+//     pluck.thresholds(cal.gate, ...);
+//   }
+
+#ifndef calibrate_input_h_
+#define calibrate_input_h_
+
+#include <Arduino.h>
+#include <Audio.h>
+
+struct InputCalibration {
+  uint32_t magic;        // CALIBRATION_MAGIC
+  uint16_t version;      // CALIBRATION_VERSION
+  uint8_t  lineIn;       // SGTL5000 lineInLevel(), 0..15
+  uint8_t  plucks;       // test plucks it was measured from
+  float    noisePeak;    // idle input at lineIn, block peak 0..1
+  float    noiseRms;
+  float    pluckPeak;    // loudest and quietest test pluck at lineIn
+  float    softPeak;
+  float    gate;         // AudioAnalyzePluckTrigger noiseFloor (block peak)
+  float    bandFloor;    // AudioAnalyzeBandOnsets floor (band level)
+  uint32_t crc;          // CRC-32 of everything before it
+
+  bool valid() const;
+  // EEPROM at address; load() leaves *this alone unless the copy is valid.
+  bool load(int address = 0);
+  void save(int address = 0);
+  void print(Print &out) const;
+};
+
+static const uint32_t CALIBRATION_MAGIC = 0x43495047;   // "GPIC"
+static const uint16_t CALIBRATION_VERSION = 1;
+
+class AudioCalibrateInput : public AudioStream
+{
+public:
+  enum State { IDLE, NOISE, PLUCKS, DONE, FAILED };
+
+  static const uint8_t MAX_PLUCKS = 36;
+  static const uint8_t MIN_PLUCKS = 3;
+  static const uint8_t MAX_RETRIES = 3;    // clipped rounds before giving up
+  static constexpr float TARGET_PEAK = 0.5f;
+  static constexpr float CLIP_PEAK = 0.98f;
+  static constexpr float STEP_DB = 1.5f;
+
+  AudioCalibrateInput(void);
+
+  // Start at the codec's current line-in level: noiseMs of silence, then
+  // plucks test plucks within timeoutMs. Prompts and the result go to out.
+  void begin(AudioControlSGTL5000 &codec, uint8_t lineIn, Print &out,
+             uint8_t plucks = 12, uint16_t noiseMs = 3000, uint16_t timeoutMs = 30000);
+  // Stop and put the codec back where begin() found it.
+  void cancel(void);
+
+  // Call from loop(). DONE and FAILED are returned once; the state is
+  // IDLE again after that.
+  State service(void);
+  bool active(void) const { return state != IDLE; }
+  uint8_t plucksHeard(void) const { return numPlucks; }
+
+  const InputCalibration &result(void) const { return cal; }
+
+  virtual void update(void);
+
+private:
+  void startPlucks(void);
+  State finish(void);
+  static uint32_t msToBlocks(uint32_t ms);
+  static float stepGain(int steps);
+
+  audio_block_t *inputQueueArray[1];
+  AudioControlSGTL5000 *codec;
+  Print *out;
+  InputCalibration cal;
+
+  volatile State state;
+  uint8_t startLevel, level;
+  uint8_t wanted;
+  uint8_t retries;
+  uint32_t noiseBlocks, timeoutBlocks;
+  uint8_t lastReported;
+
+  // Written by update()
+  volatile uint32_t blockCount;
+  uint32_t noiseCount;
+  float noisePower;      // sum of block RMS^2
+  float noiseMax;
+  float pluckThreshold;
+  bool armed, inPluck;
+  uint8_t pluckBlocks;
+  float pluckMax;
+  float prevPeak;       // block before this one
+  volatile uint8_t numPlucks;
+  volatile uint8_t clipped;
+  float peaks[MAX_PLUCKS];
+};
+
+#endif
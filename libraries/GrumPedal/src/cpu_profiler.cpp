@@ -0,0 +1,100 @@
+#include "cpu_profiler.h"
+
+#if defined(F_CPU_ACTUAL)
+  #define PROFILER_CPU_HZ F_CPU_ACTUAL
+#else
+  #define PROFILER_CPU_HZ F_CPU
+#endif
+
+CpuProfiler::CpuProfiler()
+{
+  numObjects = 0;
+  numScopes = 0;
+  periodMs = 2000;
+  periodStart = ARM_DWT_CYCCNT;
+  lastReport = 0;
+  enabled = true;
+}
+
+void CpuProfiler::begin(uint32_t ms)
+{
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  periodMs = ms;
+  periodStart = ARM_DWT_CYCCNT;
+  lastReport = millis();
+}
+
+void CpuProfiler::addObject(const char *name, AudioStream &obj)
+{
+  if (numObjects >= MAX_OBJECTS) return;
+  objects[numObjects].name = name;
+  objects[numObjects].obj = &obj;
+  numObjects++;
+}
+
+uint8_t CpuProfiler::addScope(const char *name)
+{
+  // Out of slots: share the last one rather than write past the table
+  if (numScopes >= MAX_SCOPES) return MAX_SCOPES - 1;
+  Scope &s = scopes[numScopes];
+  s.name = name;
+  s.calls = 0;
+  s.cycles = 0;
+  s.maxCycles = 0;
+  return numScopes++;
+}
+
+void CpuProfiler::record(uint8_t scope, uint32_t cycles)
+{
+  if (!enabled || scope >= numScopes) return;
+  Scope &s = scopes[scope];
+  s.calls++;
+  s.cycles += cycles;
+  if (cycles > s.maxCycles) s.maxCycles = cycles;
+}
+
+// processorUsage() is a percentage of one block period
+uint32_t CpuProfiler::percentToCycles(float percent)
+{
+  return (uint32_t)(percent * 0.01f * PROFILER_CPU_HZ * AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT);
+}
+
+bool CpuProfiler::report(Print &out)
+{
+  uint32_t now = millis();
+  if (!enabled || now - lastReport < periodMs) return false;
+  lastReport = now;
+
+  uint32_t end = ARM_DWT_CYCCNT;
+  float elapsed = (float)(end - periodStart);
+  periodStart = end;
+
+  out.printf("CPU %luus/block  audio %.1f%% max %.1f%%  mem %u max %u\n",
+             (unsigned long)(AUDIO_BLOCK_SAMPLES * 1000000.0f / AUDIO_SAMPLE_RATE_EXACT),
+             AudioProcessorUsage(), AudioProcessorUsageMax(),
+             AudioMemoryUsage(), AudioMemoryUsageMax());
+  AudioProcessorUsageMaxReset();
+
+  if (numObjects) out.println("  object       cyc/blk     max   %blk");
+  for (uint8_t i = 0; i < numObjects; i++) {
+    AudioStream *obj = objects[i].obj;
+    float usage = obj->processorUsage();
+    out.printf("  %-10s %9lu %7lu %6.1f\n", objects[i].name,
+               (unsigned long)percentToCycles(usage),
+               (unsigned long)percentToCycles(obj->processorUsageMax()), usage);
+    obj->processorUsageMaxReset();
+  }
+
+  if (numScopes) out.println("  scope        calls  cyc/call     max  %loop");
+  for (uint8_t i = 0; i < numScopes; i++) {
+    Scope &s = scopes[i];
+    out.printf("  %-10s %7lu %9lu %7lu %6.1f\n", s.name, (unsigned long)s.calls,
+               (unsigned long)(s.calls ? s.cycles / s.calls : 0),
+               (unsigned long)s.maxCycles, elapsed > 0 ? s.cycles * 100.0f / elapsed : 0.0f);
+    s.calls = 0;
+    s.cycles = 0;
+    s.maxCycles = 0;
+  }
+  return true;
+}
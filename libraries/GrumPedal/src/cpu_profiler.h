@@ -0,0 +1,101 @@
+// CpuProfiler - per-object and per-scope CPU table
+//
+// AudioProcessorUsage() is one number for the whole graph. The audio
+// library already times every AudioStream::update(); this collects those
+// per-object figures by name, adds timed scopes for code in loop() (the
+// FFT and onset detectors), and prints both as one compact table every
+// period, so the stage to cut is obvious before blocks start dropping.
+//
+//   CPU 2902us/block  audio 14.2% max 21.0%  mem 9 max 12
+//     object       cyc/blk     max   %blk
+//     highpass        4912    5120    0.3
+//     pluck          21504   24576    1.2
+//     scope          calls  cyc/call     max  %loop
+//     detectOn         344      1210    2980    0.4
+//
+// Audio figures are the library's own (64 cycle resolution, last block
+// and max since the last table). Scopes count every call in the period;
+// %loop is their share of wall time, so loop() headroom is 100 minus the
+// sum.
+//
+// Usage:
+//   CpuProfiler cpu;
+//   cpu.begin(2000);
+//   cpu.addObject("fft", fft);
+//   const uint8_t SCOPE_ONSET = cpu.addScope("onset");
+//   { CpuScope s(cpu, SCOPE_ONSET); detectOnset(...); }
+//   cpu.report(Serial);           // in loop(); prints once per period
+
+#ifndef cpu_profiler_h_
+#define cpu_profiler_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+
+class CpuProfiler
+{
+public:
+  static const uint8_t MAX_OBJECTS = 16;
+  static const uint8_t MAX_SCOPES = 8;
+
+  CpuProfiler();
+
+  // Names are not copied; pass string literals. Objects past MAX_OBJECTS
+  // are ignored, scopes past MAX_SCOPES share the last slot.
+  void addObject(const char *name, AudioStream &obj);
+  uint8_t addScope(const char *name);
+
+  // Start the cycle counter and the first period; call from setup().
+  void begin(uint32_t periodMs = 2000);
+
+  // Report period, at most ~7 s (the cycle counter wraps at 600 MHz).
+  void period(uint32_t ms) { periodMs = ms; }
+  void enable(bool on) { enabled = on; }
+  bool isEnabled() const { return enabled; }
+
+  // Called by CpuScope; loop() code only, not from the audio ISR.
+  void record(uint8_t scope, uint32_t cycles);
+
+  // Print the table and start a new period once periodMs has passed.
+  // Returns true when a table was printed.
+  bool report(Print &out);
+
+private:
+  struct Object {
+    const char *name;
+    AudioStream *obj;
+  };
+
+  struct Scope {
+    const char *name;
+    uint32_t calls;
+    uint64_t cycles;
+    uint32_t maxCycles;
+  };
+
+  static uint32_t percentToCycles(float percent);
+
+  Object objects[MAX_OBJECTS];
+  uint8_t numObjects;
+  Scope scopes[MAX_SCOPES];
+  uint8_t numScopes;
+  uint32_t periodMs;
+  uint32_t periodStart;     // ARM_DWT_CYCCNT
+  uint32_t lastReport;      // millis()
+  bool enabled;
+};
+
+// Times the enclosing block into one of the profiler's scopes.
+class CpuScope
+{
+public:
+  CpuScope(CpuProfiler &p, uint8_t scope) : prof(p), id(scope), start(ARM_DWT_CYCCNT) {}
+  ~CpuScope() { prof.record(id, ARM_DWT_CYCCNT - start); }
+
+private:
+  CpuProfiler &prof;
+  uint8_t id;
+  uint32_t start;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "drum_kit.h"
+
+static_assert(sizeof(KitHeader) == 32, "KitHeader is part of the image format");
+static_assert(sizeof(KitEntry) == 32, "KitEntry is part of the image format");
+
+// Same allocator as DrumSample: PSRAM if fitted, else the heap
+#if defined(__IMXRT1062__)
+  #define KIT_MALLOC(n) extmem_malloc(n)
+  #define KIT_FREE(p)   extmem_free(p)
+#else
+  #define KIT_MALLOC(n) malloc(n)
+  #define KIT_FREE(p)   free(p)
+#endif
+
+void *DrumKit::allocImage(uint32_t size)
+{
+  return KIT_MALLOC(size);
+}
+
+void DrumKit::freeImage(void *buf)
+{
+  if (buf) KIT_FREE(buf);
+}
+
+// Reflected CRC-32 (zlib / PNG), four bits at a time
+uint32_t DrumKit::crc32(const uint8_t *data, uint32_t len, uint32_t crc)
+{
+  static const uint32_t TABLE[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc = TABLE[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+    crc = TABLE[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+void DrumKit::detach()
+{
+  for (uint8_t i = 0; i < numSamples; i++) samples[i].unload();
+  image = nullptr;
+  numSamples = 0;
+}
+
+bool DrumKit::attach(const void *kitImage, uint32_t capacity)
+{
+  detach();
+  err = nullptr;
+  const uint8_t *base = (const uint8_t *)kitImage;
+  const KitHeader *h = (const KitHeader *)base;
+  if (!base || ((uintptr_t)base & 3)) { err = "image not 4 byte aligned"; return false; }
+  if (capacity < sizeof(KitHeader)) { err = "truncated header"; return false; }
+  if (h->magic != KIT_MAGIC) { err = "not a kit image"; return false; }
+  if (h->version != KIT_VERSION) { err = "unsupported kit version"; return false; }
+  if (h->bytes > capacity) { err = "image larger than its buffer"; return false; }
+  if (h->count > MAX_SAMPLES) { err = "too many samples"; return false; }
+  if (sizeof(KitHeader) + h->count * sizeof(KitEntry) > h->bytes) { err = "truncated index"; return false; }
+
+  const KitEntry *e = (const KitEntry *)(base + sizeof(KitHeader));
+  for (uint16_t i = 0; i < h->count; i++) {
+    // Bounds and alignment, in 64 bits so a huge count can't wrap past
+    // the check; h->bytes is already within capacity. The PCM itself is
+    // taken as is
+    uint64_t end = (uint64_t)e[i].data + 4 + (uint64_t)e[i].samples * 2;
+    uint64_t envEnd = (uint64_t)e[i].envelope +
+                      ((uint64_t)e[i].samples + AUDIO_BLOCK_SAMPLES - 1) / AUDIO_BLOCK_SAMPLES;
+    if ((e[i].data & 3) || end > h->bytes || envEnd > h->bytes || e[i].name[15] != 0) {
+      err = "bad kit entry";
+      detach();
+      return false;
+    }
+    // The sample's own header word must agree with the index
+    const unsigned int *data = (const unsigned int *)(base + e[i].data);
+    if ((data[0] & 0xFFFFFF) != e[i].samples) {
+      err = "sample length does not match index";
+      detach();
+      return false;
+    }
+    if (!samples[i].attach(e[i].name, data, base + e[i].envelope)) {
+      err = samples[i].error();
+      detach();
+      return false;
+    }
+  }
+  image = base;
+  numSamples = h->count;
+  return true;
+}
+
+bool DrumKit::verify() const
+{
+  if (!image) return false;
+  const KitHeader *h = header();
+  return crc32(image + sizeof(KitHeader), h->bytes - sizeof(KitHeader)) == h->crc;
+}
+
+bool DrumKit::assign(DrumVoiceManager &voices) const
+{
+  if (!image) return false;
+  const KitEntry *e = entries();
+  bool cleared[DrumVoiceManager::MAX_DRUMS] = {};
+  for (uint8_t i = 0; i < numSamples; i++) {
+    uint8_t d = e[i].drum;
+    if (d >= DrumVoiceManager::MAX_DRUMS) continue;
+    if (!cleared[d]) {
+      voices.clearLayers(d);
+      cleared[d] = true;
+    }
+    voices.addLayer(d, samples[i], e[i].minVelocity * (1.0f / 255.0f));
+  }
+  return true;
+}
+
+const char *DrumKit::name() const
+{
+  return image ? header()->name : "";
+}
+
+const DrumSample *DrumKit::find(const char *fileName) const
+{
+  for (uint8_t i = 0; i < numSamples; i++) {
+    if (strcmp(samples[i].name(), fileName) == 0) return &samples[i];
+  }
+  return nullptr;
+}
+
+uint32_t DrumKit::bytes() const
+{
+  return image ? header()->bytes : 0;
+}
+
+void DrumKit::printInfo(Print &out) const
+{
+  if (!image) {
+    out.printf("kit not attached (%s)\n", err ? err : "no image");
+    return;
+  }
+  out.printf("kit %.16s: %u samples, %lu bytes at 0x%08lX\n", name(), numSamples,
+             (unsigned long)bytes(), (unsigned long)(uintptr_t)image);
+  const KitEntry *e = entries();
+  for (uint8_t i = 0; i < numSamples; i++) {
+    out.printf("  drum %u  >= %.2f  ", e[i].drum, e[i].minVelocity * (1.0f / 255.0f));
+    samples[i].printInfo(out);
+  }
+}
@@ -0,0 +1,137 @@
+// DrumKit - a packed kit image played straight from memory
+//
+// tools/kitpack turns a set of WAVs into one .kit image, already converted
+// to the DrumSample RAM format: 44.1 kHz mono int16 behind an
+// AudioPlayMemory header word, padded to whole blocks, with the voice
+// stealing envelope next to it. attach() checks the header against the
+// bytes actually there and points one DrumSample per entry into the image; nothing is decoded or copied, so the
+// image can sit wherever the CPU can read it:
+//
+//   - flash chip on the Teensy 4.1 QSPI pads, memory mapped by FlexSPI2
+//   - program flash, as the const array kitpack --header writes
+//   - RAM or PSRAM, read in one go from SD or SerialFlash (readImage())
+//
+// Each entry also names its drum and velocity layer, so assign() is the
+// whole kit change: the voice manager's layers are swapped for this kit's.
+// Voices already sounding finish on the old image, which must stay valid.
+//
+// Image layout, little endian, every offset from the start of the image
+// and 4 byte aligned:
+//
+//   KitHeader                     magic "GKIT", version, entry count,
+//                                 image size, CRC-32 of everything after it
+//   KitEntry[count]               name, offsets, drum, layer velocity
+//   per entry: (0x81 << 24 | samples), PCM, envelope (one byte per block)
+//
+// Usage:
+//   DrumKit kit;
+//   if (kit.attach(image, imageBytes) && kit.assign(voices)) kit.printInfo(Serial);
+
+#ifndef drum_kit_h_
+#define drum_kit_h_
+
+#include <Arduino.h>
+#include "drum_sample.h"
+#include "drum_voices.h"
+
+struct KitHeader {
+  uint32_t magic;        // KIT_MAGIC
+  uint16_t version;      // KIT_VERSION
+  uint16_t count;        // entries
+  uint32_t bytes;        // whole image
+  uint32_t crc;          // CRC-32 of bytes [sizeof(KitHeader), bytes)
+  char     name[16];     // kit name, NUL padded
+};
+
+struct KitEntry {
+  char     name[16];     // file name the sample came from, NUL terminated
+  uint32_t data;         // offset of the AudioPlayMemory header word
+  uint32_t envelope;     // offset of the envelope bytes
+  uint32_t samples;
+  uint8_t  drum;         // DrumVoiceManager drum index
+  uint8_t  minVelocity;  // layer threshold, 0..255 = 0..1
+  uint8_t  reserved[2];
+};
+
+static const uint32_t KIT_MAGIC = 0x54494B47;   // "GKIT"
+static const uint16_t KIT_VERSION = 1;
+
+class DrumKit
+{
+public:
+  static const uint8_t MAX_SAMPLES = DrumVoiceManager::MAX_DRUMS * DrumVoiceManager::MAX_LAYERS;
+
+  DrumKit() : image(nullptr), numSamples(0), err(nullptr) {}
+
+  // Point at a kit image of at most capacity readable bytes (the buffer
+  // readImage() filled, the flash window); checks the header fits in it,
+  // the entry offsets and that each sample's length word matches its
+  // entry. The PCM is taken as is.
+  bool attach(const void *kitImage, uint32_t capacity);
+  void detach();
+
+  // Read the image, CRC included (milliseconds for a large kit on QSPI)
+  bool verify() const;
+
+  // Replace the layers of every drum this kit has samples for
+  bool assign(DrumVoiceManager &voices) const;
+
+  bool attached() const { return image != nullptr; }
+  const char *name() const;
+  uint8_t count() const { return numSamples; }
+  const DrumSample &sample(uint8_t i) const { return samples[i < MAX_SAMPLES ? i : 0]; }
+  const DrumSample *find(const char *fileName) const;
+  uint32_t bytes() const;
+  const char *error() const { return err; }
+
+  void printInfo(Print &out) const;
+
+  // Whole image from any file with size() and read() (SD File,
+  // SerialFlashFile) into PSRAM or, without it, the heap; nullptr on
+  // failure. size is set to the bytes read, the capacity to attach() with.
+  // free with freeImage().
+  template <class F>
+  static uint8_t *readImage(F &file, uint32_t &size)
+  {
+    size = file.size();
+    if (size < sizeof(KitHeader)) {
+      size = 0;
+      return nullptr;
+    }
+    uint8_t *buf = (uint8_t *)allocImage(size);
+    if (!buf) {
+      size = 0;
+      return nullptr;
+    }
+    uint32_t done = 0;
+    while (done < size) {
+      int got = file.read(buf + done, min(size - done, (uint32_t)4096));
+      if (got <= 0) break;
+      done += got;
+    }
+    if (done < size) {
+      freeImage(buf);
+      size = 0;
+      return nullptr;
+    }
+    return buf;
+  }
+  static void freeImage(void *buf);
+
+  static uint32_t crc32(const uint8_t *data, uint32_t len, uint32_t crc = 0);
+
+private:
+  DrumKit(const DrumKit &) = delete;
+  DrumKit &operator=(const DrumKit &) = delete;
+
+  static void *allocImage(uint32_t size);
+  const KitHeader *header() const { return (const KitHeader *)image; }
+  const KitEntry *entries() const { return (const KitEntry *)(image + sizeof(KitHeader)); }
+
+  const uint8_t *image;
+  DrumSample samples[MAX_SAMPLES];
+  uint8_t numSamples;
+  const char *err;
+};
+
+#endif
@@ -0,0 +1,165 @@
+// DrumMap<N> - frequency to drum in one table lookup
+//
+// The sketches map pitch to drums with chains of float range tests, one
+// per band, which grows with every note added. DrumMap compiles a band
+// list into a table indexed by quantised log frequency when the sketch is
+// built, so a lookup is a shift, a subtract and one byte read whatever the
+// number of bands: a drum per note over 24 frets x 6 strings (the 49
+// semitones E2..E6) costs the same as five drums.
+//
+// The index is a float's exponent and top 7 mantissa bits: 128 steps per
+// octave, 6.8 to 13.5 cents each, from 16 Hz to 16 kHz (1280 bytes).
+// Band edges are rounded down to a step. Where bands overlap, the first
+// one listed wins, as in an if / else chain.
+//
+// Each band has its own hysteresis in cents. Passing the previous band to
+// band() widens that band by its hysteresis, so a note wobbling on an edge
+// keeps its drum instead of flipping between two.
+//
+// Usage:
+//   constexpr DrumBand KIT_BANDS[] = {
+//     {  60, 110, 0, 30 },     // KICK, +-30 cents of hold
+//     { 110, 165, 1, 30 },     // SNARE
+//   };
+//   constexpr DrumMap<2> KIT_MAP(KIT_BANDS);
+//   int band = -1;
+//   band = KIT_MAP.band(freq, band);
+//   int drum = KIT_MAP.drum(band);          // -1 if no band
+//
+//   constexpr auto FRETS = chromaticDrumMap<49>(40);    // E2..E6, one per note
+
+#ifndef drum_map_h_
+#define drum_map_h_
+
+#include <Arduino.h>
+#include <string.h>
+
+struct DrumBand {
+  float minHz;          // inclusive
+  float maxHz;          // exclusive
+  uint8_t drum;
+  uint8_t holdCents;    // extra width while this band is the previous one
+};
+
+namespace drum_map {
+
+// 2^x, good to float precision, usable in constant expressions
+constexpr double exp2(double x)
+{
+  double scale = 1;
+  while (x >= 1) { x -= 1; scale *= 2; }
+  while (x < 0) { x += 1; scale *= 0.5; }
+  // e^(x ln 2) for 0 <= x < 1
+  double t = x * 0.6931471805599453, term = 1, sum = 1;
+  for (int k = 1; k < 20; k++) {
+    term *= t / k;
+    sum += term;
+  }
+  return scale * sum;
+}
+
+constexpr double noteHz(double midiNote) { return 440.0 * exp2((midiNote - 69) / 12.0); }
+
+const int LOG2_STEPS = 7;
+const int STEPS_PER_OCTAVE = 1 << LOG2_STEPS;
+const int MIN_OCTAVE = 4;                          // 16 Hz
+const int OCTAVES = 10;                            // up to 16384 Hz
+const int BINS = OCTAVES * STEPS_PER_OCTAVE;
+
+// Bin of a frequency, the compile-time twin of DrumMap::bin(); clamped so
+// edges outside the covered range still bound a band.
+constexpr int binOf(double hz)
+{
+  if (hz <= 0) return 0;
+  int e = 0;
+  while (hz >= 2) { hz *= 0.5; e++; }
+  while (hz < 1) { hz *= 2; e--; }
+  int b = (e - MIN_OCTAVE) * STEPS_PER_OCTAVE + (int)((hz - 1) * STEPS_PER_OCTAVE);
+  return b < 0 ? 0 : (b > BINS ? BINS : b);
+}
+
+}  // namespace drum_map
+
+template <int N>
+class DrumMap
+{
+  static_assert(N > 0 && N < 255, "1 to 254 bands");
+
+public:
+  static const int BINS = drum_map::BINS;
+
+  constexpr DrumMap(const DrumBand (&bands)[N]) : table(), drums(), holdLo(), holdHi()
+  {
+    // Last band first, so earlier bands overwrite later ones where they overlap
+    for (int i = N - 1; i >= 0; i--) {
+      const DrumBand &b = bands[i];
+      for (int k = drum_map::binOf(b.minHz); k < drum_map::binOf(b.maxHz); k++) {
+        table[k] = (uint8_t)(i + 1);
+      }
+      double widen = drum_map::exp2(b.holdCents / 1200.0);
+      drums[i] = b.drum;
+      holdLo[i] = (uint16_t)drum_map::binOf(b.minHz / widen);
+      holdHi[i] = (uint16_t)drum_map::binOf(b.maxHz * widen);
+    }
+  }
+
+  // Table index of a frequency, -1 outside 16 Hz .. 16 kHz (or not a
+  // positive number). The float's exponent and top mantissa bits are
+  // already log2 quantised.
+  static int bin(float hz)
+  {
+    uint32_t bits;
+    memcpy(&bits, &hz, sizeof(bits));
+    int32_t b = (int32_t)(bits >> (23 - drum_map::LOG2_STEPS)) -
+                ((127 + drum_map::MIN_OCTAVE) << drum_map::LOG2_STEPS);
+    return (uint32_t)b < (uint32_t)BINS ? b : -1;
+  }
+
+  // Band holding hz, -1 for none
+  int band(float hz) const
+  {
+    int b = bin(hz);
+    return b < 0 ? -1 : (int)table[b] - 1;
+  }
+
+  // Same, but `previous` (the last band returned, or -1) keeps the note
+  // while hz stays inside its hysteresis
+  int band(float hz, int previous) const
+  {
+    int b = bin(hz);
+    if (b < 0) return -1;
+    if (previous >= 0 && previous < N && b >= holdLo[previous] && b < holdHi[previous]) {
+      return previous;
+    }
+    return (int)table[b] - 1;
+  }
+
+  int drum(int band) const { return band >= 0 && band < N ? drums[band] : -1; }
+  int drumFor(float hz) const { return drum(band(hz)); }
+
+  static int size() { return N; }
+
+private:
+  uint8_t table[BINS];       // band + 1, 0 = none
+  uint8_t drums[N];
+  uint16_t holdLo[N];        // hysteresis bins, [lo, hi)
+  uint16_t holdHi[N];
+};
+
+// One band per semitone from firstNote (MIDI, 40 = low E), +-50 cents
+// each, playing drums firstDrum, firstDrum + 1, ...
+template <int N>
+constexpr DrumMap<N> chromaticDrumMap(uint8_t firstNote, uint8_t firstDrum = 0,
+                                      uint8_t holdCents = 15)
+{
+  DrumBand notes[N] = {};
+  for (int i = 0; i < N; i++) {
+    notes[i].minHz = (float)drum_map::noteHz(firstNote + i - 0.5);
+    notes[i].maxHz = (float)drum_map::noteHz(firstNote + i + 0.5);
+    notes[i].drum = (uint8_t)(firstDrum + i);
+    notes[i].holdCents = holdCents;
+  }
+  return DrumMap<N>(notes);
+}
+
+#endif
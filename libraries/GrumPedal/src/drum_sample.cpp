@@ -0,0 +1,254 @@
+#include "drum_sample.h"
+#include <SD.h>
+
+// PSRAM if present (extmem_malloc falls back to the heap without it)
+#if defined(__IMXRT1062__)
+  #define SAMPLE_MALLOC(n) extmem_malloc(n)
+  #define SAMPLE_FREE(p)   extmem_free(p)
+#else
+  #define SAMPLE_MALLOC(n) malloc(n)
+  #define SAMPLE_FREE(p)   free(p)
+#endif
+
+static uint16_t rd16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t rd32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+static bool skip(File &f, uint32_t bytes)
+{
+  return f.seek(f.position() + bytes);
+}
+
+// Header word + samples padded to whole audio blocks, two per word.
+// AudioPlayMemory always consumes a full block, so the padding keeps it
+// from reading past the end of the buffer.
+static uint32_t bufferBytes(uint32_t samples)
+{
+  uint32_t padded = (samples + AUDIO_BLOCK_SAMPLES - 1) / AUDIO_BLOCK_SAMPLES * AUDIO_BLOCK_SAMPLES;
+  return 4 + padded * 2;
+}
+
+uint32_t DrumSample::bytes() const
+{
+  if (!buffer) return 0;
+  return bufferBytes(resident) + (samples + AUDIO_BLOCK_SAMPLES - 1) / AUDIO_BLOCK_SAMPLES;
+}
+
+float DrumSample::levelAt(uint32_t pos) const
+{
+  if (!env || pos >= samples) return 0.0f;
+  return env[pos / AUDIO_BLOCK_SAMPLES] * (1.0f / 255.0f);
+}
+
+void DrumSample::unload()
+{
+  if (owned) {
+    if (buffer) SAMPLE_FREE((void *)buffer);
+    if (env) free((void *)env);
+  }
+  owned = false;
+  buffer = nullptr;
+  env = nullptr;
+  samples = 0;
+  resident = 0;
+}
+
+bool DrumSample::load(const char *filename, uint32_t residentMs)
+{
+  DrumSampleLoader loader;
+  if (!loader.begin(*this, filename, residentMs)) return false;
+  while (loader.step()) {}
+  return loaded();
+}
+
+void DrumSampleLoader::cancel()
+{
+  if (f) f.close();
+  if (mem) SAMPLE_FREE(mem);
+  if (peaks) free(peaks);
+  mem = nullptr;
+  peaks = nullptr;
+  target = nullptr;
+}
+
+bool DrumSampleLoader::begin(DrumSample &sample, const char *filename, uint32_t residentMs)
+{
+  cancel();
+  DrumSample &s = sample;
+  s.unload();
+  s.fileName = filename;
+  s.err = nullptr;
+
+  f = SD.open(filename);
+  if (!f) { s.err = "cannot open file"; return false; }
+
+  uint8_t hdr[16];
+  if (f.read(hdr, 12) != 12 || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+    s.err = "not a RIFF/WAVE file";
+    f.close();
+    return false;
+  }
+
+  // Walk the chunks until "data", picking up "fmt " on the way
+  uint16_t format = 0, bits = 0;
+  uint32_t dataBytes = 0;
+  bool haveFmt = false;
+  while (true) {
+    uint8_t chunk[8];
+    if (f.read(chunk, 8) != 8) { s.err = "no data chunk"; f.close(); return false; }
+    uint32_t size = rd32(chunk + 4);
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (size < 16 || f.read(hdr, 16) != 16) { s.err = "bad fmt chunk"; f.close(); return false; }
+      format     = rd16(hdr);
+      s.channels = rd16(hdr + 2);
+      s.rate     = rd32(hdr + 4);
+      bits       = rd16(hdr + 14);
+      haveFmt    = true;
+      skip(f, size - 16 + (size & 1));
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      dataBytes = size;
+      s.dataStart = f.position();
+      break;
+    } else {
+      skip(f, size + (size & 1));
+    }
+  }
+
+  if (!haveFmt) { s.err = "data before fmt chunk"; f.close(); return false; }
+  if ((format != 1 && format != 0xFFFE) || bits != 16) { s.err = "not 16 bit PCM"; f.close(); return false; }
+  if (s.channels != 1 && s.channels != 2) { s.err = "not mono or stereo"; f.close(); return false; }
+
+  switch (s.rate) {
+    case 44100: code = 0x81; break;
+    case 22050: code = 0x82; break;
+    case 11025: code = 0x83; break;
+    default: s.err = "sample rate not 44100/22050/11025"; f.close(); return false;
+  }
+
+  frame = 2 * s.channels;
+  count = dataBytes / frame;
+  if (count == 0 || count > 0xFFFFFF) { s.err = "empty or too long"; f.close(); return false; }
+
+  // Attack kept in RAM, in whole blocks; the rest stays on the card
+  keep = count;
+  if (residentMs) {
+    uint32_t attack = (uint32_t)((uint64_t)residentMs * s.rate / 1000);
+    attack = (attack + AUDIO_BLOCK_SAMPLES - 1) / AUDIO_BLOCK_SAMPLES * AUDIO_BLOCK_SAMPLES;
+    if (attack < keep) keep = attack;
+  }
+
+  uint32_t size = bufferBytes(keep);
+  mem = (unsigned int *)SAMPLE_MALLOC(size);
+  if (!mem) { s.err = "out of memory"; f.close(); return false; }
+  memset(mem, 0, size);
+  mem[0] = (code << 24) | keep;
+
+  // Coarse envelope for voice stealing: peak of each block, 0..255. It
+  // covers the streamed part too, so the whole file is read once here.
+  uint32_t blocks = (count + AUDIO_BLOCK_SAMPLES - 1) / AUDIO_BLOCK_SAMPLES;
+  peaks = (uint8_t *)malloc(blocks);
+  if (peaks) memset(peaks, 0, blocks);
+
+  target = &s;
+  done = 0;
+  peak = 0;
+  return true;
+}
+
+bool DrumSampleLoader::step(uint32_t maxBytes)
+{
+  if (!target) return false;
+
+  // Decode in small chunks; stereo is averaged down to mono since the
+  // sketches only ever patched the left output of the SD players.
+  int16_t *out = (int16_t *)(mem + 1);
+  uint8_t chunk[512];
+  uint32_t budget = maxBytes;
+  bool eof = false;
+  while (done < count && budget > 0) {
+    uint32_t want = (count - done) * frame;
+    if (want > sizeof(chunk)) want = sizeof(chunk) / frame * frame;
+    int got = f.read(chunk, want);
+    if (got <= 0) { eof = true; break; }
+    uint32_t frames = (uint32_t)got / frame;
+    for (uint32_t i = 0; i < frames; i++) {
+      const uint8_t *p = chunk + i * frame;
+      int16_t sample;
+      if (frame == 2) {
+        sample = (int16_t)rd16(p);
+      } else {
+        sample = (int16_t)(((int32_t)(int16_t)rd16(p) + (int16_t)rd16(p + 2)) >> 1);
+      }
+      uint32_t n = done + i;
+      if (n < keep) out[n] = sample;
+      int32_t a = abs((int32_t)sample);
+      if (a > peak) peak = a;
+      if ((n + 1) % AUDIO_BLOCK_SAMPLES == 0 || n + 1 == count) {
+        if (peaks) peaks[n / AUDIO_BLOCK_SAMPLES] = (uint8_t)((min(peak, (int32_t)32767) * 255 + 32766) / 32767);
+        peak = 0;
+      }
+    }
+    done += frames;
+    budget = (uint32_t)got < budget ? budget - got : 0;
+  }
+  if (done < count && !eof) return true;
+  f.close();
+
+  DrumSample &s = *target;
+  if (done < count) {
+    // Truncated file: keep what we read, but say so
+    s.err = "file shorter than its header";
+    if (peaks && done % AUDIO_BLOCK_SAMPLES) {
+      peaks[done / AUDIO_BLOCK_SAMPLES] = (uint8_t)((min(peak, (int32_t)32767) * 255 + 32766) / 32767);
+    }
+    if (done < keep) {
+      keep = done;
+      mem[0] = (code << 24) | done;
+    }
+  }
+
+  // Only now does the sample look loaded
+  s.buffer = mem;
+  s.env = peaks;
+  s.owned = true;
+  s.samples = done;
+  s.resident = keep;
+  mem = nullptr;
+  peaks = nullptr;
+  target = nullptr;
+  return false;
+}
+
+bool DrumSample::attach(const char *name, const unsigned int *data, const uint8_t *envelope)
+{
+  unload();
+  fileName = name;
+  err = nullptr;
+  switch (data[0] >> 24) {
+    case 0x81: rate = 44100; break;
+    case 0x82: rate = 22050; break;
+    case 0x83: rate = 11025; break;
+    default: err = "not an AudioPlayMemory sample"; return false;
+  }
+  buffer = data;
+  env = envelope;
+  samples = resident = data[0] & 0xFFFFFF;
+  channels = 1;
+  dataStart = 0;
+  return true;
+}
+
+void DrumSample::printInfo(Print &out) const
+{
+  if (!buffer) {
+    out.printf("%-10s not loaded (%s)\n", fileName, err ? err : "no file");
+    return;
+  }
+  out.printf("%-10s %7lu samples %5lu ms %7lu bytes (%s, %lu Hz)",
+             fileName, (unsigned long)samples, (unsigned long)lengthMillis(),
+             (unsigned long)bytes(), channels == 1 ? "mono" : "stereo->mono",
+             (unsigned long)rate);
+  if (streamed()) {
+    out.printf(" %lu ms in RAM, rest from SD", (unsigned long)((uint64_t)resident * 1000 / rate));
+  }
+  out.println();
+}
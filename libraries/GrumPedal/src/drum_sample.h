@@ -0,0 +1,122 @@
+// DrumSample - a WAV file decoded once into RAM
+//
+// load() reads a 16 bit PCM WAV from SD, downmixes it to mono and stores it
+// in the AudioPlayMemory data format (one header word, then two samples per
+// 32 bit word). Playback is then AudioPlayMemory::play(sample.data()), which
+// is O(1) and never touches the filesystem from a trigger.
+//
+// Memory comes from PSRAM when a Teensy 4.1 has it fitted, otherwise from
+// the normal heap (RAM2 / OCRAM on Teensy 4.0). 44.1, 22.05 and 11.025 kHz
+// files are accepted since AudioPlayMemory can play those rates natively.
+//
+// Long crashes and rides can keep just their attack in RAM: load(file, ms)
+// stores the first `ms` and leaves the rest on the card, for
+// AudioPlaySamplePool to stream through a SampleStreamer. The envelope
+// still covers the whole file, and the file name must stay valid (pass a
+// literal) since the streamer reopens it.
+//
+// DrumSampleLoader does the same load a few KB at a time, for loading
+// the next kit from loop() while this one plays (KitBank); the sample
+// only becomes loaded() once the last step is done.
+
+#ifndef drum_sample_h_
+#define drum_sample_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include <SD.h>
+
+class DrumSample
+{
+public:
+  DrumSample() : samples(0), resident(0), rate(0), dataStart(0), channels(0), owned(false),
+                 buffer(nullptr), env(nullptr), fileName(""), err(nullptr) {}
+  ~DrumSample() { unload(); }
+
+  // residentMs = 0 keeps the whole file in RAM
+  bool load(const char *filename, uint32_t residentMs = 0);
+  void unload();
+
+  // Use a sample already in this format somewhere readable (a DrumKit
+  // image in flash); nothing is copied or freed. `envelope` has one byte
+  // per block and may be nullptr.
+  bool attach(const char *name, const unsigned int *data, const uint8_t *envelope);
+
+  bool loaded() const { return buffer != nullptr; }
+  const unsigned int *data() const { return buffer; }
+  const int16_t *pcm() const { return buffer ? (const int16_t *)(buffer + 1) : nullptr; }
+  const char *name() const { return fileName; }
+
+  uint32_t length() const { return samples; }       // samples (mono)
+  uint32_t residentLength() const { return resident; }  // of those, in RAM
+  bool streamed() const { return resident < samples; }
+  uint32_t sampleRate() const { return rate; }
+  uint32_t bytes() const;                           // memory used by the sample
+  uint32_t lengthMillis() const { return rate ? (uint32_t)((uint64_t)samples * 1000 / rate) : 0; }
+
+  // Peak level (0..1) of the audio block containing sample `pos`, taken
+  // from an envelope computed at load time. 0 past the end.
+  float levelAt(uint32_t pos) const;
+
+  // Reason for the last failed load(), nullptr after a clean load. A
+  // truncated file still loads but leaves a warning here.
+  const char *error() const { return err; }
+
+  // "KICK.WAV    14210 samples   322 ms   28424 bytes (mono, 44100 Hz)"
+  void printInfo(Print &out) const;
+
+  // Where the streamer finds the rest: PCM data offset and frame layout
+  uint32_t fileOffset() const { return dataStart; }
+  uint8_t channelCount() const { return channels; }
+
+private:
+  friend class DrumSampleLoader;
+  DrumSample(const DrumSample &) = delete;
+  DrumSample &operator=(const DrumSample &) = delete;
+
+  uint32_t samples;
+  uint32_t resident;     // samples in buffer, <= samples
+  uint32_t rate;
+  uint32_t dataStart;    // file offset of the first PCM frame
+  uint8_t  channels;     // channels in the source file
+  bool     owned;        // buffer and env were allocated by load()
+  const unsigned int *buffer;
+  const uint8_t *env;    // one peak byte per audio block
+  const char *fileName;
+  const char *err;
+};
+
+class DrumSampleLoader
+{
+public:
+  DrumSampleLoader() : target(nullptr), mem(nullptr), peaks(nullptr) {}
+  ~DrumSampleLoader() { cancel(); }
+
+  // Open and check the file and allocate `sample`'s memory; false (with
+  // sample.error() set) if it can't be loaded. `sample` is unloaded
+  // until step() has finished.
+  bool begin(DrumSample &sample, const char *filename, uint32_t residentMs = 0);
+
+  // Decode about maxBytes more of the file. True while there is more.
+  bool step(uint32_t maxBytes = 512);
+
+  bool busy() const { return target != nullptr; }
+  void cancel();
+
+private:
+  DrumSampleLoader(const DrumSampleLoader &) = delete;
+  DrumSampleLoader &operator=(const DrumSampleLoader &) = delete;
+
+  DrumSample *target;
+  File f;
+  unsigned int *mem;
+  uint8_t *peaks;
+  uint32_t count;        // source samples in the file
+  uint32_t keep;         // of those, kept in RAM
+  uint32_t done;
+  uint32_t code;         // AudioPlayMemory rate code
+  int32_t peak;          // of the envelope block being decoded
+  uint8_t frame;         // bytes per source frame
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "drum_voices.h"
+
+DrumVoiceManager::DrumVoiceManager()
+{
+  pool = nullptr;
+  synth = nullptr;
+  numVoices = 0;
+  velFloor = 0.2f;
+  stealCount = 0;
+  chokeCount = 0;
+  for (uint8_t d = 0; d < MAX_DRUMS; d++) {
+    drums[d].numLayers = 0;
+    drums[d].chokeGroup = 0;
+    drums[d].maxVoices = 0;
+    drums[d].gain = 0.8f;
+    drums[d].hasPatch = false;
+  }
+}
+
+void DrumVoiceManager::begin(AudioPlaySamplePool &p, uint8_t count)
+{
+  pool = &p;
+  synth = nullptr;
+  numVoices = count < MAX_VOICES ? count : MAX_VOICES;
+  for (uint8_t v = 0; v < numVoices; v++) {
+    voices[v].drum = -1;
+    voices[v].sample = nullptr;
+    voices[v].gain = 0;
+    voices[v].startMs = 0;
+  }
+}
+
+void DrumVoiceManager::begin(AudioSynthDrumPool &p, uint8_t count)
+{
+  synth = &p;
+  pool = nullptr;
+  numVoices = count < AudioSynthDrumPool::MAX_VOICES ? count : AudioSynthDrumPool::MAX_VOICES;
+  for (uint8_t v = 0; v < numVoices; v++) {
+    voices[v].drum = -1;
+    voices[v].sample = nullptr;
+    voices[v].gain = 0;
+    voices[v].startMs = 0;
+  }
+}
+
+bool DrumVoiceManager::setPatch(uint8_t drum, const SynthDrumPatch &patch)
+{
+  if (drum >= MAX_DRUMS) return false;
+  drums[drum].patch = patch;
+  drums[drum].hasPatch = true;
+  return true;
+}
+
+bool DrumVoiceManager::poolPlaying(uint8_t v) const
+{
+  if (synth) return synth->isPlaying(v) && !synth->isStopping(v);
+  return pool->isPlaying(v) && !pool->isStopping(v);
+}
+
+float DrumVoiceManager::poolLevel(uint8_t v) const
+{
+  return synth ? synth->level(v) : pool->level(v);
+}
+
+bool DrumVoiceManager::addLayer(uint8_t drum, const DrumSample &sample, float minVelocity)
+{
+  if (drum >= MAX_DRUMS || !sample.loaded()) return false;
+  Drum &d = drums[drum];
+  if (d.numLayers >= MAX_LAYERS) return false;
+
+  // Insertion sort keeps layers ascending by minVelocity
+  uint8_t i = d.numLayers++;
+  while (i > 0 && d.layers[i - 1].minVelocity > minVelocity) {
+    d.layers[i] = d.layers[i - 1];
+    i--;
+  }
+  d.layers[i].sample = &sample;
+  d.layers[i].minVelocity = minVelocity;
+  return true;
+}
+
+void DrumVoiceManager::clearLayers(uint8_t drum)
+{
+  if (drum < MAX_DRUMS) drums[drum].numLayers = 0;
+}
+
+void DrumVoiceManager::setDrum(uint8_t drum, float gain, uint8_t chokeGroup, uint8_t maxVoices)
+{
+  if (drum >= MAX_DRUMS) return;
+  drums[drum].gain = gain;
+  drums[drum].chokeGroup = chokeGroup;
+  drums[drum].maxVoices = maxVoices;
+}
+
+bool DrumVoiceManager::isActive(uint8_t v)
+{
+  Voice &voice = voices[v];
+  if (voice.drum < 0) return false;
+  if (!poolPlaying(v)) {
+    voice.drum = -1;
+    return false;
+  }
+  return true;
+}
+
+float DrumVoiceManager::voiceLevel(uint8_t v)
+{
+  if (v >= numVoices || !isActive(v)) return 0.0f;
+  return poolLevel(v);
+}
+
+uint8_t DrumVoiceManager::activeVoices()
+{
+  uint8_t n = 0;
+  for (uint8_t v = 0; v < numVoices; v++) {
+    if (isActive(v)) n++;
+  }
+  return n;
+}
+
+void DrumVoiceManager::stopVoice(uint8_t v)
+{
+  if (synth) synth->stop(v);
+  else pool->stop(v);
+  voices[v].drum = -1;
+}
+
+void DrumVoiceManager::noteOff(int voice, uint8_t drum)
+{
+  if (voice < 0 || voice >= numVoices) return;
+  if (isActive(voice) && voices[voice].drum == drum) stopVoice(voice);
+}
+
+void DrumVoiceManager::choke(uint8_t group)
+{
+  if (group == 0) return;
+  for (uint8_t v = 0; v < numVoices; v++) {
+    if (isActive(v) && drums[voices[v].drum].chokeGroup == group) {
+      stopVoice(v);
+      chokeCount++;
+    }
+  }
+}
+
+void DrumVoiceManager::allNotesOff()
+{
+  for (uint8_t v = 0; v < numVoices; v++) stopVoice(v);
+}
+
+int DrumVoiceManager::pickVoice(uint8_t drum)
+{
+  uint32_t now = millis();
+
+  // Drum at its voice cap: recycle its own oldest voice
+  if (drums[drum].maxVoices) {
+    uint8_t count = 0;
+    int oldest = -1;
+    for (uint8_t v = 0; v < numVoices; v++) {
+      if (isActive(v) && voices[v].drum == drum) {
+        count++;
+        if (oldest < 0 || now - voices[v].startMs > now - voices[oldest].startMs) oldest = v;
+      }
+    }
+    if (count >= drums[drum].maxVoices) {
+      stealCount++;
+      return oldest;
+    }
+  }
+
+  for (uint8_t v = 0; v < numVoices; v++) {
+    if (!isActive(v)) return v;
+  }
+
+  // All busy: quietest first, oldest breaks a tie (one envelope step)
+  int best = -1;
+  float bestLevel = 0;
+  for (uint8_t v = 0; v < numVoices; v++) {
+    float level = voiceLevel(v);
+    if (best < 0 || level < bestLevel - (1.0f / 255.0f) ||
+        (level <= bestLevel + (1.0f / 255.0f) && now - voices[v].startMs > now - voices[best].startMs)) {
+      best = v;
+      bestLevel = level;
+    }
+  }
+  stealCount++;
+  return best;
+}
+
+int DrumVoiceManager::noteOn(uint8_t drum, float velocity, uint8_t offset)
+{
+  if (!hasDrum(drum) || numVoices == 0) return -1;
+  Drum &d = drums[drum];
+  velocity = constrain(velocity, 0.0f, 1.0f);
+
+  // Highest layer whose threshold this velocity reaches
+  const DrumSample *sample = synth ? nullptr : d.layers[0].sample;
+  for (uint8_t i = 1; i < d.numLayers && !synth; i++) {
+    if (velocity >= d.layers[i].minVelocity) sample = d.layers[i].sample;
+  }
+
+  choke(d.chokeGroup);
+
+  int v = pickVoice(drum);
+  if (v < 0) return -1;
+  Voice &voice = voices[v];
+  voice.drum = drum;
+  voice.sample = sample;
+  voice.gain = d.gain * (velFloor + (1.0f - velFloor) * velocity);
+  voice.startMs = millis();
+  if (synth) synth->play(v, d.patch, voice.gain, offset);
+  else pool->play(v, *sample, voice.gain, offset);
+  return v;
+}
+
+void DrumVoiceManager::printStatus(Print &out)
+{
+  uint32_t now = millis();
+  out.printf("Voices %u/%u active, %lu steals, %lu chokes\n", activeVoices(), numVoices,
+             (unsigned long)stealCount, (unsigned long)chokeCount);
+  for (uint8_t v = 0; v < numVoices; v++) {
+    if (!isActive(v)) continue;
+    const char *name = voices[v].sample ? voices[v].sample->name() : "synth";
+    out.printf("  v%-2u drum %d %-10s %5lu ms level %.3f\n", v, voices[v].drum, name,
+               (unsigned long)(now - voices[v].startMs), voiceLevel(v));
+  }
+}
@@ -0,0 +1,132 @@
+// DrumVoiceManager - polyphonic voice allocation for RAM drum samples
+//
+// Replaces the round-robin players[]/nextPlayer scheme. Voices live in an
+// AudioPlaySamplePool, which applies each note's velocity gain inside the
+// voice, so a new hit never changes the level of one still ringing. The
+// manager remembers which drum each voice is playing and reads its current
+// level from the pool (gain x the sample's envelope), which lets it:
+//
+//   - steal the quietest voice first (oldest wins a tie) when all are busy
+//   - choke drums that share a group (closed hat cuts open hat)
+//   - cap how many voices one drum may hold (so hats can't eat the pool)
+//   - pick a velocity layer per drum
+//
+// The same manager drives an AudioSynthDrumPool instead: begin() with the
+// synth pool, and setPatch() gives each drum its sound in place of sample
+// layers. Choke groups, voice caps and stealing work the same.
+//
+// Usage:
+//   AudioPlaySamplePool drumPool;
+//   DrumVoiceManager voices;
+//   voices.begin(drumPool, 12);
+//   voices.addLayer(SNARE, snareSoft, 0.0f);
+//   voices.addLayer(SNARE, snareHard, 0.7f);
+//   voices.setDrum(HHCL, 0.7f, 1);  voices.setDrum(HHOP, 0.7f, 1);
+//   voices.noteOn(SNARE, velocity);
+//
+//   AudioSynthDrumPool synthPool;
+//   voices.begin(synthPool, 8);
+//   voices.setPatch(HHOP, openHatPatch);
+
+#ifndef drum_voices_h_
+#define drum_voices_h_
+
+#include <Arduino.h>
+#include "drum_sample.h"
+#include "play_sample_pool.h"
+#include "synth_drum_pool.h"
+
+class DrumVoiceManager
+{
+public:
+  static const uint8_t MAX_VOICES = AudioPlaySamplePool::MAX_VOICES;
+  static const uint8_t MAX_DRUMS = 8;
+  static const uint8_t MAX_LAYERS = 4;
+
+  DrumVoiceManager();
+
+  // Use the first `count` voices of `pool`.
+  void begin(AudioPlaySamplePool &pool, uint8_t count = MAX_VOICES);
+  void begin(AudioSynthDrumPool &pool, uint8_t count = MAX_VOICES);
+
+  // A synth pool drum's sound (copied)
+  bool setPatch(uint8_t drum, const SynthDrumPatch &patch);
+
+  // Add a velocity layer: used when velocity >= minVelocity and no higher
+  // layer qualifies. Layers may be added in any order; unloaded samples
+  // are ignored.
+  bool addLayer(uint8_t drum, const DrumSample &sample, float minVelocity = 0.0f);
+
+  // Forget a drum's layers (a kit change); voices still sounding finish.
+  void clearLayers(uint8_t drum);
+
+  // Per-drum level, choke group (0 = none) and voice cap (0 = no cap).
+  void setDrum(uint8_t drum, float gain, uint8_t chokeGroup = 0, uint8_t maxVoices = 0);
+
+  // Quietest velocity still maps to this fraction of full gain (0.2 as in
+  // triggerDrumForFrequency()).
+  void velocityFloor(float floor) { velFloor = constrain(floor, 0.0f, 1.0f); }
+
+  // Start a drum, `offset` samples into the next block. Returns the voice
+  // used, or -1 if the drum has no sample.
+  int noteOn(uint8_t drum, float velocity, uint8_t offset = 0);
+
+  // Stop one voice from noteOn(), if it is still playing that drum
+  void noteOff(int voice, uint8_t drum);
+  void choke(uint8_t group);
+  void allNotesOff();
+
+  bool hasDrum(uint8_t drum) const
+  {
+    return drum < MAX_DRUMS && (synth ? drums[drum].hasPatch : drums[drum].numLayers > 0);
+  }
+  uint8_t voiceCount() const { return numVoices; }
+  uint8_t activeVoices();
+  float voiceLevel(uint8_t v);
+  uint32_t steals() const { return stealCount; }
+  uint32_t chokes() const { return chokeCount; }
+
+  // One line per active voice: drum, age and estimated level.
+  void printStatus(Print &out);
+
+private:
+  struct Voice {
+    int8_t drum;               // -1 when idle
+    const DrumSample *sample;
+    float gain;
+    uint32_t startMs;
+  };
+
+  struct Layer {
+    const DrumSample *sample;
+    float minVelocity;
+  };
+
+  struct Drum {
+    Layer layers[MAX_LAYERS];  // sorted by minVelocity, ascending
+    uint8_t numLayers;
+    SynthDrumPatch patch;      // synth pool only
+    bool hasPatch;
+    uint8_t chokeGroup;
+    uint8_t maxVoices;
+    float gain;
+  };
+
+  bool isActive(uint8_t v);
+  int pickVoice(uint8_t drum);
+  void stopVoice(uint8_t v);
+  // Whichever pool begin() was given
+  bool poolPlaying(uint8_t v) const;
+  float poolLevel(uint8_t v) const;
+
+  AudioPlaySamplePool *pool;
+  AudioSynthDrumPool *synth;
+  Voice voices[MAX_VOICES];
+  uint8_t numVoices;
+  Drum drums[MAX_DRUMS];
+  float velFloor;
+  uint32_t stealCount;
+  uint32_t chokeCount;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "event_log.h"
+
+static const char *const REASON_NAMES[] = {
+  "hit", "held", "no pitch", "unstable pitch", "pitch", "energy fallback", "no sample"
+};
+
+EventLog::EventLog()
+  : format(formatDefault), outMode(MODE_TEXT), sequence(0), havePending(false)
+{
+  memset(&next, 0, sizeof(next));
+}
+
+bool EventLog::log(uint8_t reason, int8_t drum, float frequency, float velocity)
+{
+  if (outMode == MODE_OFF) return false;
+  LogRecord r;
+  r.micros = micros();
+  r.frequency = frequency;
+  r.velocity = velocity;
+  r.drum = drum;
+  r.reason = reason;
+  r.sequence = sequence++;
+  return queue.push(r);
+}
+
+int EventLog::drain(Print &out, int maxRecords)
+{
+  int sent = 0;
+  while (sent < maxRecords) {
+    if (!havePending) {
+      if (!queue.pop(next)) break;
+      havePending = true;
+    }
+    if (outMode == MODE_OFF) {
+      havePending = false;
+      continue;
+    }
+
+    uint8_t buf[MAX_LINE];
+    int len;
+    if (outMode == MODE_BINARY) {
+      buf[0] = SYNC0;
+      buf[1] = SYNC1;
+      memcpy(buf + 2, &next, sizeof(next));   // Cortex-M is little endian
+      len = FRAME_BYTES;
+    } else {
+      len = format((char *)buf, sizeof(buf), next);
+      if (len <= 0) {
+        havePending = false;
+        continue;
+      }
+      if (len > (int)sizeof(buf) - 1) len = sizeof(buf) - 1;
+    }
+
+    // Keep the record for the next drain() rather than wait for room
+    if (out.availableForWrite() < len) break;
+    out.write(buf, len);
+    havePending = false;
+    sent++;
+  }
+  return sent;
+}
+
+const char *EventLog::reasonName(uint8_t reason)
+{
+  if (reason < sizeof(REASON_NAMES) / sizeof(REASON_NAMES[0])) return REASON_NAMES[reason];
+  return reason >= LOG_USER ? "user" : "?";
+}
+
+int EventLog::formatDefault(char *buf, size_t size, const LogRecord &r)
+{
+  int n = snprintf(buf, size, "[%5lu.%03lu] %s", (unsigned long)(r.micros / 1000000),
+                   (unsigned long)(r.micros / 1000 % 1000), reasonName(r.reason));
+  if (r.reason >= LOG_USER && n >= 0 && (size_t)n < size) {
+    n += snprintf(buf + n, size - n, " %u", r.reason - LOG_USER);
+  }
+  if (r.drum >= 0 && n >= 0 && (size_t)n < size) {
+    n += snprintf(buf + n, size - n, " drum %d", r.drum);
+  }
+  if (r.frequency >= 0 && n >= 0 && (size_t)n < size) {
+    n += snprintf(buf + n, size - n, " %6.1f Hz", r.frequency);
+  }
+  if (n >= 0 && (size_t)n < size) {
+    n += snprintf(buf + n, size - n, "  vel %.2f\n", r.velocity);
+  }
+  return n < 0 ? 0 : (n < (int)size ? n : (int)size - 1);
+}
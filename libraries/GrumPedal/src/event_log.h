@@ -0,0 +1,94 @@
+// EventLog - trigger log that never waits for the serial port
+//
+// A Serial.print() on the trigger path blocks whenever the USB buffer is
+// full, and with the port stalled or unplugged that delays the next hit.
+// Detectors log() a fixed 16 byte record instead, into a lock-free
+// SpscQueue (any context, one producer), and loop() calls drain() when
+// it has nothing better to do. drain() formats or frames one record at a
+// time and only writes it once the port reports room for all of it
+// (availableForWrite()), so it returns at once when the host isn't
+// reading; records that don't fit in the queue are dropped and counted.
+//
+// Text mode prints one line per record through the sketch's formatter
+// (or formatDefault()). Binary mode sends each record as
+//
+//   0xA5 0x5A  micros(4)  frequency(4)  velocity(4)  drum(1)  reason(1)  sequence(2)
+//
+// little endian, for tools/logdecode; gaps in sequence are drops.
+//
+// Usage:
+//   EventLog events;
+//   events.log(LOG_HIT, drum, freq, velocity);   // instead of Serial.print
+//   events.drain(Serial);                        // end of loop()
+
+#ifndef event_log_h_
+#define event_log_h_
+
+#include <Arduino.h>
+#include "spsc_queue.h"
+
+enum LogReason : uint8_t {
+  LOG_HIT,              // drum played
+  LOG_HELD,             // drum in its retrigger hold
+  LOG_NO_PITCH,         // onset, no pitch to map
+  LOG_UNSTABLE_PITCH,   // pitch used without agreeing frames
+  LOG_STABLE_PITCH,     // pitch debug
+  LOG_ENERGY_FALLBACK,  // drum picked from band energies, frequency = energy
+  LOG_NO_SAMPLE,        // drum has no sample loaded
+  LOG_USER = 32         // sketch-defined reasons from here
+};
+
+struct LogRecord {
+  uint32_t micros;
+  float    frequency;   // Hz, -1 for none
+  float    velocity;    // 0..1
+  int8_t   drum;        // -1 for none
+  uint8_t  reason;      // LogReason
+  uint16_t sequence;    // per record, so the host can count drops
+};
+
+class EventLog
+{
+public:
+  static const uint16_t SIZE = 64;           // records, ~1 KB
+  static const uint8_t SYNC0 = 0xA5, SYNC1 = 0x5A;
+  static const int FRAME_BYTES = 2 + 16;
+  static const int MAX_LINE = 96;
+
+  enum Mode : uint8_t { MODE_TEXT, MODE_BINARY, MODE_OFF };
+
+  // Writes one line (with its newline) into buf, returns its length
+  typedef int (*Formatter)(char *buf, size_t size, const LogRecord &r);
+
+  EventLog();
+
+  void mode(Mode m) { outMode = m; }
+  Mode mode() const { return outMode; }
+  void formatter(Formatter f) { format = f ? f : formatDefault; }
+
+  // Producer side; false if the queue was full
+  bool log(uint8_t reason, int8_t drum = -1, float frequency = -1.0f, float velocity = 0.0f);
+
+  // Consumer side, loop() only. Sends up to maxRecords without blocking
+  // and returns how many went out.
+  int drain(Print &out, int maxRecords = 4);
+
+  uint16_t pending() const { return queue.size() + (havePending ? 1 : 0); }
+  uint32_t dropped() const { return queue.dropped(); }
+
+  // "[  12.345] hit drum 0  82.4 Hz  vel 0.71"
+  static int formatDefault(char *buf, size_t size, const LogRecord &r);
+  static const char *reasonName(uint8_t reason);
+
+private:
+  SpscQueue<LogRecord, SIZE> queue;
+  Formatter format;
+  volatile Mode outMode;
+  uint16_t sequence;
+  LogRecord next;        // popped, waiting for room in the port
+  bool havePending;
+};
+
+static_assert(sizeof(LogRecord) == 16, "LogRecord is the 16 byte wire format");
+
+#endif
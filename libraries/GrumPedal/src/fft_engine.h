@@ -0,0 +1,112 @@
+// FFTEngine - compile-time sized FFT with its own window and hop
+//
+//   FFTEngine<FFT_SIZE, WINDOW_LEN, HOP, WINDOW>
+//
+//   FFT_SIZE    256, 512, 1024 or 2048 (bin width 172 / 86 / 43 / 21.5 Hz)
+//   WINDOW_LEN  samples analysed, <= FFT_SIZE; the rest is zero-padded
+//   HOP         samples between frames (128 = every audio block)
+//   WINDOW      FFTWindow::Hann, Hamming, Blackman or Rectangular
+//
+// The window table is built once in the constructor. compute() pulls the
+// newest WINDOW_LEN samples from an AudioSampleRing, applies the window,
+// runs arm_rfft_fast_f32 and leaves BINS magnitudes, scaled so a full
+// scale sine on a bin centre reads 1.0 whatever the window. It runs in
+// loop(), so a 2048 point pitch frame costs no audio interrupt time. If
+// loop() falls behind, frames are skipped, never queued.
+//
+// Usage:
+//   AudioSampleRing<2048> ring;
+//   FFTEngine<256, 256, 128> onsetFFT;          // 2.9 ms hop
+//   FFTEngine<2048, 2048, 512> pitchFFT;        // 21.5 Hz bins
+//   if (onsetFFT.compute(ring)) spectrum.compute(onsetFFT.magnitudes(),
+//                                                onsetFFT.BINS, onsetFFT.binHz());
+
+#ifndef fft_engine_h_
+#define fft_engine_h_
+
+#include <Arduino.h>
+#include <arm_math.h>
+#include "audio_sample_ring.h"
+
+enum class FFTWindow { Rectangular, Hann, Hamming, Blackman };
+
+template <int FFT_SIZE, int WINDOW_LEN = FFT_SIZE, int HOP = AUDIO_BLOCK_SAMPLES,
+          FFTWindow WINDOW = FFTWindow::Hann>
+class FFTEngine
+{
+  static_assert(FFT_SIZE == 256 || FFT_SIZE == 512 || FFT_SIZE == 1024 || FFT_SIZE == 2048,
+                "FFT size must be 256, 512, 1024 or 2048");
+  static_assert(WINDOW_LEN > 0 && WINDOW_LEN <= FFT_SIZE, "window longer than the FFT");
+  static_assert(HOP > 0, "hop must be positive");
+
+public:
+  static const int BINS = FFT_SIZE / 2;
+
+  FFTEngine() : lastFrame(0), frames(0) {
+    arm_rfft_fast_init_f32(&rfft, FFT_SIZE);
+    float sum = 0;
+    for (int i = 0; i < WINDOW_LEN; i++) {
+      float x = (float)i / (WINDOW_LEN - 1);
+      float w;
+      switch (WINDOW) {
+        case FFTWindow::Hann:     w = 0.5f - 0.5f * cosf(2 * PI * x); break;
+        case FFTWindow::Hamming:  w = 0.54f - 0.46f * cosf(2 * PI * x); break;
+        case FFTWindow::Blackman: w = 0.42f - 0.5f * cosf(2 * PI * x) + 0.08f * cosf(4 * PI * x); break;
+        default:                  w = 1.0f; break;
+      }
+      window[i] = w;
+      sum += w;
+    }
+    // Sample scale (1/32768) and the window's coherent gain in one factor
+    scale = 2.0f / (sum * 32768.0f);
+    memset(mag, 0, sizeof(mag));
+  }
+
+  static float binHz() { return AUDIO_SAMPLE_RATE_EXACT / FFT_SIZE; }
+  static int windowLength() { return WINDOW_LEN; }
+
+  // A new frame is due: HOP samples since the last one and a full window
+  template <int N>
+  bool ready(const AudioSampleRing<N> &ring) const {
+    static_assert(WINDOW_LEN <= N, "ring shorter than the analysis window");
+    uint32_t n = ring.samplesWritten();
+    return n >= (uint32_t)WINDOW_LEN && n - lastFrame >= (uint32_t)HOP;
+  }
+
+  // Analyse the newest window if ready(); true when magnitudes() changed.
+  template <int N>
+  bool compute(const AudioSampleRing<N> &ring) {
+    if (!ready(ring)) return false;
+    lastFrame = ring.snapshot(samples, WINDOW_LEN);
+    frames++;
+
+    for (int i = 0; i < WINDOW_LEN; i++) in[i] = samples[i] * window[i];
+    if (WINDOW_LEN < FFT_SIZE) memset(in + WINDOW_LEN, 0, (FFT_SIZE - WINDOW_LEN) * sizeof(float));
+
+    arm_rfft_fast_f32(&rfft, in, out, 0);
+    mag[0] = fabsf(out[0]) * scale * 0.5f;        // DC is not doubled
+    arm_cmplx_mag_f32(out + 2, mag + 1, BINS - 1);
+    for (int i = 1; i < BINS; i++) mag[i] *= scale;
+    return true;
+  }
+
+  const float *magnitudes() const { return mag; }
+  float read(int bin) const { return bin >= 0 && bin < BINS ? mag[bin] : 0.0f; }
+
+  // samplesWritten() at the newest sample of the current frame
+  uint32_t frameTime() const { return lastFrame; }
+  uint32_t frameCount() const { return frames; }
+
+private:
+  arm_rfft_fast_instance_f32 rfft;
+  float window[WINDOW_LEN];
+  float scale;
+  int16_t samples[WINDOW_LEN];
+  float in[FFT_SIZE];
+  float out[FFT_SIZE];
+  float mag[BINS];
+  uint32_t lastFrame;
+  uint32_t frames;
+};
+
+#endif
@@ -0,0 +1,114 @@
+// Guess policies for Trigger<> (trigger_engine.h)
+//
+//   NoGuess             no early estimate: every hit waits for the pitch
+//                       policy, as before (the default)
+//   ZeroCrossingGuess   period between Schmitt-trigger up-crossings of the
+//                       samples since the onset (calculateZCR() in
+//                       grum-pedal.cpp, with hysteresis), after one or two
+//                       periods of the note
+//
+// A guess only has to land in the right band, not be in tune, so it can
+// come from far less audio than the pitch policy needs: two periods of a
+// G string are 10 ms, where YIN waits out a low E's window whatever the
+// note. The engine plays the guessed drum at once and checks it against
+// the pitch policy when that reports; see Trigger::speculate().
+//
+//   struct GuessPolicy {
+//     GuessPolicy(AudioStream &input);
+//     void begin();
+//     static constexpr AudioBudget budget();
+//     void onset(const TriggerOnset &o);   // a new note started
+//     float guess(const TriggerOnset &o);  // Hz, -1 while unknown
+//   };
+
+#ifndef guess_policies_h_
+#define guess_policies_h_
+
+#include <Arduino.h>
+#include <Audio.h>
+#include "audio_budget.h"
+#include "audio_sample_ring.h"
+#include "onset_policies.h"
+
+class NoGuess
+{
+public:
+  explicit NoGuess(AudioStream &) {}
+  void begin() {}
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+  void onset(const TriggerOnset &) {}
+  float guess(const TriggerOnset &) { return -1.0f; }
+};
+
+class ZeroCrossingGuess
+{
+public:
+  static const int RING = 2048;        // 46 ms, two periods of a low E
+
+  explicit ZeroCrossingGuess(AudioStream &input)
+    : cord(input, 0, ring, 0), wanted(2), minHz(55.0f), start(0), tried(0) {}
+
+  void begin() {}
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+
+  // Periods to measure before guessing (1..8, default 2) and the lowest
+  // note worth waiting for
+  void periods(uint8_t n) { wanted = constrain(n, 1, 8); }
+  void lowest(float hz) { minHz = hz; }
+
+  // The onset block is the newest one in the ring
+  void onset(const TriggerOnset &)
+  {
+    start = ring.samplesWritten() - AUDIO_BLOCK_SAMPLES;
+    tried = start;
+  }
+
+  float guess(const TriggerOnset &)
+  {
+    const uint32_t written = ring.samplesWritten();
+    if (written == tried) return -1.0f;        // nothing new since the last try
+    tried = written;
+    uint32_t len = written - start;
+    if (len > (uint32_t)RING) return -1.0f;   // too late to be a guess
+    if (len > (uint32_t)(AUDIO_SAMPLE_RATE_EXACT / minHz) * (wanted + 1)) return -1.0f;
+
+    ring.snapshot(frame, len);
+
+    int16_t peak = 0;
+    for (uint32_t i = 0; i < len; i++) {
+      int16_t a = frame[i] < 0 ? -frame[i] : frame[i];
+      if (a > peak) peak = a;
+    }
+    // AudioAnalyzePluckTrigger's hysteresis: 30% of the peak rejects the
+    // extra crossings of the upper harmonics in the attack
+    const int16_t hyst = peak * 3 / 10;
+    if (hyst < 64) return -1.0f;
+
+    bool above = false;
+    int32_t first = -1, last = -1;
+    uint8_t crossings = 0;
+    for (uint32_t i = 0; i < len; i++) {
+      if (!above && frame[i] > hyst) {
+        above = true;
+        if (first < 0) first = i;
+        last = i;
+        crossings++;
+      } else if (above && frame[i] < -hyst) {
+        above = false;
+      }
+    }
+    if (crossings < wanted + 1) return -1.0f;
+    return AUDIO_SAMPLE_RATE_EXACT * (crossings - 1) / (float)(last - first);
+  }
+
+private:
+  AudioSampleRing<RING> ring;
+  AudioConnection cord;
+  int16_t frame[RING];
+  uint8_t wanted;
+  float minHz;
+  uint32_t start;
+  uint32_t tried;
+};
+
+#endif
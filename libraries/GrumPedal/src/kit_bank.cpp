@@ -0,0 +1,197 @@
+#include "kit_bank.h"
+#include <AudioStream.h>
+
+KitBank::KitBank(DrumVoiceManager &v, AudioPlaySamplePool &p)
+  : voices(v), pool(p), kits(nullptr), numKits(0), active(0), wanted(-1), broken(0), switchCount(0)
+{
+  for (uint8_t i = 0; i < 2; i++) {
+    banks[i].kit = 0;
+    banks[i].loaded = 0;
+    banks[i].state = EMPTY;
+  }
+}
+
+// The kit after `kit`, passing over any that failed to load
+uint8_t KitBank::following(uint8_t kit) const
+{
+  for (uint8_t n = 1; n < numKits; n++) {
+    uint8_t k = (kit + n) % numKits;
+    if (!(broken & (1UL << k))) return k;
+  }
+  return (kit + 1) % numKits;
+}
+
+bool KitBank::inUse(const Bank &b) const
+{
+  for (uint8_t i = 0; i < MAX_FILES; i++) {
+    if (b.samples[i].loaded() && pool.uses(b.samples[i])) return true;
+  }
+  return false;
+}
+
+// Start loading kit into b, once nothing plays from it any more. A bank
+// already holding the kit is kept as is.
+void KitBank::prepare(Bank &b, uint8_t kit)
+{
+  if (b.kit == kit && b.state == READY) return;
+  if (b.state == LOADING) loader.cancel();
+  b.kit = kit;
+  b.loaded = 0;
+  b.state = DRAINING;
+}
+
+// About maxBytes more of b's kit. Returns false when the kit cannot be
+// used.
+bool KitBank::loadNext(Bank &b, uint32_t maxBytes)
+{
+  const KitDef &k = kits[b.kit];
+  uint8_t n = fileCount(b.kit);
+  if (loader.busy()) {
+    if (!loader.step(maxBytes)) b.loaded++;
+  } else if (b.loaded < n) {
+    const KitFile &f = k.files[b.loaded];
+    if (!loader.begin(b.samples[b.loaded], f.file)) {
+      if (f.required) {
+        broken |= 1UL << b.kit;
+        b.state = FAILED;   // loaded stays on the file, for printStatus()
+        return false;
+      }
+      b.loaded++;         // optional layer not on the card
+    }
+  }
+  if (b.loaded >= n) b.state = READY;
+  return true;
+}
+
+bool KitBank::begin(const KitDef *k, uint8_t count, uint8_t first)
+{
+  kits = k;
+  numKits = count < MAX_KITS ? count : (uint8_t)MAX_KITS;
+  broken = 0;
+  if (!numKits) return false;
+
+  // The first kit that loads, blocking; nothing is playing yet
+  Bank &b = banks[active];
+  uint8_t kit = first % numKits;
+  for (uint8_t tries = 0; tries < numKits; tries++, kit = following(kit)) {
+    for (uint8_t i = 0; i < MAX_FILES; i++) b.samples[i].unload();
+    b.kit = kit;
+    b.loaded = 0;
+    b.state = LOADING;
+    while (b.state == LOADING) loadNext(b, 0xFFFFFFFF);
+    if (b.state == READY) break;
+  }
+  if (b.state != READY) return false;
+
+  // Apply it the way a switch would
+  active = !active;
+  swap();
+  switchCount = 0;
+  return true;
+}
+
+bool KitBank::standbyReady() const
+{
+  return banks[!active].state == READY;
+}
+
+void KitBank::swap()
+{
+  const Bank &b = banks[!active];
+  const KitDef &k = kits[b.kit];
+
+  // Between two updates, so every noteOn after this plays the new kit
+  AudioNoInterrupts();
+  for (uint8_t d = 0; d < DrumVoiceManager::MAX_DRUMS; d++) voices.clearLayers(d);
+  for (uint8_t i = 0; i < b.loaded; i++) {
+    voices.addLayer(k.files[i].drum, b.samples[i], k.files[i].minVelocity);
+  }
+  for (uint8_t i = 0; i < k.numDrums; i++) {
+    const KitDrum &d = k.drums[i];
+    voices.setDrum(d.drum, d.gain, d.chokeGroup, d.maxVoices);
+  }
+  AudioInterrupts();
+
+  active = !active;
+  wanted = -1;
+  switchCount++;
+
+  // The old bank drains, then takes the kit after this one
+  if (numKits > 1) prepare(banks[!active], following(current()));
+}
+
+bool KitBank::select(uint8_t i)
+{
+  if (i >= numKits) return false;
+  if (i == current()) {
+    wanted = -1;
+    return true;
+  }
+  Bank &s = banks[!active];
+  if (s.kit == i && s.state == READY) {
+    swap();
+    return true;
+  }
+  if (s.kit != i || s.state == FAILED || s.state == EMPTY) prepare(s, i);
+  wanted = i;
+  return false;
+}
+
+bool KitBank::next()
+{
+  if (numKits < 2) return false;
+  return select(following(wanted >= 0 ? wanted : current()));
+}
+
+void KitBank::service(uint32_t maxBytes)
+{
+  if (numKits < 2) return;
+  Bank &s = banks[!active];
+  switch (s.state) {
+    case DRAINING:
+      if (inUse(s)) break;
+      for (uint8_t i = 0; i < MAX_FILES; i++) s.samples[i].unload();
+      s.state = LOADING;
+      break;
+    case LOADING:
+      loadNext(s, maxBytes);
+      break;
+    case FAILED: {
+      // Skip the broken kit, including for a switch waiting on it
+      uint8_t skip = following(s.kit);
+      if (wanted == s.kit) wanted = skip == current() ? -1 : skip;
+      if (skip == current()) {
+        s.state = EMPTY;
+      } else {
+        prepare(s, skip);
+      }
+      break;
+    }
+    case READY:
+      if (wanted == s.kit) swap();
+      break;
+    case EMPTY:
+      break;
+  }
+}
+
+void KitBank::printStatus(Print &out) const
+{
+  static const char *const STATES[] = { "empty", "draining", "loading", "ready", "failed" };
+  for (uint8_t i = 0; i < 2; i++) {
+    const Bank &b = banks[i];
+    if (!kits || b.state == EMPTY) {
+      out.printf("bank %u: empty\n", i);
+      continue;
+    }
+    uint32_t bytes = 0;
+    for (uint8_t f = 0; f < b.loaded; f++) bytes += b.samples[f].bytes();
+    out.printf("bank %u: kit %u %-10s %-8s %u/%u files %lu bytes%s\n", i, b.kit, kits[b.kit].name,
+               i == active ? "active" : STATES[b.state], b.loaded, fileCount(b.kit),
+               (unsigned long)bytes, i != active && wanted == b.kit ? "  (switch pending)" : "");
+    if (b.state == FAILED) {
+      const DrumSample &s = b.samples[b.loaded];
+      out.printf("  %s: %s\n", kits[b.kit].files[b.loaded].file, s.error() ? s.error() : "not loaded");
+    }
+  }
+}
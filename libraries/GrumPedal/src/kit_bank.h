@@ -0,0 +1,128 @@
+// KitBank - switch between drum kits mid-song without a gap
+//
+// Two banks of DrumSamples: the active kit plays while service(), called
+// from loop(), loads the next kit into the standby bank a piece at a
+// time. next() or select() then swaps the banks in one step between two
+// audio updates: layers and per-drum levels (what setDrum() would have
+// set up) change together, hits already sounding keep playing the old
+// kit's samples, and the old bank is not reloaded until the pool has
+// finished with every one of them. Each service() reads at most a few KB
+// (DrumSampleLoader), so loading never holds up the trigger loop for
+// long.
+//
+// A switch asked for before the standby kit has loaded happens as soon as
+// it has; pending() says so. Kits with a required file missing are
+// skipped. Both banks are in RAM at once, so the largest two kits must
+// fit together.
+//
+// Usage:
+//   const KitFile rockFiles[] = { { KICK, "ROCK/KICK.WAV", 0.0f, true }, ... };
+//   const KitDrum rockDrums[] = { { KICK, 0.72f, 0, 0 }, ... };
+//   const KitDef kits[] = { KIT_DEF("Rock", rockFiles, rockDrums), ... };
+//
+//   KitBank bank(voices, drumPool);
+//   bank.begin(kits, 3);     // loads kit 0, then preloads kit 1
+//   bank.service();          // in loop()
+//   bank.next();             // footswitch
+
+#ifndef kit_bank_h_
+#define kit_bank_h_
+
+#include <Arduino.h>
+#include "drum_sample.h"
+#include "drum_voices.h"
+
+struct KitFile {
+  uint8_t drum;
+  const char *file;      // must stay valid (a literal)
+  float minVelocity;     // velocity layer, see DrumVoiceManager::addLayer()
+  bool required;         // the kit is unusable without it
+};
+
+struct KitDrum {
+  uint8_t drum;
+  float gain;            // DrumVoiceManager::setDrum() arguments
+  uint8_t chokeGroup;
+  uint8_t maxVoices;
+};
+
+struct KitDef {
+  const char *name;
+  const KitFile *files;
+  uint8_t numFiles;
+  const KitDrum *drums;
+  uint8_t numDrums;
+};
+
+#define KIT_DEF(name, files, drums) \
+  { name, files, sizeof(files) / sizeof((files)[0]), drums, sizeof(drums) / sizeof((drums)[0]) }
+
+class KitBank
+{
+public:
+  static const uint8_t MAX_FILES = 16;
+  static const uint8_t MAX_KITS = 32;
+
+  KitBank(DrumVoiceManager &voices, AudioPlaySamplePool &pool);
+
+  // Load kits[first] (blocking) and make it current; the first kit that
+  // loads if that one cannot. False if none does.
+  bool begin(const KitDef *kits, uint8_t count, uint8_t first = 0);
+
+  // loop() side: free, load and swap the standby bank, reading about
+  // maxBytes per call.
+  void service(uint32_t maxBytes = 4096);
+
+  // Switch to the next kit, or to kit i. True if it happened now; false
+  // if it will once the standby bank has loaded.
+  bool next();
+  bool select(uint8_t i);
+
+  uint8_t current() const { return banks[active].kit; }
+  const char *name() const { return kits ? kits[current()].name : ""; }
+  uint8_t kitCount() const { return numKits; }
+  bool pending() const { return wanted >= 0; }
+  // Kit a pending switch goes to (broken kits skipped), -1 for none
+  int8_t wantedKit() const { return wanted; }
+  bool standbyReady() const;
+  uint32_t switches() const { return switchCount; }
+
+  // Kit per bank, load state and RAM use.
+  void printStatus(Print &out) const;
+
+private:
+  KitBank(const KitBank &) = delete;
+  KitBank &operator=(const KitBank &) = delete;
+
+  enum State : uint8_t { EMPTY, DRAINING, LOADING, READY, FAILED };
+
+  struct Bank {
+    DrumSample samples[MAX_FILES];
+    uint8_t kit;
+    uint8_t loaded;      // files of kits[kit] tried so far
+    State state;
+  };
+
+  bool inUse(const Bank &b) const;
+  bool loadNext(Bank &b, uint32_t maxBytes);
+  void prepare(Bank &b, uint8_t kit);
+  void swap();
+  uint8_t following(uint8_t kit) const;
+  uint8_t fileCount(uint8_t kit) const
+  {
+    return kits[kit].numFiles < MAX_FILES ? kits[kit].numFiles : (uint8_t)MAX_FILES;
+  }
+
+  DrumVoiceManager &voices;
+  AudioPlaySamplePool &pool;
+  const KitDef *kits;
+  uint8_t numKits;
+  Bank banks[2];
+  DrumSampleLoader loader;   // for the standby bank
+  uint8_t active;
+  int8_t wanted;         // kit to switch to once standby has it, -1 for none
+  uint32_t broken;       // kits that failed to load, skipped by next()
+  uint32_t switchCount;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "latency_probe.h"
+
+static const char *const STAGE_NAMES[LatencyProbe::NUM_STAGES] = { "seen", "note", "output" };
+
+LatencyProbe::LatencyProbe()
+{
+  reset();
+}
+
+void LatencyProbe::begin()
+{
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+  reset();
+}
+
+void LatencyProbe::reset()
+{
+  __disable_irq();
+  memset(stats, 0, sizeof(stats));
+  for (int s = 0; s < NUM_STAGES; s++) stats[s].minUs = 0xFFFFFFFF;
+  start = 0;
+  state = IDLE;
+  dropped = 0;
+  __enable_irq();
+}
+
+uint32_t LatencyProbe::toMicros(uint32_t cycles)
+{
+#if defined(F_CPU_ACTUAL)
+  return cycles / (F_CPU_ACTUAL / 1000000);
+#else
+  return cycles / (F_CPU / 1000000);
+#endif
+}
+
+void LatencyProbe::add(Stage s, uint32_t cycles)
+{
+  Stats &st = stats[s];
+  uint32_t us = toMicros(cycles);
+  uint32_t bin = us / BIN_US;
+  if (bin >= (uint32_t)BINS) bin = BINS - 1;
+  if (st.hist[bin] < 0xFFFF) st.hist[bin]++;
+  if (us < st.minUs) st.minUs = us;
+  if (us > st.maxUs) st.maxUs = us;
+  st.sumUs += us;
+  st.count++;
+}
+
+void LatencyProbe::onset(uint32_t onsetCycles)
+{
+  uint32_t t = now();
+  __disable_irq();
+  if (state != IDLE) dropped++;
+  start = onsetCycles;
+  state = WAIT_NOTE;
+  __enable_irq();
+  add(STAGE_SEEN, t - onsetCycles);
+}
+
+void LatencyProbe::noteOn()
+{
+  if (state != WAIT_NOTE) return;
+  add(STAGE_NOTE, now() - start);
+  // From here the ISR owns the trace
+  state = WAIT_OUTPUT;
+}
+
+void LatencyProbe::output()
+{
+  if (state != WAIT_OUTPUT) return;
+  add(STAGE_OUTPUT, now() - start);
+  state = IDLE;
+}
+
+// Upper edge of the bin holding the given fraction of hits, capped at the
+// largest value actually seen
+uint32_t LatencyProbe::percentile(const Stats &st, uint32_t permille)
+{
+  uint32_t want = ((uint64_t)st.count * permille + 999) / 1000;
+  uint32_t seen = 0;
+  for (int b = 0; b < BINS; b++) {
+    seen += st.hist[b];
+    if (seen >= want) {
+      uint32_t edge = (b + 1) * BIN_US;
+      return edge < st.maxUs ? edge : st.maxUs;
+    }
+  }
+  return st.maxUs;
+}
+
+void LatencyProbe::print(Print &out)
+{
+  // Copy out so the ISR can't update a stage half way through the report
+  Stats copy[NUM_STAGES];
+  __disable_irq();
+  memcpy(copy, stats, sizeof(copy));
+  uint32_t lost = dropped;
+  __enable_irq();
+
+  out.printf("Latency from onset block (us), %lu abandoned\n", (unsigned long)lost);
+  for (int s = 0; s < NUM_STAGES; s++) {
+    const Stats &st = copy[s];
+    if (st.count == 0) {
+      out.printf("  %-6s no hits\n", STAGE_NAMES[s]);
+      continue;
+    }
+    out.printf("  %-6s n=%-5lu min %6lu avg %6lu p99 %6lu max %6lu\n", STAGE_NAMES[s],
+               (unsigned long)st.count, (unsigned long)st.minUs,
+               (unsigned long)(st.sumUs / st.count), (unsigned long)percentile(st, 990),
+               (unsigned long)st.maxUs);
+  }
+}
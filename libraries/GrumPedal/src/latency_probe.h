@@ -0,0 +1,82 @@
+// LatencyProbe - pick-to-drum timing from the DWT cycle counter
+//
+// Follows one hit at a time through four timestamps:
+//
+//   onset   the audio update() that saw the block cross the threshold
+//           (PluckEvent::cycles), or loop() for detectors with no ISR stamp
+//   seen    loop() read the event
+//   note    noteOn() / play() is about to be called (stamp it first, so
+//           the ISR can't render the voice before the probe expects it)
+//   output  the first block carrying the new voice left its audio object
+//           (AudioPlaySamplePool or AudioMixerFused, via latencyProbe())
+//
+// and keeps a histogram of seen, note and output measured from onset. The
+// onset block itself was captured one block (2.9 ms) before its update()
+// ran, and the output block reaches the codec one to two blocks after it
+// is transmitted; both are fixed and not included.
+//
+// A hit that never reaches noteOn() (retrigger lockout, no pitch) is
+// dropped when the next onset arrives and counted in abandoned().
+//
+// Usage:
+//   LatencyProbe probe;
+//   probe.begin();
+//   drumPool.latencyProbe(&probe);
+//   while (pluck.read(ev)) { probe.onset(ev.cycles); ... probe.noteOn(); voices.noteOn(..); }
+//   if (Serial.read() == 'l') probe.print(Serial);
+
+#ifndef latency_probe_h_
+#define latency_probe_h_
+
+#include <Arduino.h>
+
+class LatencyProbe
+{
+public:
+  enum Stage { STAGE_SEEN, STAGE_NOTE, STAGE_OUTPUT, NUM_STAGES };
+
+  static const int BINS = 128;
+  static const uint32_t BIN_US = 250;    // 32 ms span, later hits go in the top bin
+
+  LatencyProbe();
+
+  // Start the cycle counter (already running on Teensy 4) and clear.
+  void begin();
+  void reset();
+
+  static uint32_t now() { return ARM_DWT_CYCCNT; }
+
+  // loop() side: a new onset stamped at `onsetCycles`, then its drum start.
+  void onset(uint32_t onsetCycles);
+  void noteOn();
+
+  // Audio ISR side: a block containing a newly started voice was sent.
+  void output();
+
+  uint32_t count(Stage s) const { return stats[s].count; }
+  uint32_t abandoned() const { return dropped; }
+
+  // min / avg / p99 / max in microseconds for each stage.
+  void print(Print &out);
+
+private:
+  struct Stats {
+    uint32_t count;
+    uint32_t minUs, maxUs;
+    uint64_t sumUs;
+    uint16_t hist[BINS];
+  };
+
+  enum State : uint8_t { IDLE, WAIT_NOTE, WAIT_OUTPUT };
+
+  void add(Stage s, uint32_t cycles);
+  static uint32_t toMicros(uint32_t cycles);
+  static uint32_t percentile(const Stats &st, uint32_t permille);
+
+  Stats stats[NUM_STAGES];
+  uint32_t start;
+  volatile State state;
+  uint32_t dropped;
+};
+
+#endif
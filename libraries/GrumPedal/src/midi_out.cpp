@@ -0,0 +1,163 @@
+#include "midi_out.h"
+
+static const uint8_t NOTE_ON = 0x90;
+
+MidiOut::MidiOut()
+  : din(nullptr), usb(false), usbPending(false), chan(10), runningStatus(0),
+    velMin(1), velMax(127), velCurve(1.0f), sentCount(0), droppedCount(0), dinDroppedCount(0)
+{
+  for (uint8_t i = 0; i < MAX_NOTES; i++) notes[i].on = false;
+}
+
+void MidiOut::begin(Print *dinPort, bool useUsb)
+{
+  din = dinPort;
+#if defined(MIDI_INTERFACE)
+  usb = useUsb;
+#else
+  (void)useUsb;
+  usb = false;
+#endif
+  runningStatus = 0;
+}
+
+void MidiOut::velocityCurve(uint8_t minVel, uint8_t maxVel, float curve)
+{
+  velMin = constrain(minVel, 1, 127);
+  velMax = constrain(maxVel, velMin, 127);
+  velCurve = curve > 0.0f ? curve : 1.0f;
+}
+
+uint8_t MidiOut::velocity(float v) const
+{
+  v = constrain(v, 0.0f, 1.0f);
+  if (velCurve != 1.0f) v = powf(v, velCurve);
+  return velMin + (uint8_t)(v * (velMax - velMin) + 0.5f);
+}
+
+uint8_t MidiOut::send(uint8_t status, uint8_t d1, uint8_t d2, uint8_t ports)
+{
+  status |= chan - 1;
+  uint8_t sentTo = 0;
+  if (din && (ports & PORT_DIN)) {
+    // A note that doesn't fit would block loop() until the UART drains;
+    // skip DIN and let USB have it
+    const int need = status == runningStatus ? 2 : 3;
+    if (din->availableForWrite() >= need) {
+      if (status != runningStatus) din->write(status);
+      din->write(d1);
+      din->write(d2);
+      runningStatus = status;
+      sentTo |= PORT_DIN;
+    } else if (d2) {
+      dinDroppedCount++;
+    }
+  }
+#if defined(MIDI_INTERFACE)
+  if (usb && (ports & PORT_USB)) {
+    if (d2) usbMIDI.sendNoteOn(d1, d2, chan);
+    else usbMIDI.sendNoteOff(d1, d2, chan);
+    usbPending = true;
+    sentTo |= PORT_USB;
+  }
+#endif
+  if (sentTo) sentCount++;
+  else if (d2) droppedCount++;
+  return sentTo;
+}
+
+bool MidiOut::release(Note &n)
+{
+  // Note-on with velocity 0 keeps the DIN running status of the hits.
+  // Only the ports still sounding it; one without room keeps its bit.
+  n.ports &= ~send(NOTE_ON, n.note, 0, n.ports);
+  if (n.ports) return false;
+  n.on = false;
+  return true;
+}
+
+void MidiOut::dueNow(Note &n)
+{
+  n.start = micros() - 1;
+  n.length = 1;
+}
+
+int MidiOut::slotFor(uint8_t note)
+{
+  int free = -1;
+  int oldest = -1;
+  const uint32_t now = micros();
+  for (uint8_t i = 0; i < MAX_NOTES; i++) {
+    if (!notes[i].on) {
+      if (free < 0) free = i;
+      continue;
+    }
+    if (notes[i].note == note) return i;
+    if (oldest < 0 || now - notes[i].start > now - notes[oldest].start) oldest = i;
+  }
+  return free >= 0 ? free : oldest;
+}
+
+bool MidiOut::noteOn(uint8_t note, float v, uint16_t lengthMs)
+{
+  note &= 0x7F;
+  const int slot = slotFor(note);
+  Note &n = notes[slot];
+  // Same note still sounding, or the table is full: end the old one first.
+  // A port that had no room for the note-off still owes it; the same note
+  // can carry that over, another can't take the slot.
+  if (n.on && !release(n) && n.note != note) {
+    droppedCount++;
+    return false;
+  }
+  const uint8_t owed = n.on ? n.ports : 0;
+  const uint8_t ports = send(NOTE_ON, note, velocity(v), PORT_DIN | PORT_USB);
+  if (!ports) return false;
+  n.start = micros();
+  n.length = (uint32_t)lengthMs * 1000;
+  n.note = note;
+  n.ports = ports | owed;
+  n.on = true;
+  return true;
+}
+
+void MidiOut::noteOff(uint8_t note)
+{
+  note &= 0x7F;
+  for (uint8_t i = 0; i < MAX_NOTES; i++) {
+    if (notes[i].on && notes[i].note == note) {
+      // If the UART is full, service() retries it as an overdue note
+      if (!release(notes[i])) dueNow(notes[i]);
+      return;
+    }
+  }
+}
+
+void MidiOut::allNotesOff()
+{
+  for (uint8_t i = 0; i < MAX_NOTES; i++) {
+    if (notes[i].on && !release(notes[i])) dueNow(notes[i]);
+  }
+}
+
+void MidiOut::service()
+{
+  const uint32_t now = micros();
+  for (uint8_t i = 0; i < MAX_NOTES; i++) {
+    Note &n = notes[i];
+    if (n.on && n.length && now - n.start >= n.length) release(n);
+  }
+#if defined(MIDI_INTERFACE)
+  if (usbPending) {
+    usbMIDI.send_now();
+    usbPending = false;
+  }
+#endif
+}
+
+uint8_t MidiOut::holding() const
+{
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < MAX_NOTES; i++) count += notes[i].on;
+  return count;
+}
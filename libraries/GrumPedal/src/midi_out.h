@@ -0,0 +1,101 @@
+// MidiOut - trigger events to USB MIDI and 5-pin DIN MIDI
+//
+// Called from loop() as trigger events come off the detector's queue
+// (AudioAnalyzePluckTrigger::read() or a sketch's own), so a hit goes out
+// as soon as loop() sees it. noteOn() sends at once and books the note-off
+// in a small table that service() empties as the notes fall due; nothing
+// waits. Note-offs are polled with micros(), so their timing is as fine
+// as loop() is fast.
+//
+// USB messages are only queued by noteOn(); service() sends them with one
+// usbMIDI.send_now(), so all the strings of a strum handled in the same
+// loop() pass share one USB packet. The DIN port (any Print, usually
+// Serial1 begun at 31250 baud) uses running status, and a note is only
+// written when the UART buffer has room for it: a note-on that doesn't
+// fit is skipped on DIN and counted (dinDropped()) but still goes out on
+// USB, and a note-off waits for the next service() on the port that had
+// no room. Each note remembers which ports it sounds on.
+//
+// usbMIDI exists when the Tools > USB Type menu includes MIDI; without
+// it only the DIN port is used.
+//
+// Usage:
+//   MidiOut midi;
+//   Serial1.begin(31250);
+//   midi.begin(&Serial1);
+//   midi.noteOn(36, velocity);      // kick, note-off after 100 ms
+//   midi.service();                 // once per loop(), after the events
+
+#ifndef midi_out_h_
+#define midi_out_h_
+
+#include <Arduino.h>
+
+class MidiOut
+{
+public:
+  static const uint8_t MAX_NOTES = 16;        // note-offs in flight
+  static const uint16_t DEFAULT_LENGTH_MS = 100;
+
+  MidiOut();
+
+  // din: 5-pin output, already begun at 31250 baud (nullptr for none).
+  // usb: also send on usbMIDI, if the build has it.
+  void begin(Print *din, bool usb = true);
+
+  void channel(uint8_t ch) { chan = constrain(ch, 1, 16); }   // 10 = GM drums
+  uint8_t channel() const { return chan; }
+
+  // Onset velocity 0..1 to MIDI minVel..maxVel along v^curve
+  // (curve < 1 lifts soft hits). Default 1..127, linear.
+  void velocityCurve(uint8_t minVel, uint8_t maxVel, float curve = 1.0f);
+  uint8_t velocity(float v) const;
+
+  // lengthMs = 0 holds the note until noteOff(). A note still sounding
+  // is turned off first.
+  bool noteOn(uint8_t note, float velocity, uint16_t lengthMs = DEFAULT_LENGTH_MS);
+  void noteOff(uint8_t note);
+  void allNotesOff();
+
+  // Due note-offs, then one USB flush. Call every loop().
+  void service();
+
+  // Messages sent on at least one port; note-ons sent on none
+  uint32_t sent() const { return sentCount; }
+  uint32_t dropped() const { return droppedCount; }
+  // Note-ons skipped on DIN for want of UART room
+  uint32_t dinDropped() const { return dinDroppedCount; }
+  uint8_t holding() const;
+
+private:
+  static const uint8_t PORT_DIN = 1;
+  static const uint8_t PORT_USB = 2;
+
+  struct Note {
+    uint32_t start;      // micros() of the note-on
+    uint32_t length;     // us, 0 = until noteOff()
+    uint8_t note;
+    uint8_t ports;       // PORT_* still owed its note-off
+    bool on;
+  };
+
+  // Returns the PORT_* of `ports` that took it; d2 = 0 is a note-off
+  uint8_t send(uint8_t status, uint8_t d1, uint8_t d2, uint8_t ports);
+  bool release(Note &n);
+  void dueNow(Note &n);
+  int slotFor(uint8_t note);
+
+  Print *din;
+  bool usb;
+  bool usbPending;       // queued on usbMIDI since the last send_now()
+  uint8_t chan;
+  uint8_t runningStatus; // last status byte on DIN, 0 for none
+  uint8_t velMin, velMax;
+  float velCurve;
+  Note notes[MAX_NOTES];
+  uint32_t sentCount;
+  uint32_t droppedCount;
+  uint32_t dinDroppedCount;
+};
+
+#endif
@@ -0,0 +1,171 @@
+// AudioMixerFused<N> - one N input mixer with per-channel gain ramps
+//
+// Sums N inputs in a single pass, replacing cascades like
+// drumMixer -> mainMixer that cost an extra block and an extra pass per
+// stage. Two ways to set a channel's gain:
+//
+//   gain(ch, g)      ramps to g over the next block (level changes, bypass)
+//   noteGain(ch, g)  steps to g at the next block boundary; use it when the
+//                    source on that channel restarts in the same update
+//                    (AudioSynthSimpleDrum::noteOn), so the velocity applies
+//                    to the new note only and never to a tail still playing
+//
+// noteGain(ch, g, offset) also moves the restarted note `offset` samples
+// into the block, so it starts where the pick was rather than on the block
+// edge: the channel is delayed by offset samples from then on, the samples
+// before it finish the previous note's delayed tail (or are silent), and
+// the delay stays until the channel's next note. A channel that never gets
+// an offset is mixed straight through.
+//
+// Usage:
+//   AudioMixerFused<6> drumBus;           // dry guitar + five drums
+//   drumBus.gain(0, 0.0f);
+//   drumKick.noteOn(); drumBus.noteGain(1, 0.56f * velocity, ev.offset);
+
+#ifndef mixer_fused_h_
+#define mixer_fused_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include <dspinst.h>
+#include "latency_probe.h"
+
+template <int N>
+class AudioMixerFused : public AudioStream
+{
+public:
+  AudioMixerFused() : AudioStream(N, inputQueueArray), noted(false), probe(nullptr)
+  {
+    for (int i = 0; i < N; i++) {
+      current[i] = target[i] = 65536;
+      startDelay[i] = nextDelay[i] = 0;
+      restart[i] = false;
+    }
+  }
+
+  void gain(unsigned int channel, float level)
+  {
+    if (channel >= N) return;
+    target[channel] = toQ16(level);
+  }
+
+  void noteGain(unsigned int channel, float level, uint8_t offset = 0)
+  {
+    if (channel >= N) return;
+    int32_t g = toQ16(level);
+    if (offset >= AUDIO_BLOCK_SAMPLES) offset = AUDIO_BLOCK_SAMPLES - 1;
+    __disable_irq();
+    if (!restart[channel]) tailGain[channel] = current[channel];
+    current[channel] = target[channel] = g;
+    nextDelay[channel] = offset;
+    restart[channel] = true;
+    noted = true;
+    __enable_irq();
+  }
+
+  // Report the first block after each noteGain() to `probe`: the block the
+  // restarted source lands in (nullptr to stop).
+  void latencyProbe(LatencyProbe *p) { probe = p; }
+
+  virtual void update(void)
+  {
+    int32_t acc[AUDIO_BLOCK_SAMPLES];
+    bool any = false;
+    bool started = noted;
+    noted = false;
+
+    for (int ch = 0; ch < N; ch++) {
+      audio_block_t *in = receiveReadOnly(ch);
+      int32_t g0 = current[ch], g1 = target[ch];
+      current[ch] = g1;
+      if (startDelay[ch] || (restart[ch] && nextDelay[ch])) {
+        if (!any) memset(acc, 0, sizeof(acc));
+        any = true;
+        mixDelayed(acc, ch, in, g0, g1);
+        if (in) release(in);
+        continue;
+      }
+      restart[ch] = false;
+      if (!in) continue;
+      if (g0 == 0 && g1 == 0) {
+        release(in);
+        continue;
+      }
+      if (!any) memset(acc, 0, sizeof(acc));
+      any = true;
+
+      if (g0 == g1) {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+          acc[i] += signed_multiply_32x16b(g0, in->data[i]);
+        }
+      } else {
+        int32_t g = g0;
+        const int32_t step = (g1 - g0) / AUDIO_BLOCK_SAMPLES;
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+          acc[i] += signed_multiply_32x16b(g, in->data[i]);
+          g += step;
+        }
+      }
+      release(in);
+    }
+    if (!any) return;
+
+    audio_block_t *out = allocate();
+    if (!out) return;
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      out->data[i] = signed_saturate_rshift(acc[i], 16, 0);
+    }
+    transmit(out);
+    release(out);
+    if (started && probe) probe->output();
+  }
+
+private:
+  // One channel through its start delay. With a restart this block the
+  // new note begins at its delay and the samples before it finish the old
+  // delay's tail from history[] at the old gain; otherwise the delayed
+  // stream just continues.
+  void mixDelayed(int32_t *acc, int ch, const audio_block_t *in, int32_t g0, int32_t g1)
+  {
+    const int d0 = startDelay[ch];
+    const bool restarted = restart[ch];
+    const int d1 = restarted ? nextDelay[ch] : d0;
+    restart[ch] = false;
+
+    const int16_t *hist = history[ch];
+    int32_t g = g0;
+    const int32_t step = (g1 - g0) / AUDIO_BLOCK_SAMPLES;
+    for (int i = 0; i < d1; i++, g += step) {
+      if (i < d0) acc[i] += signed_multiply_32x16b(restarted ? tailGain[ch] : g, hist[AUDIO_BLOCK_SAMPLES - d0 + i]);
+    }
+    if (in) {
+      for (int i = d1; i < AUDIO_BLOCK_SAMPLES; i++, g += step) {
+        acc[i] += signed_multiply_32x16b(g, in->data[i - d1]);
+      }
+      memcpy(history[ch], in->data, sizeof(history[ch]));
+    } else {
+      memset(history[ch], 0, sizeof(history[ch]));
+    }
+    startDelay[ch] = d1;
+  }
+
+  static int32_t toQ16(float level)
+  {
+    if (level > 32767.0f) level = 32767.0f;
+    if (level < -32767.0f) level = -32767.0f;
+    return (int32_t)(level * 65536.0f);
+  }
+
+  audio_block_t *inputQueueArray[N];
+  volatile int32_t current[N];   // Q16, 65536 = unity
+  volatile int32_t target[N];
+  volatile bool noted;           // noteGain() since the last update
+  volatile bool restart[N];      // noteGain() on this channel since then
+  volatile uint8_t nextDelay[N]; // start delay of that note, samples
+  volatile int32_t tailGain[N];  // gain of the note it replaced
+  uint8_t startDelay[N];         // current start delay
+  int16_t history[N][AUDIO_BLOCK_SAMPLES];   // last input block, for the delay
+  LatencyProbe *probe;
+};
+
+#endif
@@ -0,0 +1,280 @@
+// Onset policies for Trigger<> (trigger_engine.h)
+//
+// Each policy owns the analysers its method needs and connects them to
+// the engine's input in its constructor, so a build only carries the
+// objects of the method it picked.
+//
+//   PluckOnset     energy / HFC test per block in the audio ISR
+//                  (AudioAnalyzePluckTrigger); also measures the period,
+//                  so pair it with OnsetPitch for the lowest latency
+//   EnvelopeOnset  fast/slow EMA ratio of the block RMS, velocity from
+//                  peak and ratio (grum-pedal-sketch_COMBINED, -GPT5);
+//                  the fast envelope must also clear its own decaying
+//                  peak, or a low string's beating retriggers
+//   PeakOnset      peak above an EMA envelope on a rising edge
+//                  (grum_pedal_sketch_Claude_v2)
+//   FluxOnset      spectral flux of a 256 point FFT above its running
+//                  mean, computed in loop() (grum-pedal.cpp FFT path)
+//
+// blocks() is the policy's count of input blocks, and TriggerOnset::block
+// the one the onset was in, so the engine can time a hit from the attack
+// rather than from whenever loop() got to it (Trigger::fixedLatency()).
+// PluckOnset sees every block in the ISR and also finds the attack's
+// sample within it; FluxOnset knows the newest block of its frame; the
+// two policies on stock analysers keep no count and return 0.
+
+#ifndef onset_policies_h_
+#define onset_policies_h_
+
+#include <Arduino.h>
+#include <Audio.h>
+#include "analyze_pluck_trigger.h"
+#include "audio_budget.h"
+#include "audio_sample_ring.h"
+#include "fft_engine.h"
+#include "spectral_frame.h"
+
+struct TriggerOnset {
+  float    velocity;   // 0..1
+  float    frequency;  // Hz if the onset detector measured one, else -1
+  uint32_t cycles;     // ARM_DWT_CYCCNT when the onset was detected
+  uint32_t millis;     // millis() when loop() saw it
+  uint32_t block;      // the policy's blocks() at the onset, 0 if untimed
+  uint8_t  offset;     // sample of that block where the attack starts
+};
+
+class PluckOnset
+{
+public:
+  explicit PluckOnset(AudioStream &input) : cord(input, 0, pluck, 0) {}
+
+  void begin() {}
+  // Analysers only: their input is the caller's block
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+
+  bool poll(TriggerOnset &o)
+  {
+    PluckEvent ev;
+    if (!pluck.read(ev)) return false;
+    o.velocity = ev.velocity;
+    o.frequency = ev.frequency;
+    o.cycles = ev.cycles;
+    o.millis = millis();
+    o.block = ev.block;
+    o.offset = ev.offset;
+    return true;
+  }
+
+  uint32_t blocks() const { return pluck.blocks(); }
+
+  // thresholds(), holdoff(), pitchRange(), level() ...
+  AudioAnalyzePluckTrigger &analyzer() { return pluck; }
+
+private:
+  AudioAnalyzePluckTrigger pluck;
+  AudioConnection cord;
+};
+
+class EnvelopeOnset
+{
+public:
+  explicit EnvelopeOnset(AudioStream &input)
+    : rmsCord(input, 0, rms, 0), peakCord(input, 0, peak, 0),
+      fastAlpha(0.35f), slowAlpha(0.02f), ratioDelta(0.05f), minDelta(0.00005f),
+      minRms(0.0002f), gapMs(90), holdDecay(0.99f), holdRise(1.1f), fastEnv(0), slowEnv(0),
+      heldEnv(0), lastOnset(0) {}
+
+  void begin() {}
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+
+  // EMA coefficients per RMS block, and the onset test: fast/slow above
+  // 1 + ratio and fast - slow above delta.
+  void envelopes(float fast, float slow) { fastAlpha = fast; slowAlpha = slow; }
+  void thresholds(float ratio, float delta, float rmsFloor)
+  {
+    ratioDelta = ratio;
+    minDelta = delta;
+    minRms = rmsFloor;
+  }
+  void holdoff(uint16_t ms) { gapMs = ms; }
+  // The fast envelope's peak, decaying by `decay` per block (0.99: ~290
+  // ms); an onset needs fast above rise x that peak. rise 0 turns it off.
+  void peakHold(float decay, float rise)
+  {
+    holdDecay = decay;
+    holdRise = rise;
+  }
+
+  bool poll(TriggerOnset &o)
+  {
+    if (!rms.available()) return false;
+    float level = rms.read();
+    float pk = peak.available() ? peak.read() : 0.0f;
+    if (level < minRms) return false;
+
+    fastEnv = (1.0f - fastAlpha) * fastEnv + fastAlpha * level;
+    slowEnv = (1.0f - slowAlpha) * slowEnv + slowAlpha * level;
+    float ratio = slowEnv > 1e-8f ? fastEnv / slowEnv : 0.0f;
+    const bool rising = fastEnv > heldEnv * holdRise;
+    heldEnv = max(fastEnv, heldEnv * holdDecay);
+
+    uint32_t now = millis();
+    if (now - lastOnset <= gapMs) return false;
+    if (ratio <= 1.0f + ratioDelta || fastEnv - slowEnv <= minDelta || !rising) return false;
+    lastOnset = now;
+
+    // Peak carries the pick strength, the ratio how sudden it was
+    float vP = constrain(pk * 6.0f, 0.0f, 1.0f);
+    float vR = constrain((ratio - 1.0f) * 6.0f, 0.0f, 1.0f);
+    o.velocity = 0.6f * vP + 0.4f * vR;
+    o.frequency = -1.0f;
+    o.cycles = ARM_DWT_CYCCNT;
+    o.millis = now;
+    o.block = 0;
+    o.offset = 0;
+    return true;
+  }
+
+  uint32_t blocks() const { return 0; }
+
+private:
+  AudioAnalyzeRMS rms;
+  AudioAnalyzePeak peak;
+  AudioConnection rmsCord;
+  AudioConnection peakCord;
+  float fastAlpha, slowAlpha, ratioDelta, minDelta, minRms;
+  uint16_t gapMs;
+  float holdDecay, holdRise;
+  float fastEnv, slowEnv;
+  float heldEnv;             // fastEnv's decaying peak
+  uint32_t lastOnset;
+};
+
+class PeakOnset
+{
+public:
+  explicit PeakOnset(AudioStream &input)
+    : cord(input, 0, peak, 0), alpha(0.07f), multiplier(1.2f), minLevel(0.002f),
+      gapMs(50), envelope(0), recentIndex(0), lastOnset(0)
+  {
+    memset(recent, 0, sizeof(recent));
+  }
+
+  void begin() {}
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+
+  // Onset when the peak exceeds max(minLevel, envelope x multiplier) and
+  // 1.3 x the mean of the last four peaks.
+  void thresholds(float emaAlpha, float mult, float noiseFloor)
+  {
+    alpha = emaAlpha;
+    multiplier = mult;
+    minLevel = noiseFloor;
+  }
+  void holdoff(uint16_t ms) { gapMs = ms; }
+
+  bool poll(TriggerOnset &o)
+  {
+    if (!peak.available()) return false;
+    float level = peak.read();
+
+    recent[recentIndex] = level;
+    recentIndex = (recentIndex + 1) & 3;
+    float avg = (recent[0] + recent[1] + recent[2] + recent[3]) * 0.25f;
+    envelope = (1.0f - alpha) * envelope + alpha * level;
+    float threshold = max(minLevel, envelope * multiplier);
+
+    uint32_t now = millis();
+    if (now - lastOnset <= gapMs) return false;
+    if (level <= threshold || level <= avg * 1.3f) return false;
+    lastOnset = now;
+
+    o.velocity = constrain(sqrtf(level) * 1.5f, 0.1f, 1.0f);
+    o.frequency = -1.0f;
+    o.cycles = ARM_DWT_CYCCNT;
+    o.millis = now;
+    o.block = 0;
+    o.offset = 0;
+    return true;
+  }
+
+  uint32_t blocks() const { return 0; }
+
+private:
+  AudioAnalyzePeak peak;
+  AudioConnection cord;
+  float alpha, multiplier, minLevel;
+  uint16_t gapMs;
+  float envelope;
+  float recent[4];
+  uint8_t recentIndex;
+  uint32_t lastOnset;
+};
+
+class FluxOnset
+{
+public:
+  static const int HISTORY = 8;
+
+  explicit FluxOnset(AudioStream &input)
+    : cord(input, 0, ring, 0), multiplier(4.0f), minLevel(0.05f), gapMs(50),
+      historyIndex(0), lastOnset(0)
+  {
+    for (int i = 0; i < HISTORY; i++) history[i] = minLevel;
+  }
+
+  void begin() {}
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+
+  // Onset when the flux exceeds mean(last HISTORY frames) x mult + minLevel
+  void thresholds(float mult, float fluxFloor)
+  {
+    multiplier = mult;
+    minLevel = fluxFloor;
+  }
+  void holdoff(uint16_t ms) { gapMs = ms; }
+
+  bool poll(TriggerOnset &o)
+  {
+    if (!fft.compute(ring)) return false;
+    spectrum.compute(fft.magnitudes(), fft.BINS, fft.binHz());
+
+    float mean = 0;
+    for (int i = 0; i < HISTORY; i++) mean += history[i];
+    mean *= 1.0f / HISTORY;
+    float flux = spectrum.flux;
+    history[historyIndex] = flux;
+    historyIndex = (historyIndex + 1) % HISTORY;
+
+    uint32_t now = millis();
+    if (now - lastOnset <= gapMs) return false;
+    if (flux <= mean * multiplier + minLevel) return false;
+    lastOnset = now;
+
+    o.velocity = constrain(spectrum.energy * 4.0f, 0.0f, 1.0f);
+    o.frequency = -1.0f;
+    o.cycles = ARM_DWT_CYCCNT;
+    o.millis = now;
+    o.block = fft.frameTime() / AUDIO_BLOCK_SAMPLES;
+    o.offset = 0;
+    return true;
+  }
+
+  uint32_t blocks() const { return ring.samplesWritten() / AUDIO_BLOCK_SAMPLES; }
+
+  // Band energies and HFC of the latest frame, for energy fallbacks
+  const SpectralFrame &frame() const { return spectrum; }
+
+private:
+  AudioSampleRing<256> ring;
+  AudioConnection cord;
+  FFTEngine<256, 256, 128> fft;
+  SpectralFrame spectrum;
+  float multiplier, minLevel;
+  uint16_t gapMs;
+  float history[HISTORY];
+  uint8_t historyIndex;
+  uint32_t lastOnset;
+};
+
+#endif
@@ -0,0 +1,223 @@
+// Pitch policies for Trigger<> (trigger_engine.h)
+//
+//   OnsetPitch          the period the onset policy already measured
+//                       (PluckOnset); no analyser of its own
+//   NoteFrequencyPitch  AudioAnalyzeNoteFrequency (Teensy YIN), gated on
+//                       its probability (grum_pedal-BEST and most forks)
+//   SlidingYinPitch     AudioAnalyzeSlidingYin, a fresh estimate per block
+//   TaskYinPitch        the same YIN run by an AnalysisTask, out of the
+//                       audio interrupt
+//   SpectrumPitch       harmonic-sum fundamental of a 2048 point FFT in
+//                       loop() (grum-pedal.cpp FFT path)
+//
+// read() only reports an estimate taken after the onset it is asked
+// about, so a note that is still ringing can't name the next one.
+
+#ifndef pitch_policies_h_
+#define pitch_policies_h_
+
+#include <Arduino.h>
+#include <Audio.h>
+#include "analysis_task.h"
+#include "analyze_sliding_yin.h"
+#include "audio_sample_ring.h"
+#include "fft_engine.h"
+#include "spectral_frame.h"
+#include "onset_policies.h"
+#include "audio_budget.h"
+
+class OnsetPitch
+{
+public:
+  static const uint16_t WAIT_MS = 0;
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+
+  explicit OnsetPitch(AudioStream &) {}
+  void begin() {}
+  void update() {}
+  void onset(const TriggerOnset &) {}
+  float read(const TriggerOnset &o) { return o.frequency; }
+};
+
+class NoteFrequencyPitch
+{
+public:
+  // AudioAnalyzeNoteFrequency needs ~24 ms of a low E before it reports
+  static const uint16_t WAIT_MS = 40;
+  // AudioAnalyzeNoteFrequency keeps its whole window as blocks
+  static constexpr AudioBudget budget() { return AudioBudget().add(AUDIO_COST_NOTE_FREQUENCY); }
+
+  explicit NoteFrequencyPitch(AudioStream &input)
+    : cord(input, 0, notefreq, 0), yinThreshold(0.15f), minProbability(0.6f), latest(-1) {}
+
+  void begin() { notefreq.begin(yinThreshold); }
+
+  // YIN threshold for begin(), and the probability an estimate needs
+  void thresholds(float threshold, float probability)
+  {
+    yinThreshold = threshold;
+    minProbability = probability;
+  }
+
+  void update()
+  {
+    if (!notefreq.available()) return;
+    float f = notefreq.read();
+    if (notefreq.probability() >= minProbability) latest = f;
+  }
+
+  void onset(const TriggerOnset &) { latest = -1; }
+  float read(const TriggerOnset &) { return latest; }
+
+private:
+  AudioAnalyzeNoteFrequency notefreq;
+  AudioConnection cord;
+  float yinThreshold, minProbability;
+  float latest;
+};
+
+class SlidingYinPitch
+{
+public:
+  // One period of low E plus a block
+  static const uint16_t WAIT_MS = 30;
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+
+  explicit SlidingYinPitch(AudioStream &input)
+    : cord(input, 0, yin, 0), yinThreshold(0.15f), minProbability(0.8f),
+      minHz(55.0f), maxHz(1000.0f), latest(-1) {}
+
+  void begin()
+  {
+    yin.pitchRange(minHz, maxHz);
+    yin.begin(yinThreshold);
+  }
+
+  void thresholds(float threshold, float probability)
+  {
+    yinThreshold = threshold;
+    minProbability = probability;
+  }
+  // 55..1000 Hz by default, the pluck trigger's range, at 2x decimation
+  void pitchRange(float lo, float hi)
+  {
+    minHz = lo;
+    maxHz = hi;
+    yin.pitchRange(lo, hi);
+  }
+
+  void update()
+  {
+    if (!yin.available()) return;
+    float f = yin.read();
+    if (yin.probability() >= minProbability) latest = f;
+  }
+
+  void onset(const TriggerOnset &) { latest = -1; }
+  float read(const TriggerOnset &) { return latest; }
+
+private:
+  AudioAnalyzeSlidingYin yin;
+  AudioConnection cord;
+  float yinThreshold, minProbability;
+  float minHz, maxHz;
+  float latest;
+};
+
+class TaskYinPitch
+{
+public:
+  // SlidingYinPitch's wait plus a timer period or two
+  static const uint16_t WAIT_MS = 32;
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+
+  explicit TaskYinPitch(AudioStream &input)
+    : cord(input, 0, tap, 0), yinThreshold(0.15f), minProbability(0.8f),
+      minHz(55.0f), maxHz(1000.0f), latest(-1) {}
+
+  void begin()
+  {
+    yin.pitchRange(minHz, maxHz);
+    yin.begin(yinThreshold);
+    task.add(tap, yin);
+    task.begin();
+  }
+
+  void thresholds(float threshold, float probability)
+  {
+    yinThreshold = threshold;
+    minProbability = probability;
+  }
+  // 55..1000 Hz by default, the pluck trigger's range, at 2x decimation
+  void pitchRange(float lo, float hi)
+  {
+    minHz = lo;
+    maxHz = hi;
+    yin.pitchRange(lo, hi);
+  }
+
+  void update()
+  {
+    if (!yin.available()) return;
+    float f = yin.read();
+    if (yin.probability() >= minProbability) latest = f;
+  }
+
+  void onset(const TriggerOnset &) { latest = -1; }
+  float read(const TriggerOnset &) { return latest; }
+
+  // blocks(), dropped(), maxLatencyUs(), printStats() ...
+  AnalysisTask &analysis() { return task; }
+
+private:
+  AudioAnalysisTap tap;
+  AudioConnection cord;
+  AudioAnalyzeSlidingYin yin;      // fed by task, not by the graph
+  AnalysisTask task;
+  float yinThreshold, minProbability;
+  float minHz, maxHz;
+  float latest;
+};
+
+class SpectrumPitch
+{
+public:
+  // Two 512 sample hops after the onset, so the frame is mostly new note
+  static const uint16_t WAIT_MS = 30;
+  static constexpr AudioBudget budget() { return AudioBudget(); }
+
+  explicit SpectrumPitch(AudioStream &input) : cord(input, 0, ring, 0), framesSinceOnset(0)
+  {
+    // Fine bins: the lowest eight peaks must reach past the 3rd harmonic
+    // of a high E, not be spent on 5 kHz of string noise
+    spectrum.peakMaxHz = 2000;
+  }
+
+  void begin() {}
+
+  void update()
+  {
+    if (!fft.compute(ring)) return;
+    spectrum.compute(fft.magnitudes(), fft.BINS, fft.binHz());
+    if (framesSinceOnset < 255) framesSinceOnset++;
+  }
+
+  void onset(const TriggerOnset &) { framesSinceOnset = 0; }
+
+  float read(const TriggerOnset &)
+  {
+    if (framesSinceOnset < 2) return -1;
+    return spectrum.fundamental;
+  }
+
+  SpectralFrame &frame() { return spectrum; }
+
+private:
+  AudioSampleRing<2048> ring;
+  AudioConnection cord;
+  FFTEngine<2048, 2048, 512> fft;
+  SpectralFrame spectrum;
+  uint8_t framesSinceOnset;
+};
+
+#endif
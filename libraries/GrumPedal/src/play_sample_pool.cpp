@@ -0,0 +1,214 @@
+#include "play_sample_pool.h"
+#include <dspinst.h>
+
+AudioPlaySamplePool::AudioPlaySamplePool() : AudioStream(0, NULL), probe(nullptr), tails(nullptr)
+{
+  memset(voices, 0, sizeof(voices));
+  for (uint8_t v = 0; v < MAX_VOICES; v++) {
+    voices[v].cur.stream = voices[v].ghost.stream = -1;
+  }
+}
+
+int32_t AudioPlaySamplePool::toQ16(float gain)
+{
+  return (int32_t)(constrain(gain, 0.0f, 2.0f) * 65536.0f);
+}
+
+static uint8_t rateShift(uint32_t rate)
+{
+  if (rate == 22050) return 1;
+  if (rate == 11025) return 2;
+  return 0;
+}
+
+bool AudioPlaySamplePool::play(uint8_t v, const DrumSample &sample, float gain, uint8_t offset)
+{
+  if (v >= MAX_VOICES || !sample.loaded()) return false;
+  Voice &voice = voices[v];
+
+  // Loop context, like SampleStreamer::service(), so claiming a slot
+  // can't race it
+  int8_t stream = sample.streamed() && tails ? tails->open(sample) : -1;
+
+  __disable_irq();
+  if (voice.ghosting) closeStream(voice.ghost);
+  if (voice.playing && voice.gain > 0) {
+    voice.ghost = voice.cur;
+    voice.ghostGain = voice.gain;
+    voice.ghosting = true;
+  } else {
+    closeStream(voice.cur);
+  }
+  voice.cur.data = sample.pcm();
+  voice.cur.resident = sample.residentLength();
+  voice.cur.length = stream >= 0 ? sample.length() : sample.residentLength();
+  voice.cur.pos = 0;
+  voice.cur.shift = rateShift(sample.sampleRate());
+  voice.cur.stream = stream;
+  voice.cur.fadeAtEnd = sample.streamed() && stream < 0;
+  voice.sample = &sample;
+  voice.gain = voice.target = toQ16(gain);
+  voice.playing = true;
+  voice.fresh = true;
+  voice.offset = offset < AUDIO_BLOCK_SAMPLES ? offset : AUDIO_BLOCK_SAMPLES - 1;
+  __enable_irq();
+  return true;
+}
+
+void AudioPlaySamplePool::stop(uint8_t v)
+{
+  if (v >= MAX_VOICES) return;
+  __disable_irq();
+  voices[v].target = 0;
+  __enable_irq();
+}
+
+void AudioPlaySamplePool::stopAll()
+{
+  for (uint8_t v = 0; v < MAX_VOICES; v++) stop(v);
+}
+
+void AudioPlaySamplePool::gain(uint8_t v, float gain)
+{
+  if (v >= MAX_VOICES) return;
+  __disable_irq();
+  if (voices[v].playing && voices[v].target != 0) voices[v].target = toQ16(gain);
+  __enable_irq();
+}
+
+uint32_t AudioPlaySamplePool::position(uint8_t v) const
+{
+  if (!isPlaying(v)) return 0;
+  return voices[v].cur.pos;
+}
+
+float AudioPlaySamplePool::level(uint8_t v) const
+{
+  if (!isPlaying(v) || isStopping(v)) return 0.0f;
+  const Voice &voice = voices[v];
+  return voice.target * (1.0f / 65536.0f) * voice.sample->levelAt(voice.cur.pos >> voice.cur.shift);
+}
+
+uint8_t AudioPlaySamplePool::activeVoices() const
+{
+  uint8_t n = 0;
+  for (uint8_t v = 0; v < MAX_VOICES; v++) {
+    if (voices[v].playing) n++;
+  }
+  return n;
+}
+
+bool AudioPlaySamplePool::uses(const DrumSample &sample) const
+{
+  const int16_t *data = sample.pcm();
+  if (!data) return false;
+  for (uint8_t v = 0; v < MAX_VOICES; v++) {
+    const Voice &voice = voices[v];
+    if (voice.playing && voice.cur.data == data) return true;
+    if (voice.ghosting && voice.ghost.data == data) return true;
+  }
+  return false;
+}
+
+void AudioPlaySamplePool::closeStream(Cursor &c)
+{
+  if (c.stream >= 0 && tails) tails->close(c.stream);
+  c.stream = -1;
+}
+
+bool AudioPlaySamplePool::mix(int32_t *acc, Cursor &c, int32_t g0, int32_t g1, uint32_t count)
+{
+  const uint32_t end = c.length << c.shift;
+  uint32_t n = count;
+  if (c.pos + n > end) n = end - c.pos;
+
+  // Source samples this block reads, plus one for the interpolation
+  const uint32_t first = c.pos >> c.shift;
+  const int16_t *d = c.data + first;
+  int16_t tail[AUDIO_BLOCK_SAMPLES + 2];
+  if (c.stream >= 0) {
+    uint32_t need = ((c.pos + n - 1) >> c.shift) + 2 - first;
+    if (first + need > c.resident) {
+      // Resident part straight from RAM, the rest from the stream ring
+      uint32_t k = first < c.resident ? c.resident - first : 0;
+      if (k) memcpy(tail, d, k * sizeof(int16_t));
+      if (!tails->read(c.stream, tail + k, first + k, need - k)) return false;
+      d = tail;
+    }
+  }
+
+  uint32_t pos = c.pos;
+  int32_t g = g0;
+  const int32_t step = (g1 - g0) / AUDIO_BLOCK_SAMPLES;
+
+  if (c.shift == 0) {
+    if (step == 0) {
+      for (uint32_t i = 0; i < n; i++) acc[i] += signed_multiply_32x16b(g, d[i]);
+    } else {
+      for (uint32_t i = 0; i < n; i++) {
+        acc[i] += signed_multiply_32x16b(g, d[i]);
+        g += step;
+      }
+    }
+  } else {
+    // Lower rate files: linear interpolation up to 44.1 kHz
+    const uint32_t mask = (1 << c.shift) - 1;
+    for (uint32_t i = 0; i < n; i++, pos++) {
+      uint32_t idx = pos >> c.shift;
+      int32_t s0 = d[idx - first];
+      int32_t s1 = idx + 1 < c.length ? d[idx + 1 - first] : 0;
+      int32_t s = s0 + (((s1 - s0) * (int32_t)(pos & mask)) >> c.shift);
+      acc[i] += signed_multiply_32x16b(g, s);
+      g += step;
+    }
+  }
+
+  c.pos += n;
+  return c.pos < end;
+}
+
+void AudioPlaySamplePool::update(void)
+{
+  int32_t acc[AUDIO_BLOCK_SAMPLES];
+  bool any = false;
+  bool started = false;
+
+  for (uint8_t v = 0; v < MAX_VOICES; v++) {
+    Voice &voice = voices[v];
+    if (voice.ghosting) {
+      if (!any) memset(acc, 0, sizeof(acc));
+      any = true;
+      mix(acc, voice.ghost, voice.ghostGain, 0);
+      closeStream(voice.ghost);
+      voice.ghosting = false;
+    }
+    if (!voice.playing) continue;
+    if (!any) memset(acc, 0, sizeof(acc));
+    any = true;
+    started |= voice.fresh;
+    const uint8_t skip = voice.fresh ? voice.offset : 0;
+    voice.fresh = false;
+
+    int32_t g0 = voice.gain, g1 = voice.target;
+    // An attack with no stream behind it fades over its last block
+    if (voice.cur.fadeAtEnd && voice.cur.pos + AUDIO_BLOCK_SAMPLES >= voice.cur.length << voice.cur.shift) {
+      g1 = 0;
+    }
+    bool more = mix(acc + skip, voice.cur, g0, g1, AUDIO_BLOCK_SAMPLES - skip);
+    voice.gain = g1;
+    if (!more || g1 == 0) {
+      voice.playing = false;
+      closeStream(voice.cur);
+    }
+  }
+  if (!any) return;
+
+  audio_block_t *block = allocate();
+  if (!block) return;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    block->data[i] = signed_saturate_rshift(acc[i], 16, 0);
+  }
+  transmit(block);
+  release(block);
+  if (started && probe) probe->output();
+}
@@ -0,0 +1,114 @@
+// AudioPlaySamplePool - many RAM drum voices rendered in one object
+//
+// Each voice plays a DrumSample straight out of memory with its own gain,
+// and every active voice is summed into a single output block per update.
+// This replaces a bank of AudioPlayMemory objects feeding a tree of
+// AudioMixer4s: velocity lives with the voice, so starting a hit never
+// rewrites a gain that a still-ringing note on the same mixer channel is
+// using, and the pool costs one audio block no matter how many voices are
+// sounding.
+//
+// Gain changes on a playing voice ramp over one block. stop() fades the
+// voice out over one block, and play() on a busy voice cross-fades the old
+// note out underneath the new one, so chokes and steals never click.
+//
+// Samples loaded with only their attack in RAM play that from memory and
+// the rest through a SampleStreamer (streamer()); without one, or with all
+// its slots busy, they fade out at the end of the attack.
+//
+// Usage:
+//   AudioPlaySamplePool drumPool;
+//   AudioConnection c(drumPool, 0, mainMixer, 1);
+//   drumPool.play(0, kickSample, 0.8f);
+
+#ifndef play_sample_pool_h_
+#define play_sample_pool_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include "drum_sample.h"
+#include "latency_probe.h"
+#include "sample_streamer.h"
+
+class AudioPlaySamplePool : public AudioStream
+{
+public:
+  static const uint8_t MAX_VOICES = 16;
+
+  AudioPlaySamplePool();
+
+  // Start `sample` on voice v at `gain` (0..2). The gain applies from the
+  // first sample; a note already on this voice fades out over one block.
+  // The note starts `offset` samples into the next block (PluckEvent::offset
+  // keeps a hit on the pick's sample, not the block edge).
+  bool play(uint8_t v, const DrumSample &sample, float gain, uint8_t offset = 0);
+
+  // Fade voice v out over one block.
+  void stop(uint8_t v);
+  void stopAll();
+
+  // Change the gain of a playing voice, ramped over one block.
+  void gain(uint8_t v, float gain);
+
+  // True until the voice has finished (including its fade-out).
+  bool isPlaying(uint8_t v) const { return v < MAX_VOICES && voices[v].playing; }
+  bool isStopping(uint8_t v) const { return v < MAX_VOICES && voices[v].target == 0; }
+
+  // Samples played so far at the output rate, and gain x the sample's
+  // envelope at that point (0 once stopping).
+  uint32_t position(uint8_t v) const;
+  float level(uint8_t v) const;
+
+  uint8_t activeVoices() const;
+
+  // True while any voice, or a note fading out under one, still reads
+  // from `sample`; it must stay loaded until then.
+  bool uses(const DrumSample &sample) const;
+
+  // Report the first block of every newly started voice to `probe`
+  // (nullptr to stop).
+  void latencyProbe(LatencyProbe *p) { probe = p; }
+
+  // Stream the tails of partly resident samples through `s` (nullptr to
+  // play only their attack). Call s->service() from loop().
+  void streamer(SampleStreamer *s) { tails = s; }
+
+  virtual void update(void);
+
+private:
+  struct Cursor {
+    const int16_t *data;
+    uint32_t length;     // source samples
+    uint32_t resident;   // of those, in data; the rest from stream
+    uint32_t pos;        // output samples
+    uint8_t shift;       // 0 = 44.1 kHz, 1 = 22.05 kHz, 2 = 11.025 kHz
+    int8_t stream;       // SampleStreamer slot, -1 for none
+    bool fadeAtEnd;      // attack only: fade out over its last block
+  };
+
+  struct Voice {
+    Cursor cur;
+    Cursor ghost;        // previous note fading out after a steal
+    const DrumSample *sample;
+    int32_t gain;        // Q16, 65536 = unity
+    int32_t target;
+    int32_t ghostGain;
+    bool playing;
+    bool ghosting;
+    bool fresh;          // play() since the last update
+    uint8_t offset;      // where in its first block the note starts
+  };
+
+  // Add up to `count` samples of c into acc, gain ramping from g0 to g1
+  // over a block. Returns false once the cursor has run off the end of its
+  // sample.
+  bool mix(int32_t *acc, Cursor &c, int32_t g0, int32_t g1, uint32_t count = AUDIO_BLOCK_SAMPLES);
+  void closeStream(Cursor &c);
+  static int32_t toQ16(float gain);
+
+  Voice voices[MAX_VOICES];
+  LatencyProbe *probe;
+  SampleStreamer *tails;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "preset_shell.h"
+
+static const char *const DELIMS = " \t";
+
+// Next token of the line being parsed, as a number in [lo, hi]
+static bool nextInt(long &v, long lo, long hi)
+{
+  const char *t = strtok(nullptr, DELIMS);
+  if (!t) return false;
+  char *end;
+  v = strtol(t, &end, 10);
+  return *end == 0 && v >= lo && v <= hi;
+}
+
+static bool nextFloat(float &v, float lo, float hi)
+{
+  const char *t = strtok(nullptr, DELIMS);
+  if (!t) return false;
+  char *end;
+  v = strtof(t, &end);
+  return *end == 0 && v >= lo && v <= hi;
+}
+
+bool PresetShell::feed(char c, const PedalPreset &current, Print &out)
+{
+  if (c == '\r' || c == '\n') {
+    if (!len) return false;
+    line[len] = 0;
+    len = 0;
+    edit = current;
+    if (!execute(out)) return false;
+    return presetChanges(current, edit) != 0;
+  }
+  if (len < LINE - 1) line[len++] = c;
+  return false;
+}
+
+bool PresetShell::ascending() const
+{
+  for (uint8_t i = 1; i < edit.numBands; i++) {
+    if (edit.bands[i].minHz <= edit.bands[i - 1].minHz) return false;
+  }
+  return edit.numBands > 0;
+}
+
+// False when nothing is to be applied: a bad line, or a command that only
+// reports or stores
+bool PresetShell::execute(Print &out)
+{
+  strtok(line, DELIMS);                      // the 'p'
+  const char *op = strtok(nullptr, DELIMS);
+  long i, a, b, m, n, l;
+  float x, y, z;
+
+  if (!op) {
+    edit.print(out);
+    return false;
+  }
+
+  if (!strcmp(op, "band")) {
+    if (!nextInt(i, 0, PedalPreset::MAX_BANDS - 1) || i > edit.numBands ||
+        !nextInt(a, 20, PedalPreset::TOP_HZ - 1) || !nextInt(b, 0, PedalPreset::VOICES - 1)) {
+      out.println("p band <i> <minHz> <drum> [hold]");
+      return false;
+    }
+    if (!nextInt(l, 0, 255)) l = i < edit.numBands ? edit.bands[i].holdCents : 0;
+    PresetBand &band = edit.bands[i];
+    band.minHz = (uint16_t)a;
+    band.drum = (uint8_t)b;
+    band.holdCents = (uint8_t)l;
+    if (i == edit.numBands) edit.numBands++;
+  } else if (!strcmp(op, "bands")) {
+    if (!nextInt(n, 1, edit.numBands)) {
+      out.printf("p bands <1..%u>\n", edit.numBands);
+      return false;
+    }
+    edit.numBands = (uint8_t)n;
+  } else if (!strcmp(op, "voice")) {
+    if (!nextInt(i, 0, PedalPreset::VOICES - 1) || !nextInt(a, 20, 20000) ||
+        !nextInt(b, 1, 5000) || !nextInt(m, 0, 100) || !nextInt(n, 0, 100) || !nextInt(l, 0, 100)) {
+      out.println("p voice <drum> <Hz> <ms> <mix%> <mod%> <level%>");
+      return false;
+    }
+    PresetVoice &v = edit.voices[i];
+    v.frequency = (uint16_t)a;
+    v.lengthMs = (uint16_t)b;
+    v.secondMix = (uint8_t)m;
+    v.pitchMod = (uint8_t)n;
+    v.level = (uint8_t)l;
+  } else if (!strcmp(op, "retrigger")) {
+    if (!nextInt(a, 0, 2000)) {
+      out.println("p retrigger <ms>");
+      return false;
+    }
+    edit.retriggerMs = (uint16_t)a;
+  } else if (!strcmp(op, "thresholds")) {
+    if (!nextFloat(x, 1.0f, 10.0f) || !nextFloat(y, 0.0f, 10.0f) || !nextFloat(z, 1.0f, 10.0f)) {
+      out.println("p thresholds <multiplier 1..10> <hfc 0..10> <ratio 1..10>");
+      return false;
+    }
+    edit.multiplier = x;
+    edit.hfcThreshold = y;
+    edit.ratioThreshold = z;
+  } else if (!strcmp(op, "name")) {
+    const char *t = strtok(nullptr, "");
+    memset(edit.name, 0, sizeof(edit.name));
+    if (t) strncpy(edit.name, t, sizeof(edit.name) - 1);
+  } else if (!strcmp(op, "save") || !strcmp(op, "load") || !strcmp(op, "boot")) {
+    if (!nextInt(i, 0, PresetStore::SLOTS - 1)) {
+      out.printf("p %s <0..%u>\n", op, PresetStore::SLOTS - 1);
+      return false;
+    }
+    if (op[0] == 's') {
+      store.save((uint8_t)i, edit);
+      out.printf("Saved to slot %ld\n", i);
+      return false;
+    }
+    if (op[0] == 'b') {
+      store.bootSlot((uint8_t)i);
+      out.printf("Boot slot %ld\n", i);
+      return false;
+    }
+    if (!store.load((uint8_t)i, edit)) {
+      out.printf("Slot %ld is empty\n", i);
+      return false;
+    }
+  } else if (!strcmp(op, "list")) {
+    store.list(out);
+    return false;
+  } else if (!strcmp(op, "reset")) {
+    edit = defaults;
+  } else {
+    out.println("p [band|bands|voice|retrigger|thresholds|name|save|load|boot|list|reset]");
+    return false;
+  }
+
+  if (!ascending()) {
+    out.println("Bands must ascend");
+    return false;
+  }
+  edit.print(out);
+  return true;
+}
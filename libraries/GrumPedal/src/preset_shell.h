@@ -0,0 +1,57 @@
+// PresetShell - edit, store and recall PedalPresets over Serial
+//
+// The sketches read single-letter commands; every line that starts with
+// 'p' goes here instead, a character at a time from loop(), so nothing
+// waits for the rest of a line. A finished line edits a copy of the
+// playing preset; feed() returns true when that copy differs and should
+// be applied, which the sketch does with presetChanges() so only what was
+// edited is touched.
+//
+//   p                                 print the playing preset
+//   p band <i> <minHz> <drum> [hold]  set or append band i (ascending)
+//   p bands <n>                       keep the first n bands
+//   p voice <d> <Hz> <ms> <mix> <mod> <level>   percent for the last three
+//   p retrigger <ms>
+//   p thresholds <multiplier> <hfc> <ratio>
+//   p name <text>
+//   p save <slot>   p load <slot>   p boot <slot>   p list   p reset
+//
+// Usage:
+//   PresetShell shell(presets, DEFAULT_PRESET);
+//   char c = Serial.read();
+//   if (c == 'p' || shell.active()) {
+//     if (shell.feed(c, preset, Serial)) applyPreset(shell.result());
+//   }
+
+#ifndef preset_shell_h_
+#define preset_shell_h_
+
+#include <Arduino.h>
+#include "preset_store.h"
+
+class PresetShell
+{
+public:
+  static const uint8_t LINE = 64;
+
+  PresetShell(PresetStore &store, const PedalPreset &defaults)
+    : store(store), defaults(defaults), len(0) {}
+
+  // One character of a command line. True when the line changed the
+  // preset; result() is the new one.
+  bool feed(char c, const PedalPreset &current, Print &out);
+  bool active() const { return len > 0; }
+  const PedalPreset &result() const { return edit; }
+
+private:
+  bool execute(Print &out);
+  bool ascending() const;
+
+  PresetStore &store;
+  const PedalPreset &defaults;
+  PedalPreset edit;
+  char line[LINE];
+  uint8_t len;
+};
+
+#endif
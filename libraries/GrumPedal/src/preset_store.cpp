@@ -0,0 +1,113 @@
+#include "preset_store.h"
+#include <EEPROM.h>
+#include "drum_kit.h"
+
+static uint32_t checksum(const PedalPreset &p, uint16_t bytes)
+{
+  return DrumKit::crc32((const uint8_t *)&p + PRESET_HEADER, bytes - PRESET_HEADER);
+}
+
+DrumMap<PedalPreset::MAX_BANDS> PedalPreset::drumMap() const
+{
+  DrumBand b[MAX_BANDS] = {};
+  for (uint8_t i = 0; i < numBands && i < MAX_BANDS; i++) {
+    b[i].minHz = bands[i].minHz;
+    b[i].maxHz = bandTopHz(i);
+    b[i].drum = bands[i].drum;
+    b[i].holdCents = bands[i].holdCents;
+  }
+  return DrumMap<MAX_BANDS>(b);
+}
+
+void PedalPreset::print(Print &out) const
+{
+  out.printf("Preset \"%.*s\": retrigger %u ms, thresholds %.2f %.2f %.2f\n",
+             (int)sizeof(name), name, retriggerMs, multiplier, hfcThreshold, ratioThreshold);
+  for (uint8_t i = 0; i < numBands; i++) {
+    out.printf("  band %u: %u-%u Hz -> drum %u, hold %u cents\n",
+               i, bands[i].minHz, (unsigned)bandTopHz(i), bands[i].drum, bands[i].holdCents);
+  }
+  for (uint8_t d = 0; d < VOICES; d++) {
+    const PresetVoice &v = voices[d];
+    out.printf("  voice %u: %u Hz, %u ms, mix %u%%, mod %u%%, level %u%%\n",
+               d, v.frequency, v.lengthMs, v.secondMix, v.pitchMod, v.level);
+  }
+}
+
+uint16_t presetChanges(const PedalPreset &a, const PedalPreset &b)
+{
+  uint16_t changes = 0;
+  if (strncmp(a.name, b.name, sizeof(a.name))) changes |= PRESET_NAME;
+  if (a.numBands != b.numBands || memcmp(a.bands, b.bands, sizeof(a.bands[0]) * a.numBands)) {
+    changes |= PRESET_BANDS;
+  }
+  if (a.retriggerMs != b.retriggerMs || a.multiplier != b.multiplier ||
+      a.hfcThreshold != b.hfcThreshold || a.ratioThreshold != b.ratioThreshold) {
+    changes |= PRESET_TRIGGER;
+  }
+  for (uint8_t d = 0; d < PedalPreset::VOICES; d++) {
+    if (memcmp(&a.voices[d], &b.voices[d], sizeof(a.voices[d]))) changes |= PRESET_VOICE << d;
+  }
+  return changes;
+}
+
+void PresetStore::seal(PedalPreset &p)
+{
+  p.magic = PRESET_MAGIC;
+  p.version = PRESET_VERSION;
+  p.bytes = sizeof(PedalPreset);
+  p.reserved = 0;
+  p.name[sizeof(p.name) - 1] = 0;
+  p.crc = checksum(p, p.bytes);
+}
+
+bool PresetStore::load(uint8_t slot, PedalPreset &p) const
+{
+  if (slot >= SLOTS) return false;
+  PedalPreset stored;
+  EEPROM.get(address(slot), stored);
+  if (stored.magic != PRESET_MAGIC || stored.version > PRESET_VERSION) return false;
+  if (stored.bytes <= PRESET_HEADER || stored.bytes > sizeof(PedalPreset)) return false;
+  if (checksum(stored, stored.bytes) != stored.crc) return false;
+  if (stored.numBands > PedalPreset::MAX_BANDS) return false;
+
+  // An older, shorter preset only brings the fields it had
+  memcpy(&p, &stored, stored.bytes);
+  p.name[sizeof(p.name) - 1] = 0;
+  return true;
+}
+
+bool PresetStore::save(uint8_t slot, PedalPreset &p)
+{
+  if (slot >= SLOTS) return false;
+  seal(p);
+  EEPROM.put(address(slot), p);
+  return true;
+}
+
+bool PresetStore::used(uint8_t slot) const
+{
+  PedalPreset p;
+  return load(slot, p);
+}
+
+uint8_t PresetStore::bootSlot() const
+{
+  uint8_t slot = EEPROM.read(base);
+  return slot < SLOTS ? slot : NO_SLOT;
+}
+
+void PresetStore::bootSlot(uint8_t slot)
+{
+  EEPROM.update(base, slot < SLOTS ? slot : NO_SLOT);
+}
+
+void PresetStore::list(Print &out) const
+{
+  const uint8_t boot = bootSlot();
+  for (uint8_t s = 0; s < SLOTS; s++) {
+    PedalPreset p;
+    if (!load(s, p)) continue;
+    out.printf("  %u%s %.*s\n", s, s == boot ? "*" : " ", (int)sizeof(p.name), p.name);
+  }
+}
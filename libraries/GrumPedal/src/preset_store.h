@@ -0,0 +1,122 @@
+// PresetStore - drum map, trigger timing and drum voices in EEPROM
+//
+// Changing which string plays which drum, the retrigger time or a drum's
+// sound used to mean editing constants and reflashing. A PedalPreset holds
+// all of it in one packed struct: the band list the DrumMap and the block
+// triggers are built from, the relative onset thresholds, and the
+// AudioSynthSimpleDrum settings and mixer level of each drum. The input
+// gate is not in it; that belongs to the guitar (InputCalibration), not
+// to the song.
+//
+// PresetStore keeps SLOTS of them after a one byte boot slot. A preset is
+// read with a single EEPROM.get() and checked before use: magic, a
+// version no newer than this code, its own size and a CRC-32 of
+// everything after the header. A preset saved by an older version is
+// shorter; the fields it did not have keep the values of the preset it is
+// loaded over. presetChanges() says which parts two presets differ in, so
+// a sketch applying one only touches those objects (see applyPreset() in
+// grum-pedal.cpp).
+//
+// Levels, mixes and pitch modulation are whole percent, which keeps a
+// preset at 116 bytes and the hand-tuned values exact.
+//
+// Usage:
+//   PresetStore presets;                     // EEPROM from address 64
+//   PedalPreset p = DEFAULT_PRESET;
+//   if (presets.load(presets.bootSlot(), p)) applyPreset(p);
+//   ...
+//   presets.save(2, p);
+//   presets.bootSlot(2);
+
+#ifndef preset_store_h_
+#define preset_store_h_
+
+#include <Arduino.h>
+#include "drum_map.h"
+
+struct PresetBand {
+  uint16_t minHz;        // up to the next band's minHz; the last is open ended
+  uint8_t  drum;
+  uint8_t  holdCents;    // DrumBand::holdCents
+};
+
+struct PresetVoice {
+  uint16_t frequency;    // AudioSynthSimpleDrum::frequency(), Hz
+  uint16_t lengthMs;
+  uint8_t  secondMix;    // percent
+  uint8_t  pitchMod;     // percent
+  uint8_t  level;        // mixer gain at full velocity, percent
+  uint8_t  reserved;
+};
+
+struct PedalPreset {
+  static const uint8_t MAX_BANDS = 8;
+  static const uint8_t VOICES = 5;
+  static const uint16_t TOP_HZ = 16384;   // where the last band ends
+
+  uint32_t magic;          // PRESET_MAGIC
+  uint16_t version;        // PRESET_VERSION when saved
+  uint16_t bytes;          // sizeof(PedalPreset) when saved
+  uint32_t crc;            // CRC-32 of bytes [16, bytes)
+  uint32_t reserved;
+  char     name[12];       // NUL terminated
+  uint8_t  numBands;
+  uint8_t  spare;
+  uint16_t retriggerMs;    // per drum
+  float    multiplier;     // AudioAnalyzePluckTrigger::thresholds()
+  float    hfcThreshold;
+  float    ratioThreshold;
+  PresetBand  bands[MAX_BANDS];
+  PresetVoice voices[VOICES];
+
+  float bandTopHz(uint8_t i) const { return i + 1 < numBands ? bands[i + 1].minHz : TOP_HZ; }
+  float level(uint8_t drum) const { return voices[drum].level * 0.01f; }
+
+  // Bands as DrumBands, unused entries empty
+  DrumMap<MAX_BANDS> drumMap() const;
+  void print(Print &out) const;
+};
+
+static const uint32_t PRESET_MAGIC = 0x54535047;   // "GPST"
+static const uint16_t PRESET_VERSION = 1;
+static const uint16_t PRESET_HEADER = 16;          // bytes the CRC skips
+
+// presetChanges() bits
+enum {
+  PRESET_NAME    = 1 << 0,
+  PRESET_BANDS   = 1 << 1,
+  PRESET_TRIGGER = 1 << 2,    // retriggerMs and thresholds
+  PRESET_VOICE   = 1 << 3,    // PRESET_VOICE << drum
+};
+uint16_t presetChanges(const PedalPreset &from, const PedalPreset &to);
+
+class PresetStore
+{
+public:
+  static const uint8_t SLOTS = 8;
+  static const uint8_t NO_SLOT = 0xFF;
+
+  // SLOTS presets and the boot slot from address on; 64 leaves room for
+  // InputCalibration at 0.
+  PresetStore(int address = 64) : base(address) {}
+
+  // False (and p untouched) for an empty, damaged or too new slot
+  bool load(uint8_t slot, PedalPreset &p) const;
+  // Stamps p's header and CRC, then writes it
+  bool save(uint8_t slot, PedalPreset &p);
+  bool used(uint8_t slot) const;
+
+  uint8_t bootSlot() const;      // NO_SLOT if none chosen
+  void bootSlot(uint8_t slot);
+
+  void list(Print &out) const;
+
+  static void seal(PedalPreset &p);
+
+private:
+  int address(uint8_t slot) const { return base + 4 + slot * (int)sizeof(PedalPreset); }
+
+  int base;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "sample_streamer.h"
+
+// Same as the SPSC queue: the ring copy must not move past the index update
+#define STREAM_BARRIER() __asm__ volatile("" ::: "memory")
+
+static_assert((SampleStreamer::RING & (SampleStreamer::RING - 1)) == 0, "RING must be a power of two");
+static_assert(SampleStreamer::CHUNK <= SampleStreamer::RING / 2, "a read must leave the other half playing");
+
+SampleStreamer::SampleStreamer() : underrunCount(0), readCount(0)
+{
+  for (uint8_t i = 0; i < MAX_STREAMS; i++) {
+    streams[i].sample = nullptr;
+    streams[i].end = 0;
+    streams[i].filled = 0;
+    streams[i].consumed = 0;
+    streams[i].state = FREE;
+  }
+}
+
+int8_t SampleStreamer::open(const DrumSample &sample)
+{
+  if (!sample.streamed()) return -1;
+  for (uint8_t i = 0; i < MAX_STREAMS; i++) {
+    Stream &s = streams[i];
+    if (s.state != FREE) continue;
+    s.sample = &sample;
+    s.end = sample.length();
+    s.filled = s.consumed = sample.residentLength();
+    s.state = OPENING;
+    return i;
+  }
+  return -1;
+}
+
+void SampleStreamer::close(int8_t slot)
+{
+  if (slot < 0 || slot >= MAX_STREAMS) return;
+  if (streams[slot].state != FREE) streams[slot].state = CLOSING;
+}
+
+bool SampleStreamer::read(int8_t slot, int16_t *dst, uint32_t from, uint32_t count)
+{
+  Stream &s = streams[slot];
+  if (s.state == FAILED) return false;
+
+  uint32_t have = s.filled;
+  STREAM_BARRIER();
+  const int16_t *ring = rings[slot];
+  // Anything older than one ring behind `have` has been overwritten
+  const uint32_t oldest = have > RING ? have - RING : 0;
+  bool late = false;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t n = from + i;
+    if (n >= oldest && n < have) {
+      dst[i] = ring[n & (RING - 1)];
+    } else {
+      dst[i] = 0;
+      late |= n < s.end;
+    }
+  }
+  STREAM_BARRIER();
+  if (from + count > s.consumed) s.consumed = from + count;
+  if (late) underrunCount++;
+  return true;
+}
+
+uint8_t SampleStreamer::activeStreams() const
+{
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < MAX_STREAMS; i++) {
+    if (streams[i].state == OPENING || streams[i].state == STREAMING) n++;
+  }
+  return n;
+}
+
+bool SampleStreamer::start(Stream &s)
+{
+  s.file = SD.open(s.sample->name());
+  return (bool)s.file;
+}
+
+// The oldest sample the voice still reads: each block also reads one
+// past its last for the interpolation, so the next starts at consumed - 1
+static uint32_t oldestNeeded(uint32_t consumed)
+{
+  return consumed > 0 ? consumed - 1 : 0;
+}
+
+// Where the next read of s starts: the ISR may have run ahead of the
+// ring, and what it already played as silence is skipped
+static uint32_t nextRead(uint32_t filled, uint32_t consumed)
+{
+  uint32_t needed = oldestNeeded(consumed);
+  return needed > filled ? needed : filled;
+}
+
+// Samples the next read of s should fetch from `from`, 0 while its ring
+// has no room. The read must not overwrite the oldest sample still needed.
+uint32_t SampleStreamer::readSize(const Stream &s, uint32_t &from) const
+{
+  const uint32_t consumed = s.consumed;
+  from = nextRead(s.filled, consumed);
+  if (from >= s.end) return 0;
+  uint32_t want = min(s.end - from, (uint32_t)CHUNK);
+  return oldestNeeded(consumed) + RING - from >= want ? want : 0;
+}
+
+// One read for stream s. Returns false when it had no room or nothing left.
+bool SampleStreamer::refill(Stream &s, int16_t *ring)
+{
+  uint32_t from;
+  uint32_t want = readSize(s, from);
+  if (want == 0) return false;
+
+  const uint32_t frame = 2 * s.sample->channelCount();
+  uint32_t pos = s.sample->fileOffset() + from * frame;
+
+  // End the read on a sector boundary; after the first read of a stream
+  // every later one then starts on one too
+  uint32_t endByte = pos + want * frame;
+  uint32_t trim = endByte % 512;
+  if (want == CHUNK && trim < want * frame && trim % frame == 0) want -= trim / frame;
+
+  if (s.file.position() != pos && !s.file.seek(pos)) return false;
+  int got = s.file.read(scratch, want * frame);
+  readCount++;
+  uint32_t frames = got > 0 ? (uint32_t)got / frame : 0;
+  for (uint32_t i = 0; i < frames; i++) {
+    const uint8_t *p = scratch + i * frame;
+    int16_t l = (int16_t)(p[0] | (p[1] << 8));
+    if (frame == 4) {
+      int16_t r = (int16_t)(p[2] | (p[3] << 8));
+      l = (int16_t)(((int32_t)l + r) >> 1);
+    }
+    ring[(from + i) & (RING - 1)] = l;
+  }
+  STREAM_BARRIER();
+  s.filled = from + frames;
+  if (frames < want) s.end = s.filled;   // short file: stop here
+  return frames > 0;
+}
+
+void SampleStreamer::service()
+{
+  for (uint8_t i = 0; i < MAX_STREAMS; i++) {
+    Stream &s = streams[i];
+    if (s.state == CLOSING) {
+      if (s.file) s.file.close();
+      s.sample = nullptr;
+      s.state = FREE;
+    } else if (s.state == OPENING) {
+      // A failed open ends the voice at its attack
+      bool ok = start(s);
+      __disable_irq();
+      if (s.state == OPENING) s.state = ok ? STREAMING : FAILED;
+      __enable_irq();
+    }
+  }
+
+  // Top up, least buffered first, until no ring has room for a read
+  while (true) {
+    int best = -1;
+    uint32_t bestAhead = 0xFFFFFFFF;
+    for (uint8_t i = 0; i < MAX_STREAMS; i++) {
+      Stream &s = streams[i];
+      if (s.state != STREAMING) continue;
+      uint32_t consumed = s.consumed;
+      uint32_t ahead = s.filled > consumed ? s.filled - consumed : 0;
+      uint32_t from;
+      if (readSize(s, from) == 0) continue;
+      if (ahead < bestAhead) {
+        bestAhead = ahead;
+        best = i;
+      }
+    }
+    if (best < 0) break;
+    if (!refill(streams[best], rings[best])) break;
+  }
+}
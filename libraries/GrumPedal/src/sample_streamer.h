@@ -0,0 +1,88 @@
+// SampleStreamer - SD tails for DrumSamples too long to keep in RAM
+//
+// A DrumSample loaded with a resident limit keeps only its attack in RAM
+// (DrumSample::load(file, residentMs)). AudioPlaySamplePool starts such a
+// sample from RAM like any other, so the hit is just as instant, and asks
+// the streamer for a stream slot to carry on from. service(), called from
+// loop(), opens the file while the attack plays and keeps a 2048 sample
+// ring per slot topped up; the audio ISR only ever copies out of the ring
+// and never touches the filesystem.
+//
+// Each service() tops up every stream that has room for a chunk, the one
+// with the least audio buffered first, so the reads for all voices go to
+// the card back to back. Reads are 1024 samples whose ends fall on 512
+// byte sectors of the file. A ring the ISR catches up with plays silence
+// (counted in underruns()) and the stream skips ahead rather than fall
+// further behind; a voice that gets no slot plays its attack and fades.
+//
+// The ring holds 46 ms, so service() must run at least every ~20 ms while
+// streams are active, and the resident attack must cover opening the
+// file (a few ms; 100 ms or more is comfortable).
+//
+// Usage:
+//   SampleStreamer streamer;
+//   drumPool.streamer(&streamer);
+//   crash.load("CRASH.WAV", 150);   // 150 ms in RAM, the rest from SD
+//   streamer.service();             // in loop()
+
+#ifndef sample_streamer_h_
+#define sample_streamer_h_
+
+#include <Arduino.h>
+#include <SD.h>
+#include "drum_sample.h"
+
+class SampleStreamer
+{
+public:
+  static const uint8_t MAX_STREAMS = 4;
+  static const uint16_t RING = 2048;      // samples per stream, power of two
+  static const uint16_t CHUNK = 1024;     // samples per read
+
+  SampleStreamer();
+
+  // loop() side: open new streams, top up the rings, close finished ones.
+  void service();
+
+  // Called by AudioPlaySamplePool::play() (loop context): a slot that
+  // continues `sample` from its first non-resident sample, or -1 if all
+  // slots are busy.
+  int8_t open(const DrumSample &sample);
+
+  // Audio ISR side. Copies source samples [from, from + count) into dst,
+  // silence for any not read yet. Returns false once the stream has
+  // failed (file missing), so the voice can end instead.
+  bool read(int8_t slot, int16_t *dst, uint32_t from, uint32_t count);
+
+  // The voice is done with the slot; service() closes the file.
+  void close(int8_t slot);
+
+  uint8_t activeStreams() const;
+  uint32_t underruns() const { return underrunCount; }
+  uint32_t reads() const { return readCount; }
+
+private:
+  enum State : uint8_t { FREE, OPENING, STREAMING, FAILED, CLOSING };
+
+  struct Stream {
+    const DrumSample *sample;
+    File file;
+    uint32_t end;                 // source samples in the file
+    volatile uint32_t filled;     // ring holds source samples up to here (loop)
+    volatile uint32_t consumed;   // voice has read up to here (ISR), the next
+                                  // block starts one before it
+    volatile State state;
+  };
+
+  bool start(Stream &s);
+  uint32_t readSize(const Stream &s, uint32_t &from) const;
+  bool refill(Stream &s, int16_t *ring);
+
+  Stream streams[MAX_STREAMS];
+  int16_t rings[MAX_STREAMS][RING];
+  uint8_t scratch[CHUNK * 4];     // one read of stereo frames
+  volatile uint32_t underrunCount;
+  uint32_t readCount;
+};
+
+#endif
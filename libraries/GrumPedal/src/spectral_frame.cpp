@@ -0,0 +1,111 @@
+#include "spectral_frame.h"
+
+SpectralFrame::SpectralFrame()
+{
+  energy = hfc = flux = power = diffPower = 0;
+  numPeaks = 0;
+  strongestFreq = strongestLevel = 0;
+  fundamental = -1;
+  for (int b = 0; b < NUM_BANDS; b++) band[b] = 0;
+
+  bandEdges[0] = 150.0f;
+  bandEdges[1] = 600.0f;
+  bandEdges[2] = 1450.0f;
+  bandEdges[3] = 3500.0f;
+  peakFloor = 0.002f;
+  peakMaxHz = 5000.0f;
+  harmonicFloor = 0.001f;
+  fundamentalMinHz = 60.0f;
+  fundamentalMaxHz = 800.0f;
+  prevBins = 0;
+}
+
+void SpectralFrame::compute(const float *mag, int bins, float binHz)
+{
+  if (bins > MAX_BINS) bins = MAX_BINS;
+  const bool havePrev = prevBins == bins;
+  const int half = bins / 2;
+  const int peakLimit = min(bins - 1, (int)(peakMaxHz / binHz) + 1);
+
+  // Bin ranges for the bands, worked out once here rather than per bin
+  int bandStart[NUM_BANDS + 1];
+  for (int b = 0; b <= NUM_BANDS; b++) bandStart[b] = (int)ceilf(bandEdges[b] / binHz);
+
+  float sumSq = 0, hfcSum = 0, fluxSum = 0, diffSum = 0;
+  // |1 - e^-jw|^2 = 2 - 2 cos(w) weights bin i for the first difference;
+  // cos(pi i / bins) by the Chebyshev recurrence rather than cosf() per bin
+  const float step = cosf((float)M_PI / bins);
+  float c = 1.0f, cPrev = step;
+  float bandSum[NUM_BANDS] = {0};
+  int strongest = 0;
+  float strongestMag = 0;
+  numPeaks = 0;
+
+  for (int i = 0; i < bins; i++) {
+    const float m = mag[i];
+    sumSq += m * m;
+    diffSum += m * m * (2.0f - 2.0f * c);
+    const float cNext = 2.0f * step * c - cPrev;
+    cPrev = c;
+    c = cNext;
+    if (i >= half) hfcSum += m * m * ((float)i / bins);
+    if (havePrev) {
+      float d = m - prev[i];
+      if (d > 0) fluxSum += d;
+    }
+    prev[i] = m;
+
+    for (int b = 0; b < NUM_BANDS; b++) {
+      if (i >= bandStart[b] && i < bandStart[b + 1]) bandSum[b] += m;
+    }
+    if (i >= 2 && m > strongestMag) {
+      strongestMag = m;
+      strongest = i;
+    }
+
+    // Local maximum: mag[i + 1] is read ahead, mag[i - 1] is already seen
+    if (i >= 1 && i < peakLimit && numPeaks < MAX_PEAKS &&
+        m > peakFloor && m > mag[i - 1] && m > mag[i + 1]) {
+      float left = mag[i - 1], right = mag[i + 1];
+      float denom = left - 2 * m + right;
+      float offset = denom != 0 ? 0.5f * (left - right) / denom : 0;
+      SpectralPeak &p = peaks[numPeaks++];
+      p.bin = i;
+      p.level = m;
+      p.freq = (i + offset) * binHz;
+    }
+  }
+  prevBins = bins;
+
+  energy = sqrtf(sumSq / bins);
+  hfc = sqrtf(hfcSum / (bins - half));
+  flux = fluxSum;
+  power = sumSq;
+  diffPower = diffSum;
+  for (int b = 0; b < NUM_BANDS; b++) band[b] = bandSum[b];
+  strongestFreq = strongestMag > 0 ? strongest * binHz : 0;
+  strongestLevel = strongestMag;
+  fundamental = findFundamental(mag, peakLimit);
+}
+
+// Score each of the first three peaks by its own level plus its 2nd-4th
+// harmonics (weighted 1/h, +-1 bin for tuning); best in range wins.
+float SpectralFrame::findFundamental(const float *mag, int peakLimit) const
+{
+  float best = -1, bestScore = 0;
+  for (int f = 0; f < numPeaks && f < 3; f++) {
+    const SpectralPeak &p = peaks[f];
+    float score = p.level;
+    for (int h = 2; h <= 4; h++) {
+      int hb = p.bin * h;
+      if (hb >= peakLimit) break;
+      float e = max(mag[hb], max(mag[hb - 1], mag[hb + 1]));
+      if (e > harmonicFloor) score += e / h;
+    }
+    if (score > bestScore && p.freq >= fundamentalMinHz && p.freq <= fundamentalMaxHz) {
+      bestScore = score;
+      best = p.freq;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,82 @@
+// SpectralFrame - every feature the FFT detectors need, in one pass
+//
+// compute() walks an FFT magnitude frame once and fills in energy, high
+// frequency content, spectral flux against the previous frame, three band
+// energies, the lowest spectral peaks (parabolic-interpolated), the
+// strongest bin and a harmonic-sum fundamental. Detectors then read the
+// frame instead of each looping over fft.read() data again, and the
+// fundamental is found once per frame no matter how many detectors ask.
+//
+// peaks[] holds the first MAX_PEAKS local maxima above peakFloor counted
+// up from the bottom bin, in frequency order, not the strongest K: the
+// fundamental search wants the low ones, and a loud 5th harmonic would
+// otherwise push the fundamental out of the list. A frame with more
+// maxima than that drops its highest ones.
+//
+// Band edges and limits are in Hz, so the same frame works for FFT256
+// (172 Hz bins) or a larger transform. Defaults reproduce grum-pedal.cpp:
+// bands 150-600 / 600-1450 / 1450-3500 Hz (bins 1-3, 4-8, 9-20 at 256),
+// peaks below 5 kHz (bin 30) above 0.002, fundamental 60-800 Hz.
+//
+// energy and hfc are averages over bins, far below the time-domain RMS
+// the block detectors' thresholds are in. power and diffPower are sums,
+// so by Parseval they give those units back: for a Hann-windowed frame
+// at the FFT256 scale the block's RMS is sqrt(power * 4/3), and
+// sqrt(diffPower * 4/3) is BlockFeatures::hfcRms().
+//
+// Usage:
+//   SpectralFrame spectrum;
+//   for (int i = 0; i < 128; i++) fftData[i] = fft.read(i);
+//   spectrum.compute(fftData, 128, AUDIO_SAMPLE_RATE_EXACT / 256);
+//   if (spectrum.fundamental > 0) ...
+
+#ifndef spectral_frame_h_
+#define spectral_frame_h_
+
+#include <Arduino.h>
+
+struct SpectralPeak {
+  float freq;       // Hz, interpolated between bins
+  float level;      // magnitude at the peak bin
+  uint16_t bin;
+};
+
+class SpectralFrame
+{
+public:
+  static const int MAX_BINS = 1024;
+  static const int MAX_PEAKS = 8;
+  static const int NUM_BANDS = 3;
+
+  SpectralFrame();
+
+  void compute(const float *mag, int bins, float binHz);
+
+  // ---- results, valid after compute() ----
+  float energy;                 // RMS over all bins
+  float hfc;                    // bin-weighted RMS of the upper half
+  float flux;                   // sum of positive changes since last frame
+  float power;                  // sum of squared magnitudes
+  float diffPower;              // power of the first difference, x[n] - x[n-1]
+  float band[NUM_BANDS];        // summed magnitude per band
+  SpectralPeak peaks[MAX_PEAKS];  // lowest local maxima, ascending
+  uint8_t numPeaks;
+  float strongestFreq;          // loudest bin from bin 2 up, Hz
+  float strongestLevel;
+  float fundamental;            // Hz, -1 when no harmonic series found
+
+  // ---- configuration ----
+  float bandEdges[NUM_BANDS + 1];
+  float peakFloor;              // minimum magnitude for a peak
+  float peakMaxHz;              // peaks (and harmonics) searched below this
+  float harmonicFloor;          // a harmonic counts above this
+  float fundamentalMinHz, fundamentalMaxHz;
+
+private:
+  float findFundamental(const float *mag, int peakLimit) const;
+
+  float prev[MAX_BINS];
+  int prevBins;
+};
+
+#endif
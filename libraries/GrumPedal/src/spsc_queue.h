@@ -0,0 +1,62 @@
+// Single-producer / single-consumer queue for handing data out of the
+// audio interrupt without locks.
+//
+// The producer (usually an AudioStream::update() running in the audio ISR)
+// only ever writes `head`, the consumer (usually loop()) only ever writes
+// `tail`. Both indices are free running; N must be a power of two so the
+// wrap is a mask and the full/empty test survives overflow of the counters.
+
+#ifndef spsc_queue_h_
+#define spsc_queue_h_
+
+#include <stdint.h>
+
+// Keep the compiler from moving the payload copy past the index update.
+// Cortex-M7 is single core, so a compiler barrier is all we need here.
+#define SPSC_BARRIER() __asm__ volatile("" ::: "memory")
+
+template <typename T, uint16_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+  SpscQueue() : head(0), tail(0), overflows(0) {}
+
+  // Producer side. Returns false (and counts it) when the queue is full,
+  // the newest item is dropped so the consumer never sees torn data.
+  bool push(const T &item) {
+    uint16_t h = head;
+    if ((uint16_t)(h - tail) >= N) {
+      overflows++;
+      return false;
+    }
+    items[h & (N - 1)] = item;
+    SPSC_BARRIER();
+    head = h + 1;
+    return true;
+  }
+
+  // Consumer side.
+  bool pop(T &item) {
+    uint16_t t = tail;
+    if (t == head) return false;
+    SPSC_BARRIER();
+    item = items[t & (N - 1)];
+    SPSC_BARRIER();
+    tail = t + 1;
+    return true;
+  }
+
+  bool empty() const { return tail == head; }
+  uint16_t size() const { return (uint16_t)(head - tail); }
+  uint32_t dropped() const { return overflows; }
+  static constexpr uint16_t capacity() { return N; }
+
+private:
+  T items[N];
+  volatile uint16_t head;
+  volatile uint16_t tail;
+  volatile uint32_t overflows;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "synth_drum_pool.h"
+#include <dspinst.h>
+
+namespace {
+
+// sin(x) for |x| <= pi, usable in constant expressions
+constexpr double sine(double x)
+{
+  double term = x, sum = x;
+  for (int k = 1; k < 12; k++) {
+    term *= -x * x / ((2 * k) * (2 * k + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+// One cycle, and its first entry again for the interpolation; built by
+// the compiler, so it lives in flash
+struct SineTable {
+  int16_t v[257];
+  constexpr SineTable() : v()
+  {
+    for (int i = 0; i <= 256; i++) {
+      const double s = sine(6.283185307179586 * (i < 128 ? i : i - 256) / 256) * 32767;
+      v[i] = (int16_t)(s < 0 ? s - 0.5 : s + 0.5);
+    }
+  }
+};
+
+constexpr SineTable SINE;
+
+// Top 8 bits of the phase pick the entry, the next 16 interpolate
+inline int32_t sineAt(uint32_t phase)
+{
+  const uint32_t i = phase >> 24;
+  const int32_t frac = (phase >> 8) & 0xFFFF;
+  const int32_t a = SINE.v[i], b = SINE.v[i + 1];
+  return a + (((b - a) * frac) >> 16);
+}
+
+}  // namespace
+
+AudioSynthDrumPool::AudioSynthDrumPool() : AudioStream(0, NULL), probe(nullptr), seed(22222)
+{
+  memset(voices, 0, sizeof(voices));
+}
+
+int32_t AudioSynthDrumPool::toQ16(float gain)
+{
+  return (int32_t)(constrain(gain, 0.0f, 2.0f) * 65536.0f);
+}
+
+bool AudioSynthDrumPool::play(uint8_t v, const SynthDrumPatch &patch, float gain, uint8_t offset)
+{
+  if (v >= MAX_VOICES) return false;
+
+  // The float work here in loop(), so update() only steps envelopes
+  const float fs = AUDIO_SAMPLE_RATE_EXACT;
+  const float hz = constrain(patch.frequency, 10.0f, fs / 8);
+  const float pm = constrain(patch.pitchMod, 0.0f, 1.0f);
+  const float second = constrain(patch.secondMix, 0.0f, 1.0f);
+  const float noise = constrain(patch.noiseMix, 0.0f, 1.0f);
+  Osc o;
+  o.phase = o.phase2 = 0;
+  o.baseInc = (uint32_t)(hz * (4294967296.0f / fs));
+  // 0.5 = steady, 1 starts at 3x, 0 at 0.25x
+  o.sweep = pm >= 0.5f ? (pm - 0.5f) * 4.0f : (pm - 0.5f) * 1.5f;
+  o.inc = (uint32_t)(o.baseInc * (1.0f + o.sweep));
+  o.env = 1.0f;
+  o.envStep = AUDIO_BLOCK_SAMPLES * 1000.0f / (fs * max(patch.lengthMs, 1.0f));
+  seed = seed * 1664525u + 1013904223u;
+  o.noise = seed | 1;
+  o.toneMix = (int16_t)((1.0f - noise) * (1.0f - second) * 32767.0f);
+  o.secondMix = (int16_t)((1.0f - noise) * second * 32767.0f);
+  o.noiseMix = (int16_t)(noise * 32767.0f);
+  o.gain = toQ16(gain);
+
+  Voice &voice = voices[v];
+  __disable_irq();
+  voice.ghosting = voice.playing && voice.cur.gain > 0;
+  if (voice.ghosting) voice.ghost = voice.cur;
+  voice.cur = o;
+  voice.velocity = gain;
+  voice.playing = true;
+  voice.stopping = false;
+  voice.fresh = true;
+  voice.offset = offset < AUDIO_BLOCK_SAMPLES ? offset : AUDIO_BLOCK_SAMPLES - 1;
+  __enable_irq();
+  return true;
+}
+
+void AudioSynthDrumPool::stop(uint8_t v)
+{
+  if (v >= MAX_VOICES) return;
+  __disable_irq();
+  if (voices[v].playing) voices[v].stopping = true;
+  __enable_irq();
+}
+
+void AudioSynthDrumPool::stopAll()
+{
+  for (uint8_t v = 0; v < MAX_VOICES; v++) stop(v);
+}
+
+float AudioSynthDrumPool::level(uint8_t v) const
+{
+  if (!isPlaying(v) || isStopping(v)) return 0.0f;
+  const Voice &voice = voices[v];
+  return voice.velocity * voice.cur.env * voice.cur.env;
+}
+
+uint8_t AudioSynthDrumPool::activeVoices() const
+{
+  uint8_t n = 0;
+  for (uint8_t v = 0; v < MAX_VOICES; v++) {
+    if (voices[v].playing) n++;
+  }
+  return n;
+}
+
+void AudioSynthDrumPool::render(int32_t *acc, Osc &o, int32_t g0, int32_t g1, uint32_t inc1,
+                                uint32_t count)
+{
+  if (!count) return;
+  int32_t g = g0;
+  const int32_t gStep = (g1 - g0) / (int32_t)count;
+  uint32_t inc = o.inc;
+  const int32_t incStep = (int32_t)(inc1 - o.inc) / (int32_t)count;
+  uint32_t ph = o.phase, ph2 = o.phase2, r = o.noise;
+  const int32_t w1 = o.toneMix, w2 = o.secondMix, wn = o.noiseMix;
+
+  // The weights add up to 1.0 in Q15, so x stays inside 31 bits
+  for (uint32_t i = 0; i < count; i++) {
+    int32_t x = sineAt(ph) * w1;
+    if (w2) x += sineAt(ph2) * w2;
+    if (wn) {
+      r ^= r << 13;
+      r ^= r >> 17;
+      r ^= r << 5;
+      x += (int16_t)(r >> 16) * wn;
+    }
+    acc[i] += signed_multiply_32x16b(g, x >> 15);
+    ph += inc;
+    ph2 += inc + (inc >> 1);
+    inc += incStep;
+    g += gStep;
+  }
+
+  o.phase = ph;
+  o.phase2 = ph2;
+  o.noise = r;
+  o.inc = inc1;
+}
+
+void AudioSynthDrumPool::update(void)
+{
+  int32_t acc[AUDIO_BLOCK_SAMPLES];
+  bool any = false;
+  bool started = false;
+
+  for (uint8_t v = 0; v < MAX_VOICES; v++) {
+    Voice &voice = voices[v];
+    if (voice.ghosting) {
+      if (!any) memset(acc, 0, sizeof(acc));
+      any = true;
+      render(acc, voice.ghost, voice.ghost.gain, 0, voice.ghost.inc, AUDIO_BLOCK_SAMPLES);
+      voice.ghosting = false;
+    }
+    if (!voice.playing) continue;
+    if (!any) memset(acc, 0, sizeof(acc));
+    any = true;
+    started |= voice.fresh;
+    const uint8_t skip = voice.fresh ? voice.offset : 0;
+    voice.fresh = false;
+
+    // Envelope and pitch at the end of this block; render() ramps to them
+    Osc &o = voice.cur;
+    o.env = o.env > o.envStep ? o.env - o.envStep : 0.0f;
+    const float a = o.env * o.env;
+    const int32_t g1 = voice.stopping ? 0 : toQ16(voice.velocity * a);
+    const uint32_t inc1 = (uint32_t)(o.baseInc * (1.0f + o.sweep * a));
+    render(acc + skip, o, o.gain, g1, inc1, AUDIO_BLOCK_SAMPLES - skip);
+    o.gain = g1;
+    if (g1 == 0) voice.playing = false;
+  }
+  if (!any) return;
+
+  audio_block_t *block = allocate();
+  if (!block) return;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    block->data[i] = signed_saturate_rshift(acc[i], 16, 0);
+  }
+  transmit(block);
+  release(block);
+  if (started && probe) probe->output();
+}
@@ -0,0 +1,113 @@
+// AudioSynthDrumPool - procedural drum voices rendered in one object
+//
+// The synth kits use five AudioSynthSimpleDrum objects, one per drum: a
+// second hit of the same drum cuts the first, the hats and crash are
+// sines with nothing of a cymbal's noise, and all five sit in the update
+// list whether they sound or not. This pool is the synth counterpart of
+// AudioPlaySamplePool: any voice plays any SynthDrumPatch, a
+// DrumVoiceManager hands voices out per hit (begin(AudioSynthDrumPool &)),
+// and every active voice is summed into one output block. With nothing
+// sounding update() returns before allocating, so a silent pool costs a
+// loop over the voice flags.
+//
+// A voice is a table sine, an optional second partial a fifth above
+// (secondMix) and white noise (noiseMix), under one decay envelope. As in
+// AudioSynthSimpleDrum the envelope falls linearly over lengthMs and the
+// level is its square, and pitchMod (0.5 = none) bends the pitch by the
+// same envelope: above 0.5 it starts up to 3x high and falls, below it
+// starts low and rises. Envelope and pitch are worked out once per block;
+// within a block the gain and the phase increment ramp linearly, so the
+// per-sample work is two table reads, a noise step and a multiply-add.
+//
+// play() on a busy voice fades the old note out over one block under the
+// new one and stop() fades a voice out over a block, as the sample pool
+// does, so steals and chokes don't click.
+//
+// Usage:
+//   AudioSynthDrumPool synthPool;
+//   AudioConnection c(synthPool, 0, mainMixer, 1);
+//   const SynthDrumPatch CRASH = { 900, 500, 1.0f, 0.5f, 0.7f };
+//   synthPool.play(0, CRASH, 0.8f);
+
+#ifndef synth_drum_pool_h_
+#define synth_drum_pool_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include "latency_probe.h"
+
+struct SynthDrumPatch {
+  float frequency;     // Hz, where the pitch settles
+  float lengthMs;      // decay to silence
+  float secondMix;     // 0..1, partial at 1.5x frequency
+  float pitchMod;      // 0..1, 0.5 = steady (AudioSynthSimpleDrum::pitchMod())
+  float noiseMix;      // 0..1, white noise against the tone
+};
+
+class AudioSynthDrumPool : public AudioStream
+{
+public:
+  static const uint8_t MAX_VOICES = 16;
+
+  AudioSynthDrumPool();
+
+  // Start `patch` on voice v at `gain` (0..2), `offset` samples into the
+  // next block. A note already on this voice fades out over one block.
+  bool play(uint8_t v, const SynthDrumPatch &patch, float gain, uint8_t offset = 0);
+
+  // Fade voice v out over one block.
+  void stop(uint8_t v);
+  void stopAll();
+
+  // True until the voice has finished (including its fade-out).
+  bool isPlaying(uint8_t v) const { return v < MAX_VOICES && voices[v].playing; }
+  bool isStopping(uint8_t v) const { return v < MAX_VOICES && voices[v].stopping; }
+
+  // gain x envelope, 0 once stopping
+  float level(uint8_t v) const;
+  uint8_t activeVoices() const;
+
+  // Report the first block of every newly started voice to `probe`
+  // (nullptr to stop).
+  void latencyProbe(LatencyProbe *p) { probe = p; }
+
+  virtual void update(void);
+
+private:
+  struct Osc {
+    uint32_t phase;
+    uint32_t phase2;     // second partial
+    uint32_t inc;        // phase step at the end of the last block
+    uint32_t baseInc;    // at `frequency`
+    float sweep;         // starting pitch ratio - 1
+    float env;           // 1 -> 0; the level is env^2
+    float envStep;       // per block
+    uint32_t noise;      // xorshift state
+    int16_t toneMix;     // Q15 weights of sine, partial and noise
+    int16_t secondMix;
+    int16_t noiseMix;
+    int32_t gain;        // Q16, at the end of the last block
+  };
+
+  struct Voice {
+    Osc cur;
+    Osc ghost;           // previous note fading out after a steal
+    float velocity;      // play()'s gain
+    bool playing;
+    bool stopping;
+    bool ghosting;
+    bool fresh;          // play() since the last update
+    uint8_t offset;      // where in its first block the note starts
+  };
+
+  // Add `count` samples of o into acc, gain ramping g0 -> g1 and the
+  // phase step o.inc -> inc1
+  static void render(int32_t *acc, Osc &o, int32_t g0, int32_t g1, uint32_t inc1, uint32_t count);
+  static int32_t toQ16(float gain);
+
+  Voice voices[MAX_VOICES];
+  LatencyProbe *probe;
+  uint32_t seed;
+};
+
+#endif
@@ -0,0 +1,428 @@
+// Trigger<OnsetPolicy, PitchPolicy, VoicePolicy, GuessPolicy> - one configurable pedal
+//
+// The sketch forks each hardwire an onset method, a pitch source and a
+// sound source, and most carry analysers they never read. Trigger takes
+// the three as template parameters instead, so a build names exactly the
+// combination it ships and only those policies' audio objects exist: an
+// unused FFT or sample pool is never constructed, never updated and never
+// holds an audio block.
+//
+//   Trigger<PluckOnset, OnsetPitch, SynthVoices> pedal(highpass);
+//   AudioConnection c(pedal.output(), 0, mainMixer, 1);
+//   void setup() { pedal.begin(); }
+//   void loop()  { pedal.update(); }
+//
+// Onsets come from the onset policy. The engine then waits up to
+// PitchPolicy::WAIT_MS for the pitch policy to name the note, maps it to a
+// drum through bands() and plays it on the voice policy, honouring a
+// per-drum retrigger time. Policies only need the members below; see
+// onset_policies.h, pitch_policies.h, voice_policies.h and
+// guess_policies.h.
+//
+// With a GuessPolicy other than NoGuess the engine speculates: while the
+// pitch policy is still listening it plays the drum of the first guess at
+// once. When the pitch arrives and names another drum, the guessed one is
+// faded out over a block (VoicePolicy::cancel()) and the right one
+// played; when no pitch arrives in time, or the next pluck comes first,
+// the guess is faded out and nothing replaces it, as the engine without a
+// guess would have played nothing. mispredictions() over speculated() is
+// the price of the early hits, gainedMs() what they bought.
+//
+// Hits start at the attack's sample within the next output block
+// (TriggerOnset::offset), not on its edge. fixedLatency() goes further for
+// onset policies that count blocks: every hit is held until exactly that
+// many samples after its attack, so the delay no longer depends on how
+// long the pitch took or when loop() came round, only on the setting. A
+// hit whose pitch arrives after its slot is dropped rather than played
+// off the grid, and counts in late() (and misses()); set the slot to the
+// slowest pitch that should still play. The slot counts from the attack
+// the onset policy found, so it is only as steady against the pick as
+// that policy's onsets are.
+//
+//   struct OnsetPolicy {
+//     OnsetPolicy(AudioStream &input);     // connect analysers to input
+//     void begin();
+//     static constexpr AudioBudget budget();   // its audio blocks
+//     bool poll(TriggerOnset &o);          // loop(): next onset, if any
+//     uint32_t blocks() const;             // input blocks so far, 0 if untimed
+//   };
+//   struct PitchPolicy {
+//     static const uint16_t WAIT_MS;       // longest wait after an onset
+//     PitchPolicy(AudioStream &input);
+//     void begin();
+//     static constexpr AudioBudget budget();
+//     void update();                       // every loop()
+//     void onset(const TriggerOnset &o);   // a new note started
+//     float read(const TriggerOnset &o);   // Hz, -1 while unknown
+//   };
+//   struct VoicePolicy {
+//     static const uint8_t NUM_DRUMS;
+//     void begin();
+//     static constexpr AudioBudget budget();
+//     bool play(uint8_t drum, float velocity,
+//               uint8_t offset);           // offset samples into the next block
+//     void cancel(uint8_t drum);           // fade out its latest hit
+//     AudioStream &output();               // mono, output 0
+//     void latencyProbe(LatencyProbe *p);
+//   };
+
+#ifndef trigger_engine_h_
+#define trigger_engine_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+#include "audio_budget.h"
+#include "latency_probe.h"
+#include "onset_policies.h"
+#include "pitch_policies.h"
+#include "voice_policies.h"
+#include "guess_policies.h"
+
+struct TriggerHit {
+  int8_t drum;         // -1 when the note mapped to no drum
+  float  frequency;    // Hz, -1 if no pitch was found in time
+  float  velocity;
+  bool   played;       // false: unmapped, no pitch or within retrigger time
+  bool   early;        // played on the guess, before the pitch was known
+  bool   late;         // not played: its fixedLatency() slot had passed,
+                       // or no slot was free to hold it
+  int8_t replaced;     // the guessed drum this hit faded out, or -1; not
+                       // played: withdrawn with nothing in its place
+  uint8_t offset;      // sample of the output block it started at
+};
+
+template <class OnsetPolicy, class PitchPolicy, class VoicePolicy, class GuessPolicy = NoGuess>
+class Trigger
+{
+public:
+  static const uint8_t MAX_BANDS = 8;
+  typedef void (*HitHandler)(const TriggerHit &hit);
+
+  OnsetPolicy onset;
+  PitchPolicy pitch;
+  VoicePolicy voice;
+  GuessPolicy guess;
+
+  explicit Trigger(AudioStream &input)
+    : onset(input), pitch(input), guess(input), waiting(false), retriggerMs(80),
+      pitchWaitMs(PitchPolicy::WAIT_MS), latencySamples(0), numHeld(0), lateCount(0),
+      speculating(true), guessDrum(-1), probe(nullptr), handler(nullptr), hitCount(0),
+      missCount(0)
+  {
+    // Same split as triggerDrumForFrequency():
+    // KICK 60-110, SNARE 110-165, HAT 165-260, RIDE 260-400, CRASH 400+
+    static const float EDGES[] = { 60.0f, 110.0f, 165.0f, 260.0f, 400.0f };
+    bands(EDGES, sizeof(EDGES) / sizeof(EDGES[0]));
+    memset(lastTrigger, 0, sizeof(lastTrigger));
+    resetSpeculation();
+  }
+
+  void begin()
+  {
+    onset.begin();
+    pitch.begin();
+    voice.begin();
+    guess.begin();
+  }
+
+  // Audio blocks the policies' objects need (audio_budget.h); add the
+  // sketch's own input, output and mixers for AudioMemory()
+  static constexpr AudioBudget budget()
+  {
+    return OnsetPolicy::budget().add(PitchPolicy::budget()).add(VoicePolicy::budget()).add(GuessPolicy::budget());
+  }
+
+  // Lower band edges in Hz, ascending; band i plays drum i. The last band
+  // is open ended; below edges[0] nothing plays.
+  void bands(const float *edgesHz, uint8_t count)
+  {
+    if (count > MAX_BANDS) count = MAX_BANDS;
+    if (count > VoicePolicy::NUM_DRUMS) count = VoicePolicy::NUM_DRUMS;
+    for (uint8_t i = 0; i < count; i++) edges[i] = edgesHz[i];
+    numBands = count;
+  }
+
+  // Minimum time between two hits on the same drum (80 ms by default)
+  void retrigger(uint16_t ms) { retriggerMs = ms; }
+  // Override PitchPolicy::WAIT_MS
+  void pitchWait(uint16_t ms) { pitchWaitMs = ms; }
+  // Start every timed hit this many samples after its attack (0, the
+  // default: as soon as the pitch is known). Hits whose pitch comes later
+  // than that are dropped, so set it to the slowest pitch the pedal
+  // should still play, WAIT_MS or less.
+  void fixedLatency(uint16_t samples) { latencySamples = samples; }
+  // Play on the GuessPolicy's estimate (on by default; no effect with
+  // NoGuess)
+  void speculate(bool on) { speculating = on; }
+
+  void latencyProbe(LatencyProbe *p)
+  {
+    probe = p;
+    voice.latencyProbe(p);
+  }
+
+  // Called from update() for every onset once its pitch is settled,
+  // whether or not a drum played. A speculative hit is reported when it
+  // plays (early set); the settled pitch only reports again if it played
+  // another drum or withdrew the guess (replaced set). A hit held for
+  // fixedLatency() reports when it starts, or with late set when its
+  // slot had passed. An onset the next pluck replaces before its pitch
+  // came reports as one without a pitch.
+  void onHit(HitHandler fn) { handler = fn; }
+
+  int drumFor(float freq) const
+  {
+    if (freq <= 0 || numBands == 0 || freq < edges[0]) return -1;
+    int b = 0;
+    while (b + 1 < numBands && freq >= edges[b + 1]) b++;
+    return b;
+  }
+
+  // Call from loop(). Returns true when a drum was played.
+  bool update()
+  {
+    pitch.update();
+    bool played = numHeld && startHeld();
+
+    TriggerOnset o;
+    if (onset.poll(o)) {
+      if (probe) probe->onset(o.cycles);
+      // A new pluck replaces one still waiting for its pitch: it goes
+      // the way of one whose pitch timed out, reported and counted in
+      // misses(), and a guess already playing for it is withdrawn
+      if (waiting) {
+        if (guessDrum >= 0) settle(-1.0f);
+        else fire(-1.0f);
+      }
+      pending = o;
+      waiting = true;
+      guessDrum = -1;
+      pitch.onset(o);
+      guess.onset(o);
+    }
+    if (!waiting) return played;
+
+    float freq = pitch.read(pending);
+    if (freq <= 0 && millis() - pending.millis < pitchWaitMs) {
+      if (speculating && guessDrum < 0 && speculate()) played = true;
+      return played;
+    }
+    waiting = false;
+    if (guessDrum >= 0 ? settle(freq) : fire(freq)) played = true;
+    return played;
+  }
+
+  AudioStream &output() { return voice.output(); }
+
+  uint32_t hits() const { return hitCount; }
+  uint32_t misses() const { return missCount; }
+  // Timed hits dropped for missing their fixedLatency() slot
+  uint32_t late() const { return lateCount; }
+
+  // Hits played on a guess; of those, the ones the pitch moved to another
+  // drum, and the ones it never confirmed either way (no pitch in time
+  // or another pluck first, faded out as well)
+  uint32_t speculated() const { return guessCount; }
+  uint32_t mispredictions() const { return wrongCount; }
+  uint32_t unconfirmed() const { return openCount; }
+  // Mean time from a confirmed guess to the pitch that confirmed it
+  float gainedMs() const
+  {
+    uint32_t right = guessCount - wrongCount - openCount;
+    return right ? (float)gainedTotal / right : 0.0f;
+  }
+  void resetSpeculation()
+  {
+    guessCount = wrongCount = openCount = 0;
+    gainedTotal = 0;
+  }
+  void printSpeculation(Print &out) const
+  {
+    out.printf("Speculation: %lu early hits, %lu mispredicted (%.1f%%), %lu unconfirmed, %.1f ms gained\n",
+               (unsigned long)guessCount, (unsigned long)wrongCount,
+               guessCount ? 100.0f * wrongCount / guessCount : 0.0f,
+               (unsigned long)openCount, gainedMs());
+  }
+
+private:
+  bool fire(float freq, int8_t replaced = -1)
+  {
+    TriggerHit hit;
+    hit.drum = (int8_t)drumFor(freq);
+    hit.frequency = freq > 0 ? freq : -1.0f;
+    hit.velocity = pending.velocity;
+    hit.played = false;
+    hit.early = false;
+    hit.late = false;
+    hit.replaced = replaced;
+    hit.offset = 0;
+
+    if (hit.drum >= 0 && millis() - lastTrigger[hit.drum] > retriggerMs) {
+      if (numHeld == MAX_HELD) {
+        // No room for its slot: as late as a pitch that came too late
+        hit.late = true;
+        lateCount++;
+        missCount++;
+        if (handler) handler(hit);
+        return false;
+      }
+      Held &h = held[numHeld++];
+      h.hit = hit;
+      h.onset = pending;
+      h.trigger = lastTrigger[hit.drum];
+      h.stamp = lastTrigger[hit.drum] = millis();
+      return startHeld();
+    }
+    missCount++;
+    if (handler) handler(hit);
+    return false;
+  }
+
+  // Where a hit for o stands against the next output block: its fixed
+  // latency slot is later (SLOT_WAIT), inside it at `offset` (SLOT_DUE) or
+  // already gone (SLOT_MISSED). The caller holds audio interrupts off
+  // until the voice is started, so the block can't move in between.
+  enum Slot { SLOT_WAIT, SLOT_DUE, SLOT_MISSED };
+  Slot slot(const TriggerOnset &o, uint8_t &offset)
+  {
+    offset = o.offset;
+    if (!latencySamples || !o.block) return SLOT_DUE;
+    const int32_t wait = (int32_t)(o.block - 1 - onset.blocks()) * AUDIO_BLOCK_SAMPLES +
+                         o.offset + latencySamples;
+    if (wait >= AUDIO_BLOCK_SAMPLES) return SLOT_WAIT;
+    if (wait < 0) return SLOT_MISSED;
+    offset = (uint8_t)wait;
+    return SLOT_DUE;
+  }
+
+  // Play the held hits whose slots have come, oldest first; drop the
+  // ones whose slots have passed and give their drums back the retrigger
+  // time, unless a later hit has taken the drum since
+  bool startHeld()
+  {
+    bool played = false;
+    while (numHeld) {
+      Held &h = held[0];
+      uint8_t offset;
+      AudioNoInterrupts();
+      const Slot s = slot(h.onset, offset);
+      if (s == SLOT_WAIT) {
+        AudioInterrupts();
+        break;
+      }
+      if (s == SLOT_DUE) {
+        if (probe) probe->noteOn();
+        h.hit.played = voice.play(h.hit.drum, h.hit.velocity, offset);
+      } else {
+        h.hit.played = false;
+        h.hit.late = true;
+        lateCount++;
+        if (lastTrigger[h.hit.drum] == h.stamp) lastTrigger[h.hit.drum] = h.trigger;
+      }
+      AudioInterrupts();
+      h.hit.offset = offset;
+      if (h.hit.played) hitCount++;
+      else missCount++;
+      played |= h.hit.played;
+      if (handler) handler(h.hit);
+      numHeld--;
+      for (uint8_t i = 0; i < numHeld; i++) held[i] = held[i + 1];
+    }
+    return played;
+  }
+
+  // Play the guessed drum now, if there is a guess and the drum is free
+  bool speculate()
+  {
+    float freq = guess.guess(pending);
+    if (freq <= 0) return false;
+    int drum = drumFor(freq);
+    if (drum < 0 || millis() - lastTrigger[drum] <= retriggerMs) return false;
+
+    // A guess keeps to the slot too; past it, the pitch's hit is dropped
+    uint8_t offset;
+    AudioNoInterrupts();
+    if (slot(pending, offset) != SLOT_DUE) {
+      AudioInterrupts();
+      return false;
+    }
+    if (probe) probe->noteOn();
+    const bool started = voice.play(drum, pending.velocity, offset);
+    AudioInterrupts();
+    if (!started) return false;
+    guessTrigger = lastTrigger[drum];
+    lastTrigger[drum] = millis();
+    guessMs = millis();
+    guessDrum = (int8_t)drum;
+    guessCount++;
+    hitCount++;
+
+    TriggerHit hit;
+    hit.drum = guessDrum;
+    hit.frequency = freq;
+    hit.velocity = pending.velocity;
+    hit.played = true;
+    hit.early = true;
+    hit.late = false;
+    hit.replaced = -1;
+    hit.offset = offset;
+    if (handler) handler(hit);
+    return true;
+  }
+
+  // The pitch is in (or timed out) with a guess already sounding
+  bool settle(float freq)
+  {
+    const int8_t guessed = guessDrum;
+    guessDrum = -1;
+    const int drum = drumFor(freq);
+    if (freq > 0 && drum == guessed) {
+      gainedTotal += millis() - guessMs;
+      // Hold the drum from here, as without the guess: speculating moves
+      // hits earlier but doesn't let a retrigger through sooner
+      lastTrigger[guessed] = millis();
+      return false;
+    }
+    // Wrong band or no pitch: fade the guess out, and give its drum back
+    // the retrigger time it had before. With no pitch fire() plays
+    // nothing and reports the withdrawal.
+    if (freq > 0) wrongCount++;
+    else openCount++;
+    voice.cancel(guessed);
+    lastTrigger[guessed] = guessTrigger;
+    hitCount--;
+    return fire(freq, guessed);
+  }
+
+  float edges[MAX_BANDS];
+  uint8_t numBands;
+  uint32_t lastTrigger[MAX_BANDS];
+  TriggerOnset pending;
+  bool waiting;
+  uint16_t retriggerMs;
+  uint16_t pitchWaitMs;
+  uint16_t latencySamples;
+  // Hits waiting for their fixedLatency() slots, oldest first
+  static const uint8_t MAX_HELD = 4;
+  struct Held {
+    TriggerHit hit;
+    TriggerOnset onset;
+    uint32_t trigger;        // lastTrigger[hit.drum] before it
+    uint32_t stamp;          // ... and what it set it to
+  };
+  Held held[MAX_HELD];
+  uint8_t numHeld;
+  uint32_t lateCount;
+  bool speculating;
+  int8_t guessDrum;          // drum playing on a guess for pending, -1 if none
+  uint32_t guessMs;
+  uint32_t guessTrigger;     // lastTrigger[guessDrum] before the guess
+  uint32_t guessCount, wrongCount, openCount;
+  uint32_t gainedTotal;      // ms
+  LatencyProbe *probe;
+  HitHandler handler;
+  uint32_t hitCount;
+  uint32_t missCount;
+};
+
+#endif
@@ -0,0 +1,210 @@
+// Voice policies for Trigger<> (trigger_engine.h)
+//
+//   SynthVoices      five AudioSynthSimpleDrum voices (kick, snare, hat,
+//                    ride, crash) summed by one AudioMixerFused, velocity
+//                    applied per note with noteGain()
+//   SynthPoolVoices  the same five drums as patches on an
+//                    AudioSynthDrumPool, voices allocated per hit by a
+//                    DrumVoiceManager: a drum rings on under its next hit,
+//                    the hats and crash get noise, and silence costs nothing
+//   SampleVoices     RAM samples on an AudioPlaySamplePool, allocated by a
+//                    DrumVoiceManager; load the kit through kit() in setup()
+//
+// output() is the policy's mono drum bus; connect it to the sketch's main
+// mix next to the dry guitar.
+
+#ifndef voice_policies_h_
+#define voice_policies_h_
+
+#include <Arduino.h>
+#include <Audio.h>
+#include "audio_budget.h"
+#include "mixer_fused.h"
+#include "play_sample_pool.h"
+#include "synth_drum_pool.h"
+#include "drum_voices.h"
+#include "latency_probe.h"
+
+class SynthVoices
+{
+public:
+  static const uint8_t NUM_DRUMS = 5;
+
+  SynthVoices()
+    : kickCord(drums[0], 0, bus, 0), snareCord(drums[1], 0, bus, 1),
+      hatCord(drums[2], 0, bus, 2), rideCord(drums[3], 0, bus, 3),
+      crashCord(drums[4], 0, bus, 4)
+  {
+    // Full-velocity level of each drum: the old drumMixer x mainMixer
+    // products (kick 0.7 x 0.8, crash 0.6 direct)
+    static const float LEVEL[NUM_DRUMS] = { 0.56f, 0.56f, 0.40f, 0.40f, 0.60f };
+    for (int i = 0; i < NUM_DRUMS; i++) level[i] = LEVEL[i];
+  }
+
+  static constexpr AudioBudget budget()
+  {
+    return AudioBudget().add(AUDIO_COST_SIMPLE_DRUM, NUM_DRUMS).add(AUDIO_COST_MIXER_FUSED);
+  }
+
+  void begin()
+  {
+    // frequency, length, secondMix, pitchMod - setupDrumSounds()
+    static const float SOUND[NUM_DRUMS][4] = {
+      {  60, 150, 0.0f, 0.5f },   // kick: deep and punchy
+      { 200, 100, 1.0f, 0.2f },   // snare: snappy with noise
+      { 800,  40, 1.0f, 0.0f },   // hat: short and crisp
+      { 500, 300, 0.5f, 0.1f },   // ride: metallic ring
+      { 900, 500, 1.0f, 0.0f },   // crash: long and bright
+    };
+    for (int i = 0; i < NUM_DRUMS; i++) {
+      drums[i].frequency(SOUND[i][0]);
+      drums[i].length(SOUND[i][1]);
+      drums[i].secondMix(SOUND[i][2]);
+      drums[i].pitchMod(SOUND[i][3]);
+      bus.gain(i, level[i]);
+    }
+  }
+
+  // Full-velocity level of one drum on the bus
+  void drumLevel(uint8_t drum, float gain)
+  {
+    if (drum < NUM_DRUMS) level[drum] = gain;
+  }
+
+  // The drum starts `offset` samples into the next block, delayed on its
+  // bus channel (AudioMixerFused::noteGain())
+  bool play(uint8_t drum, float velocity, uint8_t offset = 0)
+  {
+    if (drum >= NUM_DRUMS) return false;
+    // Quietest velocity still plays at 0.2 of full level
+    bus.noteGain(drum, level[drum] * (velocity * 0.8f + 0.2f), offset);
+    drums[drum].noteOn();
+    return true;
+  }
+
+  // Ramp the drum's channel down over the next block; the next play()
+  // sets it again
+  void cancel(uint8_t drum)
+  {
+    if (drum < NUM_DRUMS) bus.gain(drum, 0.0f);
+  }
+
+  AudioSynthSimpleDrum &drum(uint8_t i) { return drums[i < NUM_DRUMS ? i : 0]; }
+  AudioStream &output() { return bus; }
+  void latencyProbe(LatencyProbe *p) { bus.latencyProbe(p); }
+
+private:
+  AudioSynthSimpleDrum drums[NUM_DRUMS];
+  AudioMixerFused<NUM_DRUMS> bus;
+  AudioConnection kickCord, snareCord, hatCord, rideCord, crashCord;
+  float level[NUM_DRUMS];
+};
+
+class SynthPoolVoices
+{
+public:
+  static const uint8_t NUM_DRUMS = 5;
+
+  SynthPoolVoices() : numVoices(8)
+  {
+    memset(lastVoice, -1, sizeof(lastVoice));
+    // SynthVoices' full-velocity levels
+    static const float LEVEL[NUM_DRUMS] = { 0.56f, 0.56f, 0.40f, 0.40f, 0.60f };
+    for (uint8_t i = 0; i < NUM_DRUMS; i++) manager.setDrum(i, LEVEL[i]);
+  }
+
+  // Call before begin(); defaults to 8 of the pool's voices
+  void voiceCount(uint8_t count) { numVoices = count; }
+
+  void begin()
+  {
+    // SynthVoices' sounds, with noise where a real kit has it
+    static const SynthDrumPatch PATCH[NUM_DRUMS] = {
+      {  60, 150, 0.0f, 0.7f, 0.0f },   // kick: falls onto its pitch
+      { 200, 120, 0.3f, 0.6f, 0.6f },   // snare: body and wires
+      { 800,  40, 0.5f, 0.5f, 0.9f },   // hat: short, nearly all noise
+      { 500, 300, 0.5f, 0.5f, 0.3f },   // ride: ring over a little wash
+      { 900, 500, 0.5f, 0.5f, 0.8f },   // crash: long and bright
+    };
+    manager.begin(pool, numVoices);
+    for (uint8_t i = 0; i < NUM_DRUMS; i++) manager.setPatch(i, PATCH[i]);
+  }
+  // One block however many voices sound
+  static constexpr AudioBudget budget() { return AudioBudget().add(AUDIO_COST_SYNTH_DRUM_POOL); }
+
+  // Full-velocity level of one drum
+  void drumLevel(uint8_t drum, float gain)
+  {
+    if (drum < NUM_DRUMS) manager.setDrum(drum, gain);
+  }
+
+  // Patches, choke groups and voice caps: kit().setPatch(), kit().setDrum()
+  DrumVoiceManager &kit() { return manager; }
+
+  bool play(uint8_t drum, float velocity, uint8_t offset = 0)
+  {
+    int v = manager.noteOn(drum, velocity, offset);
+    if (drum < NUM_DRUMS) lastVoice[drum] = (int8_t)v;
+    return v >= 0;
+  }
+
+  // Fade out the drum's latest voice, unless it has been stolen since
+  void cancel(uint8_t drum)
+  {
+    if (drum < NUM_DRUMS) manager.noteOff(lastVoice[drum], drum);
+  }
+
+  AudioStream &output() { return pool; }
+  void latencyProbe(LatencyProbe *p) { pool.latencyProbe(p); }
+
+private:
+  AudioSynthDrumPool pool;
+  DrumVoiceManager manager;
+  uint8_t numVoices;
+  int8_t lastVoice[NUM_DRUMS];
+};
+
+class SampleVoices
+{
+public:
+  static const uint8_t NUM_DRUMS = DrumVoiceManager::MAX_DRUMS;
+
+  SampleVoices() : numVoices(12)
+  {
+    memset(lastVoice, -1, sizeof(lastVoice));
+  }
+
+  // Call before begin(); defaults to 12 of the pool's voices
+  void voiceCount(uint8_t count) { numVoices = count; }
+
+  void begin() { manager.begin(pool, numVoices); }
+  // One block however many voices sound
+  static constexpr AudioBudget budget() { return AudioBudget().add(AUDIO_COST_SAMPLE_POOL); }
+
+  // Layers, levels and choke groups: kit().addLayer(), kit().setDrum()
+  DrumVoiceManager &kit() { return manager; }
+
+  bool play(uint8_t drum, float velocity, uint8_t offset = 0)
+  {
+    int v = manager.noteOn(drum, velocity, offset);
+    if (drum < NUM_DRUMS) lastVoice[drum] = (int8_t)v;
+    return v >= 0;
+  }
+
+  // Fade out the drum's latest voice, unless it has been stolen since
+  void cancel(uint8_t drum)
+  {
+    if (drum < NUM_DRUMS) manager.noteOff(lastVoice[drum], drum);
+  }
+
+  AudioStream &output() { return pool; }
+  void latencyProbe(LatencyProbe *p) { pool.latencyProbe(p); }
+
+private:
+  AudioPlaySamplePool pool;
+  DrumVoiceManager manager;
+  uint8_t numVoices;
+  int8_t lastVoice[NUM_DRUMS];
+};
+
+#endif
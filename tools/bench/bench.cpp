@@ -0,0 +1,266 @@
+// grum-bench: replay labelled recordings through one detector and score it
+//
+//   bench-<detector> [-v] [--csv] [--synth] [take1.wav take2.wav ...]
+//
+// Each take.wav (16 bit PCM, 44.1 kHz, mono or stereo) needs a take.csv
+// next to it with one labelled pluck per line:
+//
+//   # onset_seconds, frequency_hz
+//   0.512, 82.4
+//   1.230, 110.0
+//
+// --synth replays a built-in set of Karplus-Strong plucks over the open
+// strings instead, so the bench runs without any recordings. Takes are
+// played back to back with a second of silence between them.
+//
+// A label is hit when the detector fires between 5 ms before and 100 ms
+// after it; anything else it fires is a false trigger. Latency is measured
+// from the label to the sample the drum started at (the start of its block
+// for detectors that don't say), and jitter is its standard deviation.
+// Host time per block is only comparable between detectors, not with the
+// Teensy.
+
+#include "bench.h"
+#include <Audio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+struct Label {
+  uint64_t sample;
+  float freq;
+};
+
+static const double FS = AUDIO_SAMPLE_RATE_EXACT;
+
+// ---------------- input ----------------
+
+static uint32_t rd32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t rd16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static bool loadWav(const char *path, std::vector<int16_t> &out)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) { fprintf(stderr, "%s: cannot open\n", path); return false; }
+  uint8_t hdr[12];
+  if (fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+    fprintf(stderr, "%s: not a RIFF/WAVE file\n", path);
+    fclose(f);
+    return false;
+  }
+  uint16_t format = 0, channels = 0, bits = 0;
+  uint32_t rate = 0;
+  uint8_t chunk[8];
+  while (fread(chunk, 1, 8, f) == 8) {
+    uint32_t size = rd32(chunk + 4);
+    if (!memcmp(chunk, "fmt ", 4)) {
+      uint8_t fmt[16];
+      if (size < 16 || fread(fmt, 1, 16, f) != 16) break;
+      format = rd16(fmt);
+      channels = rd16(fmt + 2);
+      rate = rd32(fmt + 4);
+      bits = rd16(fmt + 14);
+      fseek(f, size - 16 + (size & 1), SEEK_CUR);
+    } else if (!memcmp(chunk, "data", 4)) {
+      if ((format != 1 && format != 0xFFFE) || bits != 16 || channels < 1 || channels > 2) {
+        fprintf(stderr, "%s: need 16 bit PCM, mono or stereo\n", path);
+        break;
+      }
+      if (rate != 44100) fprintf(stderr, "%s: %u Hz, played as 44.1 kHz\n", path, rate);
+      std::vector<int16_t> raw(size / 2);
+      size_t got = fread(raw.data(), 2, raw.size(), f);
+      for (size_t i = 0; i + channels <= got; i += channels) {
+        out.push_back(channels == 1 ? raw[i] : (int16_t)((raw[i] + raw[i + 1]) >> 1));
+      }
+      fclose(f);
+      return true;
+    } else {
+      fseek(f, size + (size & 1), SEEK_CUR);
+    }
+  }
+  fprintf(stderr, "%s: no usable data chunk\n", path);
+  fclose(f);
+  return false;
+}
+
+static bool loadLabels(const char *wavPath, uint64_t offset, std::vector<Label> &out)
+{
+  std::string path(wavPath);
+  size_t dot = path.rfind('.');
+  path = (dot == std::string::npos ? path : path.substr(0, dot)) + ".csv";
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f) { fprintf(stderr, "%s: missing labels\n", path.c_str()); return false; }
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    double t, hz;
+    if (line[0] == '#' || sscanf(line, "%lf , %lf", &t, &hz) != 2) continue;
+    out.push_back({ offset + (uint64_t)(t * FS), (float)hz });
+  }
+  fclose(f);
+  return true;
+}
+
+// Deterministic so runs can be compared
+static uint32_t rng = 12345;
+static float frand() { rng = rng * 1664525u + 1013904223u; return (rng >> 8) * (1.0f / 16777216.0f); }
+
+// Karplus-Strong plucks over the guitar and bass open strings, with a
+// -60 dB noise floor and a few palm-muted (fast decay) notes
+static void synthSet(std::vector<int16_t> &audio, std::vector<Label> &labels)
+{
+  static const float NOTES[] = { 41.2f, 55.0f, 82.4f, 110.0f, 146.8f, 196.0f, 246.9f, 329.6f };
+  const int NUM_NOTES = sizeof(NOTES) / sizeof(NOTES[0]);
+  uint64_t pos = (uint64_t)FS;
+  audio.assign(pos, 0);
+  for (int i = 0; i < 6 * NUM_NOTES; i++) {
+    float f0 = NOTES[i % NUM_NOTES] * (1.0f + 0.004f * (frand() - 0.5f));
+    float amp = 0.15f + 0.6f * frand();
+    bool muted = (i % 7) == 3;
+    int gap = (int)(FS * (0.45f + 0.35f * frand()));
+    int period = (int)lrintf(FS / f0);
+    std::vector<float> delay(period);
+    // Picked a fifth of the way along the string: a triangle plus some noise
+    int pick = period / 5;
+    for (int k = 0; k < period; k++) {
+      float shape = k < pick ? (float)k / pick : (float)(period - k) / (period - pick);
+      delay[k] = 0.8f * (2 * shape - 1) + 0.2f * (2 * frand() - 1);
+    }
+    float loss = muted ? 0.95f : 0.996f;
+    labels.push_back({ pos, (float)(FS / period) });
+    for (int n = 0; n < gap; n++) {
+      int k = n % period;
+      float y = delay[k];
+      delay[k] = loss * 0.5f * (y + delay[(k + 1) % period]);
+      float noise = 0.001f * (2 * frand() - 1);
+      audio.push_back((int16_t)constrain(lrintf((amp * y + noise) * 32767.0f), -32768L, 32767L));
+    }
+    pos += gap;
+  }
+  audio.resize(audio.size() + (size_t)FS, 0);
+}
+
+// ---------------- scoring ----------------
+
+struct Score {
+  int labels = 0, outOfRange = 0;
+  int hits = 0, misses = 0, falseHits = 0, drumOk = 0;
+  std::vector<double> latencyMs, cents;
+  int octaveErrors = 0;
+};
+
+static double percentile(std::vector<double> v, double p)
+{
+  if (v.empty()) return NAN;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5))];
+}
+
+static Score score(const Detector &det, const std::vector<Label> &labels, const std::vector<BenchHit> &hits)
+{
+  Score s;
+  const int64_t early = (int64_t)(0.005 * FS), late = (int64_t)(0.100 * FS);
+  std::vector<bool> used(hits.size(), false);
+  s.labels = labels.size();
+  for (const Label &l : labels) {
+    int expect = det.drumFor(l.freq);
+    int match = -1;
+    for (size_t i = 0; i < hits.size(); i++) {
+      int64_t d = (int64_t)hits[i].sample - (int64_t)l.sample;
+      if (!used[i] && d >= -early && d <= late) { match = i; break; }
+    }
+    if (match >= 0) used[match] = true;
+    // Notes this variant doesn't map are neither hits nor misses
+    if (expect < 0) { s.outOfRange++; continue; }
+    if (match < 0) { s.misses++; continue; }
+    const BenchHit &h = hits[match];
+    s.hits++;
+    if (h.drum == expect) s.drumOk++;
+    s.latencyMs.push_back(((int64_t)h.sample - (int64_t)l.sample) * 1000.0 / FS);
+    if (h.freq > 0) {
+      double c = 1200.0 * log2(h.freq / l.freq);
+      if (fabs(c) > 600) s.octaveErrors++;
+      s.cents.push_back(fabs(c));
+    }
+  }
+  for (size_t i = 0; i < hits.size(); i++) if (!used[i]) s.falseHits++;
+  return s;
+}
+
+// ---------------- main ----------------
+
+int main(int argc, char **argv)
+{
+  bool csv = false, synth = false;
+  std::vector<int16_t> audio;
+  std::vector<Label> labels;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-v")) Serial.echo = true;
+    else if (!strcmp(argv[i], "--csv")) csv = true;
+    else if (!strcmp(argv[i], "--synth")) synth = true;
+    else {
+      std::vector<int16_t> take;
+      if (!loadWav(argv[i], take) || !loadLabels(argv[i], audio.size(), labels)) return 1;
+      audio.insert(audio.end(), take.begin(), take.end());
+      audio.resize(audio.size() + (size_t)FS, 0);
+    }
+  }
+  if (synth || audio.empty()) {
+    audio.clear();
+    labels.clear();
+    synthSet(audio, labels);
+  }
+  audio.resize((audio.size() + AUDIO_BLOCK_SAMPLES - 1) / AUDIO_BLOCK_SAMPLES * AUDIO_BLOCK_SAMPLES, 0);
+
+  Detector *det = makeDetector();
+  det->begin();
+
+  std::vector<BenchHit> hits;
+  uint64_t totalNs = 0, maxNs = 0;
+  size_t blocks = audio.size() / AUDIO_BLOCK_SAMPLES;
+  for (size_t b = 0; b < blocks; b++) {
+    auto t0 = std::chrono::steady_clock::now();
+    det->process(&audio[b * AUDIO_BLOCK_SAMPLES], (b + 1) * AUDIO_BLOCK_SAMPLES, hits);
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    totalNs += ns;
+    if (ns > maxNs) maxNs = ns;
+  }
+
+  Score s = score(*det, labels, hits);
+  double nsAvg = blocks ? (double)totalNs / blocks : 0;
+  double latAvg = 0;
+  for (double l : s.latencyMs) latAvg += l;
+  if (!s.latencyMs.empty()) latAvg /= s.latencyMs.size();
+  double latVar = 0;
+  for (double l : s.latencyMs) latVar += (l - latAvg) * (l - latAvg);
+  if (!s.latencyMs.empty()) latVar /= s.latencyMs.size();
+
+  if (csv) {
+    printf("%s,%d,%d,%d,%d,%d,%.2f,%.2f,%.1f,%d,%.0f,%llu\n", det->name(), s.labels - s.outOfRange,
+           s.hits, s.misses, s.falseHits, s.drumOk, latAvg, percentile(s.latencyMs, 0.99),
+           percentile(s.cents, 0.5), s.octaveErrors, nsAvg, (unsigned long long)maxNs);
+    return 0;
+  }
+  printf("%s: %d onsets (%d outside its range), %.1f s of audio\n", det->name(), s.labels,
+         s.outOfRange, audio.size() / FS);
+  printf("  hits %d  misses %d  false %d  right drum %d/%d\n", s.hits, s.misses, s.falseHits,
+         s.drumOk, s.hits);
+  if (!s.latencyMs.empty()) {
+    printf("  latency ms      avg %.1f  p99 %.1f  max %.1f  jitter %.1f\n", latAvg,
+           percentile(s.latencyMs, 0.99), percentile(s.latencyMs, 1.0), sqrt(latVar));
+  }
+  if (!s.cents.empty()) {
+    printf("  pitch cents     median %.1f  p90 %.1f  octave errors %d (%zu pitched)\n",
+           percentile(s.cents, 0.5), percentile(s.cents, 0.9), s.octaveErrors, s.cents.size());
+  } else {
+    printf("  pitch cents     not reported by this detector\n");
+  }
+  printf("  host ns/block   avg %.0f  max %llu  (%.0fx realtime)\n", nsAvg,
+         (unsigned long long)maxNs, nsAvg > 0 ? AUDIO_BLOCK_SAMPLES / FS * 1e9 / nsAvg : 0.0);
+  det->report();
+  return 0;
+}
@@ -0,0 +1,44 @@
+// Offline detector bench - replays labelled audio through one detector
+//
+// Each detector_*.cpp wraps one trigger algorithm (usually by compiling a
+// sketch unchanged against shim/) and is linked with bench.cpp into its
+// own binary, since every sketch defines its own globals and setup()/loop().
+// The bench feeds the audio one 128 sample block at a time, collects the
+// hits the detector reports and scores them against the labels.
+
+#ifndef bench_h_
+#define bench_h_
+
+#include <stdint.h>
+#include <vector>
+
+struct BenchHit {
+  uint64_t sample;     // stream position when the hit reached the drums
+  int drum;            // the detector's drum / sample index, -1 if none
+  float freq;          // Hz, -1 if the detector does not report pitch
+};
+
+class Detector
+{
+public:
+  virtual ~Detector() {}
+  virtual const char *name() const = 0;
+
+  // Called once before the first block
+  virtual void begin() {}
+
+  // One block of input. `now` is the stream position after this block;
+  // append anything triggered while handling it to `hits`.
+  virtual void process(const int16_t *block, uint64_t now, std::vector<BenchHit> &hits) = 0;
+
+  // The drum this variant should play for a note at `freq`, -1 for none.
+  virtual int drumFor(float freq) const = 0;
+
+  // Lines of its own after the scores (not with --csv)
+  virtual void report() const {}
+};
+
+// Defined by the detector_*.cpp linked into this binary
+Detector *makeDetector();
+
+#endif
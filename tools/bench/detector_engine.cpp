@@ -0,0 +1,75 @@
+// grum-pedal-engine.ino, built unchanged for one PEDAL_SKU. Hits come
+// straight from the engine's onHit() handler, so the score sees exactly
+// what the pedal decided, drum and pitch included. A speculated hit the
+// engine fades out again (TriggerHit::replaced) is taken back off the
+// score: it sounds for one block.
+
+#include "bench.h"
+#include <Audio.h>
+#include <trigger_engine.h>
+
+// Prototype the Arduino builder would generate for the sketch
+void logHit(const TriggerHit &hit);
+
+#include "../../grum-pedal-engine/grum-pedal-engine.ino"
+
+static std::vector<TriggerHit> reported;
+
+static void onHit(const TriggerHit &hit)
+{
+  if (hit.played || hit.replaced >= 0) reported.push_back(hit);
+  logHit(hit);
+}
+
+class EngineDetector : public Detector
+{
+public:
+  const char *name() const override
+  {
+    if (SPECULATE) return PEDAL_SKU == SKU_TASK_YIN ? "engine-task-yin-early" : "engine-early";
+    if (FIXED_LATENCY_MS) return PEDAL_SKU == SKU_SYNTH ? "engine-synth-fixed" : "engine-fixed";
+    switch (PEDAL_SKU) {
+      case SKU_SYNTH:    return "engine-synth";
+      case SKU_SAMPLES:  return "engine-samples";
+      case SKU_SPECTRAL: return "engine-spectral";
+      case SKU_TASK_YIN: return "engine-task-yin";
+      case SKU_YIN:      return "engine-yin";
+    }
+    return "engine";
+  }
+
+  void begin() override
+  {
+    setup();
+    pedal.onHit(onHit);
+  }
+
+  void process(const int16_t *block, uint64_t now, std::vector<BenchHit> &hits) override
+  {
+    bench_set_input(block);
+    AudioStream::update_all();
+    loop();
+    for (const TriggerHit &h : reported) {
+      if (h.replaced >= 0) {
+        // The latest hit of the withdrawn guess
+        for (size_t i = hits.size(); i-- > 0;) {
+          if (hits[i].drum == h.replaced) {
+            hits.erase(hits.begin() + i);
+            break;
+          }
+        }
+      }
+      // The drum starts that far into the next output block
+      if (h.played) hits.push_back({ now + h.offset, h.drum, h.frequency });
+    }
+    reported.clear();
+  }
+
+  int drumFor(float freq) const override { return pedal.drumFor(freq); }
+};
+
+Detector *makeDetector()
+{
+  static EngineDetector det;
+  return &det;
+}
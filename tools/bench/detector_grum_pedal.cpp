@@ -0,0 +1,82 @@
+// grum-pedal.cpp, built unchanged. USE_BLOCK_TRIGGER picks the variant:
+// 1 = AudioAnalyzePluckTrigger in the audio update (AudioAnalyzeBandOnsets
+// with POLY_TRIGGER), 0 = the loop() FFT path (detectOnset() /
+// getStablePitch()). Drums are identified from the
+// AudioSynthSimpleDrum that got noteOn(), the pitch from triggerDrum()'s
+// "... 82.4 Hz, Vel: ..." line as the event log drains it.
+
+#include "bench.h"
+#include <Audio.h>
+#include <ctype.h>
+#include <event_log.h>
+#include <preset_store.h>
+
+// Prototypes the Arduino builder would generate for the sketch
+void setupDrumSounds();
+bool canRetrigger(int drumIndex);
+float getStablePitch();
+int formatEvent(char *buf, size_t size, const LogRecord &r);
+void applyCalibration();
+void serviceCalibration();
+void applyPreset(const PedalPreset &next);
+
+#include "../../grum-pedal.cpp"
+
+static std::vector<int> notes;
+static std::vector<float> freqs;
+
+static void onNote(AudioStream *src)
+{
+  AudioStream *drums[5] = { &drumKick, &drumSnare, &drumHihat, &drumRide, &drumCrash };
+  for (int d = 0; d < 5; d++) {
+    if (src == drums[d]) notes.push_back(d);
+  }
+}
+
+static void onLine(const char *line)
+{
+  const char *end = strstr(line, " Hz, Vel:");
+  if (!end) return;
+  const char *p = end;
+  while (p > line && (isdigit((unsigned char)p[-1]) || p[-1] == '.' || p[-1] == '-')) p--;
+  freqs.push_back((float)atof(p));
+}
+
+class GrumPedalDetector : public Detector
+{
+public:
+  const char *name() const override
+  {
+    return !USE_BLOCK_TRIGGER ? "grum-pedal-fft" : POLY_TRIGGER ? "grum-pedal-poly" : "grum-pedal-block";
+  }
+
+  void begin() override
+  {
+    setup();
+    // Ignore the start-up drum sequence
+    notes.clear();
+    freqs.clear();
+    bench_note_hook = onNote;
+    Serial.lineHook = onLine;
+  }
+
+  void process(const int16_t *block, uint64_t now, std::vector<BenchHit> &hits) override
+  {
+    bench_set_input(block);
+    AudioStream::update_all();
+    loop();
+    for (size_t i = 0; i < notes.size(); i++) {
+      hits.push_back({ now, notes[i], i < freqs.size() ? freqs[i] : -1.0f });
+    }
+    notes.clear();
+    freqs.clear();
+  }
+
+  int drumFor(float freq) const override { return drumForFrequency(freq); }
+};
+
+Detector *makeDetector()
+{
+  static GrumPedalDetector det;
+  return &det;
+}
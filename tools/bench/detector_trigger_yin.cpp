@@ -0,0 +1,98 @@
+// "YIN Algo with Attack Detection/trigger-yin.cpp", built unchanged: a hit
+// is a new lastTriggered(), its pitch lastTriggerFrequency() and its
+// "drum" its BASS_BANDS[] entry.
+//
+// The sketch's only output is MIDI, so its DIN bytes on Serial1 are
+// decoded as well: every mapped hit should send one note-on, and every
+// note-on should be followed by its note-off.
+
+#include "bench.h"
+#include "../../YIN Algo with Attack Detection/trigger-yin.cpp"
+
+// Note messages on the DIN port, running status included
+struct MidiWatch {
+  uint8_t status = 0;
+  uint8_t data[2];
+  int count = 0;
+  int noteOns = 0, noteOffs = 0, strayOffs = 0;
+  bool sounding[128] = {};
+
+  void byte(uint8_t c)
+  {
+    if (c & 0x80) {
+      status = c;
+      count = 0;
+      return;
+    }
+    if ((status & 0xE0) != 0x80) return;
+    data[count++] = c;
+    if (count < 2) return;
+    count = 0;
+    const uint8_t note = data[0];
+    if ((status & 0xF0) == 0x90 && data[1]) {
+      noteOns++;
+      sounding[note] = true;
+    } else if (sounding[note]) {
+      noteOffs++;
+      sounding[note] = false;
+    } else {
+      strayOffs++;
+    }
+  }
+
+  int held() const
+  {
+    int n = 0;
+    for (bool on : sounding) n += on;
+    return n;
+  }
+};
+static MidiWatch midiWatch;
+
+class TriggerYinDetector : public Detector
+{
+public:
+  const char *name() const override { return "trigger-yin"; }
+
+  void begin() override
+  {
+    setup();
+    Serial1.byteHook = [](uint8_t c) { midiWatch.byte(c); };
+    lastTrigger = trigger.lastTriggered();
+  }
+
+  void process(const int16_t *block, uint64_t now, std::vector<BenchHit> &hits) override
+  {
+    bench_set_input(block);
+    AudioStream::update_all();
+    loop();
+    if (trigger.lastTriggered() != lastTrigger) {
+      lastTrigger = trigger.lastTriggered();
+      float f = trigger.lastTriggerFrequency();
+      hits.push_back({ now, drumFor(f), f });
+      if (drumFor(f) >= 0) mapped++;
+    }
+  }
+
+  int drumFor(float freq) const override { return BASS_MAP.drumFor(freq); }
+
+  void report() const override
+  {
+    const MidiWatch &m = midiWatch;
+    // A note still held at the end is fine: the last one waits for the
+    // next pluck or for its energy to die away
+    const bool ok = m.noteOns == mapped && m.noteOffs + m.held() == m.noteOns && !m.strayOffs;
+    printf("  midi out        %d note-ons for %d mapped hits, %d note-offs, %d held, %d stray%s\n",
+           m.noteOns, mapped, m.noteOffs, m.held(), m.strayOffs, ok ? "" : "  MISMATCH");
+  }
+
+private:
+  unsigned long lastTrigger = 0;
+  int mapped = 0;
+};
+
+Detector *makeDetector()
+{
+  static TriggerYinDetector det;
+  return &det;
+}
@@ -0,0 +1,138 @@
+// Host stand-in for the parts of the Teensyduino core the detectors use.
+// Time comes from the bench's sample clock, not the wall clock, so
+// millis()/micros() advance exactly one block per AudioStream::update_all().
+
+#ifndef bench_arduino_h_
+#define bench_arduino_h_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define DMAMEM
+#define EXTMEM
+#define FASTRUN
+#define FLASHMEM
+#define PROGMEM
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define BUILTIN_SDCARD 254
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+#define F_CPU 600000000
+#define F_CPU_ACTUAL 600000000
+
+template <class T, class L, class H>
+inline T constrain(T x, L lo, H hi) { return x < lo ? lo : (x > hi ? hi : x); }
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+inline int digitalRead(int) { return HIGH; }
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+
+inline void *extmem_malloc(size_t n) { return malloc(n); }
+inline void extmem_free(void *p) { free(p); }
+
+// Cycle counter at a nominal 600 MHz, derived from the host clock
+uint32_t bench_cycles();
+#define ARM_DWT_CYCCNT (bench_cycles())
+extern volatile uint32_t ARM_DEMCR, ARM_DWT_CTRL;
+#define ARM_DEMCR_TRCENA (1 << 24)
+#define ARM_DWT_CTRL_CYCCNTENA 1
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual int availableForWrite() { return 0; }
+  size_t write(const uint8_t *b, size_t n) { for (size_t i = 0; i < n; i++) write(b[i]); return n; }
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+  template <class T> size_t println(T v) { return print(v) + println(); }
+  size_t println(double v, int digits) { return print(v, digits) + println(); }
+  size_t println() { return print("\n"); }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write((const uint8_t *)buf, strlen(buf));
+  }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+};
+
+// Sketch chatter is dropped unless the bench runs with -v. Detectors that
+// only report through Serial can watch complete lines via lineHook, or
+// raw bytes (MIDI on Serial1) via byteHook.
+class BenchSerial : public Stream
+{
+public:
+  void begin(long) {}
+  operator bool() const { return true; }
+  size_t write(uint8_t c) override;
+  using Print::write;
+  int availableForWrite() override { return 4096; }   // never stalls
+  bool echo = false;
+  void (*lineHook)(const char *line) = nullptr;
+  void (*byteHook)(uint8_t c) = nullptr;
+private:
+  char line[256];
+  size_t len = 0;
+};
+extern BenchSerial Serial;
+
+// Callbacks run at the end of AudioStream::update_all(), once per period
+// that has elapsed, as an interrupt below the audio update's would
+class IntervalTimer
+{
+public:
+  ~IntervalTimer() { end(); }
+  bool begin(void (*fn)(), uint32_t us);
+  void end();
+  void priority(uint8_t) {}
+  static void runDue();
+private:
+  void (*callback)() = nullptr;
+  uint64_t periodNs = 0, dueNs = 0;
+};
+extern BenchSerial Serial1;    // MIDI out, bytes dropped unless hooked
+typedef BenchSerial HardwareSerial;
+
+#endif
@@ -0,0 +1,148 @@
+// Host versions of the stock Teensy audio objects the sketches patch in.
+// Only what the detectors depend on is modelled: the input plays the
+// bench's WAV, the biquad and peak analyser compute the real thing, and
+// drum sources just report noteOn() to the bench.
+
+#ifndef bench_audio_h_
+#define bench_audio_h_
+
+#include <Arduino.h>
+#include <AudioStream.h>
+
+// Set by the bench: the next input block, and who to tell about a noteOn()
+void bench_set_input(const int16_t *block);
+extern void (*bench_note_hook)(AudioStream *source);
+
+#define AUDIO_INPUT_LINEIN 0
+#define AUDIO_INPUT_MIC 1
+
+class AudioInputI2S : public AudioStream
+{
+public:
+  AudioInputI2S() : AudioStream(0, NULL) {}
+  virtual void update(void);
+};
+
+class AudioOutputI2S : public AudioStream
+{
+public:
+  AudioOutputI2S() : AudioStream(2, inputQueueArray) {}
+  virtual void update(void);
+private:
+  audio_block_t *inputQueueArray[2];
+};
+
+class AudioFilterBiquad : public AudioStream
+{
+public:
+  AudioFilterBiquad();
+  void setHighpass(uint32_t stage, float frequency, float q = 0.7071f);
+  void setLowpass(uint32_t stage, float frequency, float q = 0.7071f);
+  void setBandpass(uint32_t stage, float frequency, float q = 1.0f);
+  void setNotch(uint32_t stage, float frequency, float q = 1.0f);
+  virtual void update(void);
+private:
+  void set(uint32_t stage, const double b[3], const double a[3]);
+  audio_block_t *inputQueueArray[1];
+  double coef[4][5];       // b0 b1 b2 a1 a2, normalised
+  double state[4][2];
+  int stages;
+};
+
+class AudioAnalyzePeak : public AudioStream
+{
+public:
+  AudioAnalyzePeak() : AudioStream(1, inputQueueArray), peak(0), fresh(false) {}
+  bool available(void) { bool f = fresh; fresh = false; return f; }
+  float read(void) { float p = peak * (1.0f / 32768.0f); peak = 0; return p; }
+  virtual void update(void);
+private:
+  audio_block_t *inputQueueArray[1];
+  int32_t peak;
+  bool fresh;
+};
+
+class AudioMixer4 : public AudioStream
+{
+public:
+  AudioMixer4() : AudioStream(4, inputQueueArray) { for (int i = 0; i < 4; i++) mult[i] = 1.0f; }
+  void gain(unsigned int channel, float level) { if (channel < 4) mult[channel] = level; }
+  virtual void update(void);
+private:
+  audio_block_t *inputQueueArray[4];
+  float mult[4];
+};
+
+class AudioAnalyzeRMS : public AudioStream
+{
+public:
+  AudioAnalyzeRMS() : AudioStream(1, inputQueueArray), sum(0), count(0) {}
+  bool available(void) { return count > 0; }
+  float read(void);
+  virtual void update(void);
+private:
+  audio_block_t *inputQueueArray[1];
+  double sum;
+  uint32_t count;
+};
+
+// Not modelled: never reports a note (only there so the pitch policy
+// that wraps it compiles)
+class AudioAnalyzeNoteFrequency : public AudioStream
+{
+public:
+  AudioAnalyzeNoteFrequency() : AudioStream(1, inputQueueArray) {}
+  void begin(float) {}
+  bool available(void) { return false; }
+  float read(void) { return -1; }
+  float probability(void) { return 0; }
+  virtual void update(void) { audio_block_t *b = receiveReadOnly(); if (b) release(b); }
+private:
+  audio_block_t *inputQueueArray[1];
+};
+
+class AudioRecordQueue : public AudioStream
+{
+public:
+  AudioRecordQueue() : AudioStream(1, inputQueueArray), head(0), tail(0), enabled(false) {}
+  void begin(void) { enabled = true; }
+  void end(void) { enabled = false; }
+  int available(void) { return (head - tail + SIZE) % SIZE; }
+  int16_t *readBuffer(void) { return available() ? queue[tail]->data : NULL; }
+  void freeBuffer(void);
+  virtual void update(void);
+private:
+  static const int SIZE = 53;
+  audio_block_t *inputQueueArray[1];
+  audio_block_t *queue[SIZE];
+  int head, tail;
+  bool enabled;
+};
+
+class AudioSynthSimpleDrum : public AudioStream
+{
+public:
+  AudioSynthSimpleDrum() : AudioStream(0, NULL) {}
+  void noteOn(void) { if (bench_note_hook) bench_note_hook(this); }
+  void frequency(float) {}
+  void length(int32_t) {}
+  void secondMix(float) {}
+  void pitchMod(float) {}
+  virtual void update(void) {}
+};
+
+class AudioControlSGTL5000
+{
+public:
+  bool enable(void) { return true; }
+  bool inputSelect(int) { return true; }
+  bool lineInLevel(uint8_t) { return true; }
+  bool lineOutLevel(uint8_t) { return true; }
+  bool micGain(unsigned int) { return true; }
+  bool volume(float) { return true; }
+  bool unmuteHeadphone(void) { return true; }
+  bool unmuteLineout(void) { return true; }
+  unsigned short adcHighPassFilterEnable(void) { return 0; }
+};
+
+#endif
@@ -0,0 +1,89 @@
+// Host AudioStream: a block pool and an update list, run one block at a
+// time by the bench. Same interface subset as the Teensy audio library.
+
+#ifndef bench_audiostream_h_
+#define bench_audiostream_h_
+
+#include <Arduino.h>
+
+#define AUDIO_BLOCK_SAMPLES 128
+#define AUDIO_SAMPLE_RATE_EXACT 44117.64706f
+#define AUDIO_SAMPLE_RATE AUDIO_SAMPLE_RATE_EXACT
+
+typedef struct audio_block_struct {
+  uint8_t ref_count;
+  uint8_t reserved1;
+  uint16_t memory_pool_index;
+  int16_t data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioStream;
+
+class AudioConnection
+{
+public:
+  AudioConnection(AudioStream &source, unsigned char sourceOutput,
+                  AudioStream &destination, unsigned char destinationInput);
+  AudioConnection(AudioStream &source, AudioStream &destination);
+  int connect();
+  int disconnect();
+
+private:
+  friend class AudioStream;
+  AudioStream &src;
+  AudioStream &dst;
+  unsigned char src_index, dest_index;
+  AudioConnection *next_dest;
+  bool isConnected;
+};
+
+class AudioStream
+{
+public:
+  AudioStream(unsigned char ninput, audio_block_t **iqueue);
+  virtual ~AudioStream() {}
+
+  static void initialize_memory(audio_block_t *data, unsigned int num);
+  static void update_all();
+
+  // Percent of one block period spent in this object's last update()
+  float processorUsage() { return cpu_cycles * 0.01f; }
+  float processorUsageMax() { return cpu_cycles_max * 0.01f; }
+  void processorUsageMaxReset() { cpu_cycles_max = cpu_cycles; }
+  bool isActive() { return active; }
+
+  static uint16_t cpu_cycles_total, cpu_cycles_total_max;
+  static uint16_t memory_used, memory_used_max;
+
+  virtual void update(void) = 0;
+
+protected:
+  static audio_block_t *allocate(void);
+  static void release(audio_block_t *block);
+  void transmit(audio_block_t *block, unsigned char index = 0);
+  audio_block_t *receiveReadOnly(unsigned int index = 0);
+  audio_block_t *receiveWritable(unsigned int index = 0);
+
+  bool active;
+  unsigned char num_inputs;
+  uint16_t cpu_cycles, cpu_cycles_max;   // hundredths of a percent
+
+private:
+  friend class AudioConnection;
+  AudioConnection *destination_list;
+  audio_block_t **inputQueue;
+  AudioStream *next_update;
+  static AudioStream *first_update;
+};
+
+#define AudioMemory(num) ({ static audio_block_t data[num]; AudioStream::initialize_memory(data, num); })
+#define AudioMemoryUsage() (AudioStream::memory_used)
+#define AudioMemoryUsageMax() (AudioStream::memory_used_max)
+#define AudioMemoryUsageMaxReset() (AudioStream::memory_used_max = AudioStream::memory_used)
+#define AudioProcessorUsage() (AudioStream::cpu_cycles_total * 0.01f)
+#define AudioProcessorUsageMax() (AudioStream::cpu_cycles_total_max * 0.01f)
+#define AudioProcessorUsageMaxReset() (AudioStream::cpu_cycles_total_max = AudioStream::cpu_cycles_total)
+#define AudioNoInterrupts() ((void)0)
+#define AudioInterrupts() ((void)0)
+
+#endif
@@ -0,0 +1,39 @@
+// EEPROM as erased RAM: nothing survives the process, and a fresh run
+// reads 0xFF like a Teensy that has never been written
+
+#ifndef bench_eeprom_h_
+#define bench_eeprom_h_
+
+#include <Arduino.h>
+
+class EEPROMClass
+{
+public:
+  static const int SIZE = 4284;   // Teensy 4.1 emulated EEPROM
+
+  EEPROMClass() { memset(bytes, 0xFF, sizeof(bytes)); }
+  uint8_t read(int addr) { return addr >= 0 && addr < SIZE ? bytes[addr] : 0xFF; }
+  void write(int addr, uint8_t v) { if (addr >= 0 && addr < SIZE) bytes[addr] = v; }
+  void update(int addr, uint8_t v) { write(addr, v); }
+  uint16_t length() { return SIZE; }
+
+  template <class T> T &get(int addr, T &t)
+  {
+    uint8_t *p = (uint8_t *)&t;
+    for (size_t i = 0; i < sizeof(T); i++) p[i] = read(addr + (int)i);
+    return t;
+  }
+  template <class T> const T &put(int addr, const T &t)
+  {
+    const uint8_t *p = (const uint8_t *)&t;
+    for (size_t i = 0; i < sizeof(T); i++) write(addr + (int)i, p[i]);
+    return t;
+  }
+
+private:
+  uint8_t bytes[SIZE];
+};
+
+static EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,32 @@
+// SD card as the host filesystem, relative to the working directory
+
+#ifndef bench_sd_h_
+#define bench_sd_h_
+
+#include <Arduino.h>
+
+class File
+{
+public:
+  File(FILE *f = NULL) : fp(f) {}
+  operator bool() const { return fp != NULL; }
+  int read(void *buf, size_t n) { return fp ? (int)fread(buf, 1, n, fp) : -1; }
+  int read() { uint8_t c; return read(&c, 1) == 1 ? c : -1; }
+  bool seek(uint32_t pos) { return fp && fseek(fp, pos, SEEK_SET) == 0; }
+  uint32_t position() { return fp ? (uint32_t)ftell(fp) : 0; }
+  uint32_t size();
+  void close() { if (fp) fclose(fp); fp = NULL; }
+private:
+  FILE *fp;
+};
+
+class SDClass
+{
+public:
+  bool begin(uint8_t) { return true; }
+  File open(const char *path) { return File(fopen(path, "rb")); }
+  bool exists(const char *path);
+};
+extern SDClass SD;
+
+#endif
@@ -0,0 +1,118 @@
+// The CMSIS-DSP calls used by the detectors, in plain C++. The real FFT
+// keeps arm_rfft_fast_f32's packed layout: [0] = DC, [1] = Nyquist, then
+// (re, im) pairs; the inverse is scaled by 1/N like CMSIS.
+
+#ifndef bench_arm_math_h_
+#define bench_arm_math_h_
+
+#include <stdint.h>
+#include <math.h>
+#include <complex>
+#include <vector>
+
+typedef float float32_t;
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+typedef int64_t q63_t;
+
+typedef enum { ARM_MATH_SUCCESS = 0, ARM_MATH_ARGUMENT_ERROR = -1 } arm_status;
+
+struct arm_rfft_fast_instance_f32 {
+  uint16_t fftLenRFFT;
+};
+
+inline arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, uint16_t fftLen)
+{
+  if (fftLen < 32 || (fftLen & (fftLen - 1))) return ARM_MATH_ARGUMENT_ERROR;
+  S->fftLenRFFT = fftLen;
+  return ARM_MATH_SUCCESS;
+}
+
+// In-place iterative radix-2 FFT, sign -1 forward, +1 inverse (unscaled)
+inline void bench_fft(std::vector<std::complex<double>> &a, int sign)
+{
+  const size_t n = a.size();
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) std::swap(a[i], a[j]);
+  }
+  for (size_t len = 2; len <= n; len <<= 1) {
+    double ang = sign * 2 * M_PI / len;
+    std::complex<double> wl(cos(ang), sin(ang));
+    for (size_t i = 0; i < n; i += len) {
+      std::complex<double> w(1);
+      for (size_t k = 0; k < len / 2; k++) {
+        std::complex<double> u = a[i + k], v = a[i + k + len / 2] * w;
+        a[i + k] = u + v;
+        a[i + k + len / 2] = u - v;
+        w *= wl;
+      }
+    }
+  }
+}
+
+inline void arm_rfft_fast_f32(const arm_rfft_fast_instance_f32 *S, float32_t *p,
+                              float32_t *pOut, uint8_t ifftFlag)
+{
+  const int n = S->fftLenRFFT;
+  std::vector<std::complex<double>> a(n);
+  if (!ifftFlag) {
+    for (int i = 0; i < n; i++) a[i] = p[i];
+    bench_fft(a, -1);
+    pOut[0] = (float)a[0].real();
+    pOut[1] = (float)a[n / 2].real();
+    for (int k = 1; k < n / 2; k++) {
+      pOut[2 * k] = (float)a[k].real();
+      pOut[2 * k + 1] = (float)a[k].imag();
+    }
+  } else {
+    a[0] = p[0];
+    a[n / 2] = p[1];
+    for (int k = 1; k < n / 2; k++) {
+      a[k] = std::complex<double>(p[2 * k], p[2 * k + 1]);
+      a[n - k] = std::conj(a[k]);
+    }
+    bench_fft(a, 1);
+    for (int i = 0; i < n; i++) pOut[i] = (float)(a[i].real() / n);
+  }
+}
+
+inline void arm_cmplx_conj_f32(const float32_t *src, float32_t *dst, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++) {
+    dst[2 * i] = src[2 * i];
+    dst[2 * i + 1] = -src[2 * i + 1];
+  }
+}
+
+inline void arm_cmplx_mult_cmplx_f32(const float32_t *a, const float32_t *b, float32_t *dst, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++) {
+    float ar = a[2 * i], ai = a[2 * i + 1], br = b[2 * i], bi = b[2 * i + 1];
+    dst[2 * i] = ar * br - ai * bi;
+    dst[2 * i + 1] = ar * bi + ai * br;
+  }
+}
+
+inline void arm_cmplx_mag_f32(const float32_t *src, float32_t *dst, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++) {
+    dst[i] = sqrtf(src[2 * i] * src[2 * i] + src[2 * i + 1] * src[2 * i + 1]);
+  }
+}
+
+inline void arm_dot_prod_f32(const float32_t *a, const float32_t *b, uint32_t n, float32_t *result)
+{
+  float s = 0;
+  for (uint32_t i = 0; i < n; i++) s += a[i] * b[i];
+  *result = s;
+}
+
+inline void arm_q15_to_float(const q15_t *src, float32_t *dst, uint32_t n)
+{
+  for (uint32_t i = 0; i < n; i++) dst[i] = src[i] * (1.0f / 32768.0f);
+}
+
+#endif
@@ -0,0 +1,30 @@
+// Scalar equivalents of the Teensy audio library's DSP helpers
+
+#ifndef bench_dspinst_h_
+#define bench_dspinst_h_
+
+#include <stdint.h>
+
+static inline int32_t signed_saturate_rshift(int32_t val, int bits, int rshift)
+{
+  int32_t v = val >> rshift;
+  int32_t hi = (1 << (bits - 1)) - 1, lo = -(1 << (bits - 1));
+  return v > hi ? hi : (v < lo ? lo : v);
+}
+
+static inline int32_t signed_multiply_32x16b(int32_t a, uint32_t b)
+{
+  return (int32_t)(((int64_t)a * (int16_t)(b & 0xFFFF)) >> 16);
+}
+
+static inline int32_t signed_multiply_32x16t(int32_t a, uint32_t b)
+{
+  return (int32_t)(((int64_t)a * (int16_t)(b >> 16)) >> 16);
+}
+
+static inline int32_t multiply_32x32_rshift32(int32_t a, int32_t b)
+{
+  return (int32_t)(((int64_t)a * b) >> 32);
+}
+
+#endif
@@ -0,0 +1,398 @@
+#include "Audio.h"
+#include "SD.h"
+#include <chrono>
+
+BenchSerial Serial;
+BenchSerial Serial1;
+volatile uint32_t ARM_DEMCR, ARM_DWT_CTRL;
+void (*bench_note_hook)(AudioStream *source) = nullptr;
+
+size_t BenchSerial::write(uint8_t c)
+{
+  if (echo) fputc(c, stdout);
+  if (byteHook) byteHook(c);
+  if (c == '\n' || len == sizeof(line) - 1) {
+    line[len] = 0;
+    if (lineHook) lineHook(line);
+    len = 0;
+  } else {
+    line[len++] = (char)c;
+  }
+  return 1;
+}
+
+// ---------------- clocks ----------------
+
+static uint64_t sampleClock;    // samples since start, advanced per block
+
+uint32_t millis() { return (uint32_t)(sampleClock * 1000.0 / AUDIO_SAMPLE_RATE_EXACT); }
+uint32_t micros() { return (uint32_t)(sampleClock * 1000000.0 / AUDIO_SAMPLE_RATE_EXACT); }
+void delay(uint32_t ms) { sampleClock += (uint64_t)(ms * (AUDIO_SAMPLE_RATE_EXACT / 1000.0)); }
+void delayMicroseconds(uint32_t us) { sampleClock += (uint64_t)(us * (AUDIO_SAMPLE_RATE_EXACT / 1e6)); }
+
+static uint64_t hostNanos()
+{
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t bench_cycles() { return (uint32_t)(hostNanos() * 6 / 10); }
+
+// ---------------- block pool ----------------
+
+uint16_t AudioStream::cpu_cycles_total, AudioStream::cpu_cycles_total_max;
+uint16_t AudioStream::memory_used, AudioStream::memory_used_max;
+AudioStream *AudioStream::first_update;
+
+static audio_block_t *pool;
+static unsigned int poolSize;
+static bool *poolUsed;
+
+void AudioStream::initialize_memory(audio_block_t *data, unsigned int num)
+{
+  pool = data;
+  poolSize = num;
+  free(poolUsed);
+  poolUsed = (bool *)calloc(num, sizeof(bool));
+  for (unsigned int i = 0; i < num; i++) data[i].memory_pool_index = i;
+  memory_used = memory_used_max = 0;
+}
+
+audio_block_t *AudioStream::allocate(void)
+{
+  for (unsigned int i = 0; i < poolSize; i++) {
+    if (poolUsed[i]) continue;
+    poolUsed[i] = true;
+    pool[i].ref_count = 1;
+    if (++memory_used > memory_used_max) memory_used_max = memory_used;
+    return &pool[i];
+  }
+  return NULL;
+}
+
+void AudioStream::release(audio_block_t *block)
+{
+  if (!block) return;
+  if (block->ref_count > 1) {
+    block->ref_count--;
+    return;
+  }
+  poolUsed[block->memory_pool_index] = false;
+  memory_used--;
+}
+
+AudioStream::AudioStream(unsigned char ninput, audio_block_t **iqueue)
+  : active(false), num_inputs(ninput), cpu_cycles(0), cpu_cycles_max(0),
+    destination_list(NULL), inputQueue(iqueue), next_update(NULL)
+{
+  for (int i = 0; i < ninput; i++) iqueue[i] = NULL;
+  // Update in construction order, as the Teensy library does
+  if (!first_update) {
+    first_update = this;
+  } else {
+    AudioStream *p = first_update;
+    while (p->next_update) p = p->next_update;
+    p->next_update = this;
+  }
+}
+
+void AudioStream::transmit(audio_block_t *block, unsigned char index)
+{
+  for (AudioConnection *c = destination_list; c; c = c->next_dest) {
+    if (c->src_index != index || !c->isConnected) continue;
+    if (c->dst.inputQueue[c->dest_index] == NULL) {
+      c->dst.inputQueue[c->dest_index] = block;
+      block->ref_count++;
+    }
+  }
+}
+
+audio_block_t *AudioStream::receiveReadOnly(unsigned int index)
+{
+  if (index >= num_inputs) return NULL;
+  audio_block_t *b = inputQueue[index];
+  inputQueue[index] = NULL;
+  return b;
+}
+
+audio_block_t *AudioStream::receiveWritable(unsigned int index)
+{
+  audio_block_t *b = receiveReadOnly(index);
+  if (b && b->ref_count > 1) {
+    audio_block_t *copy = allocate();
+    if (copy) memcpy(copy->data, b->data, sizeof(copy->data));
+    b->ref_count--;
+    b = copy;
+  }
+  return b;
+}
+
+// Host time per update() in hundredths of a percent of one block period
+static uint16_t usage(uint64_t ns)
+{
+  uint64_t u = ns * 10000 / 2902494;
+  return u > 65535 ? 65535 : (uint16_t)u;
+}
+
+void AudioStream::update_all()
+{
+  uint64_t total = 0;
+  for (AudioStream *p = first_update; p; p = p->next_update) {
+    if (!p->active) continue;
+    uint64_t t0 = hostNanos();
+    p->update();
+    uint64_t ns = hostNanos() - t0;
+    total += ns;
+    p->cpu_cycles = usage(ns);
+    if (p->cpu_cycles > p->cpu_cycles_max) p->cpu_cycles_max = p->cpu_cycles;
+  }
+  cpu_cycles_total = usage(total);
+  if (cpu_cycles_total > cpu_cycles_total_max) cpu_cycles_total_max = cpu_cycles_total;
+  sampleClock += AUDIO_BLOCK_SAMPLES;
+  IntervalTimer::runDue();
+}
+
+// ---------------- timers ----------------
+
+static IntervalTimer *timers[8];
+
+static uint64_t clockNs() { return (uint64_t)(sampleClock * 1e9 / AUDIO_SAMPLE_RATE_EXACT); }
+
+bool IntervalTimer::begin(void (*fn)(), uint32_t us)
+{
+  end();
+  for (IntervalTimer *&t : timers) {
+    if (t) continue;
+    t = this;
+    callback = fn;
+    periodNs = (uint64_t)us * 1000;
+    dueNs = clockNs() + periodNs;
+    return true;
+  }
+  return false;
+}
+
+void IntervalTimer::end()
+{
+  for (IntervalTimer *&t : timers) {
+    if (t == this) t = nullptr;
+  }
+}
+
+void IntervalTimer::runDue()
+{
+  const uint64_t now = clockNs();
+  for (IntervalTimer *t : timers) {
+    while (t && t->periodNs && t->dueNs <= now) {
+      t->dueNs += t->periodNs;
+      t->callback();
+    }
+  }
+}
+
+AudioConnection::AudioConnection(AudioStream &source, unsigned char sourceOutput,
+                                 AudioStream &destination, unsigned char destinationInput)
+  : src(source), dst(destination), src_index(sourceOutput), dest_index(destinationInput),
+    next_dest(NULL), isConnected(false)
+{
+  connect();
+}
+
+AudioConnection::AudioConnection(AudioStream &source, AudioStream &destination)
+  : AudioConnection(source, 0, destination, 0) {}
+
+int AudioConnection::connect()
+{
+  if (isConnected) return 0;
+  next_dest = src.destination_list;
+  src.destination_list = this;
+  isConnected = true;
+  src.active = true;
+  dst.active = true;
+  return 0;
+}
+
+int AudioConnection::disconnect()
+{
+  isConnected = false;
+  return 0;
+}
+
+// ---------------- objects ----------------
+
+static const int16_t *inputBlock;
+
+void bench_set_input(const int16_t *block) { inputBlock = block; }
+
+void AudioInputI2S::update(void)
+{
+  audio_block_t *b = allocate();
+  if (!b) return;
+  if (inputBlock) memcpy(b->data, inputBlock, sizeof(b->data));
+  else memset(b->data, 0, sizeof(b->data));
+  transmit(b, 0);
+  transmit(b, 1);
+  release(b);
+}
+
+void AudioOutputI2S::update(void)
+{
+  for (int ch = 0; ch < 2; ch++) release(receiveReadOnly(ch));
+}
+
+AudioFilterBiquad::AudioFilterBiquad() : AudioStream(1, inputQueueArray), stages(0)
+{
+  memset(coef, 0, sizeof(coef));
+  memset(state, 0, sizeof(state));
+}
+
+void AudioFilterBiquad::set(uint32_t stage, const double b[3], const double a[3])
+{
+  if (stage >= 4) return;
+  coef[stage][0] = b[0] / a[0];
+  coef[stage][1] = b[1] / a[0];
+  coef[stage][2] = b[2] / a[0];
+  coef[stage][3] = a[1] / a[0];
+  coef[stage][4] = a[2] / a[0];
+  if ((int)stage >= stages) stages = stage + 1;
+}
+
+// RBJ cookbook, as the Teensy library computes them
+void AudioFilterBiquad::setHighpass(uint32_t stage, float frequency, float q)
+{
+  double w0 = 2 * M_PI * frequency / AUDIO_SAMPLE_RATE_EXACT, c = cos(w0), alpha = sin(w0) / (2 * q);
+  double b[3] = { (1 + c) / 2, -(1 + c), (1 + c) / 2 }, a[3] = { 1 + alpha, -2 * c, 1 - alpha };
+  set(stage, b, a);
+}
+
+void AudioFilterBiquad::setLowpass(uint32_t stage, float frequency, float q)
+{
+  double w0 = 2 * M_PI * frequency / AUDIO_SAMPLE_RATE_EXACT, c = cos(w0), alpha = sin(w0) / (2 * q);
+  double b[3] = { (1 - c) / 2, 1 - c, (1 - c) / 2 }, a[3] = { 1 + alpha, -2 * c, 1 - alpha };
+  set(stage, b, a);
+}
+
+void AudioFilterBiquad::setBandpass(uint32_t stage, float frequency, float q)
+{
+  double w0 = 2 * M_PI * frequency / AUDIO_SAMPLE_RATE_EXACT, c = cos(w0), alpha = sin(w0) / (2 * q);
+  double b[3] = { alpha, 0, -alpha }, a[3] = { 1 + alpha, -2 * c, 1 - alpha };
+  set(stage, b, a);
+}
+
+void AudioFilterBiquad::setNotch(uint32_t stage, float frequency, float q)
+{
+  double w0 = 2 * M_PI * frequency / AUDIO_SAMPLE_RATE_EXACT, c = cos(w0), alpha = sin(w0) / (2 * q);
+  double b[3] = { 1, -2 * c, 1 }, a[3] = { 1 + alpha, -2 * c, 1 - alpha };
+  set(stage, b, a);
+}
+
+void AudioFilterBiquad::update(void)
+{
+  audio_block_t *b = receiveWritable();
+  if (!b) return;
+  for (int s = 0; s < stages; s++) {
+    const double *k = coef[s];
+    double z1 = state[s][0], z2 = state[s][1];
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+      double x = b->data[i];
+      double y = k[0] * x + z1;
+      z1 = k[1] * x - k[3] * y + z2;
+      z2 = k[2] * x - k[4] * y;
+      b->data[i] = (int16_t)constrain(lrint(y), -32768L, 32767L);
+    }
+    state[s][0] = z1;
+    state[s][1] = z2;
+  }
+  transmit(b);
+  release(b);
+}
+
+void AudioAnalyzePeak::update(void)
+{
+  audio_block_t *b = receiveReadOnly();
+  if (!b) return;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    int32_t a = abs((int32_t)b->data[i]);
+    if (a > peak) peak = a;
+  }
+  fresh = true;
+  release(b);
+}
+
+float AudioAnalyzeRMS::read(void)
+{
+  float r = count ? (float)sqrt(sum / count) * (1.0f / 32768.0f) : 0.0f;
+  sum = 0;
+  count = 0;
+  return r;
+}
+
+void AudioAnalyzeRMS::update(void)
+{
+  audio_block_t *b = receiveReadOnly();
+  if (!b) return;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) sum += (double)b->data[i] * b->data[i];
+  count += AUDIO_BLOCK_SAMPLES;
+  release(b);
+}
+
+void AudioMixer4::update(void)
+{
+  float acc[AUDIO_BLOCK_SAMPLES] = { 0 };
+  bool any = false;
+  for (int ch = 0; ch < 4; ch++) {
+    audio_block_t *in = receiveReadOnly(ch);
+    if (!in) continue;
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) acc[i] += mult[ch] * in->data[i];
+    release(in);
+    any = true;
+  }
+  if (!any) return;
+  audio_block_t *out = allocate();
+  if (!out) return;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+    out->data[i] = (int16_t)constrain(lrintf(acc[i]), -32768L, 32767L);
+  }
+  transmit(out);
+  release(out);
+}
+
+void AudioRecordQueue::freeBuffer(void)
+{
+  if (!available()) return;
+  release(queue[tail]);
+  tail = (tail + 1) % SIZE;
+}
+
+void AudioRecordQueue::update(void)
+{
+  audio_block_t *b = receiveReadOnly();
+  if (!b) return;
+  if (!enabled || (head + 1) % SIZE == tail) {
+    release(b);
+    return;
+  }
+  queue[head] = b;
+  head = (head + 1) % SIZE;
+}
+
+// ---------------- SD ----------------
+
+SDClass SD;
+
+uint32_t File::size()
+{
+  if (!fp) return 0;
+  long here = ftell(fp);
+  fseek(fp, 0, SEEK_END);
+  long end = ftell(fp);
+  fseek(fp, here, SEEK_SET);
+  return (uint32_t)end;
+}
+
+bool SDClass::exists(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (f) fclose(f);
+  return f != NULL;
+}
@@ -0,0 +1,310 @@
+// kitpack: pack WAVs into a DrumKit image (drum_kit.h)
+//
+//   kitpack [-n name] [-o DRUMS.KIT] [--header kit.h] file.wav[:drum[:minvel]] ...
+//
+// drum is the DrumVoiceManager index the sketch uses (default: the file's
+// position on the command line), minvel the layer threshold 0..1 (default
+// 0). Files are 16 bit PCM at any rate, mono or stereo; they come out the
+// way DrumSample::load() would have stored them, 44.1 kHz mono, with
+// other rates resampled here rather than on the Teensy.
+//
+// Copy the .kit to the SD card (the sketch moves it to SerialFlash) or to
+// the flash chip of a Teensy 4.1; --header writes a const array instead,
+// for a kit small enough to live in program flash.
+//
+// The image is attached and CRC-checked with the library's own DrumKit
+// before it is written.
+
+#include <Arduino.h>
+#include <drum_kit.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static const uint32_t RATE = 44100;
+static const int SINC_TAPS = 32;   // per side, for the resampler
+
+struct Input {
+  std::string path;
+  std::string name;
+  uint8_t drum;
+  uint8_t minVelocity;
+  std::vector<int16_t> pcm;
+};
+
+static uint32_t rd32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t rd16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static bool loadWav(const char *path, std::vector<int16_t> &out, uint32_t &rate)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) { fprintf(stderr, "%s: cannot open\n", path); return false; }
+  uint8_t hdr[12];
+  if (fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+    fprintf(stderr, "%s: not a RIFF/WAVE file\n", path);
+    fclose(f);
+    return false;
+  }
+  uint16_t format = 0, channels = 0, bits = 0;
+  rate = 0;
+  uint8_t chunk[8];
+  while (fread(chunk, 1, 8, f) == 8) {
+    uint32_t size = rd32(chunk + 4);
+    if (!memcmp(chunk, "fmt ", 4)) {
+      uint8_t fmt[16];
+      if (size < 16 || fread(fmt, 1, 16, f) != 16) break;
+      format = rd16(fmt);
+      channels = rd16(fmt + 2);
+      rate = rd32(fmt + 4);
+      bits = rd16(fmt + 14);
+      fseek(f, size - 16 + (size & 1), SEEK_CUR);
+    } else if (!memcmp(chunk, "data", 4)) {
+      if ((format != 1 && format != 0xFFFE) || bits != 16 || channels < 1 || channels > 2 || !rate) {
+        fprintf(stderr, "%s: need 16 bit PCM, mono or stereo\n", path);
+        break;
+      }
+      std::vector<int16_t> raw(size / 2);
+      size_t got = fread(raw.data(), 2, raw.size(), f);
+      // Same downmix as DrumSample::load()
+      for (size_t i = 0; i + channels <= got; i += channels) {
+        out.push_back(channels == 1 ? raw[i] : (int16_t)(((int32_t)raw[i] + raw[i + 1]) >> 1));
+      }
+      fclose(f);
+      return true;
+    } else {
+      fseek(f, size + (size & 1), SEEK_CUR);
+    }
+  }
+  fprintf(stderr, "%s: no usable data chunk\n", path);
+  fclose(f);
+  return false;
+}
+
+// Windowed-sinc (Blackman) resampler; the cutoff follows the lower of the
+// two Nyquist rates so downsampling does not alias
+static std::vector<int16_t> resample(const std::vector<int16_t> &in, uint32_t from, uint32_t to)
+{
+  const double ratio = (double)to / from;
+  const double cutoff = ratio < 1 ? ratio : 1.0;
+  const double halfWidth = SINC_TAPS / cutoff;
+  size_t n = (size_t)ceil(in.size() * ratio);
+  std::vector<int16_t> out(n);
+  for (size_t i = 0; i < n; i++) {
+    double centre = i / ratio;
+    long first = (long)ceil(centre - halfWidth);
+    long last = (long)floor(centre + halfWidth);
+    double acc = 0;
+    for (long k = first; k <= last; k++) {
+      if (k < 0 || k >= (long)in.size()) continue;
+      double x = k - centre;
+      double w = 0.42 + 0.5 * cos(M_PI * x / halfWidth) + 0.08 * cos(2 * M_PI * x / halfWidth);
+      double s = x == 0 ? cutoff : sin(M_PI * cutoff * x) / (M_PI * x);
+      acc += in[k] * s * w;
+    }
+    long v = lround(acc);
+    out[i] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+  }
+  return out;
+}
+
+// "samples/Snare Hi.wav" -> "SNARE HI.WAV", what the sketch would have
+// passed to DrumSample::load()
+static std::string entryName(const std::string &path)
+{
+  size_t slash = path.find_last_of("/\\");
+  std::string base = slash == std::string::npos ? path : path.substr(slash + 1);
+  for (char &c : base) c = (char)toupper((unsigned char)c);
+  if (base.size() > sizeof(KitEntry::name) - 1) base.resize(sizeof(KitEntry::name) - 1);
+  return base;
+}
+
+static bool parseInput(const char *arg, uint8_t defaultDrum, Input &in)
+{
+  std::string s(arg);
+  in.drum = defaultDrum;
+  in.minVelocity = 0;
+  // Split "file:drum:minvel" from the right so paths may contain ':'
+  size_t c1 = s.rfind(':');
+  if (c1 != std::string::npos && c1 > 1) {
+    std::string tail = s.substr(c1 + 1);
+    size_t c0 = s.rfind(':', c1 - 1);
+    char *end;
+    if (c0 != std::string::npos && c0 > 1) {
+      std::string drum = s.substr(c0 + 1, c1 - c0 - 1);
+      long d = strtol(drum.c_str(), &end, 10);
+      double v = strtod(tail.c_str(), nullptr);
+      if (*end == 0 && !drum.empty()) {
+        in.drum = (uint8_t)d;
+        in.minVelocity = (uint8_t)lround((v < 0 ? 0 : v > 1 ? 1 : v) * 255);
+        s.resize(c0);
+      }
+    } else {
+      long d = strtol(tail.c_str(), &end, 10);
+      if (*end == 0 && !tail.empty()) {
+        in.drum = (uint8_t)d;
+        s.resize(c1);
+      }
+    }
+  }
+  if (in.drum >= DrumVoiceManager::MAX_DRUMS) {
+    fprintf(stderr, "%s: drum %u out of range (0..%u)\n", arg, in.drum, DrumVoiceManager::MAX_DRUMS - 1);
+    return false;
+  }
+  in.path = s;
+  in.name = entryName(s);
+  return true;
+}
+
+static void put32(std::vector<uint8_t> &img, size_t at, uint32_t v)
+{
+  for (int i = 0; i < 4; i++) img[at + i] = (uint8_t)(v >> (8 * i));
+}
+
+static void align4(std::vector<uint8_t> &img)
+{
+  while (img.size() & 3) img.push_back(0);
+}
+
+static std::vector<uint8_t> pack(const std::vector<Input> &inputs, const char *kitName)
+{
+  std::vector<uint8_t> img(sizeof(KitHeader) + inputs.size() * sizeof(KitEntry), 0);
+  for (size_t i = 0; i < inputs.size(); i++) {
+    const Input &in = inputs[i];
+    KitEntry e;
+    memset(&e, 0, sizeof(e));
+    strncpy(e.name, in.name.c_str(), sizeof(e.name) - 1);
+    e.samples = in.pcm.size();
+    e.drum = in.drum;
+    e.minVelocity = in.minVelocity;
+
+    // Header word and PCM, zero padded to whole blocks like DrumSample
+    e.data = img.size();
+    uint32_t header = 0x81u << 24 | e.samples;
+    for (int b = 0; b < 4; b++) img.push_back((uint8_t)(header >> (8 * b)));
+    uint32_t blocks = (e.samples + AUDIO_BLOCK_SAMPLES - 1) / AUDIO_BLOCK_SAMPLES;
+    for (uint32_t n = 0; n < blocks * AUDIO_BLOCK_SAMPLES; n++) {
+      int16_t v = n < e.samples ? in.pcm[n] : 0;
+      img.push_back((uint8_t)v);
+      img.push_back((uint8_t)(v >> 8));
+    }
+
+    // Envelope: peak of each block, 0..255, as DrumSample::load() computes it
+    e.envelope = img.size();
+    for (uint32_t b = 0; b < blocks; b++) {
+      int32_t peak = 0;
+      for (uint32_t n = b * AUDIO_BLOCK_SAMPLES; n < (b + 1) * AUDIO_BLOCK_SAMPLES && n < e.samples; n++) {
+        int32_t a = abs((int32_t)in.pcm[n]);
+        if (a > peak) peak = a;
+      }
+      img.push_back((uint8_t)((min(peak, (int32_t)32767) * 255 + 32766) / 32767));
+    }
+    align4(img);
+    memcpy(img.data() + sizeof(KitHeader) + i * sizeof(KitEntry), &e, sizeof(e));
+  }
+
+  KitHeader h;
+  memset(&h, 0, sizeof(h));
+  h.magic = KIT_MAGIC;
+  h.version = KIT_VERSION;
+  h.count = inputs.size();
+  h.bytes = img.size();
+  strncpy(h.name, kitName, sizeof(h.name) - 1);
+  memcpy(img.data(), &h, sizeof(h));
+  put32(img, offsetof(KitHeader, crc), DrumKit::crc32(img.data() + sizeof(KitHeader), img.size() - sizeof(KitHeader)));
+  return img;
+}
+
+static bool writeHeader(const char *path, const std::vector<uint8_t> &img, const char *kitName)
+{
+  FILE *f = fopen(path, "w");
+  if (!f) { perror(path); return false; }
+  std::string id = "kit_";
+  for (const char *p = kitName; *p; p++) id += isalnum((unsigned char)*p) ? (char)tolower((unsigned char)*p) : '_';
+  fprintf(f, "// Generated by kitpack; attach with DrumKit::attach(%s, sizeof(%s))\n", id.c_str(), id.c_str());
+  fprintf(f, "#pragma once\n#include <Arduino.h>\n\n");
+  fprintf(f, "PROGMEM const uint8_t %s[%zu] __attribute__((aligned(4))) = {", id.c_str(), img.size());
+  for (size_t i = 0; i < img.size(); i++) {
+    fprintf(f, "%s0x%02X,", i % 16 ? " " : "\n  ", img[i]);
+  }
+  fprintf(f, "\n};\n");
+  return fclose(f) == 0;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: kitpack [-n name] [-o out.kit] [--header out.h] file.wav[:drum[:minvel]] ...\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *kitName = "kit";
+  const char *outPath = "DRUMS.KIT";
+  const char *headerPath = nullptr;
+  std::vector<Input> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+      kitName = argv[++i];
+    } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (!strcmp(argv[i], "--header") && i + 1 < argc) {
+      headerPath = argv[++i];
+    } else if (argv[i][0] == '-') {
+      usage();
+      return 2;
+    } else {
+      Input in;
+      if (!parseInput(argv[i], (uint8_t)inputs.size(), in)) return 1;
+      inputs.push_back(in);
+    }
+  }
+  if (inputs.empty()) {
+    usage();
+    return 2;
+  }
+  if (inputs.size() > DrumKit::MAX_SAMPLES) {
+    fprintf(stderr, "%zu files, a kit holds at most %u\n", inputs.size(), DrumKit::MAX_SAMPLES);
+    return 1;
+  }
+
+  for (Input &in : inputs) {
+    std::vector<int16_t> pcm;
+    uint32_t rate;
+    if (!loadWav(in.path.c_str(), pcm, rate)) return 1;
+    if (pcm.empty() || pcm.size() > 0xFFFFFF) {
+      fprintf(stderr, "%s: %zu samples, need 1..16777215\n", in.path.c_str(), pcm.size());
+      return 1;
+    }
+    in.pcm = rate == RATE ? pcm : resample(pcm, rate, RATE);
+    for (const Input &other : inputs) {
+      if (&other != &in && other.name == in.name) {
+        fprintf(stderr, "%s: name %s used twice\n", in.path.c_str(), in.name.c_str());
+        return 1;
+      }
+    }
+  }
+
+  std::vector<uint8_t> img = pack(inputs, kitName);
+
+  // Read it back the way the sketch will
+  DrumKit kit;
+  if (!kit.attach(img.data(), img.size()) || !kit.verify()) {
+    fprintf(stderr, "packed image does not attach: %s\n", kit.error() ? kit.error() : "bad CRC");
+    return 1;
+  }
+  Serial.echo = true;
+  kit.printInfo(Serial);
+
+  FILE *f = fopen(outPath, "wb");
+  if (!f || fwrite(img.data(), 1, img.size(), f) != img.size() || fclose(f) != 0) {
+    perror(outPath);
+    return 1;
+  }
+  if (headerPath && !writeHeader(headerPath, img, kitName)) return 1;
+  kit.detach();
+  return 0;
+}
@@ -0,0 +1,56 @@
+// logdecode: print EventLog binary records (event_log.h) as text
+//
+//   logdecode [capture.bin]      (stdin if no file)
+//   stty -F /dev/ttyACM0 raw && logdecode /dev/ttyACM0
+//
+// Send 'b' to the sketch first to switch its log to binary. Bytes before
+// a 0xA5 0x5A sync are skipped, so starting mid-stream or mixing in text
+// lines is fine; a jump in sequence is reported as dropped records.
+
+#include <Arduino.h>
+#include <event_log.h>
+#include <stdio.h>
+
+// event_log.cpp's producer side is never called here
+uint32_t micros() { return 0; }
+
+int main(int argc, char **argv)
+{
+  FILE *in = argc > 1 ? fopen(argv[1], "rb") : stdin;
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  uint8_t frame[EventLog::FRAME_BYTES];
+  int have = 0;
+  bool first = true;
+  uint16_t expect = 0;
+  unsigned long records = 0, dropped = 0;
+  int c;
+  while ((c = fgetc(in)) != EOF) {
+    frame[have++] = (uint8_t)c;
+    if (have == 1 && frame[0] != EventLog::SYNC0) have = 0;
+    if (have == 2 && frame[1] != EventLog::SYNC1) have = frame[1] == EventLog::SYNC0 ? 1 : 0;
+    if (have < EventLog::FRAME_BYTES) continue;
+    have = 0;
+
+    LogRecord r;
+    memcpy(&r, frame + 2, sizeof(r));   // host and Teensy are both little endian
+    if (!first && r.sequence != expect) {
+      uint16_t gap = r.sequence - expect;
+      printf("... %u records dropped\n", gap);
+      dropped += gap;
+    }
+    first = false;
+    expect = r.sequence + 1;
+    records++;
+
+    char line[EventLog::MAX_LINE];
+    EventLog::formatDefault(line, sizeof(line), r);
+    fputs(line, stdout);
+    fflush(stdout);
+  }
+  fprintf(stderr, "%lu records, %lu dropped\n", records, dropped);
+  return 0;
+}